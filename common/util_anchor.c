@@ -0,0 +1,458 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include "util_anchor.h"
+#include "util_debug.h"
+
+#if defined (__ARM_NEON__) || defined (__aarch64__)
+#include <arm_neon.h>
+#define ANCHOR_USE_NEON
+#elif defined (__SSE__)
+#include <xmmintrin.h>
+#define ANCHOR_USE_SSE
+#endif
+
+#define ANCHOR_ALIGN    32
+#define ANCHOR_CACHE_NUM 8
+
+/* mediapipe/modules/palm_detection/palm_detection_cpu.pbtxt */
+const anchor_ssd_opt_t anchor_ssd_opt_palm = {
+    256, 256,                   /* input_w, input_h */
+    0.1171875f, 0.75f,          /* min_scale, max_scale */
+    0.5f, 0.5f,                 /* offset_x, offset_y */
+    5, {8, 16, 32, 32, 32},     /* num_layers, strides */
+    1, {1.0f},                  /* num_aspect_ratios, aspect_ratios */
+    0,                          /* reduce_boxes_in_lowest_layer */
+    1.0f,                       /* interpolated_scale_aspect_ratio */
+    1,                          /* fixed_anchor_size */
+};
+
+/* mediapipe/modules/pose_detection/pose_detection_cpu.pbtxt */
+const anchor_ssd_opt_t anchor_ssd_opt_pose = {
+    128, 128,
+    0.1484375f, 0.75f,
+    0.5f, 0.5f,
+    4, {8, 16, 16, 16},
+    1, {1.0f},
+    0,
+    1.0f,
+    1,
+};
+
+typedef struct _anchor_cache_t
+{
+    anchor_ssd_opt_t    opt;
+    anchor_table_t      tbl;
+} anchor_cache_t;
+
+static anchor_cache_t   s_cache[ANCHOR_CACHE_NUM];
+static int              s_cache_num;
+static pthread_mutex_t  s_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/* -------------------------------------------------- *
+ *  Anchor table
+ * -------------------------------------------------- */
+int
+anchor_table_alloc (anchor_table_t *tbl, int num)
+{
+    /* keep each array aligned for SIMD loads */
+    int   stride = (num + 7) & ~7;
+    void *buf;
+
+    memset (tbl, 0, sizeof (*tbl));
+
+    if (posix_memalign (&buf, ANCHOR_ALIGN, 4 * stride * sizeof (float)) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    memset (buf, 0, 4 * stride * sizeof (float));
+
+    tbl->num = num;
+    tbl->buf = buf;
+    tbl->cx  = (float *)buf + stride * 0;
+    tbl->cy  = (float *)buf + stride * 1;
+    tbl->w   = (float *)buf + stride * 2;
+    tbl->h   = (float *)buf + stride * 3;
+
+    return 0;
+}
+
+void
+anchor_table_free (anchor_table_t *tbl)
+{
+    if (tbl->buf)
+        free (tbl->buf);
+
+    memset (tbl, 0, sizeof (*tbl));
+}
+
+/*
+ * determine where the anchor points are scatterd.
+ *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
+ */
+int
+anchor_table_create_blazeface (anchor_table_t *tbl, int input_w, int input_h)
+{
+    /* ANCHORS_CONFIG  */
+    int strides[2] = {8, 16};
+    int anchors[2] = {2,  6};
+    int numtotal = 0;
+    int i, idx = 0;
+
+    for (i = 0; i < 2; i ++)
+    {
+        int gridCols = (input_w + strides[i] - 1) / strides[i];
+        int gridRows = (input_h + strides[i] - 1) / strides[i];
+        numtotal += gridCols * gridRows * anchors[i];
+    }
+
+    if (anchor_table_alloc (tbl, numtotal) < 0)
+        return -1;
+
+    for (i = 0; i < 2; i ++)
+    {
+        int stride = strides[i];
+        int gridCols = (input_w + stride - 1) / stride;
+        int gridRows = (input_h + stride - 1) / stride;
+        int anchorNum = anchors[i];
+
+        for (int gridY = 0; gridY < gridRows; gridY ++)
+        {
+            float cy = stride * (gridY + 0.5f) / (float)input_h;
+            for (int gridX = 0; gridX < gridCols; gridX ++)
+            {
+                float cx = stride * (gridX + 0.5f) / (float)input_w;
+                for (int n = 0; n < anchorNum; n ++)
+                {
+                    tbl->cx[idx] = cx;
+                    tbl->cy[idx] = cy;
+                    tbl->w [idx] = 1.0f;
+                    tbl->h [idx] = 1.0f;
+                    idx ++;
+                }
+            }
+        }
+    }
+
+    return numtotal;
+}
+
+static float
+calc_scale (const anchor_ssd_opt_t *opt, int stride_index)
+{
+    if (opt->num_layers == 1)
+        return (opt->min_scale + opt->max_scale) * 0.5f;
+    else
+        return opt->min_scale + (opt->max_scale - opt->min_scale) * 1.0 * stride_index / (opt->num_layers - 1.0f);
+}
+
+/*
+ *  port of GenerateAnchors() of
+ *    mediapipe/calculators/tflite/ssd_anchors_calculator.cc
+ */
+int
+anchor_table_create_ssd (anchor_table_t *tbl, const anchor_ssd_opt_t *opt)
+{
+    float anchor_w[ANCHOR_MAX_LAYER_NUM * (ANCHOR_MAX_ASPECT_NUM + 3)];
+    float anchor_h[ANCHOR_MAX_LAYER_NUM * (ANCHOR_MAX_ASPECT_NUM + 3)];
+    int   pass, layer_id, idx = 0, numtotal = 0;
+
+    if (opt->num_layers <= 0 || opt->num_layers > ANCHOR_MAX_LAYER_NUM ||
+        opt->num_aspect_ratios > ANCHOR_MAX_ASPECT_NUM)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* 1st pass counts the anchors, 2nd pass fills the table. */
+    for (pass = 0; pass < 2; pass ++)
+    {
+        if (pass == 1 && anchor_table_alloc (tbl, numtotal) < 0)
+            return -1;
+
+        for (layer_id = 0; layer_id < opt->num_layers; )
+        {
+            int stride = opt->strides[layer_id];
+            int last   = layer_id;
+            int num_anchors = 0;
+            int fmap_w = (opt->input_w + stride - 1) / stride;
+            int fmap_h = (opt->input_h + stride - 1) / stride;
+            int x, y, n;
+
+            /* the layers of the same stride are merged in the same order. */
+            for (; last < opt->num_layers && opt->strides[last] == stride; last ++)
+            {
+                float scale = calc_scale (opt, last);
+
+                if (last == 0 && opt->reduce_boxes_in_lowest_layer)
+                {
+                    static const float ratios[3] = {1.0f, 2.0f, 0.5f};
+                    float scales[3] = {0.1f, scale, scale};
+
+                    for (n = 0; n < 3; n ++, num_anchors ++)
+                    {
+                        anchor_w[num_anchors] = scales[n] * sqrtf (ratios[n]);
+                        anchor_h[num_anchors] = scales[n] / sqrtf (ratios[n]);
+                    }
+                    continue;
+                }
+
+                for (n = 0; n < opt->num_aspect_ratios; n ++, num_anchors ++)
+                {
+                    float ratio_sqrt = sqrtf (opt->aspect_ratios[n]);
+                    anchor_w[num_anchors] = scale * ratio_sqrt;
+                    anchor_h[num_anchors] = scale / ratio_sqrt;
+                }
+
+                if (opt->interpolated_scale_aspect_ratio > 0.0f)
+                {
+                    float scale_next = (last == opt->num_layers - 1) ? 1.0f : calc_scale (opt, last + 1);
+                    float ratio_sqrt = sqrtf (opt->interpolated_scale_aspect_ratio);
+                    float s = sqrtf (scale * scale_next);
+
+                    anchor_w[num_anchors] = s * ratio_sqrt;
+                    anchor_h[num_anchors] = s / ratio_sqrt;
+                    num_anchors ++;
+                }
+            }
+
+            if (pass == 0)
+            {
+                numtotal += fmap_w * fmap_h * num_anchors;
+                layer_id = last;
+                continue;
+            }
+
+            for (y = 0; y < fmap_h; y ++)
+            {
+                float cy = (y + opt->offset_y) / (float)fmap_h;
+                for (x = 0; x < fmap_w; x ++)
+                {
+                    float cx = (x + opt->offset_x) / (float)fmap_w;
+                    for (n = 0; n < num_anchors; n ++)
+                    {
+                        tbl->cx[idx] = cx;
+                        tbl->cy[idx] = cy;
+                        tbl->w [idx] = opt->fixed_anchor_size ? 1.0f : anchor_w[n];
+                        tbl->h [idx] = opt->fixed_anchor_size ? 1.0f : anchor_h[n];
+                        idx ++;
+                    }
+                }
+            }
+            layer_id = last;
+        }
+    }
+
+    return numtotal;
+}
+
+static int
+ssd_opt_equal (const anchor_ssd_opt_t *a, const anchor_ssd_opt_t *b)
+{
+    int i;
+
+    if (a->input_w    != b->input_w    || a->input_h    != b->input_h    ||
+        a->min_scale  != b->min_scale  || a->max_scale  != b->max_scale  ||
+        a->offset_x   != b->offset_x   || a->offset_y   != b->offset_y   ||
+        a->num_layers != b->num_layers || a->num_aspect_ratios != b->num_aspect_ratios ||
+        a->reduce_boxes_in_lowest_layer    != b->reduce_boxes_in_lowest_layer    ||
+        a->interpolated_scale_aspect_ratio != b->interpolated_scale_aspect_ratio ||
+        a->fixed_anchor_size               != b->fixed_anchor_size)
+        return 0;
+
+    for (i = 0; i < a->num_layers; i ++)
+    {
+        if (a->strides[i] != b->strides[i])
+            return 0;
+    }
+    for (i = 0; i < a->num_aspect_ratios; i ++)
+    {
+        if (a->aspect_ratios[i] != b->aspect_ratios[i])
+            return 0;
+    }
+    return 1;
+}
+
+static const anchor_table_t *
+find_cache (const anchor_ssd_opt_t *opt)
+{
+    int i;
+
+    for (i = 0; i < s_cache_num; i ++)
+    {
+        if (ssd_opt_equal (&s_cache[i].opt, opt))
+            return &s_cache[i].tbl;
+    }
+    return NULL;
+}
+
+const anchor_table_t *
+anchor_table_get_ssd (const anchor_ssd_opt_t *opt)
+{
+    const anchor_table_t *tbl;
+
+    pthread_mutex_lock (&s_cache_mutex);
+
+    tbl = find_cache (opt);
+    if (tbl == NULL && s_cache_num < ANCHOR_CACHE_NUM)
+    {
+        anchor_cache_t *cache = &s_cache[s_cache_num];
+
+        if (anchor_table_create_ssd (&cache->tbl, opt) >= 0)
+        {
+            cache->opt = *opt;
+            tbl = &cache->tbl;
+            s_cache_num ++;
+        }
+    }
+
+    pthread_mutex_unlock (&s_cache_mutex);
+
+    if (tbl == NULL)
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+
+    return tbl;
+}
+
+
+/* -------------------------------------------------- *
+ *  Decode
+ * -------------------------------------------------- */
+
+/*
+ *  sigmoid(x) > thresh  <==>  x > logit(thresh)
+ *  so the raw classificator output can be compared without exp().
+ */
+float
+anchor_logit (float score)
+{
+    if (score <= 0.0f)
+        return -FLT_MAX;
+    if (score >= 1.0f)
+        return FLT_MAX;
+
+    return logf (score / (1.0f - score));
+}
+
+/* return the index of the next anchor whose raw score exceeds the threshold. */
+static int
+find_next_candidate (const float *scores, int start, int num, float logit_thresh)
+{
+    int i = start;
+
+#if defined (ANCHOR_USE_NEON)
+    float32x4_t vthresh = vdupq_n_f32 (logit_thresh);
+    for (; i + 4 <= num; i += 4)
+    {
+        uint32x4_t mask = vcgtq_f32 (vld1q_f32 (&scores[i]), vthresh);
+        uint32x2_t mor  = vorr_u32 (vget_low_u32 (mask), vget_high_u32 (mask));
+        if (vget_lane_u32 (vpmax_u32 (mor, mor), 0))
+            break;
+    }
+#elif defined (ANCHOR_USE_SSE)
+    __m128 vthresh = _mm_set1_ps (logit_thresh);
+    for (; i + 4 <= num; i += 4)
+    {
+        int mask = _mm_movemask_ps (_mm_cmpgt_ps (_mm_loadu_ps (&scores[i]), vthresh));
+        if (mask)
+            return i + __builtin_ctz (mask);
+    }
+#endif
+
+    for (; i < num; i ++)
+    {
+        if (scores[i] > logit_thresh)
+            return i;
+    }
+    return num;
+}
+
+/*
+ *  decode the regressors of BlazeFace style SSD detectors:
+ *    [cx, cy, w, h, key0_x, key0_y, key1_x, key1_y, ...] per anchor
+ *
+ *  results are written to dets[] (up to max_dets). if more candidates
+ *  than max_dets survive, the lowest scored ones are dropped.
+ *  returns the number of detections.
+ */
+int
+anchor_decode_blazeface (const anchor_table_t *tbl, const float *scores, const float *bboxes,
+                         const anchor_decode_opt_t *opt, anchor_detect_t *dets, int max_dets)
+{
+    float logit_thresh = anchor_logit (opt->score_thresh);
+    float scale_x  = 1.0f / (float)opt->input_w;
+    float scale_y  = 1.0f / (float)opt->input_h;
+    int   num_keys = opt->num_keys;
+    int   num_dets = 0;
+    int   num = tbl->num;
+    int   i, j;
+
+    if (num_keys > ANCHOR_MAX_KEY_NUM)
+        num_keys = ANCHOR_MAX_KEY_NUM;
+
+    if (max_dets <= 0)
+        return 0;
+
+    for (i = find_next_candidate (scores, 0, num, logit_thresh); i < num;
+         i = find_next_candidate (scores, i + 1, num, logit_thresh))
+    {
+        float score = 1.0f / (1.0f + expf (-scores[i]));
+        anchor_detect_t *det;
+
+        if (num_dets < max_dets)
+        {
+            det = &dets[num_dets ++];
+        }
+        else
+        {
+            /* buffer is full. replace the weakest one. */
+            int min_idx = 0;
+            for (j = 1; j < max_dets; j ++)
+            {
+                if (dets[j].score < dets[min_idx].score)
+                    min_idx = j;
+            }
+            if (score <= dets[min_idx].score)
+                continue;
+
+            det = &dets[min_idx];
+        }
+
+        const float *p = &bboxes[i * opt->num_coords];
+        float anchor_cx = tbl->cx[i];
+        float anchor_cy = tbl->cy[i];
+        float anchor_w  = tbl->w[i] * scale_x;
+        float anchor_h  = tbl->h[i] * scale_y;
+
+        /* boundary box */
+        float cx = p[0] * anchor_w + anchor_cx;
+        float cy = p[1] * anchor_h + anchor_cy;
+        float w  = p[2] * anchor_w;
+        float h  = p[3] * anchor_h;
+
+        det->anchor_idx = i;
+        det->score = score;
+        det->x0    = cx - w * 0.5f;
+        det->y0    = cy - h * 0.5f;
+        det->x1    = cx + w * 0.5f;
+        det->y1    = cy + h * 0.5f;
+
+        /* landmark positions */
+        for (j = 0; j < num_keys; j ++)
+        {
+            det->keys[j][0] = p[4 + (2 * j) + 0] * anchor_w + anchor_cx;
+            det->keys[j][1] = p[4 + (2 * j) + 1] * anchor_h + anchor_cy;
+        }
+    }
+
+    return num_dets;
+}
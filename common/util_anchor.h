@@ -0,0 +1,95 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_ANCHOR_H_
+#define _UTIL_ANCHOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ANCHOR_MAX_KEY_NUM  8
+#define ANCHOR_MAX_LAYER_NUM 8
+#define ANCHOR_MAX_ASPECT_NUM 8
+
+/*
+ *  anchor table (SoA).
+ *  all coordinates are normalized to the model input size [0, 1].
+ */
+typedef struct _anchor_table_t
+{
+    int     num;
+    float   *cx;
+    float   *cy;
+    float   *w;
+    float   *h;
+    void    *buf;       /* single aligned allocation backing cx/cy/w/h */
+} anchor_table_t;
+
+/*
+ *  SSD anchor options (mediapipe/calculators/tflite/ssd_anchors_calculator.proto)
+ *  the layers of the same stride are merged into one feature map.
+ */
+typedef struct _anchor_ssd_opt_t
+{
+    int     input_w;
+    int     input_h;
+    float   min_scale;
+    float   max_scale;
+    float   offset_x;       /* center of the anchor in the scale of stride. (0.5) */
+    float   offset_y;
+    int     num_layers;
+    int     strides[ANCHOR_MAX_LAYER_NUM];
+    int     num_aspect_ratios;
+    float   aspect_ratios[ANCHOR_MAX_ASPECT_NUM];
+    int     reduce_boxes_in_lowest_layer;
+    float   interpolated_scale_aspect_ratio;
+    int     fixed_anchor_size;  /* w = h = 1.0 */
+} anchor_ssd_opt_t;
+
+/* presets of the mediapipe detectors */
+extern const anchor_ssd_opt_t anchor_ssd_opt_palm;     /* palm_detection  256x256 */
+extern const anchor_ssd_opt_t anchor_ssd_opt_pose;     /* pose_detection  128x128 */
+
+typedef struct _anchor_decode_opt_t
+{
+    float   score_thresh;   /* threshold after sigmoid            */
+    int     num_keys;       /* number of (x, y) keypoints         */
+    int     num_coords;     /* stride of the regressors tensor    */
+    int     input_w;        /* model input width  [pixel]         */
+    int     input_h;        /* model input height [pixel]         */
+} anchor_decode_opt_t;
+
+typedef struct _anchor_detect_t
+{
+    int     anchor_idx;
+    float   score;
+    float   x0, y0;         /* topleft  (normalized) */
+    float   x1, y1;         /* btmright (normalized) */
+    float   keys[ANCHOR_MAX_KEY_NUM][2];
+} anchor_detect_t;
+
+
+int   anchor_table_alloc (anchor_table_t *tbl, int num);
+void  anchor_table_free  (anchor_table_t *tbl);
+int   anchor_table_create_blazeface (anchor_table_t *tbl, int input_w, int input_h);
+int   anchor_table_create_ssd (anchor_table_t *tbl, const anchor_ssd_opt_t *opt);
+
+/*
+ *  the table of (opt), shared in the process. it is generated at the first
+ *  request of the options and never freed, so the sessions of the same model
+ *  don't generate their own copies. returns NULL on failure.
+ */
+const anchor_table_t *anchor_table_get_ssd (const anchor_ssd_opt_t *opt);
+
+float anchor_logit (float score);
+
+int   anchor_decode_blazeface (const anchor_table_t *tbl, const float *scores, const float *bboxes,
+                               const anchor_decode_opt_t *opt, anchor_detect_t *dets, int max_dets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_ANCHOR_H_ */
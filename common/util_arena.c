@@ -0,0 +1,209 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "util_arena.h"
+#include "util_debug.h"
+
+#define ALIGN_UP(x)     (((x) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+struct _arena_block_t
+{
+    arena_block_t   *next;
+    char            pad[ARENA_ALIGN - sizeof (arena_block_t *)];
+    /* data follows */
+};
+
+static pthread_key_t    s_thread_key;
+static pthread_once_t   s_thread_once = PTHREAD_ONCE_INIT;
+
+
+/* -------------------------------------------------- *
+ *  arena
+ * -------------------------------------------------- */
+int
+arena_init (arena_t *arena, size_t size)
+{
+    void *ptr = NULL;
+
+    memset (arena, 0, sizeof (*arena));
+
+    size = ALIGN_UP (size);
+    if (size > 0 && posix_memalign (&ptr, ARENA_ALIGN, size) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    arena->buf  = (char *)ptr;
+    arena->size = size;
+    return 0;
+}
+
+static void
+free_overflow (arena_t *arena)
+{
+    arena_block_t *blk = arena->overflow;
+
+    while (blk)
+    {
+        arena_block_t *next = blk->next;
+        free (blk);
+        blk = next;
+    }
+    arena->overflow = NULL;
+}
+
+void
+arena_destroy (arena_t *arena)
+{
+    free_overflow (arena);
+
+    if (arena->buf)
+        free (arena->buf);
+
+    memset (arena, 0, sizeof (*arena));
+}
+
+void
+arena_reset (arena_t *arena)
+{
+    /* the last frame didn't fit. grow to its peak, while nothing is in use. */
+    if (arena->overflow)
+    {
+        size_t size = ALIGN_UP (arena->peak + arena->peak / 4);
+        void *ptr;
+
+        free_overflow (arena);
+
+        if (posix_memalign (&ptr, ARENA_ALIGN, size) == 0)
+        {
+            if (arena->buf)
+                free (arena->buf);
+            arena->buf  = (char *)ptr;
+            arena->size = size;
+        }
+    }
+
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+void *
+arena_alloc (arena_t *arena, size_t size)
+{
+    arena_block_t *blk;
+    void *ptr;
+
+    size = ALIGN_UP (size);
+    arena->peak += size;
+
+    if (arena->used + size <= arena->size)
+    {
+        ptr = arena->buf + arena->used;
+        arena->used += size;
+        return ptr;
+    }
+
+    if (posix_memalign (&ptr, ARENA_ALIGN, sizeof (arena_block_t) + size) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return NULL;
+    }
+    blk = (arena_block_t *)ptr;
+
+    blk->next = arena->overflow;
+    arena->overflow = blk;
+
+    return (char *)blk + sizeof (arena_block_t);
+}
+
+
+/* -------------------------------------------------- *
+ *  per-thread arena
+ * -------------------------------------------------- */
+static void
+destroy_thread_arena (void *ptr)
+{
+    arena_destroy ((arena_t *)ptr);
+    free (ptr);
+}
+
+static void
+create_thread_key ()
+{
+    pthread_key_create (&s_thread_key, destroy_thread_arena);
+}
+
+arena_t *
+arena_get_thread ()
+{
+    arena_t *arena;
+
+    pthread_once (&s_thread_once, create_thread_key);
+
+    arena = (arena_t *)pthread_getspecific (s_thread_key);
+    if (arena)
+        return arena;
+
+    arena = (arena_t *)malloc (sizeof (arena_t));
+    if (arena == NULL || arena_init (arena, ARENA_DEFAULT_SIZE) < 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        free (arena);
+        return NULL;
+    }
+
+    pthread_setspecific (s_thread_key, arena);
+    return arena;
+}
+
+
+/* -------------------------------------------------- *
+ *  vector
+ * -------------------------------------------------- */
+void
+arena_vec_init (arena_vec_t *vec, arena_t *arena, int item_size, int capacity)
+{
+    vec->arena     = arena;
+    vec->num       = 0;
+    vec->item_size = item_size;
+    vec->capacity  = 0;
+    vec->data      = NULL;
+
+    if (capacity > 0)
+    {
+        vec->data = arena_alloc (arena, (size_t)item_size * capacity);
+        if (vec->data)
+            vec->capacity = capacity;
+    }
+}
+
+void *
+arena_vec_push (arena_vec_t *vec)
+{
+    char *item;
+
+    if (vec->num >= vec->capacity)
+    {
+        int  capacity = vec->capacity ? vec->capacity * 2 : 8;
+        void *data = arena_alloc (vec->arena, (size_t)vec->item_size * capacity);
+        if (data == NULL)
+            return NULL;
+
+        if (vec->num > 0)
+            memcpy (data, vec->data, (size_t)vec->item_size * vec->num);
+
+        vec->data     = data;
+        vec->capacity = capacity;
+    }
+
+    item = (char *)vec->data + (size_t)vec->item_size * vec->num ++;
+    memset (item, 0, vec->item_size);
+
+    return item;
+}
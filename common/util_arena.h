@@ -0,0 +1,80 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_ARENA_H_
+#define _UTIL_ARENA_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  per-frame scratch memory for the post-processing.
+ *
+ *  a bump allocator which is reset at the frame boundary, so that the
+ *  decode loops don't call malloc()/free(). what doesn't fit is taken
+ *  from the heap for the frame, and the buffer grows to the peak usage
+ *  at the next arena_reset(). the steady-state frames allocate nothing.
+ *
+ *      arena_t *arena = arena_get_thread ();
+ *      arena_reset (arena);
+ *      float *votes = (float *)arena_alloc (arena, 16 * sizeof (float));
+ *
+ *  an arena is not thread safe. use arena_get_thread() to get the one
+ *  of the calling thread.
+ */
+#define ARENA_ALIGN             16
+#define ARENA_DEFAULT_SIZE      (64 * 1024)
+
+typedef struct _arena_block_t arena_block_t;
+
+typedef struct _arena_t
+{
+    char            *buf;
+    size_t          size;
+    size_t          used;
+    size_t          peak;           /* max usage since the last reset (including the overflow) */
+    arena_block_t   *overflow;      /* heap blocks of this frame */
+} arena_t;
+
+int   arena_init    (arena_t *arena, size_t size);
+void  arena_destroy (arena_t *arena);
+
+/* release everything allocated from the arena. */
+void  arena_reset   (arena_t *arena);
+
+/* ARENA_ALIGN aligned. returns NULL only when the heap is exhausted. */
+void *arena_alloc   (arena_t *arena, size_t size);
+
+/* the arena of the calling thread. created on the first call, freed at the thread exit. */
+arena_t *arena_get_thread ();
+
+
+/*
+ *  growable array in an arena. the old storage is left in the arena
+ *  when it grows, so reserve the expected capacity at the init.
+ */
+typedef struct _arena_vec_t
+{
+    arena_t *arena;
+    void    *data;
+    int     num;
+    int     capacity;
+    int     item_size;
+} arena_vec_t;
+
+void  arena_vec_init (arena_vec_t *vec, arena_t *arena, int item_size, int capacity);
+
+/* append an item (zero cleared) and returns it. NULL on allocation failure. */
+void *arena_vec_push (arena_vec_t *vec);
+
+#define ARENA_VEC_AT(vec, type, i)  (((type *)(vec)->data)[i])
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_ARENA_H_ */
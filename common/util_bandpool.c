@@ -0,0 +1,146 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "util_bandpool.h"
+
+
+static void *
+bandpool_thread_main (void *arg)
+{
+    bandpool_worker_t *worker = (bandpool_worker_t *)arg;
+    bandpool_t *pool = worker->pool;
+
+    pthread_mutex_lock (&pool->mutex);
+    while (1)
+    {
+        while (pool->job_seq == worker->seq && !pool->quit)
+            pthread_cond_wait (&pool->start_cond, &pool->mutex);
+
+        if (pool->quit)
+            break;
+
+        worker->seq = pool->job_seq;
+        if (worker->id >= pool->num_bands)
+            continue;
+
+        pthread_mutex_unlock (&pool->mutex);
+        pool->func (pool->job, worker->id);
+        pthread_mutex_lock (&pool->mutex);
+
+        if (-- pool->num_running == 0)
+            pthread_cond_signal (&pool->done_cond);
+    }
+    pthread_mutex_unlock (&pool->mutex);
+
+    return NULL;
+}
+
+int
+bandpool_init (bandpool_t *pool, int num_threads)
+{
+    int i;
+
+    if (pool->num_threads > 1)
+        return 0;
+
+    if (num_threads <= 0)
+        num_threads = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > BANDPOOL_MAX_THREADS)
+        num_threads = BANDPOOL_MAX_THREADS;
+
+    pthread_mutex_lock (&pool->mutex);
+    pool->quit = 0;
+    pthread_mutex_unlock (&pool->mutex);
+
+    for (i = 1; i < num_threads; i ++)
+    {
+        bandpool_worker_t *worker = &pool->workers[i];
+
+        /* start from the current job. a worker of a restarted pool must not
+         * take the last job of the previous one. */
+        worker->pool = pool;
+        worker->id   = i;
+        worker->seq  = pool->job_seq;
+
+        if (pthread_create (&pool->threads[i], NULL, bandpool_thread_main, worker) != 0)
+        {
+            fprintf (stderr, "ERR: %s(%d): pthread_create() failed.\n", __FILE__, __LINE__);
+            break;
+        }
+    }
+    pool->num_threads = i;
+
+    return 0;
+}
+
+void
+bandpool_terminate (bandpool_t *pool)
+{
+    int i;
+
+    pthread_mutex_lock (&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast (&pool->start_cond);
+    pthread_mutex_unlock (&pool->mutex);
+
+    for (i = 1; i < pool->num_threads; i ++)
+        pthread_join (pool->threads[i], NULL);
+
+    pool->num_threads = 1;
+}
+
+int
+bandpool_get_num_threads (bandpool_t *pool)
+{
+    return pool->num_threads;
+}
+
+int
+bandpool_split (bandpool_t *pool, int num_items, int min_items)
+{
+    int num_bands = num_items / min_items;
+
+    if (num_bands > pool->num_threads)
+        num_bands = pool->num_threads;
+    if (num_bands < 1)
+        num_bands = 1;
+
+    return num_bands;
+}
+
+void
+bandpool_run (bandpool_t *pool, bandpool_func_t func, void *job, int num_bands)
+{
+    if (num_bands <= 1)
+    {
+        func (job, 0);
+        return;
+    }
+
+    /* one job at a time. the workers are shared by all the callers. */
+    pthread_mutex_lock (&pool->call_mutex);
+
+    pthread_mutex_lock (&pool->mutex);
+    pool->func        = func;
+    pool->job         = job;
+    pool->num_bands   = num_bands;
+    pool->num_running = num_bands - 1;
+    pool->job_seq ++;
+    pthread_cond_broadcast (&pool->start_cond);
+    pthread_mutex_unlock (&pool->mutex);
+
+    func (job, 0);
+
+    pthread_mutex_lock (&pool->mutex);
+    while (pool->num_running > 0)
+        pthread_cond_wait (&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock (&pool->mutex);
+
+    pthread_mutex_unlock (&pool->call_mutex);
+}
@@ -0,0 +1,84 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_BANDPOOL_H_
+#define _UTIL_BANDPOOL_H_
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  worker threads which split one job into bands (e.g. rows of an image).
+ *  band 0 is processed by the calling thread, the others by the workers.
+ *
+ *      static bandpool_t s_pool = BANDPOOL_INITIALIZER;
+ *
+ *      bandpool_init (&s_pool, num_threads);
+ *      num_bands = bandpool_split (&s_pool, w * h, 4096);
+ *      bandpool_run (&s_pool, run_band, &job, num_bands);
+ *      bandpool_terminate (&s_pool);
+ *
+ *  without bandpool_init(), bandpool_run() runs all the bands on the calling thread.
+ */
+#define BANDPOOL_MAX_THREADS    8
+
+typedef void (*bandpool_func_t) (void *job, int band);
+
+struct _bandpool_t;
+
+typedef struct _bandpool_worker_t
+{
+    struct _bandpool_t  *pool;
+    int                 id;
+    int                 seq;            /* the last job seen */
+} bandpool_worker_t;
+
+typedef struct _bandpool_t
+{
+    pthread_t           threads[BANDPOOL_MAX_THREADS];
+    bandpool_worker_t   workers[BANDPOOL_MAX_THREADS];
+    int                 num_threads;    /* including the calling thread */
+
+    pthread_mutex_t     call_mutex;     /* one job at a time */
+    pthread_mutex_t     mutex;
+    pthread_cond_t      start_cond;
+    pthread_cond_t      done_cond;
+
+    /* the current job (protected by mutex) */
+    bandpool_func_t     func;
+    void                *job;
+    int                 num_bands;
+    int                 job_seq;
+    int                 num_running;
+    int                 quit;
+} bandpool_t;
+
+#define BANDPOOL_INITIALIZER                    \
+    { .num_threads = 1,                         \
+      .call_mutex  = PTHREAD_MUTEX_INITIALIZER, \
+      .mutex       = PTHREAD_MUTEX_INITIALIZER, \
+      .start_cond  = PTHREAD_COND_INITIALIZER,  \
+      .done_cond   = PTHREAD_COND_INITIALIZER }
+
+/* start the workers. (num_threads = 0: number of online CPUs) */
+int  bandpool_init      (bandpool_t *pool, int num_threads);
+void bandpool_terminate (bandpool_t *pool);
+
+int  bandpool_get_num_threads (bandpool_t *pool);
+
+/* number of bands for (num_items), at least (min_items) per band. */
+int  bandpool_split (bandpool_t *pool, int num_items, int min_items);
+
+/* run func (job, band) for all the bands, and wait for them.
+ * (num_bands) must not exceed the number of threads. see bandpool_split(). */
+void bandpool_run (bandpool_t *pool, bandpool_func_t func, void *job, int num_bands);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_BANDPOOL_H_ */
@@ -0,0 +1,836 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "util_bench.h"
+#include "util_warp.h"
+#include "util_debug.h"
+
+/* the bench targets don't link util_texture.c, which has the GL dependency. */
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+
+double
+bench_get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + (double)tv.tv_nsec / 1000000.0);
+}
+
+
+/* -------------------------------------------------- *
+ *  Input images
+ * -------------------------------------------------- */
+static int
+has_suffix (const char *name, const char *suffix)
+{
+    int len0 = strlen (name);
+    int len1 = strlen (suffix);
+
+    if (len0 < len1)
+        return 0;
+    return (strcasecmp (name + len0 - len1, suffix) == 0);
+}
+
+/* raw frames (*.rgba, *.rgb) carry no header. the size is given by the user. */
+static int
+load_raw_frame (bench_image_t *img, const char *path, int raw_w, int raw_h)
+{
+    int bpp = has_suffix (path, ".rgb") ? 3 : 4;
+    int num = raw_w * raw_h;
+    unsigned char *buf;
+    FILE *fp;
+    int i;
+
+    if (raw_w <= 0 || raw_h <= 0)
+    {
+        fprintf (stderr, "ERR: %s(%d): size of raw frame \"%s\" is not specified\n", __FILE__, __LINE__, path);
+        return -1;
+    }
+
+    fp = fopen (path, "rb");
+    if (fp == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d): can't open \"%s\"\n", __FILE__, __LINE__, path);
+        return -1;
+    }
+
+    buf = (unsigned char *)malloc (num * 4);
+    if (fread (buf, bpp, num, fp) != (size_t)num)
+    {
+        fprintf (stderr, "ERR: %s(%d): \"%s\" is shorter than %dx%d\n", __FILE__, __LINE__, path, raw_w, raw_h);
+        free (buf);
+        fclose (fp);
+        return -1;
+    }
+    fclose (fp);
+
+    /* expand RGB to RGBA in place, from the tail */
+    if (bpp == 3)
+    {
+        for (i = num - 1; i >= 0; i --)
+        {
+            buf[i * 4 + 3] = 0xFF;
+            buf[i * 4 + 2] = buf[i * 3 + 2];
+            buf[i * 4 + 1] = buf[i * 3 + 1];
+            buf[i * 4 + 0] = buf[i * 3 + 0];
+        }
+    }
+
+    img->w    = raw_w;
+    img->h    = raw_h;
+    img->rgba = buf;
+    return 0;
+}
+
+static int
+load_image (bench_image_t *img, const char *path, int raw_w, int raw_h)
+{
+    int comp;
+
+    snprintf (img->path, sizeof (img->path), "%s", path);
+
+    if (has_suffix (path, ".rgba") || has_suffix (path, ".rgb") || has_suffix (path, ".raw"))
+        return load_raw_frame (img, path, raw_w, raw_h);
+
+    img->rgba = stbi_load (path, &img->w, &img->h, &comp, 4);
+    if (img->rgba == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d): can't load \"%s\" (%s)\n", __FILE__, __LINE__,
+                 path, stbi_failure_reason ());
+        return -1;
+    }
+    return 0;
+}
+
+static int
+is_image_file (const char *name)
+{
+    static const char *suffix[] = {".jpg", ".jpeg", ".png", ".bmp", ".tga", ".ppm", ".pgm",
+                                   ".rgba", ".rgb", ".raw"};
+    int i;
+
+    for (i = 0; i < (int)(sizeof (suffix) / sizeof (suffix[0])); i ++)
+    {
+        if (has_suffix (name, suffix[i]))
+            return 1;
+    }
+    return 0;
+}
+
+static int
+compare_name (const void *a, const void *b)
+{
+    return strcmp (*(const char **)a, *(const char **)b);
+}
+
+/*
+ *  load all images in the directory (sorted by file name), or a single image.
+ *  returns the number of loaded images.
+ */
+int
+bench_load_images (const char *path, int raw_w, int raw_h, bench_image_t **images)
+{
+    struct stat st;
+    struct dirent *ent;
+    char **names = NULL;
+    int num_names = 0;
+    int num = 0;
+    DIR *dir;
+    int i;
+
+    *images = NULL;
+
+    if (stat (path, &st) != 0)
+    {
+        fprintf (stderr, "ERR: %s(%d): can't find \"%s\"\n", __FILE__, __LINE__, path);
+        return -1;
+    }
+
+    if (!S_ISDIR (st.st_mode))
+    {
+        *images = (bench_image_t *)calloc (1, sizeof (bench_image_t));
+        if (load_image (*images, path, raw_w, raw_h) < 0)
+        {
+            free (*images);
+            *images = NULL;
+            return -1;
+        }
+        return 1;
+    }
+
+    dir = opendir (path);
+    if (dir == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d): can't open \"%s\"\n", __FILE__, __LINE__, path);
+        return -1;
+    }
+
+    while ((ent = readdir (dir)) != NULL)
+    {
+        if (ent->d_name[0] == '.' || !is_image_file (ent->d_name))
+            continue;
+
+        names = (char **)realloc (names, (num_names + 1) * sizeof (char *));
+        names[num_names ++] = strdup (ent->d_name);
+    }
+    closedir (dir);
+
+    qsort (names, num_names, sizeof (char *), compare_name);
+
+    *images = (bench_image_t *)calloc (num_names > 0 ? num_names : 1, sizeof (bench_image_t));
+    for (i = 0; i < num_names; i ++)
+    {
+        char fname[512];
+
+        snprintf (fname, sizeof (fname), "%s/%s", path, names[i]);
+        if (load_image (&(*images)[num], fname, raw_w, raw_h) == 0)
+            num ++;
+
+        free (names[i]);
+    }
+    free (names);
+
+    if (num == 0)
+    {
+        fprintf (stderr, "ERR: %s(%d): no image found in \"%s\"\n", __FILE__, __LINE__, path);
+        free (*images);
+        *images = NULL;
+        return -1;
+    }
+
+    return num;
+}
+
+void
+bench_free_images (bench_image_t *images, int num)
+{
+    int i;
+
+    if (images == NULL)
+        return;
+
+    for (i = 0; i < num; i ++)
+        free (images[i].rgba);      /* stbi_image_free() is free() */
+
+    free (images);
+}
+
+
+/* -------------------------------------------------- *
+ *  Latency statistics
+ * -------------------------------------------------- */
+int
+bench_stat_init (bench_stat_t *st, const char *name, int capacity)
+{
+    memset (st, 0, sizeof (*st));
+    snprintf (st->name, sizeof (st->name), "%s", name);
+
+    st->samples = (double *)malloc ((capacity > 0 ? capacity : 1) * sizeof (double));
+    if (st->samples == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    st->capacity = capacity;
+
+    return 0;
+}
+
+void
+bench_stat_destroy (bench_stat_t *st)
+{
+    if (st->samples)
+        free (st->samples);
+
+    memset (st, 0, sizeof (*st));
+}
+
+void
+bench_stat_add (bench_stat_t *st, double ms)
+{
+    if (st->num >= st->capacity)
+    {
+        st->capacity = st->capacity * 2 + 16;
+        st->samples  = (double *)realloc (st->samples, st->capacity * sizeof (double));
+    }
+    st->samples[st->num ++] = ms;
+}
+
+void
+bench_stat_add_stage (bench_stat_t *stats, int idx, double t0, double t1, double t2, double invoke_ms)
+{
+    bench_stat_add (&stats[idx + 0], t1 - t0);
+    bench_stat_add (&stats[idx + 1], invoke_ms);
+    bench_stat_add (&stats[idx + 2], t2 - t1 - invoke_ms);
+}
+
+static int
+compare_double (const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/*
+ *  nearest-rank percentile. the samples are sorted in place, so call
+ *  this after all the samples are collected.
+ */
+double
+bench_stat_percentile (bench_stat_t *st, double percent)
+{
+    int rank;
+
+    if (st->num == 0)
+        return 0.0;
+
+    qsort (st->samples, st->num, sizeof (double), compare_double);
+
+    rank = (int)(percent / 100.0 * st->num + 0.999999);
+    if (rank < 1)       rank = 1;
+    if (rank > st->num) rank = st->num;
+
+    return st->samples[rank - 1];
+}
+
+double
+bench_stat_mean (bench_stat_t *st)
+{
+    double sum = 0.0;
+    int i;
+
+    if (st->num == 0)
+        return 0.0;
+
+    for (i = 0; i < st->num; i ++)
+        sum += st->samples[i];
+
+    return sum / st->num;
+}
+
+
+/* -------------------------------------------------- *
+ *  Report (JSON)
+ * -------------------------------------------------- */
+void
+bench_report_add_stat (bench_report_t *rep, bench_stat_t *st)
+{
+    if (rep->num_stats < BENCH_MAX_STATS)
+        rep->stats[rep->num_stats ++] = st;
+}
+
+static void
+write_json_string (FILE *fp, const char *str)
+{
+    fputc ('"', fp);
+    for (; str && *str; str ++)
+    {
+        if (*str == '"' || *str == '\\')
+            fputc ('\\', fp);
+        if ((unsigned char)*str < 0x20)
+            continue;
+        fputc (*str, fp);
+    }
+    fputc ('"', fp);
+}
+
+int
+bench_report_write_json (const bench_report_t *rep, FILE *fp)
+{
+    double fps = (rep->total_ms > 0.0) ? rep->iterations * 1000.0 / rep->total_ms : 0.0;
+    int i;
+
+    fprintf (fp, "{\n");
+    fprintf (fp, "  \"app\": ");        write_json_string (fp, rep->app);   fprintf (fp, ",\n");
+    fprintf (fp, "  \"input\": ");      write_json_string (fp, rep->input); fprintf (fp, ",\n");
+    fprintf (fp, "  \"num_images\": %d,\n", rep->num_images);
+    fprintf (fp, "  \"warmup\": %d,\n",      rep->warmup);
+    fprintf (fp, "  \"iterations\": %d,\n",  rep->iterations);
+    fprintf (fp, "  \"total_ms\": %.3f,\n",  rep->total_ms);
+    fprintf (fp, "  \"fps\": %.3f,\n",       fps);
+    fprintf (fp, "  \"latency_ms\": {");
+
+    for (i = 0; i < rep->num_stats; i ++)
+    {
+        bench_stat_t *st = rep->stats[i];
+        double mean = bench_stat_mean (st);
+        double p50  = bench_stat_percentile (st, 50.0);
+        double p95  = bench_stat_percentile (st, 95.0);
+        double p99  = bench_stat_percentile (st, 99.0);
+        double vmin = st->num ? st->samples[0] : 0.0;
+        double vmax = st->num ? st->samples[st->num - 1] : 0.0;
+
+        fprintf (fp, "%s\n    ", (i == 0) ? "" : ",");
+        write_json_string (fp, st->name);
+        fprintf (fp, ": {\"count\": %d, \"mean\": %.3f, \"min\": %.3f, \"max\": %.3f, "
+                     "\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f}",
+                 st->num, mean, vmin, vmax, p50, p95, p99);
+    }
+    fprintf (fp, "\n  }\n");
+    fprintf (fp, "}\n");
+
+    return ferror (fp) ? -1 : 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  Driver
+ * -------------------------------------------------- */
+void
+bench_opt_init (bench_opt_t *opt)
+{
+    memset (opt, 0, sizeof (*opt));
+    opt->warmup     = 10;
+    opt->iterations = 100;
+}
+
+int
+bench_opt_parse (bench_opt_t *opt, int c, const char *arg)
+{
+    switch (c)
+    {
+    case 'w':
+        opt->warmup = atoi (arg);
+        return 1;
+    case 'n':
+        opt->iterations = atoi (arg);
+        return (opt->iterations > 0) ? 1 : -1;
+    case 's':
+        if (sscanf (arg, "%dx%d", &opt->raw_w, &opt->raw_h) != 2)
+            return -1;
+        return 1;
+    case 'o':
+        opt->output = arg;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void
+bench_opt_usage (const char *app)
+{
+    fprintf (stderr, "usage: %s [options] <image file | image directory>\n", app);
+    fprintf (stderr, "  -w num   : number of warmup iterations     (default: 10)\n");
+    fprintf (stderr, "  -n num   : number of measured iterations   (default: 100)\n");
+    fprintf (stderr, "  -s WxH   : size of raw frames (*.rgba, *.rgb, *.raw)\n");
+    fprintf (stderr, "  -o file  : write the JSON report to file   (default: stdout)\n");
+}
+
+static int
+write_report (const bench_report_t *rep, const char *output)
+{
+    FILE *fp;
+    int ret;
+
+    if (output == NULL)
+        return bench_report_write_json (rep, stdout);
+
+    fp = fopen (output, "w");
+    if (fp == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d): can't open \"%s\"\n", __FILE__, __LINE__, output);
+        return -1;
+    }
+
+    ret = bench_report_write_json (rep, fp);
+    fclose (fp);
+
+    return ret;
+}
+
+int
+bench_run (const bench_model_t *model, const bench_opt_t *opt)
+{
+    bench_image_t  *images;
+    bench_stat_t   *stats;
+    bench_report_t report = {0};
+    int num_images, i, ret = 0;
+    double t0, t1;
+
+    if (opt->input == NULL || opt->iterations <= 0 || model->num_stats > BENCH_MAX_STATS)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    num_images = bench_load_images (opt->input, opt->raw_w, opt->raw_h, &images);
+    if (num_images <= 0)
+        return -1;
+
+    stats = (bench_stat_t *)calloc (model->num_stats, sizeof (bench_stat_t));
+    if (stats == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        bench_free_images (images, num_images);
+        return -1;
+    }
+
+    for (i = 0; i < model->num_stats; i ++)
+        bench_stat_init (&stats[i], model->stat_names[i], opt->iterations);
+
+    for (i = 0; i < opt->warmup && ret == 0; i ++)
+        ret = model->run_frame (model->usr, &images[i % num_images], NULL);
+
+    if (ret == 0 && model->begin_measure)
+        model->begin_measure (model->usr);
+
+    t0 = bench_get_time_ms ();
+    for (i = 0; i < opt->iterations && ret == 0; i ++)
+        ret = model->run_frame (model->usr, &images[i % num_images], stats);
+    t1 = bench_get_time_ms ();
+
+    if (ret == 0)
+    {
+        report.app        = model->app;
+        report.input      = opt->input;
+        report.num_images = num_images;
+        report.warmup     = opt->warmup;
+        report.iterations = opt->iterations;
+        report.total_ms   = t1 - t0;
+        for (i = 0; i < model->num_stats; i ++)
+            bench_report_add_stat (&report, &stats[i]);
+
+        ret = write_report (&report, opt->output);
+    }
+
+    for (i = 0; i < model->num_stats; i ++)
+        bench_stat_destroy (&stats[i]);
+    free (stats);
+    bench_free_images (images, num_images);
+
+    return ret;
+}
+
+
+/* -------------------------------------------------- *
+ *  Two-stage (detector -> landmark) driver
+ * -------------------------------------------------- */
+enum cascade_stat_id {
+    CASCADE_STAT_DETECT_PRE = 0,
+    CASCADE_STAT_DETECT_INVOKE,
+    CASCADE_STAT_DETECT_POST,
+    CASCADE_STAT_LANDMARK_PRE,
+    CASCADE_STAT_LANDMARK_INVOKE,
+    CASCADE_STAT_LANDMARK_POST,
+    CASCADE_STAT_FRAME,
+
+    CASCADE_STAT_NUM
+};
+
+static const char *s_cascade_stat_names[CASCADE_STAT_NUM] = {
+    "detect_preprocess",
+    "detect_invoke",
+    "detect_postprocess",
+    "landmark_preprocess",
+    "landmark_invoke",
+    "landmark_postprocess",
+    "frame",
+};
+
+typedef struct _cascade_ctx_t
+{
+    const bench_cascade_t *cas;
+    void            *sess;
+    int             batch_landmark;
+    int             enable_track;
+    roi_track_t     track;
+
+    /* [max_items] each */
+    unsigned char   *items;
+    unsigned char   *results;
+    unsigned char   *next_items;
+    roi_t           *next_rois;
+    float           *scores;
+} cascade_ctx_t;
+
+#define CASCADE_ITEM(ctx, i)    ((ctx)->items   + (i) * (ctx)->cas->item_size)
+#define CASCADE_RESULT(ctx, i)  ((ctx)->results + (i) * (ctx)->cas->result_size)
+
+
+static void
+cascade_usage (const bench_cascade_t *cas, const char *app)
+{
+    bench_opt_usage (app);
+    fprintf (stderr, "  -t num   : number of preprocess threads    (default: 1, 0: all CPUs)\n");
+    fprintf (stderr, "  -b       : batch the landmark of all the %s into one Invoke()\n", cas->item_name);
+    fprintf (stderr, "  -r num   : track the ROIs from the landmarks, and run the detector\n");
+    fprintf (stderr, "             only when lost or every num frames (0: only when lost)\n");
+    fprintf (stderr, "  -q       : use quantized models\n");
+}
+
+/* landmark for all the items in one Invoke(). */
+static int
+cascade_landmark_batch (cascade_ctx_t *ctx, warp_src_t *src, preproc_norm_t *norm,
+                        int num, bench_stat_t *stats)
+{
+    const bench_cascade_t *cas = ctx->cas;
+    double t0, t1, t2;
+    int w, h, i;
+
+    float *input = (float *)cas->get_landmark_batch_input (ctx->sess, num, &w, &h);
+    if (input == NULL)
+        return -1;
+
+    t0 = bench_get_time_ms ();
+    for (i = 0; i < num; i ++)
+    {
+        float quad[4][2];
+
+        cas->get_item_quad (CASCADE_ITEM (ctx, i), quad);
+        warp_quad_to_fp32 (src, quad, input + i * w * h * 3, w, h, norm, 0);
+    }
+    t1 = bench_get_time_ms ();
+    if (cas->invoke_landmark_batch (ctx->sess, ctx->results, num) < 0)
+        return -1;
+    t2 = bench_get_time_ms ();
+
+    if (stats)
+        bench_stat_add_stage (stats, CASCADE_STAT_LANDMARK_PRE, t0, t1, t2, cas->get_invoke_ms ());
+
+    return 0;
+}
+
+/* landmark for each item. */
+static int
+cascade_landmark (cascade_ctx_t *ctx, warp_src_t *src, preproc_norm_t *norm,
+                  int num, bench_stat_t *stats)
+{
+    const bench_cascade_t *cas = ctx->cas;
+    double t0, t1, t2;
+    int w, h, i;
+
+    for (i = 0; i < num; i ++)
+    {
+        float quad[4][2];
+        float *input;
+
+        cas->get_item_quad (CASCADE_ITEM (ctx, i), quad);
+        input = (float *)cas->get_landmark_input (ctx->sess, &w, &h);
+
+        t0 = bench_get_time_ms ();
+        warp_quad_to_fp32 (src, quad, input, w, h, norm, 0);
+        t1 = bench_get_time_ms ();
+        if (cas->invoke_landmark (ctx->sess, CASCADE_RESULT (ctx, i)) < 0)
+            return -1;
+        t2 = bench_get_time_ms ();
+
+        if (stats)
+            bench_stat_add_stage (stats, CASCADE_STAT_LANDMARK_PRE, t0, t1, t2, cas->get_invoke_ms ());
+    }
+
+    return 0;
+}
+
+/* ROIs of the next frame from the landmarks */
+static void
+cascade_update_track (cascade_ctx_t *ctx, int num)
+{
+    const bench_cascade_t *cas = ctx->cas;
+    int i;
+
+    for (i = 0; i < num; i ++)
+    {
+        ctx->scores[i] = cas->landmark_to_item (CASCADE_ITEM (ctx, i), CASCADE_RESULT (ctx, i),
+                                                ctx->next_items + i * cas->item_size,
+                                                &ctx->next_rois[i]);
+    }
+
+    roi_track_update (&ctx->track, ctx->next_rois, ctx->scores, ctx->next_items, num);
+}
+
+static int
+cascade_run_frame (void *usr, bench_image_t *img, bench_stat_t *stats)
+{
+    cascade_ctx_t *ctx = (cascade_ctx_t *)usr;
+    const bench_cascade_t *cas = ctx->cas;
+    warp_src_t src;
+    preproc_norm_t norm;
+    double t0, t1, t2;
+    int w, h, num, ret;
+
+    double tf = bench_get_time_ms ();
+
+    warp_src_set (&src, img->rgba, img->w, img->h, 0, WARP_FMT_RGBA);
+    preproc_norm_set (&norm, 128.0f, 128.0f);
+
+    /* detection (skipped while the items are tracked) */
+    if (!ctx->enable_track || roi_track_need_detect (&ctx->track))
+    {
+        float *input = (float *)cas->get_detect_input (ctx->sess, &w, &h);
+
+        t0 = bench_get_time_ms ();
+        warp_resize_to_fp32 (&src, input, w, h, &norm, 0);
+        t1 = bench_get_time_ms ();
+        num = cas->invoke_detect (ctx->sess, ctx->items);
+        if (num < 0)
+            return -1;
+        t2 = bench_get_time_ms ();
+
+        if (stats)
+            bench_stat_add_stage (stats, CASCADE_STAT_DETECT_PRE, t0, t1, t2, cas->get_invoke_ms ());
+    }
+    else
+    {
+        num = roi_track_get (&ctx->track, ctx->items);
+    }
+
+    if (num > cas->max_items)
+        num = cas->max_items;
+
+    /* landmark for each item */
+    if (ctx->batch_landmark && num > 0)
+        ret = cascade_landmark_batch (ctx, &src, &norm, num, stats);
+    else
+        ret = cascade_landmark (ctx, &src, &norm, num, stats);
+    if (ret < 0)
+        return -1;
+
+    if (ctx->enable_track)
+        cascade_update_track (ctx, num);
+
+    if (stats)
+        bench_stat_add (&stats[CASCADE_STAT_FRAME], bench_get_time_ms () - tf);
+
+    return 0;
+}
+
+/* count the measured frames only */
+static void
+cascade_begin_measure (void *usr)
+{
+    cascade_ctx_t *ctx = (cascade_ctx_t *)usr;
+
+    memset (&ctx->track.stats, 0, sizeof (ctx->track.stats));
+}
+
+static void
+cascade_free_buf (cascade_ctx_t *ctx)
+{
+    free (ctx->items);
+    free (ctx->results);
+    free (ctx->next_items);
+    free (ctx->next_rois);
+    free (ctx->scores);
+}
+
+int
+bench_cascade_main (const bench_cascade_t *cas, int argc, char *argv[])
+{
+    int num_threads = 1;
+    int redetect_interval = 0;
+    int use_quantized_tflite = 0;
+    cascade_ctx_t ctx = {0};
+    bench_opt_t   opt;
+    bench_model_t model = {0};
+    int ret, c;
+
+    bench_opt_init (&opt);
+
+    while ((c = getopt (argc, argv, BENCH_OPTSTRING "t:bqr:h")) != -1)
+    {
+        ret = bench_opt_parse (&opt, c, optarg);
+        if (ret > 0)
+            continue;
+        if (ret < 0)
+        {
+            cascade_usage (cas, argv[0]);
+            return -1;
+        }
+
+        switch (c)
+        {
+        case 't':
+            num_threads = atoi (optarg);
+            break;
+        case 'b':
+            ctx.batch_landmark = 1;
+            break;
+        case 'q':
+            use_quantized_tflite = 1;
+            break;
+        case 'r':
+            ctx.enable_track = 1;
+            redetect_interval = atoi (optarg);
+            break;
+        default:
+            cascade_usage (cas, argv[0]);
+            return -1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        cascade_usage (cas, argv[0]);
+        return -1;
+    }
+    opt.input = argv[optind];
+
+    ctx.cas        = cas;
+    ctx.items      = (unsigned char *)malloc (cas->max_items * cas->item_size);
+    ctx.results    = (unsigned char *)malloc (cas->max_items * cas->result_size);
+    ctx.next_items = (unsigned char *)malloc (cas->max_items * cas->item_size);
+    ctx.next_rois  = (roi_t *)malloc (cas->max_items * sizeof (roi_t));
+    ctx.scores     = (float *)malloc (cas->max_items * sizeof (float));
+    if (!ctx.items || !ctx.results || !ctx.next_items || !ctx.next_rois || !ctx.scores)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        cascade_free_buf (&ctx);
+        return -1;
+    }
+
+    ctx.sess = cas->session_create (use_quantized_tflite);
+    if (ctx.sess == NULL)
+    {
+        cascade_free_buf (&ctx);
+        return -1;
+    }
+
+    if (ctx.enable_track &&
+        roi_track_init (&ctx.track, cas->max_items, cas->item_size, 0.5f, redetect_interval) < 0)
+    {
+        cas->session_destroy (ctx.sess);
+        cascade_free_buf (&ctx);
+        return -1;
+    }
+
+    warp_init (num_threads);
+
+    model.app        = cas->app;
+    model.num_stats  = CASCADE_STAT_NUM;
+    model.stat_names = s_cascade_stat_names;
+    model.usr        = &ctx;
+    model.run_frame  = cascade_run_frame;
+    model.begin_measure = cascade_begin_measure;
+
+    ret = bench_run (&model, &opt);
+
+    if (ctx.enable_track)
+    {
+        if (ret == 0)
+        {
+            fprintf (stderr, "ROI tracking: detector ran in %d of %d frames (hit:%d miss:%d)\n",
+                     ctx.track.stats.detect_frames, ctx.track.stats.frames,
+                     ctx.track.stats.hits, ctx.track.stats.misses);
+        }
+        roi_track_destroy (&ctx.track);
+    }
+
+    warp_terminate ();
+    cas->session_destroy (ctx.sess);
+    cascade_free_buf (&ctx);
+
+    return ret;
+}
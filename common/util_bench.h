@@ -0,0 +1,165 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_BENCH_H_
+#define _UTIL_BENCH_H_
+
+#include <stdio.h>
+#include "util_roi_track.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  Headless benchmark helpers.
+ *
+ *  everything here runs on CPU only (no EGL/GLES), so that the model
+ *  pipelines can be measured on CI machines without a display.
+ */
+#define BENCH_MAX_STATS     16
+
+typedef struct _bench_image_t
+{
+    char            path[256];
+    int             w, h;
+    unsigned char   *rgba;          /* RGBA8, top-down */
+} bench_image_t;
+
+typedef struct _bench_stat_t
+{
+    char    name[32];
+    double  *samples;               /* [ms] */
+    int     num;
+    int     capacity;
+} bench_stat_t;
+
+typedef struct _bench_report_t
+{
+    const char      *app;
+    const char      *input;
+    int             num_images;
+    int             warmup;
+    int             iterations;
+    double          total_ms;       /* wall time of the measured iterations */
+    int             num_stats;
+    bench_stat_t    *stats[BENCH_MAX_STATS];
+} bench_report_t;
+
+
+double bench_get_time_ms ();
+
+/* input images */
+int  bench_load_images (const char *path, int raw_w, int raw_h, bench_image_t **images);
+void bench_free_images (bench_image_t *images, int num);
+
+/* latency statistics */
+int    bench_stat_init    (bench_stat_t *st, const char *name, int capacity);
+void   bench_stat_destroy (bench_stat_t *st);
+void   bench_stat_add     (bench_stat_t *st, double ms);
+double bench_stat_percentile (bench_stat_t *st, double percent);
+double bench_stat_mean    (bench_stat_t *st);
+
+/* record stats[idx + 0..2] = preprocess (t0 -> t1), Invoke, post-process (t1 -> t2 - Invoke) */
+void   bench_stat_add_stage (bench_stat_t *stats, int idx, double t0, double t1, double t2,
+                             double invoke_ms);
+
+/* report */
+void bench_report_add_stat (bench_report_t *rep, bench_stat_t *st);
+int  bench_report_write_json (const bench_report_t *rep, FILE *fp);
+
+
+/*
+ *  Benchmark driver.
+ *
+ *  the model specific part is a callback which runs one frame. bench_run()
+ *  loads the input, runs the warm-up and the measured iterations, and
+ *  writes the JSON report.
+ *
+ *      while ((c = getopt (argc, argv, BENCH_OPTSTRING "q")) != -1)
+ *      {
+ *          if (bench_opt_parse (&opt, c, optarg) > 0)
+ *              continue;
+ *          ...
+ *      }
+ *      opt.input = argv[optind];
+ *      bench_run (&model, &opt);
+ */
+#define BENCH_OPTSTRING     "w:n:s:o:"
+
+typedef struct _bench_opt_t
+{
+    const char  *input;             /* image file or directory */
+    const char  *output;            /* JSON report. NULL: stdout */
+    int         warmup;
+    int         iterations;
+    int         raw_w, raw_h;       /* size of raw frames */
+} bench_opt_t;
+
+typedef struct _bench_model_t
+{
+    const char  *app;
+    int         num_stats;
+    const char  **stat_names;       /* [num_stats] */
+    void        *usr;
+
+    /* run one frame. record the latencies in stats[] unless (stats) is NULL (warm-up). */
+    int         (*run_frame) (void *usr, bench_image_t *img, bench_stat_t *stats);
+
+    /* called after the warm-up, before the measurement. (optional) */
+    void        (*begin_measure) (void *usr);
+} bench_model_t;
+
+void bench_opt_init  (bench_opt_t *opt);
+
+/* returns 1 if (c) is one of BENCH_OPTSTRING, 0 if not, -1 if (arg) is invalid. */
+int  bench_opt_parse (bench_opt_t *opt, int c, const char *arg);
+void bench_opt_usage (const char *app);
+
+int  bench_run (const bench_model_t *model, const bench_opt_t *opt);
+
+
+/*
+ *  Two-stage (detector -> landmark of each ROI) benchmark driver.
+ *
+ *  the driver gives the model callbacks only. bench_cascade_main() parses
+ *  the options (BENCH_OPTSTRING and -t -b -r -q), and runs the detector,
+ *  the landmark of each ROI (or of all the ROIs in one Invoke()) and the
+ *  ROI tracking for each frame.
+ */
+typedef struct _bench_cascade_t
+{
+    const char  *app;
+    const char  *item_name;         /* e.g. "faces". for the usage */
+    int         max_items;
+    int         item_size;          /* e.g. sizeof (face_t) */
+    int         result_size;        /* e.g. sizeof (face_landmark_result_t) */
+
+    void        *(*session_create)  (int use_quantized);
+    void        (*session_destroy)  (void *sess);
+    double      (*get_invoke_ms)    ();
+
+    /* detector. fill (items) and return the number of them, or -1. */
+    void        *(*get_detect_input) (void *sess, int *w, int *h);
+    int         (*invoke_detect)     (void *sess, void *items);
+
+    /* landmark. (quad) is the ROI of (item) in the frame. */
+    void        (*get_item_quad)     (const void *item, float quad[4][2]);
+    void        *(*get_landmark_input)       (void *sess, int *w, int *h);
+    int         (*invoke_landmark)           (void *sess, void *result);
+    void        *(*get_landmark_batch_input) (void *sess, int num, int *w, int *h);
+    int         (*invoke_landmark_batch)     (void *sess, void *results, int num);
+
+    /* the item and the ROI of the next frame. returns the landmark score. */
+    float       (*landmark_to_item) (const void *item, const void *result,
+                                     void *next_item, roi_t *next_roi);
+} bench_cascade_t;
+
+int  bench_cascade_main (const bench_cascade_t *cas, int argc, char *argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_BENCH_H_ */
@@ -5,118 +5,127 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 #include "util_v4l2.h"
 #include "util_debug.h"
 #include "util_texture.h"
 #include "util_camera_capture.h"
+#include "util_yuv.h"
+
+/*
+ *  triple buffer between the capture thread (producer) and the render
+ *  thread (consumer).
+ *
+ *    back   : being written by the producer
+ *    middle : the newest complete frame
+ *    front  : being read by the consumer
+ *
+ *  the producer swaps (back <-> middle) and the consumer swaps
+ *  (front <-> middle) with one atomic exchange, so neither side waits
+ *  for the other. unconsumed frames are simply overwritten.
+ */
+#define CAPTURE_SLOT_NUM    3
+#define SLOT_IDX_MASK       0xFF
+#define SLOT_NEW            (1 << 8)    /* the middle has not been taken yet */
+
+typedef struct _capture_slot_t
+{
+    void            *buf;               /* converted/cropped image       */
+    capture_frame_t *v4l2_frame;        /* held V4L2 buffer (zero copy)  */
+    void            *image;             /* (buf) or the V4L2 mmap buffer */
+    uint32_t        seq;
+    double          timestamp_ms;
+} capture_slot_t;
 
 static pthread_t    s_capture_thread;
-static void         *s_capture_buf = NULL;
 static capture_dev_t *s_cap_dev;
 static int          s_capture_w, s_capture_h;
 static int          s_capcrop_w, s_capcrop_h;
 static int          s_capcropped = 0;
+static int          s_capout_w, s_capout_h;     /* size of the RGBA image */
+static int          s_capture_stride = 0;
+static int          s_yuv_flags = 0;
 static unsigned int s_capture_fmt;
 static int          s_force_convert_to_rgba = 0;
+static int          s_zero_copy = 0;
 
-#define _max(A, B)    ((A) > (B) ? (A) : (B))
-#define _min(A, B)    ((A) < (B) ? (A) : (B))
+static capture_slot_t s_slots[CAPTURE_SLOT_NUM];
+static int          s_back_idx   = 0;   /* producer only */
+static int          s_front_idx  = 1;   /* consumer only */
+static int          s_front_valid = 0;  /* consumer only */
+static int          s_middle     = 2;   /* shared: index | SLOT_NEW */
+static uint32_t     s_capture_seq = 0;
 
 
-static int
-convert_to_rgba8888 (void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsigned int fmt)
+static double
+get_time_ms ()
 {
-    int x, y;
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + (double)tv.tv_nsec / 1000000.0);
+}
 
-    if (s_capture_buf == NULL)
+/* capture time of the frame, on the same clock as pmeter_get_time_ms() */
+static double
+get_frame_timestamp_ms (capture_frame_t *frame)
+{
+    if ((frame->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+        (frame->timestamp.tv_sec || frame->timestamp.tv_usec))
     {
-        s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 4);
+        return frame->timestamp.tv_sec * 1000.0 + frame->timestamp.tv_usec / 1000.0;
     }
 
-    if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V') ||
-        fmt == v4l2_fourcc ('U', 'Y', 'V', 'Y'))
-    {
-        unsigned char *src8 = buf;
-        unsigned char *srcline = buf;
-        unsigned char *dst8 = s_capture_buf;
-        int y0_idx = 0, cb_idx = 1, y1_idx = 2, cr_idx = 3;
+    /* the driver doesn't tell. use the dequeue time instead. */
+    return get_time_ms ();
+}
 
-        if (fmt == v4l2_fourcc ('U', 'Y', 'V', 'Y'))
-        {
-            y0_idx = 1;
-            cb_idx = 0;
-            y1_idx = 3;
-            cr_idx = 2;
-        }
-        for (y = 0; y < cap_h; y ++)
-        {
-            src8 = &srcline[y * 2 * s_capture_w];
-            src8 += ofstx * 2;
-            for (x = 0; x < cap_w; x += 2)
-            {
-                int y0 = src8[y0_idx];
-                int cb = src8[cb_idx];
-                int y1 = src8[y1_idx];
-                int cr = src8[cr_idx];
-                src8 += 4;
-
-                y0 -= 16;
-                y1 -= 16;
-                cb -= 128;
-                cr -= 128;
-                int r, g, b;
-                
-                r = 1164 * y0 + 1596 * cr;
-                g = 1164 * y0 -  392 * cb - 813 * cr;
-                b = 1164 * y0 + 2017 * cb;
-                
-                r = _min (_max (r, 999) / 1000, 255);
-                g = _min (_max (g, 999) / 1000, 255);
-                b = _min (_max (b, 999) / 1000, 255);
-                
-                *dst8 ++ = r;
-                *dst8 ++ = g;
-                *dst8 ++ = b;
-                *dst8 ++ = 255;
-
-                r = 1164 * y1 + 1596 * cr;
-                g = 1164 * y1 -  392 * cb - 813 * cr;
-                b = 1164 * y1 + 2017 * cb;
-                
-                r = _min (_max (r, 999) / 1000, 255);
-                g = _min (_max (g, 999) / 1000, 255);
-                b = _min (_max (b, 999) / 1000, 255);
-                
-                *dst8 ++ = r;
-                *dst8 ++ = g;
-                *dst8 ++ = b;
-                *dst8 ++ = 255;
-            }
-        }
-    }
-    else
+
+/* crop the center of the frame, and scale it to (s_capout_w x s_capout_h) while converting. */
+static int
+convert_to_rgba8888 (void *dst, void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsigned int fmt)
+{
+    yuv_src_t src;
+
+    if (yuv_src_set (&src, buf, s_capture_w, s_capture_h, s_capture_stride, fmt) < 0)
     {
         fprintf (stderr, "ERR: %s(%d): pixformat(%.4s) is not supported.\n",
             __FILE__, __LINE__, (char *)&fmt);
         return -1;
     }
-    return 0;
+
+    return yuv422_to_rgb (&src, ofstx, ofsty, cap_w, cap_h,
+                          dst, s_capout_w, s_capout_h, s_yuv_flags);
 }
 
+/* BT.601/709 and the range, as the driver reports. */
 static int
-copy_yuyv_image_cropped (void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsigned int fmt)
+get_yuv_flags (capture_dev_t *cap_dev)
 {
-    if (s_capture_buf == NULL)
-    {
-        s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 2);
-    }
+    struct v4l2_pix_format *pix = &cap_dev->stream.format.fmt.pix;
+    int flags = 0;
 
+    if (cap_dev->stream.buftype != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        return 0;
+
+    if (pix->colorspace == V4L2_COLORSPACE_REC709)
+        flags |= YUV_BT709;
+
+    if (pix->quantization == V4L2_QUANTIZATION_FULL_RANGE ||
+       (pix->quantization == V4L2_QUANTIZATION_DEFAULT && pix->colorspace == V4L2_COLORSPACE_JPEG))
+        flags |= YUV_FULL_RANGE;
+
+    return flags;
+}
+
+static int
+copy_yuyv_image_cropped (void *dst, void *buf, int ofstx, int ofsty, int cap_w, int cap_h, unsigned int fmt)
+{
     if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V') ||
         fmt == v4l2_fourcc ('U', 'Y', 'V', 'Y'))
     {
         unsigned char *src8 = buf;
-        unsigned char *dst8 = s_capture_buf;
+        unsigned char *dst8 = dst;
         for (int ydst = 0; ydst < cap_h; ydst ++)
         {
             int ysrc = ydst + ofsty;
@@ -137,59 +146,80 @@ copy_yuyv_image_cropped (void *buf, int ofstx, int ofsty, int cap_w, int cap_h,
     return 0;
 }
 
-static int
-copy_yuyv_image (void *buf, int cap_w, int cap_h, unsigned int fmt)
+/* hand the (back) slot over to the consumer, and take the old middle back. */
+static void
+publish_frame (capture_slot_t *slot)
 {
-    if (s_capture_buf == NULL)
-    {
-        s_capture_buf = (unsigned char *)malloc (cap_w * cap_h * 2);
-    }
+    int prev;
 
-    if (fmt == v4l2_fourcc ('Y', 'U', 'Y', 'V') ||
-        fmt == v4l2_fourcc ('U', 'Y', 'V', 'Y'))
-    {
-        memcpy (s_capture_buf, buf, cap_w * cap_h * 2);
-    }
-    else
+    slot->seq = ++ s_capture_seq;
+    prev = __atomic_exchange_n (&s_middle, s_back_idx | SLOT_NEW, __ATOMIC_ACQ_REL);
+    s_back_idx = prev & SLOT_IDX_MASK;
+
+    /* the old middle is either overwritten (never taken), or returned by
+     * the consumer. its V4L2 buffer can go back to the driver. */
+    slot = &s_slots[s_back_idx];
+    if (slot->v4l2_frame)
     {
-        fprintf (stderr, "ERR: %s(%d): pixformat(%.4s) is not supported.\n",
-            __FILE__, __LINE__, (char *)&fmt);
-        return -1;
+        v4l2_release_capture_frame (s_cap_dev, slot->v4l2_frame);
+        slot->v4l2_frame = NULL;
     }
-    return 0;
 }
 
 static void *
 capture_thread_main ()
 {
-    v4l2_start_capture (s_cap_dev);
+    if (v4l2_start_capture (s_cap_dev) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return NULL;
+    }
 
     while (1)
     {
         int ofstx = (s_capture_w - s_capcrop_w) * 0.5f;
         int ofsty = (s_capture_h - s_capcrop_h) * 0.5f;
+        capture_slot_t *slot = &s_slots[s_back_idx];
 
         capture_frame_t *frame = v4l2_acquire_capture_frame (s_cap_dev);
+        if (frame == NULL)
+        {
+            /* the device is gone. the last frame stays on the screen. */
+            if (v4l2_capture_is_dead (s_cap_dev))
+            {
+                fprintf (stderr, "ERR: %s(%d): capture stopped\n", __FILE__, __LINE__);
+                break;
+            }
+            continue;
+        }
 
-        if (s_force_convert_to_rgba)
+        slot->timestamp_ms = get_frame_timestamp_ms (frame);
+
+        if (s_zero_copy)
         {
-            convert_to_rgba8888 (frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
+            /* keep the V4L2 buffer until the consumer has done with it. */
+            slot->v4l2_frame = frame;
+            slot->image      = frame->vaddr;
         }
         else
         {
-            if (s_capcropped)
-                copy_yuyv_image_cropped (frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
+            if (s_force_convert_to_rgba)
+                convert_to_rgba8888 (slot->buf, frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
             else
-                copy_yuyv_image (frame->vaddr, s_capcrop_w, s_capcrop_h, s_capture_fmt);
+                copy_yuyv_image_cropped (slot->buf, frame->vaddr, ofstx, ofsty, s_capcrop_w, s_capcrop_h, s_capture_fmt);
+
+            v4l2_release_capture_frame (s_cap_dev, frame);
+            slot->image = slot->buf;
         }
-        v4l2_release_capture_frame (s_cap_dev, frame);
+
+        publish_frame (slot);
     }
     return 0;
 }
 
 
 int
-init_capture (uint32_t flags)
+init_capture_ex (uint32_t flags, int out_w, int out_h)
 {
     int cap_devid = -1;
     capture_dev_t *cap_dev;
@@ -227,19 +257,73 @@ init_capture (uint32_t flags)
         s_capcrop_h = cap_h;
     }
 
-    if (flags & CAPTURE_PIXFORMAT_RGBA)
+    /* scaling is done in the RGBA conversion. */
+    if ((flags & CAPTURE_PIXFORMAT_RGBA) || out_w > 0 || out_h > 0)
     {
         s_force_convert_to_rgba = 1;
     }
-    
+
+    s_capout_w = (out_w > 0) ? out_w : s_capcrop_w;
+    s_capout_h = (out_h > 0) ? out_h : s_capcrop_h;
+
+    if (cap_fmt != v4l2_fourcc ('Y', 'U', 'Y', 'V') &&
+        cap_fmt != v4l2_fourcc ('U', 'Y', 'V', 'Y'))
+    {
+        fprintf (stderr, "ERR: %s(%d): pixformat(%.4s) is not supported.\n",
+            __FILE__, __LINE__, (char *)&cap_fmt);
+        return -1;
+    }
+
+    /* YUYV as it is: read the V4L2 mmap buffer directly, unless the lines are padded. */
+    if (!s_force_convert_to_rgba && !s_capcropped &&
+        cap_dev->stream.buftype == V4L2_BUF_TYPE_VIDEO_CAPTURE &&
+        cap_dev->stream.format.fmt.pix.bytesperline == (unsigned int)cap_w * 2)
+    {
+        s_zero_copy = 1;
+    }
+
+    if (cap_dev->stream.buftype == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        s_capture_stride = cap_dev->stream.format.fmt.pix.bytesperline;
+
+    if (s_force_convert_to_rgba)
+    {
+        s_yuv_flags = get_yuv_flags (cap_dev);
+        if (flags & CAPTURE_SCALE_BILINEAR)
+            s_yuv_flags |= YUV_SCALE_BILINEAR;
+
+        yuv_init (0);
+    }
+
+    for (int i = 0; i < CAPTURE_SLOT_NUM; i ++)
+    {
+        if (s_zero_copy)
+            break;
+
+        if (s_force_convert_to_rgba)
+            s_slots[i].buf = malloc (s_capout_w * s_capout_h * 4);
+        else
+            s_slots[i].buf = malloc (s_capcrop_w * s_capcrop_h * 2);
+        if (s_slots[i].buf == NULL)
+        {
+            DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
     return 0;
 }
 
+int
+init_capture (uint32_t flags)
+{
+    return init_capture_ex (flags, 0, 0);
+}
+
 int 
 get_capture_dimension (int *width, int *height)
 {
-    *width  = s_capcrop_w;
-    *height = s_capcrop_h;
+    *width  = s_force_convert_to_rgba ? s_capout_w : s_capcrop_w;
+    *height = s_force_convert_to_rgba ? s_capout_h : s_capcrop_h;
 
     return 0;
 }
@@ -267,10 +351,42 @@ get_capture_pixformat (uint32_t *pixformat)
     return 0;
 }
 
+/*
+ *  take the newest complete frame, and release the previous one.
+ *  returns 1 if a new frame is taken, 0 if no new frame has arrived
+ *  (the previous one is kept).
+ */
+int
+acquire_capture_frame ()
+{
+    int prev;
+
+    if ((__atomic_load_n (&s_middle, __ATOMIC_ACQUIRE) & SLOT_NEW) == 0)
+        return 0;
+
+    prev = __atomic_exchange_n (&s_middle, s_front_idx, __ATOMIC_ACQ_REL);
+    s_front_idx   = prev & SLOT_IDX_MASK;
+    s_front_valid = 1;
+
+    return 1;
+}
+
+/* the frame taken by acquire_capture_frame(). NULL until the first frame arrives. */
 int
 get_capture_buffer (void ** buf)
 {
-    *buf = s_capture_buf;
+    *buf = s_front_valid ? s_slots[s_front_idx].image : NULL;
+    return 0;
+}
+
+int
+get_capture_frame_info (uint32_t *seq, double *timestamp_ms)
+{
+    if (!s_front_valid)
+        return -1;
+
+    *seq          = s_slots[s_front_idx].seq;
+    *timestamp_ms = s_slots[s_front_idx].timestamp_ms;
     return 0;
 }
 
@@ -9,12 +9,31 @@
 
 #define CAPTURE_SQUARED_CROP        (1 << 0)
 #define CAPTURE_PIXFORMAT_RGBA      (1 << 1)
+#define CAPTURE_SCALE_BILINEAR      (1 << 2)    /* box filter if not set */
 
 int init_capture (uint32_t flags);
+
+/*
+ *  (out_w x out_h) > 0: the cropped frame is scaled to that size while it is
+ *  converted to RGBA (CAPTURE_PIXFORMAT_RGBA is implied), e.g. to the input
+ *  size of the detector. get_capture_dimension() returns the scaled size.
+ */
+int init_capture_ex (uint32_t flags, int out_w, int out_h);
+
 int get_capture_dimension (int *width, int *height);
 int get_capture_pixformat (uint32_t *pixformat);
+
+/*
+ *  the capture thread never waits for the renderer. acquire_capture_frame()
+ *  takes the newest complete frame, which stays valid until the next call.
+ *  (update_capture_texture() calls it once per frame.)
+ */
+int acquire_capture_frame ();
 int get_capture_buffer (void ** buf);
 
+/* sequence number (1, 2, ...) and capture time [ms] on the pmeter_get_time_ms() clock */
+int get_capture_frame_info (uint32_t *seq, double *timestamp_ms);
+
 int start_capture ();
 
 
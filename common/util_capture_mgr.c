@@ -0,0 +1,656 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include "util_v4l2.h"
+#include "util_debug.h"
+#include "util_telemetry.h"
+#include "util_capture_mgr.h"
+
+#define STATS_PERIOD_MS     1000.0
+
+typedef struct _capmgr_stream_t
+{
+    int             id;
+    capmgr_config_t cfg;
+    capture_dev_t   *cap_dev;       /* NULL: virtual device */
+    int             width, height, stride;
+    uint32_t        pixformat;
+    int             num_bufs;
+    pthread_t       thread;
+    int             running;
+    int             dead;           /* the device failed (protected by s_mutex) */
+
+    /* virtual device */
+    unsigned char   *vbuf;          /* [num_bufs][stride * height] */
+    int             vbuf_busy[CAPMGR_MAX_BUFS];
+
+    /* frames waiting for the application (protected by s_mutex) */
+    capmgr_frame_t  queue[CAPMGR_QUEUE_MAX];
+    int             q_head, q_num;
+    int             num_held;
+
+    /* statistics (protected by s_mutex) */
+    capmgr_stats_t  stats;
+    uint32_t        last_seq;
+    int             has_seq;
+    double          win_t0;
+    uint32_t        win_frames;
+    double          win_latency_sum;
+    double          win_latency_max;
+    int             telem_latency;
+    int             telem_dropped;
+} capmgr_stream_t;
+
+static capmgr_stream_t  s_streams[CAPMGR_MAX_STREAMS];
+static int              s_num_streams = 0;
+static pthread_mutex_t  s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   s_cond;             /* a frame is queued */
+static int              s_cond_initialized = 0;
+
+
+static double
+get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + (double)tv.tv_nsec / 1000000.0);
+}
+
+/* capture time of the frame, on the same clock as pmeter_get_time_ms() */
+static double
+get_frame_timestamp_ms (capture_frame_t *frame)
+{
+    if ((frame->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+        (frame->timestamp.tv_sec || frame->timestamp.tv_usec))
+    {
+        return frame->timestamp.tv_sec * 1000.0 + frame->timestamp.tv_usec / 1000.0;
+    }
+
+    /* the driver doesn't tell. use the dequeue time instead. */
+    return get_time_ms ();
+}
+
+
+/* -------------------------------------------------- *
+ *  frame queue (protected by s_mutex)
+ * -------------------------------------------------- */
+static void
+release_buffer (capmgr_stream_t *st, int index)
+{
+    if (st->cap_dev)
+        v4l2_release_capture_frame (st->cap_dev, &st->cap_dev->stream.frames[index]);
+    else
+        st->vbuf_busy[index] = 0;
+}
+
+static void
+update_stats (capmgr_stream_t *st, const capmgr_frame_t *frame)
+{
+    double latency = frame->dequeue_ms - frame->timestamp_ms;
+
+    st->stats.num_frames ++;
+
+    if (st->has_seq && frame->seq > st->last_seq + 1)
+    {
+        uint32_t lost = frame->seq - st->last_seq - 1;
+        st->stats.num_dropped += lost;
+        telem_count (st->telem_dropped, lost);
+    }
+    st->last_seq = frame->seq;
+    st->has_seq  = 1;
+
+    telem_record (st->telem_latency, latency);
+
+    st->win_frames ++;
+    st->win_latency_sum += latency;
+    if (latency > st->win_latency_max)
+        st->win_latency_max = latency;
+
+    if (frame->dequeue_ms - st->win_t0 >= STATS_PERIOD_MS)
+    {
+        double period = frame->dequeue_ms - st->win_t0;
+
+        st->stats.fps            = st->win_frames * 1000.0 / period;
+        st->stats.latency_avg_ms = st->win_latency_sum / st->win_frames;
+        st->stats.latency_max_ms = st->win_latency_max;
+
+        st->win_t0          = frame->dequeue_ms;
+        st->win_frames      = 0;
+        st->win_latency_sum = 0;
+        st->win_latency_max = 0;
+    }
+}
+
+static void
+push_frame (capmgr_stream_t *st, const capmgr_frame_t *frame)
+{
+    pthread_mutex_lock (&s_mutex);
+
+    update_stats (st, frame);
+
+    /* the application is late. the oldest one goes back to the device. */
+    if (st->q_num == st->cfg.queue_depth)
+    {
+        release_buffer (st, st->queue[st->q_head].index);
+        st->q_head = (st->q_head + 1) % CAPMGR_QUEUE_MAX;
+        st->q_num --;
+        st->stats.num_overwritten ++;
+    }
+
+    st->queue[(st->q_head + st->q_num) % CAPMGR_QUEUE_MAX] = *frame;
+    st->q_num ++;
+
+    pthread_cond_broadcast (&s_cond);
+    pthread_mutex_unlock (&s_mutex);
+}
+
+static void
+pop_frame (capmgr_stream_t *st, capmgr_frame_t *frame)
+{
+    *frame = st->queue[st->q_head];
+    st->q_head = (st->q_head + 1) % CAPMGR_QUEUE_MAX;
+    st->q_num --;
+    st->num_held ++;
+}
+
+
+/* -------------------------------------------------- *
+ *  capture threads
+ * -------------------------------------------------- */
+static void
+init_frame (capmgr_stream_t *st, capmgr_frame_t *frame, int index, void *buf)
+{
+    frame->stream    = st->id;
+    frame->index     = index;
+    frame->buf       = buf;
+    frame->width     = st->width;
+    frame->height    = st->height;
+    frame->stride    = st->stride;
+    frame->pixformat = st->pixformat;
+}
+
+/* wake up the waiters. they don't wait for this stream any more. */
+static void
+mark_stream_dead (capmgr_stream_t *st)
+{
+    pthread_mutex_lock (&s_mutex);
+    st->dead = 1;
+    pthread_cond_broadcast (&s_cond);
+    pthread_mutex_unlock (&s_mutex);
+}
+
+static void *
+v4l2_thread_main (void *arg)
+{
+    capmgr_stream_t *st = (capmgr_stream_t *)arg;
+
+    while (__atomic_load_n (&st->running, __ATOMIC_ACQUIRE))
+    {
+        capmgr_frame_t frame;
+
+        /* wake up periodically to see (running) */
+        capture_frame_t *cap_frame = v4l2_acquire_capture_frame_timeout (st->cap_dev, 100);
+        if (cap_frame == NULL)
+        {
+            if (v4l2_capture_is_dead (st->cap_dev))
+            {
+                fprintf (stderr, "ERR: %s(%d): stream %d: %s stopped\n",
+                         __FILE__, __LINE__, st->id, st->cap_dev->dev_name);
+                mark_stream_dead (st);
+                break;
+            }
+            continue;
+        }
+
+        init_frame (st, &frame, cap_frame->v4l_buf.index, cap_frame->vaddr);
+        frame.seq          = cap_frame->sequence;
+        frame.timestamp_ms = get_frame_timestamp_ms (cap_frame);
+        frame.dequeue_ms   = get_time_ms ();
+
+        push_frame (st, &frame);
+    }
+
+    return NULL;
+}
+
+/* moving diagonal gradient, tinted per stream. */
+static void
+draw_test_pattern (capmgr_stream_t *st, unsigned char *buf, uint32_t seq)
+{
+    int y0_idx = 0, u_idx = 1, y1_idx = 2, v_idx = 3;
+    unsigned char u = 128 + ((st->id & 1) ? 48 : -48);
+    unsigned char v = 128 + ((st->id & 2) ? 48 : -48);
+
+    if (st->pixformat == v4l2_fourcc ('U', 'Y', 'V', 'Y'))
+    {
+        y0_idx = 1; u_idx = 0; y1_idx = 3; v_idx = 2;
+    }
+
+    for (int y = 0; y < st->height; y ++)
+    {
+        unsigned char *line = buf + y * st->stride;
+
+        for (int x = 0; x < st->width; x += 2)
+        {
+            line[y0_idx] = (x     + y + seq * 4) & 0xFF;
+            line[y1_idx] = (x + 1 + y + seq * 4) & 0xFF;
+            line[u_idx]  = u;
+            line[v_idx]  = v;
+            line += 4;
+        }
+    }
+}
+
+static void *
+virtual_thread_main (void *arg)
+{
+    capmgr_stream_t *st = (capmgr_stream_t *)arg;
+    double period = 1000.0 / st->cfg.fps;
+    double next = get_time_ms ();
+    uint32_t seq = 0;
+
+    while (__atomic_load_n (&st->running, __ATOMIC_ACQUIRE))
+    {
+        capmgr_frame_t frame;
+        struct timespec ts;
+        int index = -1;
+
+        /* sleep until the next frame time. skip the frames if we are late. */
+        next += period;
+        if (next < get_time_ms ())
+            next = get_time_ms ();
+        ts.tv_sec  = (time_t)(next / 1000.0);
+        ts.tv_nsec = (long)((next - ts.tv_sec * 1000.0) * 1000000.0);
+        clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        seq ++;
+
+        pthread_mutex_lock (&s_mutex);
+        for (int i = 0; i < st->num_bufs; i ++)
+        {
+            if (st->vbuf_busy[i] == 0)
+            {
+                st->vbuf_busy[i] = 1;
+                index = i;
+                break;
+            }
+        }
+        pthread_mutex_unlock (&s_mutex);
+
+        /* all the buffers are held: the frame is lost, as a camera does. */
+        if (index < 0)
+            continue;
+
+        unsigned char *buf = st->vbuf + (size_t)index * st->stride * st->height;
+        draw_test_pattern (st, buf, seq);
+
+        init_frame (st, &frame, index, buf);
+        frame.seq          = seq;
+        frame.timestamp_ms = next;
+        frame.dequeue_ms   = get_time_ms ();
+
+        push_frame (st, &frame);
+    }
+
+    return NULL;
+}
+
+
+/* -------------------------------------------------- *
+ *  open/close
+ * -------------------------------------------------- */
+void
+capmgr_config_default (capmgr_config_t *cfg, int devid)
+{
+    memset (cfg, 0, sizeof (*cfg));
+    cfg->devid = devid;
+}
+
+static int
+open_v4l2_device (capmgr_stream_t *st)
+{
+    capmgr_config_t *cfg = &st->cfg;
+    capture_dev_t *cap_dev;
+
+    cap_dev = v4l2_open_capture_device_ex (cfg->devid, cfg->width, cfg->height,
+                                           cfg->pixformat, st->num_bufs);
+    if (cap_dev == NULL)
+    {
+        DBG_LOGE ("capture device(%d) not found.\n", cfg->devid);
+        return -1;
+    }
+
+    if (cap_dev->stream.buftype != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+    {
+        DBG_LOGE ("%s: multi-planar capture is not supported.\n", cap_dev->dev_name);
+        v4l2_close_capture_device (cap_dev);
+        return -1;
+    }
+
+    v4l2_show_current_capture_settings (cap_dev);
+
+    st->cap_dev   = cap_dev;
+    st->width     = cap_dev->stream.format.fmt.pix.width;
+    st->height    = cap_dev->stream.format.fmt.pix.height;
+    st->stride    = cap_dev->stream.format.fmt.pix.bytesperline;
+    st->pixformat = cap_dev->stream.format.fmt.pix.pixelformat;
+
+    if (v4l2_start_capture (cap_dev) < 0)
+    {
+        v4l2_close_capture_device (cap_dev);
+        st->cap_dev = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int
+open_virtual_device (capmgr_stream_t *st)
+{
+    capmgr_config_t *cfg = &st->cfg;
+
+    st->width     = cfg->width  ? cfg->width  : 640;
+    st->height    = cfg->height ? cfg->height : 480;
+    st->pixformat = cfg->pixformat ? cfg->pixformat : v4l2_fourcc ('Y', 'U', 'Y', 'V');
+    st->width    &= ~1;
+    st->stride    = st->width * 2;
+
+    if (st->pixformat != v4l2_fourcc ('Y', 'U', 'Y', 'V') &&
+        st->pixformat != v4l2_fourcc ('U', 'Y', 'V', 'Y'))
+    {
+        DBG_LOGE ("pixformat(%.4s) is not supported.\n", (char *)&st->pixformat);
+        return -1;
+    }
+
+    if (cfg->fps <= 0.0f)
+        cfg->fps = 30.0f;
+
+    st->vbuf = (unsigned char *)malloc ((size_t)st->num_bufs * st->stride * st->height);
+    if (st->vbuf == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    DBG_LOG ("virtual capture device: WH(%d, %d), 4CC(%.4s), %.1f fps\n",
+             st->width, st->height, (char *)&st->pixformat, cfg->fps);
+    return 0;
+}
+
+int
+capmgr_open_stream (const capmgr_config_t *cfg)
+{
+    capmgr_stream_t *st;
+    char telem_name[TELEM_NAME_LEN];
+    int id = s_num_streams;
+    int ret;
+
+    if (id >= CAPMGR_MAX_STREAMS)
+    {
+        DBG_LOGE ("ERR: %s(%d): too many streams.\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (!s_cond_initialized)
+    {
+        /* timed waits on the monotonic clock */
+        pthread_condattr_t attr;
+        pthread_condattr_init (&attr);
+        pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+        pthread_cond_init (&s_cond, &attr);
+        pthread_condattr_destroy (&attr);
+        s_cond_initialized = 1;
+    }
+
+    st = &s_streams[id];
+    memset (st, 0, sizeof (*st));
+    st->id  = id;
+    st->cfg = *cfg;
+
+    if (st->cfg.queue_depth <= 0)
+        st->cfg.queue_depth = 2;
+    if (st->cfg.queue_depth > CAPMGR_QUEUE_MAX)
+        st->cfg.queue_depth = CAPMGR_QUEUE_MAX;
+
+    st->num_bufs = (st->cfg.num_bufs > 0) ? st->cfg.num_bufs : st->cfg.queue_depth + 2;
+    if (st->num_bufs > CAPMGR_MAX_BUFS)
+        st->num_bufs = CAPMGR_MAX_BUFS;
+
+    if (cfg->devid == CAPMGR_VIRTUAL_DEVICE)
+        ret = open_virtual_device (st);
+    else
+        ret = open_v4l2_device (st);
+
+    if (ret < 0)
+    {
+        free (st->vbuf);
+        st->vbuf = NULL;
+        return -1;
+    }
+
+    snprintf (telem_name, sizeof (telem_name), "cam%d.latency", id);
+    st->telem_latency = telem_register (telem_name, TELEM_TIMER);
+    snprintf (telem_name, sizeof (telem_name), "cam%d.dropped", id);
+    st->telem_dropped = telem_register (telem_name, TELEM_COUNTER);
+
+    st->win_t0  = get_time_ms ();
+    st->running = 1;
+
+    pthread_mutex_lock (&s_mutex);
+    s_num_streams ++;
+    pthread_mutex_unlock (&s_mutex);
+
+    if (pthread_create (&st->thread, NULL,
+                        st->cap_dev ? v4l2_thread_main : virtual_thread_main, st) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+
+        pthread_mutex_lock (&s_mutex);
+        s_num_streams --;
+        pthread_mutex_unlock (&s_mutex);
+
+        st->running = 0;
+        if (st->cap_dev)
+        {
+            v4l2_stop_capture (st->cap_dev);
+            v4l2_close_capture_device (st->cap_dev);
+            st->cap_dev = NULL;
+        }
+        free (st->vbuf);
+        st->vbuf = NULL;
+        return -1;
+    }
+
+    return id;
+}
+
+/* the frames held by the application become invalid. */
+void
+capmgr_terminate ()
+{
+    for (int i = 0; i < s_num_streams; i ++)
+    {
+        capmgr_stream_t *st = &s_streams[i];
+
+        __atomic_store_n (&st->running, 0, __ATOMIC_RELEASE);
+        pthread_join (st->thread, NULL);
+
+        if (st->cap_dev)
+        {
+            v4l2_stop_capture (st->cap_dev);
+            v4l2_close_capture_device (st->cap_dev);
+            st->cap_dev = NULL;
+        }
+        free (st->vbuf);
+        st->vbuf = NULL;
+    }
+
+    pthread_mutex_lock (&s_mutex);
+    s_num_streams = 0;
+    pthread_cond_broadcast (&s_cond);
+    pthread_mutex_unlock (&s_mutex);
+}
+
+int
+capmgr_get_num_streams ()
+{
+    return s_num_streams;
+}
+
+int
+capmgr_get_stream_format (int stream, int *width, int *height, uint32_t *pixformat)
+{
+    if (stream < 0 || stream >= s_num_streams)
+        return -1;
+
+    *width     = s_streams[stream].width;
+    *height    = s_streams[stream].height;
+    *pixformat = s_streams[stream].pixformat;
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  acquire/release
+ * -------------------------------------------------- */
+static void
+get_deadline (struct timespec *ts, int timeout_ms)
+{
+    clock_gettime (CLOCK_MONOTONIC, ts);
+    ts->tv_sec  += timeout_ms / 1000;
+    ts->tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec  ++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* the stream whose oldest frame is the oldest. -1 if all queues are empty. */
+static int
+find_oldest_stream (int stream)
+{
+    int found = -1;
+
+    for (int i = 0; i < s_num_streams; i ++)
+    {
+        capmgr_stream_t *st = &s_streams[i];
+
+        if ((stream >= 0 && i != stream) || st->q_num == 0)
+            continue;
+
+        if (found < 0 ||
+            st->queue[st->q_head].timestamp_ms < s_streams[found].queue[s_streams[found].q_head].timestamp_ms)
+            found = i;
+    }
+    return found;
+}
+
+/* no frame will come to (stream). (-1: all the streams) */
+static int
+is_stream_dead (int stream)
+{
+    if (stream >= 0)
+        return s_streams[stream].dead;
+
+    for (int i = 0; i < s_num_streams; i ++)
+    {
+        if (s_streams[i].dead == 0)
+            return 0;
+    }
+    return 1;
+}
+
+/* (stream) = -1: any stream */
+static int
+acquire_frame (int stream, capmgr_frame_t *frame, int timeout_ms)
+{
+    struct timespec deadline;
+    int found;
+
+    if (timeout_ms > 0)
+        get_deadline (&deadline, timeout_ms);
+
+    pthread_mutex_lock (&s_mutex);
+    while ((found = find_oldest_stream (stream)) < 0)
+    {
+        if (timeout_ms == 0 || s_num_streams == 0 || is_stream_dead (stream))
+            break;
+
+        if (timeout_ms < 0)
+            pthread_cond_wait (&s_cond, &s_mutex);
+        else if (pthread_cond_timedwait (&s_cond, &s_mutex, &deadline) == ETIMEDOUT)
+        {
+            found = find_oldest_stream (stream);
+            break;
+        }
+    }
+
+    if (found >= 0)
+        pop_frame (&s_streams[found], frame);
+    pthread_mutex_unlock (&s_mutex);
+
+    return (found >= 0) ? 0 : -1;
+}
+
+int
+capmgr_acquire_frame (int stream, capmgr_frame_t *frame, int timeout_ms)
+{
+    if (stream < 0 || stream >= s_num_streams)
+        return -1;
+
+    return acquire_frame (stream, frame, timeout_ms);
+}
+
+int
+capmgr_acquire_any_frame (capmgr_frame_t *frame, int timeout_ms)
+{
+    return acquire_frame (-1, frame, timeout_ms);
+}
+
+int
+capmgr_release_frame (const capmgr_frame_t *frame)
+{
+    capmgr_stream_t *st;
+
+    pthread_mutex_lock (&s_mutex);
+    if (frame->stream < 0 || frame->stream >= s_num_streams)
+    {
+        pthread_mutex_unlock (&s_mutex);
+        return -1;
+    }
+
+    st = &s_streams[frame->stream];
+    release_buffer (st, frame->index);
+    st->num_held --;
+    pthread_mutex_unlock (&s_mutex);
+
+    return 0;
+}
+
+int
+capmgr_get_stats (int stream, capmgr_stats_t *stats)
+{
+    capmgr_stream_t *st;
+
+    if (stream < 0 || stream >= s_num_streams)
+        return -1;
+
+    st = &s_streams[stream];
+
+    pthread_mutex_lock (&s_mutex);
+    *stats = st->stats;
+    stats->num_queued = st->q_num;
+    stats->num_held   = st->num_held;
+    stats->dead       = st->dead;
+    pthread_mutex_unlock (&s_mutex);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_CAPTURE_MGR_H_
+#define _UTIL_CAPTURE_MGR_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  multi-camera capture.
+ *
+ *  every stream has its own device, V4L2 buffers and capture thread, and
+ *  a frame queue between the capture thread and the application:
+ *
+ *      id0 = capmgr_open_stream (&cfg0);
+ *      id1 = capmgr_open_stream (&cfg1);
+ *
+ *      while (capmgr_acquire_any_frame (&frame, 1000) == 0)
+ *      {
+ *          ... frame.stream, frame.buf ...
+ *          capmgr_release_frame (&frame);
+ *      }
+ *
+ *  the frames are not copied: an acquired frame holds its V4L2 buffer until
+ *  it is released. when the queue is full, the oldest waiting frame goes
+ *  back to the driver (counted as num_overwritten).
+ *  a device can't fill a buffer held by the application, so
+ *  (num_bufs) should exceed (queue_depth) + the frames held at a time.
+ *
+ *  devid = CAPMGR_VIRTUAL_DEVICE makes a test pattern source at (fps),
+ *  which behaves like a camera without the hardware.
+ */
+#define CAPMGR_MAX_STREAMS      8
+#define CAPMGR_QUEUE_MAX        8
+#define CAPMGR_MAX_BUFS         32
+#define CAPMGR_VIRTUAL_DEVICE   (-2)
+
+typedef struct _capmgr_config_t
+{
+    int         devid;              /* /dev/video(devid). -1: the first capture device */
+    int         width, height;      /* 0: as the device is configured */
+    uint32_t    pixformat;          /* V4L2 fourcc. 0: as the device is configured */
+    int         num_bufs;           /* V4L2 buffers.   0: queue_depth + 2 */
+    int         queue_depth;        /* 1..CAPMGR_QUEUE_MAX. 0: 2 */
+    float       fps;                /* virtual device only. 0: 30 */
+} capmgr_config_t;
+
+typedef struct _capmgr_frame_t
+{
+    int         stream;
+    int         index;              /* buffer index */
+    void        *buf;
+    int         width, height;
+    int         stride;             /* in bytes */
+    uint32_t    pixformat;
+    uint32_t    seq;                /* sequence number from the driver */
+    double      timestamp_ms;       /* capture time, pmeter_get_time_ms() clock */
+    double      dequeue_ms;         /* when the capture thread got it */
+} capmgr_frame_t;
+
+/* (fps) and the latency are measured over the last second. */
+typedef struct _capmgr_stats_t
+{
+    float       fps;
+    uint32_t    num_frames;         /* dequeued from the device    */
+    uint32_t    num_dropped;        /* lost before the dequeue (sequence gaps) */
+    uint32_t    num_overwritten;    /* dropped from the full queue */
+    float       latency_avg_ms;     /* capture -> dequeue */
+    float       latency_max_ms;
+    int         num_queued;         /* waiting in the queue now  */
+    int         num_held;           /* acquired and not released */
+    int         dead;               /* the device failed. no more frames */
+} capmgr_stats_t;
+
+void capmgr_config_default (capmgr_config_t *cfg, int devid);
+
+/* open the device and start capturing. returns the stream id, or -1. */
+int  capmgr_open_stream (const capmgr_config_t *cfg);
+
+/* stop all the streams, and close the devices. */
+void capmgr_terminate ();
+
+int  capmgr_get_num_streams ();
+int  capmgr_get_stream_format (int stream, int *width, int *height, uint32_t *pixformat);
+
+/*
+ *  take the oldest frame in the queue. wait up to (timeout_ms) for a frame.
+ *  (-1: forever, 0: don't wait). returns -1 if no frame is available.
+ *  a dead stream doesn't block: it returns -1 once its queue is empty.
+ */
+int  capmgr_acquire_frame (int stream, capmgr_frame_t *frame, int timeout_ms);
+
+/* the oldest frame among all the streams, to serve them with one model. */
+int  capmgr_acquire_any_frame (capmgr_frame_t *frame, int timeout_ms);
+int  capmgr_release_frame (const capmgr_frame_t *frame);
+
+int  capmgr_get_stats (int stream, capmgr_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_CAPTURE_MGR_H_ */
@@ -3,6 +3,7 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include <stdio.h>
+#include <string.h>
 #include <GLES2/gl2.h>
 #include "util_shader.h"
 #include "util_debugstr.h"
@@ -46,6 +47,7 @@ static const char s_strDbgStrFS[] =
 #define DEBSTR_FONT_NUM     (95)
 #define DBGSTR_IMAGE_WIDTH  (DEBSTR_FONT_WIDTH*DEBSTR_FONT_NUM)
 #define DBGSTR_IMAGE_HEIGHT (DEBSTR_FONT_HEIGHT)
+#define DBGSTR_MAX_CHARS    (256)   /* characters per draw call */
 
 static unsigned int     s_font12x22[];
 static unsigned int     s_fontTexID;
@@ -54,6 +56,8 @@ static GLuint           s_progShader;
 static int              locVtx, locUv, locTranslate, locSampler0;
 static int              locPrjMul, locPrjAdd;
 static int              locColFG, locColBG;
+static GLuint           s_vbo;
+static float            s_vtxbuf[DBGSTR_MAX_CHARS * 6 * 4];    /* 6 x (x, y, u, v) per char */
 
 static int
 load_debug_font_texture (void)
@@ -105,36 +109,59 @@ init_dbgstr (int win_w, int win_h)
 
     load_debug_font_texture ();
     setup_shader();
+
+    if (s_vbo == 0)
+        glGenBuffers (1, &s_vbo);
+}
+
+
+static void
+flush_chars (int num)
+{
+    if (num == 0)
+        return;
+
+    glBufferData (GL_ARRAY_BUFFER, num * 6 * 4 * sizeof (float), s_vtxbuf, GL_STREAM_DRAW);
+    glDrawArrays (GL_TRIANGLES, 0, num * 6);
 }
 
+static void (*s_flush_hook) ();
+
+void
+set_dbgstr_flush_hook (void (*flush_func) ())
+{
+    s_flush_hook = flush_func;
+}
 
+/*
+ *  all the characters of the string are put in one vertex buffer
+ *  and drawn by one draw call.
+ */
 int
 draw_dbgstr_ex (char *str, int x, int y, float scale, float *col_fg, float *col_bg)
 {
-    int   i, row, column;
-    float u0, u1;
-    float vertices[8], texcoord[8];
+    int   i, row, column, num;
     float fW = DEBSTR_FONT_WIDTH  * scale;
     float fH = DEBSTR_FONT_HEIGHT * scale;
     float fx = (float)x;
     float fy = (float)y;
 
-    vertices[ 2 * 0 + 0 ] = fx;      vertices[ 2 * 0 + 1 ] = fy;
-    vertices[ 2 * 1 + 0 ] = fx;      vertices[ 2 * 1 + 1 ] = fy + fH;
-    vertices[ 2 * 2 + 0 ] = fx + fW; vertices[ 2 * 2 + 1 ] = fy;
-    vertices[ 2 * 3 + 0 ] = fx + fW; vertices[ 2 * 3 + 1 ] = fy + fH;
+    /* keep the drawing order with the pending 2D primitives */
+    if (s_flush_hook)
+        s_flush_hook ();
 
     glUseProgram (s_progShader);
 
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
+    glBindBuffer (GL_ARRAY_BUFFER, s_vbo);
     glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
 
     glEnableVertexAttribArray (locVtx);
     glEnableVertexAttribArray (locUv );
-    glVertexAttribPointer (locVtx, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-    glVertexAttribPointer (locUv,  2, GL_FLOAT, GL_FALSE, 0, texcoord);
+    glVertexAttribPointer (locVtx, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (float), (void *)0);
+    glVertexAttribPointer (locUv,  2, GL_FLOAT, GL_FALSE, 4 * sizeof (float), (void *)(2 * sizeof (float)));
 
     glUniform1i (locSampler0, 0);
+    glUniform4f (locTranslate, 0.0f, 0.0f, 0.0f, 0.0f);
     glUniform4f (locPrjMul, 2.0f / s_wndW, -2.0f / s_wndH, 0.0f, 0.0f);
     glUniform4f (locPrjAdd, -1.0f, 1.0f, 1.0f, 1.0f);
     glUniform4fv(locColFG, 1, col_fg);
@@ -150,7 +177,7 @@ draw_dbgstr_ex (char *str, int x, int y, float scale, float *col_fg, float *col_
     glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, 
     	       GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
-    row = column = 0;
+    row = column = num = 0;
     for (i = 0; ; i ++)
     {
         int c = str[i];
@@ -165,24 +192,31 @@ draw_dbgstr_ex (char *str, int x, int y, float scale, float *col_fg, float *col_
             continue;
         }
 
-        u0 = (c - 0x20) * (1.0f / DEBSTR_FONT_NUM);
-        u1 = u0 + (1.0f / DEBSTR_FONT_NUM);
-
-        texcoord[ 2 * 0 + 0 ] = texcoord[ 2 * 1 + 0 ] = u0;
-        texcoord[ 2 * 2 + 0 ] = texcoord[ 2 * 3 + 0 ] = u1;
-        texcoord[ 2 * 0 + 1 ] = texcoord[ 2 * 2 + 1 ] = 0.0;
-        texcoord[ 2 * 1 + 1 ] = texcoord[ 2 * 3 + 1 ] = 1.0;
-
-        glUniform4f (locTranslate, column * fW, row * fH, 0.0f, 0.0f );
-
-        glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
+        float u0 = (c - 0x20) * (1.0f / DEBSTR_FONT_NUM);
+        float u1 = u0 + (1.0f / DEBSTR_FONT_NUM);
+        float x0 = fx + column * fW;
+        float y0 = fy + row    * fH;
+        float x1 = x0 + fW;
+        float y1 = y0 + fH;
+        float quad[6][4] = {{x0, y0, u0, 0.0f}, {x0, y1, u0, 1.0f}, {x1, y0, u1, 0.0f},
+                            {x1, y0, u1, 0.0f}, {x0, y1, u0, 1.0f}, {x1, y1, u1, 1.0f}};
 
+        memcpy (&s_vtxbuf[num * 6 * 4], quad, sizeof (quad));
+        num ++;
         column ++;
+
+        if (num == DBGSTR_MAX_CHARS)
+        {
+            flush_chars (num);
+            num = 0;
+        }
     }
+    flush_chars (num);
 
     glDisable (GL_BLEND);
     glDisableVertexAttribArray (locVtx);
     glDisableVertexAttribArray (locUv );
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
     GLASSERT();
 
     return 0;
@@ -13,6 +13,9 @@ void init_dbgstr (int win_w, int win_h);
 int  draw_dbgstr    (char *str, int x, int y);
 int  draw_dbgstr_ex (char *str, int x, int y, float scale, float *col_fg, float *col_bg);
 
+/* called before drawing a string, to draw the pending primitives of another renderer first. */
+void set_dbgstr_flush_hook (void (*flush_func) ());
+
 #ifdef __cplusplus
 }
 #endif
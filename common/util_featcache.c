@@ -0,0 +1,260 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "util_featcache.h"
+#include "util_debug.h"
+
+#define FEATCACHE_MAGIC         0x48434346      /* "FCCH" */
+#define FEATCACHE_VERSION       1
+
+#define FNV_OFFSET_BASIS        0xcbf29ce484222325ULL
+#define FNV_PRIME               0x00000100000001b3ULL
+
+typedef struct _featcache_header_t
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    dim;
+    uint32_t    num;            /* updated after the record is written */
+    uint64_t    model_key;
+    uint64_t    reserved;
+} featcache_header_t;
+
+typedef struct _featcache_record_t
+{
+    uint64_t    key;
+    float       vec[1];         /* [dim] */
+} featcache_record_t;
+
+
+/* -------------------------------------------------- *
+ *  hash
+ * -------------------------------------------------- */
+uint64_t
+featcache_hash (const void *data, size_t size, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = seed ? seed : FNV_OFFSET_BASIS;
+
+    while (size --> 0)
+    {
+        h ^= *p ++;
+        h *= FNV_PRIME;
+    }
+
+    return h;
+}
+
+int
+featcache_hash_file (const char *path, uint64_t *hash)
+{
+    unsigned char buf[64 * 1024];
+    uint64_t h = 0;
+    size_t len;
+    FILE *fp;
+
+    fp = fopen (path, "rb");
+    if (fp == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d): %s\n", __FILE__, __LINE__, path);
+        return -1;
+    }
+
+    while ((len = fread (buf, 1, sizeof (buf), fp)) > 0)
+        h = featcache_hash (buf, len, h);
+
+    fclose (fp);
+
+    *hash = h;
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  file
+ * -------------------------------------------------- */
+static featcache_record_t *
+get_record (featcache_t *cache, int idx)
+{
+    char *p = (char *)cache->map + sizeof (featcache_header_t);
+    return (featcache_record_t *)(p + cache->stride * idx);
+}
+
+static int
+map_file (featcache_t *cache, size_t size)
+{
+    void *map;
+
+    if (cache->map)
+        munmap (cache->map, cache->map_size);
+    cache->map      = NULL;
+    cache->map_size = 0;
+
+    map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    cache->map      = map;
+    cache->map_size = size;
+    return 0;
+}
+
+static int
+init_file (featcache_t *cache, uint64_t model_key)
+{
+    featcache_header_t *hdr;
+
+    if (ftruncate (cache->fd, 0) < 0 ||
+        ftruncate (cache->fd, sizeof (featcache_header_t)) < 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (map_file (cache, sizeof (featcache_header_t)) < 0)
+        return -1;
+
+    hdr = (featcache_header_t *)cache->map;
+    hdr->magic     = FEATCACHE_MAGIC;
+    hdr->version   = FEATCACHE_VERSION;
+    hdr->dim       = cache->dim;
+    hdr->num       = 0;
+    hdr->model_key = model_key;
+    hdr->reserved  = 0;
+
+    cache->num = 0;
+    return 0;
+}
+
+int
+featcache_open (featcache_t *cache, const char *path, int dim, uint64_t model_key)
+{
+    featcache_header_t *hdr;
+    struct stat st;
+    size_t num_fit;
+
+    memset (cache, 0, sizeof (*cache));
+    cache->dim    = dim;
+    cache->stride = (sizeof (uint64_t) + dim * sizeof (float) + 7) & ~(size_t)7;
+
+    cache->fd = open (path, O_RDWR | O_CREAT, 0644);
+    if (cache->fd < 0)
+    {
+        DBG_LOGE ("ERR: %s(%d): %s\n", __FILE__, __LINE__, path);
+        cache->fd = -1;
+        return -1;
+    }
+
+    if (fstat (cache->fd, &st) < 0 || (size_t)st.st_size < sizeof (featcache_header_t))
+    {
+        if (init_file (cache, model_key) < 0)
+        {
+            featcache_close (cache);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (map_file (cache, st.st_size) < 0)
+    {
+        featcache_close (cache);
+        return -1;
+    }
+
+    hdr = (featcache_header_t *)cache->map;
+    if (hdr->magic != FEATCACHE_MAGIC || hdr->version != FEATCACHE_VERSION ||
+        hdr->dim != (uint32_t)dim || hdr->model_key != model_key)
+    {
+        DBG_LOG ("%s: stale cache, discarded.\n", path);
+        if (init_file (cache, model_key) < 0)
+        {
+            featcache_close (cache);
+            return -1;
+        }
+        return 0;
+    }
+
+    /* a record cut off by a crash is ignored. */
+    num_fit    = (st.st_size - sizeof (featcache_header_t)) / cache->stride;
+    cache->num = (hdr->num < num_fit) ? hdr->num : num_fit;
+
+    return 0;
+}
+
+void
+featcache_close (featcache_t *cache)
+{
+    if (cache->map)
+        munmap (cache->map, cache->map_size);
+    if (cache->fd >= 0)
+        close (cache->fd);
+
+    cache->map      = NULL;
+    cache->map_size = 0;
+    cache->fd       = -1;
+    cache->num      = 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  records
+ * -------------------------------------------------- */
+const float *
+featcache_lookup (featcache_t *cache, uint64_t key)
+{
+    int i;
+
+    if (cache->map == NULL)
+        return NULL;
+
+    for (i = 0; i < cache->num; i ++)
+    {
+        featcache_record_t *rec = get_record (cache, i);
+        if (rec->key == key)
+            return rec->vec;
+    }
+
+    return NULL;
+}
+
+int
+featcache_insert (featcache_t *cache, uint64_t key, const float *vec)
+{
+    featcache_header_t *hdr;
+    featcache_record_t *rec;
+    size_t size;
+
+    if (cache->map == NULL)
+        return -1;
+
+    size = sizeof (featcache_header_t) + cache->stride * (cache->num + 1);
+    if (size > cache->map_size)
+    {
+        if (ftruncate (cache->fd, size) < 0 || map_file (cache, size) < 0)
+        {
+            DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    rec = get_record (cache, cache->num);
+    rec->key = key;
+    memcpy (rec->vec, vec, cache->dim * sizeof (float));
+
+    cache->num ++;
+    hdr = (featcache_header_t *)cache->map;
+    hdr->num = cache->num;
+
+    return 0;
+}
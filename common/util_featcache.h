@@ -0,0 +1,58 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_FEATCACHE_H_
+#define _UTIL_FEATCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  persistent cache of the feature vectors (style bottlenecks, embeddings, ...).
+ *
+ *      featcache_hash_file (model_path, &model_key);
+ *      featcache_open (&cache, "style_cache.bin", 100, model_key);
+ *
+ *      featcache_hash_file (image_path, &key);
+ *      if ((vec = featcache_lookup (&cache, key)) == NULL)
+ *      {
+ *          ... run the model ...
+ *          featcache_insert (&cache, key, result);
+ *      }
+ *
+ *  the file is a header and the fixed size records {key, float[dim]}, and is
+ *  mapped to the memory as it is. a file made by another model (model_key) or
+ *  another dimension is discarded on open.
+ *
+ *  the pointer returned by featcache_lookup() is valid until the next insert.
+ */
+typedef struct _featcache_t
+{
+    int         fd;
+    void        *map;
+    size_t      map_size;
+    int         dim;
+    int         num;
+    size_t      stride;         /* bytes of a record */
+} featcache_t;
+
+/* FNV-1a 64bit. (seed) is 0 for the first block. */
+uint64_t featcache_hash      (const void *data, size_t size, uint64_t seed);
+int      featcache_hash_file (const char *path, uint64_t *hash);
+
+int      featcache_open   (featcache_t *cache, const char *path, int dim, uint64_t model_key);
+void     featcache_close  (featcache_t *cache);
+
+const float *featcache_lookup (featcache_t *cache, uint64_t key);
+int      featcache_insert (featcache_t *cache, uint64_t key, const float *vec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_FEATCACHE_H_ */
@@ -0,0 +1,304 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "util_heatmap.h"
+#include "util_debug.h"
+
+
+/* -------------------------------------------------- *
+ *  load
+ * -------------------------------------------------- */
+static inline float
+logistic (float val)
+{
+    const float cutoff_upper = 16.619047164916992188f;
+    const float cutoff_lower = -9.f;
+
+    if (val > cutoff_upper)
+        return 1.0f;
+    else if (val < cutoff_lower)
+        return expf (val);
+    else
+        return 1.f / (1.f + expf (-val));
+}
+
+static int
+reserve_floats (float **buf, int *size, int num)
+{
+    float *ptr;
+
+    if (*buf && *size >= num)
+        return 0;
+
+    ptr = (float *)realloc (*buf, num * sizeof (float));
+    if (ptr == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    *buf  = ptr;
+    *size = num;
+    return 0;
+}
+
+int
+heatmap_load (heatmap_t *hmp, const float *src, int w, int h, int c, int flags)
+{
+    int num = w * h;
+    int len = (w > h) ? w : h;
+    int x, y, key;
+
+    if (reserve_floats (&hmp->score, &hmp->score_size, num * c + num) < 0)
+        return -1;
+
+    /* 3 lines of (n + 4 * radius) at most. radius is clamped to (len). see max_filter_1d() */
+    if (reserve_floats (&hmp->work, &hmp->work_size, 3 * (5 * len + 1)) < 0)
+        return -1;
+
+    hmp->w      = w;
+    hmp->h      = h;
+    hmp->c      = c;
+    hmp->maxmap = hmp->score + num * c;
+
+    /* [h][w][c] --> [c][h][w] */
+    for (y = 0; y < h; y ++)
+    {
+        for (x = 0; x < w; x ++)
+        {
+            const float *s = &src[(y * w + x) * c];
+            float *d = &hmp->score[y * w + x];
+
+            if (flags & HEATMAP_FLAG_LOGISTIC)
+            {
+                for (key = 0; key < c; key ++)
+                    d[key * num] = logistic (s[key]);
+            }
+            else
+            {
+                for (key = 0; key < c; key ++)
+                    d[key * num] = s[key];
+            }
+        }
+    }
+
+    return 0;
+}
+
+void
+heatmap_free (heatmap_t *hmp)
+{
+    if (hmp->score)
+        free (hmp->score);
+    if (hmp->work)
+        free (hmp->work);
+
+    memset (hmp, 0, sizeof (*hmp));
+}
+
+float
+heatmap_get (const heatmap_t *hmp, int x, int y, int key)
+{
+    return hmp->score[(key * hmp->h + y) * hmp->w + x];
+}
+
+
+/* -------------------------------------------------- *
+ *  van Herk/Gil-Werman max filter
+ *
+ *  the line is padded with -FLT_MAX by (r) on both sides and split into
+ *  blocks of the window size (k). the max of any window is the max of
+ *  the suffix max of one block and the prefix max of the next block:
+ *
+ *      dst[i] = max (suffix[i], prefix[i + k - 1])
+ *
+ *  (src) and (dst) may be the same line.
+ * -------------------------------------------------- */
+static void
+max_filter_1d (const float *src, int sstep, float *dst, int dstep, int n, int r, float *work)
+{
+    int k   = 2 * r + 1;
+    int len = ((n + 2 * r + k - 1) / k) * k;
+    float *pad    = work;
+    float *prefix = work + len;
+    float *suffix = work + len * 2;
+    int i, b;
+
+    for (i = 0; i < len; i ++)
+        pad[i] = (i < r || i >= r + n) ? -FLT_MAX : src[(i - r) * sstep];
+
+    for (b = 0; b < len; b += k)
+    {
+        prefix[b] = pad[b];
+        for (i = b + 1; i < b + k; i ++)
+            prefix[i] = fmaxf (prefix[i - 1], pad[i]);
+
+        suffix[b + k - 1] = pad[b + k - 1];
+        for (i = b + k - 2; i >= b; i --)
+            suffix[i] = fmaxf (suffix[i + 1], pad[i]);
+    }
+
+    for (i = 0; i < n; i ++)
+        dst[i * dstep] = fmaxf (suffix[i], prefix[i + k - 1]);
+}
+
+void
+heatmap_max_filter (heatmap_t *hmp, int key, int radius, float *dst)
+{
+    const float *score = &hmp->score[key * hmp->w * hmp->h];
+    int w = hmp->w;
+    int h = hmp->h;
+    int x, y;
+
+    /* the window never needs to be larger than the map */
+    if (radius > w && radius > h)
+        radius = (w > h) ? w : h;
+
+    if (radius <= 0)
+    {
+        memcpy (dst, score, w * h * sizeof (float));
+        return;
+    }
+
+    for (y = 0; y < h; y ++)
+        max_filter_1d (&score[y * w], 1, &dst[y * w], 1, w, radius, hmp->work);
+
+    for (x = 0; x < w; x ++)
+        max_filter_1d (&dst[x], w, &dst[x], w, h, radius, hmp->work);
+}
+
+
+/* -------------------------------------------------- *
+ *  peaks
+ * -------------------------------------------------- */
+/* (a) comes before (b) */
+static inline int
+peak_precedes (const heatmap_peak_t *a, const heatmap_peak_t *b)
+{
+    if (a->score != b->score) return a->score > b->score;
+    if (a->y     != b->y    ) return a->y     < b->y;
+    if (a->x     != b->x    ) return a->x     < b->x;
+    return a->key < b->key;
+}
+
+/*
+ *  the peaks are kept in a binary heap whose root is the lowest one,
+ *  so that only the best (max_peaks) survive in O(N log max_peaks).
+ */
+static void
+sift_down (heatmap_peak_t *heap, int num, int i)
+{
+    heatmap_peak_t item = heap[i];
+
+    while (1)
+    {
+        int child = 2 * i + 1;
+        if (child >= num)
+            break;
+
+        if (child + 1 < num && peak_precedes (&heap[child], &heap[child + 1]))
+            child ++;
+
+        if (!peak_precedes (&item, &heap[child]))
+            break;
+
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+static int
+push_peak (heatmap_peak_t *heap, int num, int max_peaks, const heatmap_peak_t *item)
+{
+    int i;
+
+    if (num == max_peaks)
+    {
+        /* replace the lowest one */
+        if (peak_precedes (item, &heap[0]))
+        {
+            heap[0] = *item;
+            sift_down (heap, num, 0);
+        }
+        return num;
+    }
+
+    /* sift up */
+    for (i = num; i > 0; )
+    {
+        int parent = (i - 1) / 2;
+        if (!peak_precedes (&heap[parent], item))
+            break;
+
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = *item;
+
+    return num + 1;
+}
+
+/* heap sort. the lowest one goes to the tail first. */
+static void
+sort_peaks (heatmap_peak_t *heap, int num)
+{
+    int i;
+
+    for (i = num - 1; i > 0; i --)
+    {
+        heatmap_peak_t tmp = heap[0];
+        heap[0] = heap[i];
+        heap[i] = tmp;
+        sift_down (heap, i, 0);
+    }
+}
+
+int
+heatmap_find_peaks (heatmap_t *hmp, int radius, float thresh,
+                    heatmap_peak_t *peaks, int max_peaks)
+{
+    int w = hmp->w;
+    int h = hmp->h;
+    int num = 0;
+    int x, y, key;
+
+    if (max_peaks <= 0)
+        return 0;
+
+    for (key = 0; key < hmp->c; key ++)
+    {
+        const float *score = &hmp->score[key * w * h];
+
+        heatmap_max_filter (hmp, key, radius, hmp->maxmap);
+
+        for (y = 0; y < h; y ++)
+        {
+            for (x = 0; x < w; x ++)
+            {
+                heatmap_peak_t item;
+                float val = score[y * w + x];
+
+                /* if there is a higher score near this cell, skip it. */
+                if (val < thresh || val < hmp->maxmap[y * w + x])
+                    continue;
+
+                item.score = val;
+                item.x     = x;
+                item.y     = y;
+                item.key   = key;
+                num = push_peak (peaks, num, max_peaks, &item);
+            }
+        }
+    }
+
+    sort_peaks (peaks, num);
+
+    return num;
+}
@@ -0,0 +1,63 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_HEATMAP_H_
+#define _UTIL_HEATMAP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  peak extraction of keypoint heatmaps (objectron, posenet).
+ *
+ *  a cell is a peak if it is the maximum in the (2 * radius + 1) square
+ *  window around it, and its score is not less than the threshold.
+ *  the window max is computed by the van Herk/Gil-Werman algorithm,
+ *  horizontally then vertically, so the cost doesn't depend on (radius).
+ *
+ *  the activation is applied only once, when the heatmap is loaded.
+ */
+#define HEATMAP_FLAG_LOGISTIC   (1 << 0)    /* apply sigmoid to the raw logits */
+
+typedef struct _heatmap_t
+{
+    int     w, h;
+    int     c;              /* number of keys */
+    float   *score;         /* [c][h][w] */
+    float   *maxmap;        /* [h][w] window max of one key */
+    float   *work;          /* line buffers of the max filter */
+    int     score_size;     /* allocated floats */
+    int     work_size;
+} heatmap_t;
+
+typedef struct _heatmap_peak_t
+{
+    float   score;
+    int     x, y;
+    int     key;
+} heatmap_peak_t;
+
+/* (src) is [h][w][c] (NHWC output tensor). returns -1 on allocation failure. */
+int   heatmap_load  (heatmap_t *hmp, const float *src, int w, int h, int c, int flags);
+void  heatmap_free  (heatmap_t *hmp);
+
+float heatmap_get   (const heatmap_t *hmp, int x, int y, int key);
+
+/* window max of one key. (dst) is [h][w] */
+void  heatmap_max_filter (heatmap_t *hmp, int key, int radius, float *dst);
+
+/*
+ *  find the peaks of all the keys, in the descending order of the score.
+ *  (ties are in the raster order of (y, x, key)). when there are more than
+ *  (max_peaks), the lowest ones are dropped. returns the number of peaks.
+ */
+int   heatmap_find_peaks (heatmap_t *hmp, int radius, float thresh,
+                          heatmap_peak_t *peaks, int max_peaks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_HEATMAP_H_ */
@@ -0,0 +1,450 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_nms.h"
+#include "util_debug.h"
+
+#if defined (__ARM_NEON__) || defined (__aarch64__)
+#include <arm_neon.h>
+#define NMS_USE_NEON
+#elif defined (__SSE__)
+#include <xmmintrin.h>
+#define NMS_USE_SSE
+#endif
+
+#define _max(A, B)    ((A) > (B) ? (A) : (B))
+#define _min(A, B)    ((A) < (B) ? (A) : (B))
+
+typedef struct _nms_order_t
+{
+    float   score;
+    int     idx;
+} nms_order_t;
+
+
+int
+nms_init (nms_t *nms, int capacity)
+{
+    int   stride = (capacity + 3) & ~3;
+    size_t size  = stride * sizeof (nms_order_t) +
+                   stride * sizeof (float) * 5 +
+                   stride * sizeof (int);
+    void  *buf;
+
+    memset (nms, 0, sizeof (*nms));
+
+    if (posix_memalign (&buf, 16, size) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+    memset (buf, 0, size);
+
+    float *fbuf = (float *)((nms_order_t *)buf + stride);
+
+    nms->capacity = capacity;
+    nms->buf   = buf;
+    nms->order = buf;
+    nms->x0    = fbuf + stride * 0;
+    nms->y0    = fbuf + stride * 1;
+    nms->x1    = fbuf + stride * 2;
+    nms->y1    = fbuf + stride * 3;
+    nms->area  = fbuf + stride * 4;
+    nms->alive = (int *)(fbuf + stride * 5);
+
+    return 0;
+}
+
+void
+nms_destroy (nms_t *nms)
+{
+    if (nms->buf)
+        free (nms->buf);
+
+    memset (nms, 0, sizeof (*nms));
+}
+
+
+/* -------------------------------------------------- *
+ *  IoU
+ *      https://github.com/tensorflow/tfjs/blob/master/tfjs-core/src/ops/image_ops.ts
+ * -------------------------------------------------- */
+float
+nms_calc_iou (const nms_box_t *box0, const nms_box_t *box1)
+{
+    float xmin0 = _min (box0->x0, box0->x1);
+    float ymin0 = _min (box0->y0, box0->y1);
+    float xmax0 = _max (box0->x0, box0->x1);
+    float ymax0 = _max (box0->y0, box0->y1);
+    float xmin1 = _min (box1->x0, box1->x1);
+    float ymin1 = _min (box1->y0, box1->y1);
+    float xmax1 = _max (box1->x0, box1->x1);
+    float ymax1 = _max (box1->y0, box1->y1);
+
+    float area0 = (ymax0 - ymin0) * (xmax0 - xmin0);
+    float area1 = (ymax1 - ymin1) * (xmax1 - xmin1);
+    if (area0 <= 0 || area1 <= 0)
+        return 0.0f;
+
+    float intersect_xmin = _max (xmin0, xmin1);
+    float intersect_ymin = _max (ymin0, ymin1);
+    float intersect_xmax = _min (xmax0, xmax1);
+    float intersect_ymax = _min (ymax0, ymax1);
+
+    float intersect_area = _max (intersect_ymax - intersect_ymin, 0.0f) *
+                           _max (intersect_xmax - intersect_xmin, 0.0f);
+
+    return intersect_area / (area0 + area1 - intersect_area);
+}
+
+/* store a box into the SoA slot with normalized (min/max) coordinates */
+static void
+store_box (nms_t *nms, int slot, const nms_box_t *box)
+{
+    float x0 = _min (box->x0, box->x1);
+    float y0 = _min (box->y0, box->y1);
+    float x1 = _max (box->x0, box->x1);
+    float y1 = _max (box->y0, box->y1);
+
+    nms->x0  [slot] = x0;
+    nms->y0  [slot] = y0;
+    nms->x1  [slot] = x1;
+    nms->y1  [slot] = y1;
+    nms->area[slot] = (x1 - x0) * (y1 - y0);
+}
+
+/*
+ *  test box[slot] against SoA boxes [start, start + 4).
+ *  IoU >= thresh is evaluated as (inter >= thresh * union) to avoid the division.
+ *  returns a 4bit mask of the overlapped boxes.
+ */
+static int
+overlap_mask4 (const nms_t *nms, int slot, int start, float thresh, int strict)
+{
+    float cx0   = nms->x0  [slot];
+    float cy0   = nms->y0  [slot];
+    float cx1   = nms->x1  [slot];
+    float cy1   = nms->y1  [slot];
+    float carea = nms->area[slot];
+
+#if defined (NMS_USE_NEON)
+    static const uint32_t s_bits[4] = {1, 2, 4, 8};
+    float32x4_t vzero = vdupq_n_f32 (0.0f);
+    float32x4_t karea = vld1q_f32 (&nms->area[start]);
+    float32x4_t ix0 = vmaxq_f32 (vdupq_n_f32 (cx0), vld1q_f32 (&nms->x0[start]));
+    float32x4_t iy0 = vmaxq_f32 (vdupq_n_f32 (cy0), vld1q_f32 (&nms->y0[start]));
+    float32x4_t ix1 = vminq_f32 (vdupq_n_f32 (cx1), vld1q_f32 (&nms->x1[start]));
+    float32x4_t iy1 = vminq_f32 (vdupq_n_f32 (cy1), vld1q_f32 (&nms->y1[start]));
+    float32x4_t iw  = vmaxq_f32 (vsubq_f32 (ix1, ix0), vzero);
+    float32x4_t ih  = vmaxq_f32 (vsubq_f32 (iy1, iy0), vzero);
+    float32x4_t inter = vmulq_f32 (iw, ih);
+    float32x4_t uni   = vsubq_f32 (vaddq_f32 (vdupq_n_f32 (carea), karea), inter);
+    float32x4_t tuni  = vmulq_f32 (uni, vdupq_n_f32 (thresh));
+    uint32x4_t  mask  = strict ? vcgtq_f32 (inter, tuni) : vcgeq_f32 (inter, tuni);
+
+    mask = vandq_u32 (mask, vcgtq_f32 (karea, vzero));
+    mask = vandq_u32 (mask, vld1q_u32 (s_bits));
+
+    uint32x2_t sum = vadd_u32 (vget_low_u32 (mask), vget_high_u32 (mask));
+    sum = vpadd_u32 (sum, sum);
+    return (carea > 0.0f) ? (int)vget_lane_u32 (sum, 0) : 0;
+
+#elif defined (NMS_USE_SSE)
+    __m128 vzero = _mm_setzero_ps ();
+    __m128 karea = _mm_loadu_ps (&nms->area[start]);
+    __m128 ix0 = _mm_max_ps (_mm_set1_ps (cx0), _mm_loadu_ps (&nms->x0[start]));
+    __m128 iy0 = _mm_max_ps (_mm_set1_ps (cy0), _mm_loadu_ps (&nms->y0[start]));
+    __m128 ix1 = _mm_min_ps (_mm_set1_ps (cx1), _mm_loadu_ps (&nms->x1[start]));
+    __m128 iy1 = _mm_min_ps (_mm_set1_ps (cy1), _mm_loadu_ps (&nms->y1[start]));
+    __m128 iw  = _mm_max_ps (_mm_sub_ps (ix1, ix0), vzero);
+    __m128 ih  = _mm_max_ps (_mm_sub_ps (iy1, iy0), vzero);
+    __m128 inter = _mm_mul_ps (iw, ih);
+    __m128 uni   = _mm_sub_ps (_mm_add_ps (_mm_set1_ps (carea), karea), inter);
+    __m128 tuni  = _mm_mul_ps (uni, _mm_set1_ps (thresh));
+    __m128 mask  = strict ? _mm_cmpgt_ps (inter, tuni) : _mm_cmpge_ps (inter, tuni);
+
+    mask = _mm_and_ps (mask, _mm_cmpgt_ps (karea, vzero));
+    return (carea > 0.0f) ? _mm_movemask_ps (mask) : 0;
+
+#else
+    int i, bits = 0;
+
+    if (carea <= 0.0f)
+        return 0;
+
+    for (i = 0; i < 4; i ++)
+    {
+        int   k = start + i;
+        float iw = _max (_min (cx1, nms->x1[k]) - _max (cx0, nms->x0[k]), 0.0f);
+        float ih = _max (_min (cy1, nms->y1[k]) - _max (cy0, nms->y0[k]), 0.0f);
+        float inter = iw * ih;
+        float tuni  = (carea + nms->area[k] - inter) * thresh;
+
+        if (nms->area[k] > 0.0f && (strict ? (inter > tuni) : (inter >= tuni)))
+            bits |= (1 << i);
+    }
+    return bits;
+#endif
+}
+
+static int
+overlap_1 (const nms_t *nms, int slot, int k, float thresh, int strict)
+{
+    float carea = nms->area[slot];
+    float karea = nms->area[k];
+
+    if (carea <= 0.0f || karea <= 0.0f)
+        return 0;
+
+    float iw = _max (_min (nms->x1[slot], nms->x1[k]) - _max (nms->x0[slot], nms->x0[k]), 0.0f);
+    float ih = _max (_min (nms->y1[slot], nms->y1[k]) - _max (nms->y0[slot], nms->y0[k]), 0.0f);
+    float inter = iw * ih;
+    float tuni  = (carea + karea - inter) * thresh;
+
+    return strict ? (inter > tuni) : (inter >= tuni);
+}
+
+
+/* -------------------------------------------------- *
+ *  sort candidates by score (descending).
+ *  a bounded min-heap keeps the best k, then it is
+ *  heap-sorted in place. no allocation.
+ * -------------------------------------------------- */
+static int
+order_less (const nms_order_t *a, const nms_order_t *b)
+{
+    /* ties are broken by index to keep the result stable. */
+    if (a->score != b->score)
+        return a->score < b->score;
+    return a->idx > b->idx;
+}
+
+static void
+heap_sift_down (nms_order_t *heap, int num, int pos)
+{
+    while (1)
+    {
+        int l = 2 * pos + 1;
+        int r = l + 1;
+        int m = pos;
+
+        if (l < num && order_less (&heap[l], &heap[m])) m = l;
+        if (r < num && order_less (&heap[r], &heap[m])) m = r;
+        if (m == pos)
+            break;
+
+        nms_order_t tmp = heap[pos];
+        heap[pos] = heap[m];
+        heap[m]   = tmp;
+        pos = m;
+    }
+}
+
+static int
+select_topk (nms_t *nms, const nms_box_t *boxes, int num, int k)
+{
+    nms_order_t *heap = (nms_order_t *)nms->order;
+    int i;
+
+    if (k > num)           k = num;
+    if (k > nms->capacity) k = nms->capacity;
+    if (k <= 0)
+        return 0;
+
+    for (i = 0; i < k; i ++)
+    {
+        heap[i].score = boxes[i].score;
+        heap[i].idx   = i;
+    }
+    for (i = k / 2 - 1; i >= 0; i --)
+        heap_sift_down (heap, k, i);
+
+    for (i = k; i < num; i ++)
+    {
+        nms_order_t item = {boxes[i].score, i};
+        if (order_less (&heap[0], &item))
+        {
+            heap[0] = item;
+            heap_sift_down (heap, k, 0);
+        }
+    }
+
+    /* heap sort: min goes to the tail, which yields descending order. */
+    for (i = k - 1; i > 0; i --)
+    {
+        nms_order_t tmp = heap[0];
+        heap[0] = heap[i];
+        heap[i] = tmp;
+        heap_sift_down (heap, i, 0);
+    }
+
+    return k;
+}
+
+
+/* -------------------------------------------------- *
+ *  Hard NMS
+ * -------------------------------------------------- */
+static int
+nms_hard_sorted (nms_t *nms, const nms_box_t *boxes, int num_sorted, float iou_thresh,
+                 int max_keep, int *keep)
+{
+    nms_order_t *order = (nms_order_t *)nms->order;
+    int num_keep = 0;
+    int i, k;
+
+    for (i = 0; i < num_sorted && num_keep < max_keep; i ++)
+    {
+        int idx = order[i].idx;
+        int suppressed = 0;
+
+        /* the candidate is staged in the first free slot of the kept list. */
+        store_box (nms, num_keep, &boxes[idx]);
+
+        for (k = 0; k + 4 <= num_keep; k += 4)
+        {
+            if (overlap_mask4 (nms, num_keep, k, iou_thresh, 0))
+            {
+                suppressed = 1;
+                break;
+            }
+        }
+        for (; !suppressed && k < num_keep; k ++)
+        {
+            suppressed = overlap_1 (nms, num_keep, k, iou_thresh, 0);
+        }
+
+        if (!suppressed)
+            keep[num_keep ++] = idx;
+    }
+
+    return num_keep;
+}
+
+/*
+ *  boxes with IoU >= iou_thresh against a higher scored box are removed.
+ *  keep[] receives indices into boxes[], ordered by score.
+ *  if num exceeds the capacity, only the best (capacity) boxes are considered.
+ */
+int
+nms_hard (nms_t *nms, const nms_box_t *boxes, int num, float iou_thresh,
+          int max_keep, int *keep)
+{
+    int num_sorted = select_topk (nms, boxes, num, num);
+
+    return nms_hard_sorted (nms, boxes, num_sorted, iou_thresh, max_keep, keep);
+}
+
+
+/* -------------------------------------------------- *
+ *  Weighted NMS
+ *    mediapipe/calculators/util/non_max_suppression_calculator.cc
+ *      WeightedNonMaxSuppression()
+ *
+ *  candidates with IoU > iou_thresh against the best remaining box are
+ *  merged into it. box coordinates and the optional aux vectors
+ *  (e.g. keypoints, aux_num floats every aux_stride bytes) are blended
+ *  with the scores as weights. the score of the best box is kept.
+ * -------------------------------------------------- */
+int
+nms_weighted (nms_t *nms, const nms_box_t *boxes, int num, float iou_thresh, int max_keep,
+              nms_box_t *out_boxes,
+              const float *aux, int aux_num, int aux_stride, float *out_aux)
+{
+    nms_order_t *order = (nms_order_t *)nms->order;
+    int num_sorted = select_topk (nms, boxes, num, num);
+    int num_out = 0;
+    int i, j, a;
+
+    for (i = 0; i < num_sorted; i ++)
+    {
+        store_box (nms, i, &boxes[order[i].idx]);
+        nms->alive[i] = 1;
+    }
+    /* pad the SoA tail so that the 4-wide test never reads stale boxes. */
+    for (; i & 3; i ++)
+    {
+        nms->area [i] = 0.0f;
+        nms->alive[i] = 0;
+    }
+
+    for (i = 0; i < num_sorted && num_out < max_keep; i ++)
+    {
+        float w_sum = 0.0f;
+        float bx0 = 0.0f, by0 = 0.0f, bx1 = 0.0f, by1 = 0.0f;
+        float *dst_aux = (aux && out_aux) ? &out_aux[num_out * aux_num] : NULL;
+
+        if (!nms->alive[i])
+            continue;
+
+        if (dst_aux)
+            memset (dst_aux, 0, aux_num * sizeof (float));
+
+        for (j = i; j < num_sorted; j += 4)
+        {
+            int base = j & ~3;
+            int bits = overlap_mask4 (nms, i, base, iou_thresh, 1);
+            int b;
+
+            if (j == i)
+                bits |= (1 << (i - base));   /* itself, even if area <= 0 */
+
+            for (b = j - base; b < 4; b ++)
+            {
+                int k = base + b;
+                if (!(bits & (1 << b)) || !nms->alive[k])
+                    continue;
+
+                int   idx = order[k].idx;
+                float w   = boxes[idx].score;
+
+                nms->alive[k] = 0;
+                w_sum += w;
+                bx0 += nms->x0[k] * w;
+                by0 += nms->y0[k] * w;
+                bx1 += nms->x1[k] * w;
+                by1 += nms->y1[k] * w;
+
+                if (dst_aux)
+                {
+                    const float *src = (const float *)((const char *)aux + (size_t)idx * aux_stride);
+                    for (a = 0; a < aux_num; a ++)
+                        dst_aux[a] += src[a] * w;
+                }
+            }
+            j = base;
+        }
+
+        nms_box_t *dst = &out_boxes[num_out];
+        if (w_sum > 0.0f)
+        {
+            float inv = 1.0f / w_sum;
+            dst->x0 = bx0 * inv;
+            dst->y0 = by0 * inv;
+            dst->x1 = bx1 * inv;
+            dst->y1 = by1 * inv;
+            for (a = 0; dst_aux && a < aux_num; a ++)
+                dst_aux[a] *= inv;
+        }
+        else
+        {
+            dst->x0 = nms->x0[i];
+            dst->y0 = nms->y0[i];
+            dst->x1 = nms->x1[i];
+            dst->y1 = nms->y1[i];
+            if (dst_aux)
+            {
+                const float *src = (const float *)((const char *)aux + (size_t)order[i].idx * aux_stride);
+                memcpy (dst_aux, src, aux_num * sizeof (float));
+            }
+        }
+        dst->score = boxes[order[i].idx].score;
+        num_out ++;
+    }
+
+    return num_out;
+}
@@ -0,0 +1,51 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_NMS_H_
+#define _UTIL_NMS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _nms_box_t
+{
+    float   x0, y0;         /* topleft  */
+    float   x1, y1;         /* btmright */
+    float   score;
+} nms_box_t;
+
+/*
+ *  NMS workspace.
+ *  all buffers are allocated once by nms_init(), so that
+ *  nms_hard()/nms_weighted() never touch the heap.
+ */
+typedef struct _nms_t
+{
+    int     capacity;
+    void    *order;         /* (score, index) pairs sorted by score */
+    float   *x0, *y0;       /* SoA copy of the sorted/kept boxes    */
+    float   *x1, *y1;
+    float   *area;
+    int     *alive;
+    void    *buf;
+} nms_t;
+
+int  nms_init    (nms_t *nms, int capacity);
+void nms_destroy (nms_t *nms);
+
+int  nms_hard (nms_t *nms, const nms_box_t *boxes, int num, float iou_thresh,
+               int max_keep, int *keep);
+
+int  nms_weighted (nms_t *nms, const nms_box_t *boxes, int num, float iou_thresh, int max_keep,
+                   nms_box_t *out_boxes,
+                   const float *aux, int aux_num, int aux_stride, float *out_aux);
+
+float nms_calc_iou (const nms_box_t *box0, const nms_box_t *box1);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_NMS_H_ */
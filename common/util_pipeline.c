@@ -0,0 +1,365 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "util_pipeline.h"
+#include "util_debug.h"
+#include "util_telemetry.h"
+
+
+static double
+get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + (double)tv.tv_nsec / 1000000.0);
+}
+
+
+/* -------------------------------------------------- *
+ *  Ring buffer (protected by pipe->mutex)
+ * -------------------------------------------------- */
+static void
+queue_push (pipeline_queue_t *q, void *item)
+{
+    int tail = (q->head + q->count) % PIPELINE_MAX_FRAMES;
+
+    q->items[tail] = item;
+    q->count ++;
+}
+
+static void *
+queue_pop (pipeline_queue_t *q)
+{
+    void *item;
+
+    if (q->count == 0)
+        return NULL;
+
+    item = q->items[q->head];
+    q->head = (q->head + 1) % PIPELINE_MAX_FRAMES;
+    q->count --;
+
+    return item;
+}
+
+
+/* -------------------------------------------------- *
+ *  Worker thread
+ * -------------------------------------------------- */
+static void *
+stage_thread_main (void *arg)
+{
+    pipeline_stage_t *stage = (pipeline_stage_t *)arg;
+    pipeline_t *pipe = stage->pipe;
+    int next = (stage->id + 1) % pipe->num_stages;
+
+    while (1)
+    {
+        void *frame;
+
+        pthread_mutex_lock (&pipe->mutex);
+        while (pipe->running && stage->queue.count == 0)
+            pthread_cond_wait (&pipe->cond, &pipe->mutex);
+
+        if (!pipe->running)
+        {
+            pthread_mutex_unlock (&pipe->mutex);
+            break;
+        }
+        frame = queue_pop (&stage->queue);
+        pthread_mutex_unlock (&pipe->mutex);
+
+        /* the result is carried by the frame itself. forward it anyway. */
+        double t0 = get_time_ms ();
+        stage->func (frame, stage->usr);
+        double t1 = get_time_ms ();
+
+        pthread_mutex_lock (&pipe->mutex);
+        stage->num_done ++;
+        stage->last_ms   = t1 - t0;
+        stage->total_ms += t1 - t0;
+        telem_record (stage->telem_id, t1 - t0);
+        queue_push (&pipe->stages[next].queue, frame);
+        pthread_cond_broadcast (&pipe->cond);
+        pthread_mutex_unlock (&pipe->mutex);
+    }
+
+    return NULL;
+}
+
+
+/* -------------------------------------------------- *
+ *  Setup
+ * -------------------------------------------------- */
+int
+pipeline_init (pipeline_t *pipe, void **frames, int num_frames, int policy)
+{
+    int i;
+
+    if (num_frames <= 0 || num_frames > PIPELINE_MAX_FRAMES)
+    {
+        DBG_LOGE ("ERR: %s(%d): invalid number of frames (%d)\n", __FILE__, __LINE__, num_frames);
+        return -1;
+    }
+
+    memset (pipe, 0, sizeof (*pipe));
+    pthread_mutex_init (&pipe->mutex, NULL);
+    pthread_cond_init  (&pipe->cond,  NULL);
+    pipe->policy     = policy;
+    pipe->num_frames = num_frames;
+
+    /* stage[0] is the source stage, which owns the free frames. */
+    pipeline_add_stage (pipe, "source", NULL, NULL);
+    for (i = 0; i < num_frames; i ++)
+        queue_push (&pipe->stages[0].queue, frames[i]);
+
+    return 0;
+}
+
+int
+pipeline_add_stage (pipeline_t *pipe, const char *name, pipeline_func_t func, void *usr)
+{
+    int id = pipe->num_stages;
+
+    if (pipe->running || id >= PIPELINE_MAX_STAGES)
+    {
+        DBG_LOGE ("ERR: %s(%d): can't add stage \"%s\"\n", __FILE__, __LINE__, name);
+        return -1;
+    }
+
+    pipeline_stage_t *stage = &pipe->stages[id];
+    stage->pipe = pipe;
+    stage->id   = id;
+    stage->func = func;
+    stage->usr  = usr;
+    snprintf (stage->name, sizeof (stage->name), "%s", name);
+
+    /* the worker stages are timed as "stage.<name>" */
+    if (func)
+    {
+        char telem_name[TELEM_NAME_LEN];
+        snprintf (telem_name, sizeof (telem_name), "stage.%s", name);
+        stage->telem_id = telem_register (telem_name, TELEM_TIMER);
+    }
+    else
+        stage->telem_id = -1;
+
+    pipe->num_stages ++;
+    return id;
+}
+
+int
+pipeline_start (pipeline_t *pipe)
+{
+    int i;
+
+    pipe->running = 1;
+
+    for (i = 0; i < pipe->num_stages; i ++)
+    {
+        pipeline_stage_t *stage = &pipe->stages[i];
+
+        if (stage->func == NULL)
+            continue;
+
+        if (pthread_create (&stage->thread, NULL, stage_thread_main, stage) != 0)
+        {
+            DBG_LOGE ("ERR: %s(%d): can't create thread \"%s\"\n", __FILE__, __LINE__, stage->name);
+            pipeline_stop (pipe);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+pipeline_stop (pipeline_t *pipe)
+{
+    int i;
+
+    pthread_mutex_lock (&pipe->mutex);
+    pipe->running = 0;
+    pthread_cond_broadcast (&pipe->cond);
+    pthread_mutex_unlock (&pipe->mutex);
+
+    for (i = 0; i < pipe->num_stages; i ++)
+    {
+        pipeline_stage_t *stage = &pipe->stages[i];
+
+        if (stage->func && stage->thread)
+        {
+            pthread_join (stage->thread, NULL);
+            stage->thread = 0;
+        }
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  Frame exchange (for inline stages)
+ * -------------------------------------------------- */
+
+/*
+ *  take back the oldest frame waiting in the most upstream queue.
+ *  frames closer to the display carry more finished work, so they are
+ *  recycled last.
+ */
+static void *
+reclaim_oldest_frame (pipeline_t *pipe)
+{
+    int i;
+
+    for (i = 1; i < pipe->num_stages; i ++)
+    {
+        void *frame = queue_pop (&pipe->stages[i].queue);
+        if (frame)
+        {
+            pipe->num_dropped ++;
+            TELEM_COUNT ("pipeline.dropped", 1);
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+/*
+ *  take the oldest frame waiting for the (inline) stage.
+ *  for stage[0] this acquires a free frame. when no frame is free and the
+ *  policy is PIPELINE_POLICY_DROP_OLDEST, the oldest frame that is not in
+ *  process is recycled instead of waiting.
+ */
+void *
+pipeline_get_frame (pipeline_t *pipe, int stage, int wait)
+{
+    pipeline_queue_t *q = &pipe->stages[stage].queue;
+    void *frame = NULL;
+
+    pthread_mutex_lock (&pipe->mutex);
+    while (1)
+    {
+        frame = queue_pop (q);
+        if (frame)
+            break;
+
+        if (stage == 0 && pipe->policy == PIPELINE_POLICY_DROP_OLDEST)
+        {
+            frame = reclaim_oldest_frame (pipe);
+            if (frame)
+                break;
+        }
+
+        if (!wait || !pipe->running)
+            break;
+
+        pthread_cond_wait (&pipe->cond, &pipe->mutex);
+    }
+    pthread_mutex_unlock (&pipe->mutex);
+
+    return frame;
+}
+
+/*
+ *  take the newest frame waiting for the (inline) stage.
+ *  older ones are skipped and returned to the source stage.
+ *  useful for the display stage to keep latency at minimum.
+ */
+void *
+pipeline_get_latest_frame (pipeline_t *pipe, int stage)
+{
+    pipeline_queue_t *q = &pipe->stages[stage].queue;
+    void *frame;
+
+    pthread_mutex_lock (&pipe->mutex);
+    if (q->count > 1)
+    {
+        while (q->count > 1)
+        {
+            queue_push (&pipe->stages[0].queue, queue_pop (q));
+            pipe->num_dropped ++;
+            TELEM_COUNT ("pipeline.dropped", 1);
+        }
+        pthread_cond_broadcast (&pipe->cond);
+    }
+    frame = queue_pop (q);
+    pthread_mutex_unlock (&pipe->mutex);
+
+    return frame;
+}
+
+/* hand the frame processed by the (inline) stage to the next stage. */
+void
+pipeline_put_frame (pipeline_t *pipe, int stage, void *frame)
+{
+    int next = (stage + 1) % pipe->num_stages;
+
+    pthread_mutex_lock (&pipe->mutex);
+    queue_push (&pipe->stages[next].queue, frame);
+    pipe->stages[stage].num_done ++;
+    pthread_cond_broadcast (&pipe->cond);
+    pthread_mutex_unlock (&pipe->mutex);
+}
+
+/* block until a frame is waiting for one of the inline stages. */
+int
+pipeline_wait_inline (pipeline_t *pipe)
+{
+    int i;
+
+    pthread_mutex_lock (&pipe->mutex);
+    while (pipe->running)
+    {
+        for (i = 0; i < pipe->num_stages; i ++)
+        {
+            if (pipe->stages[i].func == NULL && pipe->stages[i].queue.count > 0)
+                goto exit;
+        }
+        pthread_cond_wait (&pipe->cond, &pipe->mutex);
+    }
+exit:
+    pthread_mutex_unlock (&pipe->mutex);
+
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  Statistics
+ * -------------------------------------------------- */
+int
+pipeline_get_stage_stat (pipeline_t *pipe, int stage, unsigned int *num_done,
+                         double *last_ms, double *avg_ms)
+{
+    pipeline_stage_t *s;
+
+    if (stage < 0 || stage >= pipe->num_stages)
+        return -1;
+
+    s = &pipe->stages[stage];
+
+    pthread_mutex_lock (&pipe->mutex);
+    if (num_done) *num_done = s->num_done;
+    if (last_ms)  *last_ms  = s->last_ms;
+    if (avg_ms)   *avg_ms   = s->num_done ? s->total_ms / s->num_done : 0.0;
+    pthread_mutex_unlock (&pipe->mutex);
+
+    return 0;
+}
+
+unsigned int
+pipeline_get_dropped (pipeline_t *pipe)
+{
+    unsigned int num;
+
+    pthread_mutex_lock (&pipe->mutex);
+    num = pipe->num_dropped;
+    pthread_mutex_unlock (&pipe->mutex);
+
+    return num;
+}
@@ -0,0 +1,92 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_PIPELINE_H_
+#define _UTIL_PIPELINE_H_
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  Frame pipeline.
+ *
+ *  a fixed set of user allocated frames circulates through the stages:
+ *
+ *    stage[0] -> stage[1] -> ... -> stage[N-1] -> stage[0] -> ...
+ *
+ *  stage[0] is the source: its queue holds the free frames.
+ *  a stage with func != NULL runs on its own worker thread.
+ *  a stage with func == NULL is "inline": the caller thread (typically
+ *  the GL thread, which owns the EGL context) serves it with
+ *  pipeline_get_frame() / pipeline_put_frame().
+ */
+#define PIPELINE_MAX_STAGES     8
+#define PIPELINE_MAX_FRAMES     16
+
+enum pipeline_policy_id {
+    PIPELINE_POLICY_BLOCK = 0,      /* process every frame. source waits for a free frame.  */
+    PIPELINE_POLICY_DROP_OLDEST,    /* recycle the oldest waiting frame when the pipeline is full. */
+};
+
+typedef int (*pipeline_func_t) (void *frame, void *usr);
+
+typedef struct _pipeline_queue_t
+{
+    void    *items[PIPELINE_MAX_FRAMES];
+    int     head;
+    int     count;
+} pipeline_queue_t;
+
+typedef struct _pipeline_stage_t
+{
+    struct _pipeline_t  *pipe;
+    int                 id;
+    char                name[32];
+    pipeline_func_t     func;
+    void                *usr;
+    pthread_t           thread;
+    pipeline_queue_t    queue;      /* frames waiting for this stage */
+
+    /* statistics */
+    unsigned int        num_done;
+    double              last_ms;
+    double              total_ms;
+    int                 telem_id;   /* see util_telemetry.h */
+} pipeline_stage_t;
+
+typedef struct _pipeline_t
+{
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    int                 policy;
+    int                 num_frames;
+    int                 num_stages;
+    int                 running;
+    unsigned int        num_dropped;
+    pipeline_stage_t    stages[PIPELINE_MAX_STAGES];
+} pipeline_t;
+
+
+int   pipeline_init      (pipeline_t *pipe, void **frames, int num_frames, int policy);
+int   pipeline_add_stage (pipeline_t *pipe, const char *name, pipeline_func_t func, void *usr);
+int   pipeline_start     (pipeline_t *pipe);
+void  pipeline_stop      (pipeline_t *pipe);
+
+void *pipeline_get_frame (pipeline_t *pipe, int stage, int wait);
+void *pipeline_get_latest_frame (pipeline_t *pipe, int stage);
+void  pipeline_put_frame (pipeline_t *pipe, int stage, void *frame);
+int   pipeline_wait_inline (pipeline_t *pipe);
+
+int   pipeline_get_stage_stat (pipeline_t *pipe, int stage, unsigned int *num_done,
+                               double *last_ms, double *avg_ms);
+unsigned int pipeline_get_dropped (pipeline_t *pipe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_PIPELINE_H_ */
@@ -9,11 +9,41 @@
 #include <GLES2/gl2.h>
 #include "util_pmeter.h"
 #include "util_shader.h"
+#include "util_telemetry.h"
 
-static int    s_laptime_idx[10] = {0};
-static int    s_laptime_num[10] = {0};
-static float  s_laptime_stack[10][PMETER_MAX_LAP_NUM];
-static double s_last_laptime[10] = {0};
+#define PMETER_DPY_NUM  10
+#define PMETER_NUM      8       /* laps + total */
+#define PMETER_DATA_NUM 1000
+
+static int    s_laptime_idx[PMETER_DPY_NUM] = {0};
+static int    s_laptime_num[PMETER_DPY_NUM] = {0};
+static float  s_laptime_stack[PMETER_DPY_NUM][PMETER_MAX_LAP_NUM];
+static double s_last_laptime[PMETER_DPY_NUM] = {0};
+
+/* the laps are also recorded as telemetry timers: "pmeter<id>.lap<n>" */
+static int    s_telem_lap[PMETER_DPY_NUM][PMETER_NUM];
+static int    s_telem_initialized;
+
+static int
+get_telem_id (int id, int lap)
+{
+    char name[TELEM_NAME_LEN];
+
+    if (!s_telem_initialized)
+    {
+        memset (s_telem_lap, 0xff, sizeof (s_telem_lap));   /* -1: TELEM_ID_UNREGISTERED */
+        s_telem_initialized = 1;
+    }
+
+    /* the name is needed only for the registration. */
+    if (s_telem_lap[id][lap] >= 0)
+        return s_telem_lap[id][lap];
+    if (s_telem_lap[id][lap] == TELEM_ID_FAILED)
+        return -1;
+
+    snprintf (name, sizeof (name), "pmeter%d.lap%d", id, lap);
+    return telem_get_id (&s_telem_lap[id][lap], name, TELEM_TIMER);
+}
 
 double
 pmeter_get_time_ms ()
@@ -37,10 +67,15 @@ pmeter_set_lap (int id)
         return;
 
     double laptime = pmeter_get_time_ms ();
-    s_laptime_stack[id][s_laptime_idx[id]] = laptime - s_last_laptime[id];
+    int    lap     = s_laptime_idx[id];
+    s_laptime_stack[id][lap] = laptime - s_last_laptime[id];
     s_laptime_idx[id] ++;
     s_laptime_num[id] ++;
 
+    /* the very first lap has no start point. */
+    if (s_last_laptime[id] > 0 && lap < PMETER_NUM - 1)
+        telem_record (get_telem_id (id, lap), s_laptime_stack[id][lap]);
+
     s_last_laptime[id] = laptime;
 }
 
@@ -75,10 +110,6 @@ void main()                                  \n\
    gl_FragColor = u_Color;                   \n\
 }                                            \n";
 
-#define PMETER_DPY_NUM  10
-#define PMETER_NUM      4
-#define PMETER_DATA_NUM 1000
-
 static int      s_wndW, s_wndH;
 static int      s_data_num;
 static int      s_pm_idx[PMETER_DPY_NUM];
@@ -132,34 +163,35 @@ static int set_pmeter_val (int dpy_id, int id, float val)
     return 0;
 }
 
+/* BLUE, SKYBLUE, ORANGE, GREEN, MAGENTA, YELLOW, WHITE: laps,  RED: total */
+static const float s_pmeter_col[PMETER_NUM][3] = {
+    {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 1.0f}, {1.0f, 0.5f, 0.2f}, {0.0f, 1.0f, 0.0f},
+    {1.0f, 0.0f, 1.0f}, {1.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.0f, 0.0f},
+};
+
 int draw_pmeter_ex (int dpy_id, int x, int y, float scale)
 {
-    int i, num_time;
+    int i, num_time, num_graph;
     float vert1[] = { 0.0f, 0.0f, 0.0f, (float)PMETER_DATA_NUM };
     float vert2[] = { 0.0f, 0.0f, 100.0f, 0.0f  };
     float *laptime,sumval;
-    static int   s_ncnt[PMETER_DPY_NUM] = {0};
-    static float s_lap[PMETER_DPY_NUM][10] = {{0}};
+
+    if ( dpy_id >= PMETER_DPY_NUM )
+        return -1;
 
     pmeter_get_laptime (dpy_id, &num_time, &laptime);
 
     sumval = 0;
     for (i = 0; i < num_time; i ++)
-    {
-        s_lap[dpy_id][i] += laptime[i];
         sumval += laptime[i];
+
+    num_graph = (num_time < PMETER_NUM - 1) ? num_time : PMETER_NUM - 1;
+    for (i = 0; i < PMETER_NUM - 1; i ++)
+    {
+        float val = (i < num_graph) ? laptime[i] : 0.0f;
+        set_pmeter_val (dpy_id, i, (val > 100.0f) ? 100.0f : val);
     }
-    s_lap[dpy_id][i] += sumval;
-    s_ncnt[dpy_id] ++;
-
-    if (laptime[0] > 100.0f) laptime[0] = 100.0f;
-    if (laptime[1] > 100.0f) laptime[1] = 100.0f;
-    if (laptime[2] > 100.0f) laptime[2] = 100.0f;
-    if (sumval     > 100.0f) sumval     = 100.0f;
-    set_pmeter_val (dpy_id, 0, laptime[0]); /* BLUE:    render */
-    set_pmeter_val (dpy_id, 1, laptime[1]); /* SKYBLUE: render */
-    set_pmeter_val (dpy_id, 2, laptime[2]); /* SKYBLUE: render */
-    set_pmeter_val (dpy_id, 3, sumval);     /* RED:     total  */
+    set_pmeter_val (dpy_id, PMETER_NUM - 1, (sumval > 100.0f) ? 100.0f : sumval);
 
     s_pm_idx[dpy_id] ++;
     if (s_pm_idx[dpy_id] >= s_data_num)
@@ -190,21 +222,15 @@ int draw_pmeter_ex (int dpy_id, int x, int y, float scale)
 
     /* GRAPH */
     glUniform4f (s_locTransPM, x, y, 0.0f, 0.0f );
-    glVertexAttribPointer (s_locVtxPM, 2, GL_FLOAT, GL_FALSE, 0, s_vertPM[dpy_id][0]);
-    glUniform4f (s_locColPM,   0.0f, 0.0f, 1.0f, 1.0f);
-    glDrawArrays (GL_LINE_STRIP, 0, s_data_num);
-
-    glVertexAttribPointer (s_locVtxPM, 2, GL_FLOAT, GL_FALSE, 0, s_vertPM[dpy_id][1]);
-    glUniform4f (s_locColPM,   0.0f, 1.0f, 1.0f, 1.0f);
-    glDrawArrays (GL_LINE_STRIP, 0, s_data_num);
-
-    glVertexAttribPointer (s_locVtxPM, 2, GL_FLOAT, GL_FALSE, 0, s_vertPM[dpy_id][2]);
-    glUniform4f (s_locColPM, 1.0f, 0.5f, 0.2f, 1.0f);
-    glDrawArrays (GL_LINE_STRIP, 0, s_data_num);
+    for ( i = 0; i < PMETER_NUM; i ++ )
+    {
+        if (i >= num_graph && i < PMETER_NUM - 1)
+            continue;
 
-    glVertexAttribPointer (s_locVtxPM, 2, GL_FLOAT, GL_FALSE, 0, s_vertPM[dpy_id][3]);
-    glUniform4f (s_locColPM, 1.0f, 0.0f, 0.0f, 1.0f);
-    glDrawArrays (GL_LINE_STRIP, 0, s_data_num);
+        glVertexAttribPointer (s_locVtxPM, 2, GL_FLOAT, GL_FALSE, 0, s_vertPM[dpy_id][i]);
+        glUniform4f (s_locColPM, s_pmeter_col[i][0], s_pmeter_col[i][1], s_pmeter_col[i][2], 1.0f);
+        glDrawArrays (GL_LINE_STRIP, 0, s_data_num);
+    }
 
     /* CURSOR */
     glLineWidth (3.0f);
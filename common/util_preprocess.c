@@ -0,0 +1,731 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "util_preprocess.h"
+#include "util_debug.h"
+
+#if defined (__ARM_NEON__) || defined (__aarch64__)
+#include <arm_neon.h>
+#define PREPROC_USE_NEON
+#elif defined (__AVX2__)
+#include <immintrin.h>
+#define PREPROC_USE_AVX2
+#define PREPROC_USE_SSE2
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define PREPROC_USE_SSE2
+#endif
+
+#if defined (__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define PREPROC_ALIGN       32
+#define PREPROC_CHUNK       64          /* pixels per chunk of the quantized path */
+
+
+const preproc_norm_t preproc_norm_unit        = {{  0.0f,    0.0f,    0.0f  }, {255.0f,  255.0f,  255.0f  }};
+const preproc_norm_t preproc_norm_signed_unit = {{127.5f,  127.5f,  127.5f  }, {127.5f,  127.5f,  127.5f  }};
+const preproc_norm_t preproc_norm_imagenet    = {{123.675f, 116.28f, 103.53f}, { 58.395f, 57.12f,  57.375f}};
+const preproc_norm_t preproc_norm_none        = {{  0.0f,    0.0f,    0.0f  }, {  1.0f,    1.0f,    1.0f  }};
+
+void
+preproc_norm_set (preproc_norm_t *norm, float mean, float std)
+{
+    int i;
+
+    for (i = 0; i < 3; i ++)
+    {
+        norm->mean[i] = mean;
+        norm->std[i]  = std;
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  Row kernels: RGBA8 --> (src * scale + bias) in fp32
+ * -------------------------------------------------- */
+#if defined (PREPROC_USE_SSE2)
+/* interleave 4 pixels of planar R, G, B into [r0 g0 b0 r1] [g1 b1 r2 g2] [b2 r3 g3 b3] */
+#define SSE_INTERLEAVE_RGB(r, g, b, o0, o1, o2)                                             \
+    do {                                                                                    \
+        __m128 rg_lo = _mm_unpacklo_ps (r, g);                                              \
+        __m128 rg_hi = _mm_unpackhi_ps (r, g);                                              \
+        __m128 t0 = _mm_shuffle_ps (b, r, _MM_SHUFFLE (1, 1, 0, 0));                        \
+        __m128 t1 = _mm_shuffle_ps (g, b, _MM_SHUFFLE (1, 1, 1, 1));                        \
+        __m128 t2 = _mm_shuffle_ps (r, g, _MM_SHUFFLE (2, 2, 2, 2));                        \
+        __m128 t3 = _mm_shuffle_ps (b, rg_hi, _MM_SHUFFLE (2, 2, 2, 2));                    \
+        __m128 t4 = _mm_shuffle_ps (g, b, _MM_SHUFFLE (3, 3, 3, 3));                        \
+        o0 = _mm_shuffle_ps (rg_lo, t0, _MM_SHUFFLE (2, 0, 1, 0));                          \
+        o1 = _mm_shuffle_ps (t1, t2, _MM_SHUFFLE (2, 0, 2, 0));                             \
+        o2 = _mm_shuffle_ps (t3, t4, _MM_SHUFFLE (2, 0, 2, 0));                             \
+    } while (0)
+
+/* load 4 pixels and split them into planar R, G, B in fp32 */
+static inline void
+sse_load_rgb (const unsigned char *src, __m128 *r, __m128 *g, __m128 *b)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i v    = _mm_loadu_si128 ((const __m128i *)src);
+    __m128i lo   = _mm_unpacklo_epi8 (v, zero);
+    __m128i hi   = _mm_unpackhi_epi8 (v, zero);
+    __m128  p0   = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (lo, zero));
+    __m128  p1   = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (lo, zero));
+    __m128  p2   = _mm_cvtepi32_ps (_mm_unpacklo_epi16 (hi, zero));
+    __m128  p3   = _mm_cvtepi32_ps (_mm_unpackhi_epi16 (hi, zero));
+
+    _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+    *r = p0;
+    *g = p1;
+    *b = p2;
+}
+#endif
+
+#if defined (PREPROC_USE_AVX2)
+/* load 8 pixels and split them into planar R, G, B in fp32 */
+static inline void
+avx2_load_rgb (const unsigned char *src, __m256 *r, __m256 *g, __m256 *b)
+{
+    const __m256i shuf = _mm256_setr_epi8 (0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                           0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i perm = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7);
+
+    __m256i v  = _mm256_loadu_si256 ((const __m256i *)src);
+    v = _mm256_shuffle_epi8 (v, shuf);          /* RRRR GGGG BBBB AAAA in each lane */
+    v = _mm256_permutevar8x32_epi32 (v, perm);  /* RRRRRRRR GGGGGGGG BBBBBBBB AAAAAAAA */
+
+    __m128i rg = _mm256_castsi256_si128 (v);
+    __m128i ba = _mm256_extracti128_si256 (v, 1);
+
+    *r = _mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (rg));
+    *g = _mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (_mm_srli_si128 (rg, 8)));
+    *b = _mm256_cvtepi32_ps (_mm256_cvtepu8_epi32 (ba));
+}
+#endif
+
+/* RGBA --> RGB (or BGR) interleaved */
+static void
+row_to_hwc (const unsigned char *src, int n, float *dst,
+            const float *scale, const float *bias, int bgr)
+{
+    int x = 0;
+    int ir = bgr ? 2 : 0;
+    int ib = bgr ? 0 : 2;
+
+#if defined (PREPROC_USE_NEON)
+    float32x4_t vs0 = vdupq_n_f32 (scale[0]), vb0 = vdupq_n_f32 (bias[0]);
+    float32x4_t vs1 = vdupq_n_f32 (scale[1]), vb1 = vdupq_n_f32 (bias[1]);
+    float32x4_t vs2 = vdupq_n_f32 (scale[2]), vb2 = vdupq_n_f32 (bias[2]);
+
+    for (; x + 16 <= n; x += 16)
+    {
+        uint8x16x4_t px = vld4q_u8 (src + x * 4);
+        uint16x8_t r16[2] = {vmovl_u8 (vget_low_u8 (px.val[0])), vmovl_u8 (vget_high_u8 (px.val[0]))};
+        uint16x8_t g16[2] = {vmovl_u8 (vget_low_u8 (px.val[1])), vmovl_u8 (vget_high_u8 (px.val[1]))};
+        uint16x8_t b16[2] = {vmovl_u8 (vget_low_u8 (px.val[2])), vmovl_u8 (vget_high_u8 (px.val[2]))};
+        int i;
+
+        for (i = 0; i < 4; i ++)
+        {
+            uint16x4_t r = (i & 1) ? vget_high_u16 (r16[i >> 1]) : vget_low_u16 (r16[i >> 1]);
+            uint16x4_t g = (i & 1) ? vget_high_u16 (g16[i >> 1]) : vget_low_u16 (g16[i >> 1]);
+            uint16x4_t b = (i & 1) ? vget_high_u16 (b16[i >> 1]) : vget_low_u16 (b16[i >> 1]);
+            float32x4x3_t o;
+
+            o.val[ir] = vmlaq_f32 (vb0, vcvtq_f32_u32 (vmovl_u16 (r)), vs0);
+            o.val[1]  = vmlaq_f32 (vb1, vcvtq_f32_u32 (vmovl_u16 (g)), vs1);
+            o.val[ib] = vmlaq_f32 (vb2, vcvtq_f32_u32 (vmovl_u16 (b)), vs2);
+            vst3q_f32 (dst + (x + i * 4) * 3, o);
+        }
+    }
+#elif defined (PREPROC_USE_AVX2)
+    __m256 vs0 = _mm256_set1_ps (scale[0]), vb0 = _mm256_set1_ps (bias[0]);
+    __m256 vs1 = _mm256_set1_ps (scale[1]), vb1 = _mm256_set1_ps (bias[1]);
+    __m256 vs2 = _mm256_set1_ps (scale[2]), vb2 = _mm256_set1_ps (bias[2]);
+
+    for (; x + 8 <= n; x += 8)
+    {
+        __m256 c[3], o0, o1, o2;
+
+        avx2_load_rgb (src + x * 4, &c[0], &c[1], &c[2]);
+        c[0] = _mm256_add_ps (_mm256_mul_ps (c[0], vs0), vb0);
+        c[1] = _mm256_add_ps (_mm256_mul_ps (c[1], vs1), vb1);
+        c[2] = _mm256_add_ps (_mm256_mul_ps (c[2], vs2), vb2);
+
+        /* the SSE interleave works on each 128bit lane. (pixel 0-3 | pixel 4-7) */
+        {
+            __m256 r = c[ir], g = c[1], b = c[ib];
+            __m256 rg_lo = _mm256_unpacklo_ps (r, g);
+            __m256 rg_hi = _mm256_unpackhi_ps (r, g);
+            __m256 t0 = _mm256_shuffle_ps (b, r, _MM_SHUFFLE (1, 1, 0, 0));
+            __m256 t1 = _mm256_shuffle_ps (g, b, _MM_SHUFFLE (1, 1, 1, 1));
+            __m256 t2 = _mm256_shuffle_ps (r, g, _MM_SHUFFLE (2, 2, 2, 2));
+            __m256 t3 = _mm256_shuffle_ps (b, rg_hi, _MM_SHUFFLE (2, 2, 2, 2));
+            __m256 t4 = _mm256_shuffle_ps (g, b, _MM_SHUFFLE (3, 3, 3, 3));
+            o0 = _mm256_shuffle_ps (rg_lo, t0, _MM_SHUFFLE (2, 0, 1, 0));
+            o1 = _mm256_shuffle_ps (t1, t2, _MM_SHUFFLE (2, 0, 2, 0));
+            o2 = _mm256_shuffle_ps (t3, t4, _MM_SHUFFLE (2, 0, 2, 0));
+        }
+
+        float *d = dst + x * 3;
+        _mm256_storeu_ps (d +  0, _mm256_permute2f128_ps (o0, o1, 0x20));
+        _mm256_storeu_ps (d +  8, _mm256_permute2f128_ps (o2, o0, 0x30));
+        _mm256_storeu_ps (d + 16, _mm256_permute2f128_ps (o1, o2, 0x31));
+    }
+#elif defined (PREPROC_USE_SSE2)
+    __m128 vs0 = _mm_set1_ps (scale[0]), vb0 = _mm_set1_ps (bias[0]);
+    __m128 vs1 = _mm_set1_ps (scale[1]), vb1 = _mm_set1_ps (bias[1]);
+    __m128 vs2 = _mm_set1_ps (scale[2]), vb2 = _mm_set1_ps (bias[2]);
+
+    for (; x + 4 <= n; x += 4)
+    {
+        __m128 c[3], o0, o1, o2;
+
+        sse_load_rgb (src + x * 4, &c[0], &c[1], &c[2]);
+        c[0] = _mm_add_ps (_mm_mul_ps (c[0], vs0), vb0);
+        c[1] = _mm_add_ps (_mm_mul_ps (c[1], vs1), vb1);
+        c[2] = _mm_add_ps (_mm_mul_ps (c[2], vs2), vb2);
+
+        SSE_INTERLEAVE_RGB (c[ir], c[1], c[ib], o0, o1, o2);
+        _mm_storeu_ps (dst + x * 3 + 0, o0);
+        _mm_storeu_ps (dst + x * 3 + 4, o1);
+        _mm_storeu_ps (dst + x * 3 + 8, o2);
+    }
+#endif
+
+    for (; x < n; x ++)
+    {
+        const unsigned char *s = src + x * 4;
+        float *d = dst + x * 3;
+
+        d[ir] = s[0] * scale[0] + bias[0];
+        d[1]  = s[1] * scale[1] + bias[1];
+        d[ib] = s[2] * scale[2] + bias[2];
+    }
+}
+
+/* RGBA --> planar R, G, B */
+static void
+row_to_chw (const unsigned char *src, int n, float *dr, float *dg, float *db,
+            const float *scale, const float *bias)
+{
+    int x = 0;
+
+#if defined (PREPROC_USE_NEON)
+    float32x4_t vs0 = vdupq_n_f32 (scale[0]), vb0 = vdupq_n_f32 (bias[0]);
+    float32x4_t vs1 = vdupq_n_f32 (scale[1]), vb1 = vdupq_n_f32 (bias[1]);
+    float32x4_t vs2 = vdupq_n_f32 (scale[2]), vb2 = vdupq_n_f32 (bias[2]);
+
+    for (; x + 8 <= n; x += 8)
+    {
+        uint8x8x4_t px = vld4_u8 (src + x * 4);
+        uint16x8_t r = vmovl_u8 (px.val[0]);
+        uint16x8_t g = vmovl_u8 (px.val[1]);
+        uint16x8_t b = vmovl_u8 (px.val[2]);
+
+        vst1q_f32 (dr + x + 0, vmlaq_f32 (vb0, vcvtq_f32_u32 (vmovl_u16 (vget_low_u16  (r))), vs0));
+        vst1q_f32 (dr + x + 4, vmlaq_f32 (vb0, vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (r))), vs0));
+        vst1q_f32 (dg + x + 0, vmlaq_f32 (vb1, vcvtq_f32_u32 (vmovl_u16 (vget_low_u16  (g))), vs1));
+        vst1q_f32 (dg + x + 4, vmlaq_f32 (vb1, vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (g))), vs1));
+        vst1q_f32 (db + x + 0, vmlaq_f32 (vb2, vcvtq_f32_u32 (vmovl_u16 (vget_low_u16  (b))), vs2));
+        vst1q_f32 (db + x + 4, vmlaq_f32 (vb2, vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (b))), vs2));
+    }
+#elif defined (PREPROC_USE_AVX2)
+    __m256 vs0 = _mm256_set1_ps (scale[0]), vb0 = _mm256_set1_ps (bias[0]);
+    __m256 vs1 = _mm256_set1_ps (scale[1]), vb1 = _mm256_set1_ps (bias[1]);
+    __m256 vs2 = _mm256_set1_ps (scale[2]), vb2 = _mm256_set1_ps (bias[2]);
+
+    for (; x + 8 <= n; x += 8)
+    {
+        __m256 r, g, b;
+
+        avx2_load_rgb (src + x * 4, &r, &g, &b);
+        _mm256_storeu_ps (dr + x, _mm256_add_ps (_mm256_mul_ps (r, vs0), vb0));
+        _mm256_storeu_ps (dg + x, _mm256_add_ps (_mm256_mul_ps (g, vs1), vb1));
+        _mm256_storeu_ps (db + x, _mm256_add_ps (_mm256_mul_ps (b, vs2), vb2));
+    }
+#elif defined (PREPROC_USE_SSE2)
+    __m128 vs0 = _mm_set1_ps (scale[0]), vb0 = _mm_set1_ps (bias[0]);
+    __m128 vs1 = _mm_set1_ps (scale[1]), vb1 = _mm_set1_ps (bias[1]);
+    __m128 vs2 = _mm_set1_ps (scale[2]), vb2 = _mm_set1_ps (bias[2]);
+
+    for (; x + 4 <= n; x += 4)
+    {
+        __m128 r, g, b;
+
+        sse_load_rgb (src + x * 4, &r, &g, &b);
+        _mm_storeu_ps (dr + x, _mm_add_ps (_mm_mul_ps (r, vs0), vb0));
+        _mm_storeu_ps (dg + x, _mm_add_ps (_mm_mul_ps (g, vs1), vb1));
+        _mm_storeu_ps (db + x, _mm_add_ps (_mm_mul_ps (b, vs2), vb2));
+    }
+#endif
+
+    for (; x < n; x ++)
+    {
+        const unsigned char *s = src + x * 4;
+
+        dr[x] = s[0] * scale[0] + bias[0];
+        dg[x] = s[1] * scale[1] + bias[1];
+        db[x] = s[2] * scale[2] + bias[2];
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  fp32 --> uint8/int8 (round to nearest, saturate)
+ * -------------------------------------------------- */
+static void
+quantize_row (const float *src, int n, void *dst, int is_signed)
+{
+    int qmin = is_signed ? -128 : 0;
+    int qmax = is_signed ?  127 : 255;
+    int x = 0;
+
+#if defined (PREPROC_USE_SSE2)
+    for (; x + 16 <= n; x += 16)
+    {
+        __m128i i0 = _mm_cvtps_epi32 (_mm_loadu_ps (src + x +  0));
+        __m128i i1 = _mm_cvtps_epi32 (_mm_loadu_ps (src + x +  4));
+        __m128i i2 = _mm_cvtps_epi32 (_mm_loadu_ps (src + x +  8));
+        __m128i i3 = _mm_cvtps_epi32 (_mm_loadu_ps (src + x + 12));
+        __m128i lo = _mm_packs_epi32 (i0, i1);
+        __m128i hi = _mm_packs_epi32 (i2, i3);
+        __m128i v  = is_signed ? _mm_packs_epi16 (lo, hi) : _mm_packus_epi16 (lo, hi);
+
+        _mm_storeu_si128 ((__m128i *)((unsigned char *)dst + x), v);
+    }
+#elif defined (__aarch64__)
+    for (; x + 8 <= n; x += 8)
+    {
+        int16x4_t  lo = vqmovn_s32 (vcvtnq_s32_f32 (vld1q_f32 (src + x + 0)));
+        int16x4_t  hi = vqmovn_s32 (vcvtnq_s32_f32 (vld1q_f32 (src + x + 4)));
+        int16x8_t  v  = vcombine_s16 (lo, hi);
+
+        if (is_signed)
+            vst1_s8 ((int8_t *)dst + x, vqmovn_s16 (v));
+        else
+            vst1_u8 ((uint8_t *)dst + x, vqmovun_s16 (v));
+    }
+#endif
+
+    for (; x < n; x ++)
+    {
+        long q = lrintf (src[x]);
+
+        if (q < qmin) q = qmin;
+        if (q > qmax) q = qmax;
+
+        if (is_signed)
+            ((signed char *)dst)[x]   = (signed char)q;
+        else
+            ((unsigned char *)dst)[x] = (unsigned char)q;
+    }
+}
+
+
+/* RGBA --> RGB (or BGR) bytes as they are. for uint8 models taking raw pixels. */
+static void
+copy_row_to_rgb (const unsigned char *src, int n, unsigned char *dst, int bgr)
+{
+    int ir = bgr ? 2 : 0;
+    int ib = bgr ? 0 : 2;
+    int x = 0;
+
+#if defined (PREPROC_USE_NEON)
+    for (; x + 16 <= n; x += 16)
+    {
+        uint8x16x4_t px = vld4q_u8 (src + x * 4);
+        uint8x16x3_t o;
+
+        o.val[ir] = px.val[0];
+        o.val[1]  = px.val[1];
+        o.val[ib] = px.val[2];
+        vst3q_u8 (dst + x * 3, o);
+    }
+#elif defined (__SSSE3__)
+    __m128i shuf = bgr ? _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                       : _mm_setr_epi8 (0, 1, 2, 4, 5, 6,  8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    /* each store writes 16 bytes, of which 12 are valid. keep 4 bytes of margin. */
+    for (; x + 4 <= n - 2; x += 4)
+    {
+        __m128i v = _mm_loadu_si128 ((const __m128i *)(src + x * 4));
+        _mm_storeu_si128 ((__m128i *)(dst + x * 3), _mm_shuffle_epi8 (v, shuf));
+    }
+#endif
+
+    for (; x < n; x ++)
+    {
+        dst[x * 3 + ir] = src[x * 4 + 0];
+        dst[x * 3 + 1]  = src[x * 4 + 1];
+        dst[x * 3 + ib] = src[x * 4 + 2];
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  API
+ * -------------------------------------------------- */
+static void
+get_scale_bias (const preproc_norm_t *norm, float quant_scale, float quant_zerop,
+                float *scale, float *bias)
+{
+    int i;
+
+    /* ((src - mean) / std) / qscale + zerop  =  src * scale + bias */
+    for (i = 0; i < 3; i ++)
+    {
+        scale[i] = 1.0f / (norm->std[i] * quant_scale);
+        bias[i]  = -norm->mean[i] * scale[i] + quant_zerop;
+    }
+}
+
+void
+preproc_rgba_to_fp32_ex (const unsigned char *src, int w, int h, int src_stride,
+                         float *dst, const preproc_norm_t *norm, int flags)
+{
+    float scale[3], bias[3];
+    int y;
+
+    if (src_stride == 0)
+        src_stride = w * 4;
+
+    get_scale_bias (norm, 1.0f, 0.0f, scale, bias);
+
+    for (y = 0; y < h; y ++)
+    {
+        const unsigned char *s = src + y * src_stride;
+
+        if (flags & PREPROC_FLAG_CHW)
+        {
+            float *dr = dst + (0 * h + y) * w;
+            float *dg = dst + (1 * h + y) * w;
+            float *db = dst + (2 * h + y) * w;
+
+            if (flags & PREPROC_FLAG_BGR)
+                row_to_chw (s, w, db, dg, dr, scale, bias);
+            else
+                row_to_chw (s, w, dr, dg, db, scale, bias);
+        }
+        else
+        {
+            row_to_hwc (s, w, dst + y * w * 3, scale, bias, flags & PREPROC_FLAG_BGR);
+        }
+    }
+}
+
+void
+preproc_rgba_to_fp32 (const unsigned char *src, int w, int h, float *dst,
+                      float mean, float std)
+{
+    preproc_norm_t norm;
+
+    preproc_norm_set (&norm, mean, std);
+    preproc_rgba_to_fp32_ex (src, w, h, 0, dst, &norm, 0);
+}
+
+static void
+rgba_to_quant (const unsigned char *src, int w, int h, int src_stride, void *dst,
+               const preproc_norm_t *norm, float quant_scale, int quant_zerop,
+               int flags, int is_signed)
+{
+    float tmp[PREPROC_CHUNK * 3];
+    unsigned char *d = (unsigned char *)dst;    /* both types are 1 byte */
+    float scale[3], bias[3];
+    int x, y, n;
+
+    if (src_stride == 0)
+        src_stride = w * 4;
+
+    if (quant_scale == 0.0f)
+        quant_scale = 1.0f;
+
+    get_scale_bias (norm, quant_scale, (float)quant_zerop, scale, bias);
+
+    if (!is_signed && !(flags & PREPROC_FLAG_CHW) &&
+        scale[0] == 1.0f && scale[1] == 1.0f && scale[2] == 1.0f &&
+        bias[0]  == 0.0f && bias[1]  == 0.0f && bias[2]  == 0.0f)
+    {
+        for (y = 0; y < h; y ++)
+            copy_row_to_rgb (src + y * src_stride, w, d + y * w * 3, flags & PREPROC_FLAG_BGR);
+        return;
+    }
+
+    for (y = 0; y < h; y ++)
+    {
+        const unsigned char *s = src + y * src_stride;
+
+        for (x = 0; x < w; x += n)
+        {
+            n = (w - x < PREPROC_CHUNK) ? w - x : PREPROC_CHUNK;
+
+            if (flags & PREPROC_FLAG_CHW)
+            {
+                int ir = (flags & PREPROC_FLAG_BGR) ? 2 : 0;
+                int ib = (flags & PREPROC_FLAG_BGR) ? 0 : 2;
+                float *t[3] = {tmp, tmp + PREPROC_CHUNK, tmp + PREPROC_CHUNK * 2};
+
+                row_to_chw (s + x * 4, n, t[0], t[1], t[2], scale, bias);
+                quantize_row (t[0], n, d + (ir * h + y) * w + x, is_signed);
+                quantize_row (t[1], n, d + (1  * h + y) * w + x, is_signed);
+                quantize_row (t[2], n, d + (ib * h + y) * w + x, is_signed);
+            }
+            else
+            {
+                row_to_hwc (s + x * 4, n, tmp, scale, bias, flags & PREPROC_FLAG_BGR);
+                quantize_row (tmp, n * 3, d + (y * w + x) * 3, is_signed);
+            }
+        }
+    }
+}
+
+void
+preproc_rgba_to_uint8 (const unsigned char *src, int w, int h, int src_stride,
+                       unsigned char *dst, const preproc_norm_t *norm,
+                       float quant_scale, int quant_zerop, int flags)
+{
+    rgba_to_quant (src, w, h, src_stride, dst, norm, quant_scale, quant_zerop, flags, 0);
+}
+
+void
+preproc_rgba_to_int8 (const unsigned char *src, int w, int h, int src_stride,
+                      signed char *dst, const preproc_norm_t *norm,
+                      float quant_scale, int quant_zerop, int flags)
+{
+    rgba_to_quant (src, w, h, src_stride, dst, norm, quant_scale, quant_zerop, flags, 1);
+}
+
+
+/* -------------------------------------------------- *
+ *  fp32 --> 8bit pixels for the visualization
+ * -------------------------------------------------- */
+static inline unsigned int
+to_pixel (float val, float scale, float bias)
+{
+    val = val * scale + bias;
+    val = fmaxf (val, 0.0f);
+    val = fminf (val, 1.0f);
+    return (unsigned int)(val * 255.0f);
+}
+
+#if defined (PREPROC_USE_NEON)
+static inline uint16x4_t
+neon_to_pixel (float32x4_t v, float32x4_t scale, float32x4_t bias)
+{
+    v = vmlaq_f32 (bias, v, scale);
+    v = vmaxq_f32 (v, vdupq_n_f32 (0.0f));
+    v = vminq_f32 (v, vdupq_n_f32 (1.0f));
+    v = vmulq_f32 (v, vdupq_n_f32 (255.0f));
+    return vmovn_u32 (vcvtq_u32_f32 (v));   /* truncate, same as the scalar cast */
+}
+
+/* 8 floats --> 8 bytes */
+static inline uint8x8_t
+neon_to_pixel8 (const float *src, float32x4_t scale, float32x4_t bias)
+{
+    uint16x4_t lo = neon_to_pixel (vld1q_f32 (src + 0), scale, bias);
+    uint16x4_t hi = neon_to_pixel (vld1q_f32 (src + 4), scale, bias);
+    return vmovn_u16 (vcombine_u16 (lo, hi));
+}
+#elif defined (PREPROC_USE_SSE2)
+static inline __m128i
+sse_to_pixel (__m128 v, __m128 scale, __m128 bias)
+{
+    v = _mm_add_ps (_mm_mul_ps (v, scale), bias);
+    v = _mm_max_ps (v, _mm_setzero_ps ());
+    v = _mm_min_ps (v, _mm_set1_ps (1.0f));
+    v = _mm_mul_ps (v, _mm_set1_ps (255.0f));
+    return _mm_cvttps_epi32 (v);            /* truncate, same as the scalar cast */
+}
+
+/* 16 floats --> 16 bytes */
+static inline __m128i
+sse_to_pixel16 (__m128 v0, __m128 v1, __m128 v2, __m128 v3, __m128 scale, __m128 bias)
+{
+    __m128i lo = _mm_packs_epi32 (sse_to_pixel (v0, scale, bias), sse_to_pixel (v1, scale, bias));
+    __m128i hi = _mm_packs_epi32 (sse_to_pixel (v2, scale, bias), sse_to_pixel (v3, scale, bias));
+    return _mm_packus_epi16 (lo, hi);
+}
+#endif
+
+void
+preproc_fp32_minmax (const float *src, int num, int src_step, float *min, float *max)
+{
+    float vmin =  INFINITY;
+    float vmax = -INFINITY;
+    int i = 0;
+
+    if (src_step == 1)
+    {
+#if defined (PREPROC_USE_NEON)
+        float32x4_t mn = vdupq_n_f32 (vmin);
+        float32x4_t mx = vdupq_n_f32 (vmax);
+        float tmp[4];
+
+        for (; i + 4 <= num; i += 4)
+        {
+            float32x4_t v = vld1q_f32 (src + i);
+            mn = vminq_f32 (mn, v);
+            mx = vmaxq_f32 (mx, v);
+        }
+        vst1q_f32 (tmp, mn);
+        vmin = fminf (fminf (tmp[0], tmp[1]), fminf (tmp[2], tmp[3]));
+        vst1q_f32 (tmp, mx);
+        vmax = fmaxf (fmaxf (tmp[0], tmp[1]), fmaxf (tmp[2], tmp[3]));
+#elif defined (PREPROC_USE_SSE2)
+        __m128 mn = _mm_set1_ps (vmin);
+        __m128 mx = _mm_set1_ps (vmax);
+        float tmp[4];
+
+        for (; i + 4 <= num; i += 4)
+        {
+            __m128 v = _mm_loadu_ps (src + i);
+            mn = _mm_min_ps (mn, v);
+            mx = _mm_max_ps (mx, v);
+        }
+        _mm_storeu_ps (tmp, mn);
+        vmin = fminf (fminf (tmp[0], tmp[1]), fminf (tmp[2], tmp[3]));
+        _mm_storeu_ps (tmp, mx);
+        vmax = fmaxf (fmaxf (tmp[0], tmp[1]), fmaxf (tmp[2], tmp[3]));
+#endif
+    }
+
+    for (; i < num; i ++)
+    {
+        float v = src[i * src_step];
+        if (v < vmin) vmin = v;
+        if (v > vmax) vmax = v;
+    }
+
+    *min = vmin;
+    *max = vmax;
+}
+
+void
+preproc_fp32_to_gray (const float *src, int num, int src_step,
+                      float scale, float bias, unsigned char *dst)
+{
+    int i = 0;
+
+    if (src_step == 1)
+    {
+#if defined (PREPROC_USE_NEON)
+        float32x4_t vscale = vdupq_n_f32 (scale);
+        float32x4_t vbias  = vdupq_n_f32 (bias);
+
+        for (; i + 8 <= num; i += 8)
+            vst1_u8 (dst + i, neon_to_pixel8 (src + i, vscale, vbias));
+#elif defined (PREPROC_USE_SSE2)
+        __m128 vscale = _mm_set1_ps (scale);
+        __m128 vbias  = _mm_set1_ps (bias);
+
+        for (; i + 16 <= num; i += 16)
+        {
+            __m128i v = sse_to_pixel16 (_mm_loadu_ps (src + i +  0), _mm_loadu_ps (src + i +  4),
+                                        _mm_loadu_ps (src + i +  8), _mm_loadu_ps (src + i + 12),
+                                        vscale, vbias);
+            _mm_storeu_si128 ((__m128i *)(dst + i), v);
+        }
+#endif
+    }
+
+    for (; i < num; i ++)
+        dst[i] = to_pixel (src[i * src_step], scale, bias);
+}
+
+void
+preproc_fp32_to_rgba (const float *src, int num,
+                      float scale, float bias, unsigned int *dst)
+{
+    int i = 0;
+
+#if defined (PREPROC_USE_NEON)
+    float32x4_t vscale = vdupq_n_f32 (scale);
+    float32x4_t vbias  = vdupq_n_f32 (bias);
+
+    for (; i + 8 <= num; i += 8)
+    {
+        float32x4x3_t p0 = vld3q_f32 (src + i * 3);
+        float32x4x3_t p1 = vld3q_f32 (src + i * 3 + 12);
+        uint8x8x4_t px;
+        int c;
+
+        for (c = 0; c < 3; c ++)
+        {
+            uint16x4_t lo = neon_to_pixel (p0.val[c], vscale, vbias);
+            uint16x4_t hi = neon_to_pixel (p1.val[c], vscale, vbias);
+            px.val[c] = vmovn_u16 (vcombine_u16 (lo, hi));
+        }
+        px.val[3] = vdup_n_u8 (0xff);
+        vst4_u8 ((uint8_t *)(dst + i), px);
+    }
+#elif defined (PREPROC_USE_SSE2)
+    __m128 vscale = _mm_set1_ps (scale);
+    __m128 vbias  = _mm_set1_ps (bias);
+    __m128i alpha = _mm_set1_epi32 ((int)0xff000000);
+
+    for (; i + 4 <= num; i += 4)
+    {
+        /* [r0 g0 b0 r1] [g1 b1 r2 g2] [b2 r3 g3 b3] --> [rgb?] x 4. lane 3 is overwritten by alpha */
+        __m128 a  = _mm_loadu_ps (src + i * 3 + 0);
+        __m128 b  = _mm_loadu_ps (src + i * 3 + 4);
+        __m128 c  = _mm_loadu_ps (src + i * 3 + 8);
+        __m128 t  = _mm_shuffle_ps (a, b, _MM_SHUFFLE (1, 0, 3, 3));
+        __m128 p1 = _mm_shuffle_ps (t, t, _MM_SHUFFLE (3, 3, 2, 0));
+        __m128 p2 = _mm_shuffle_ps (b, c, _MM_SHUFFLE (0, 0, 3, 2));
+        __m128 p3 = _mm_shuffle_ps (c, c, _MM_SHUFFLE (3, 3, 2, 1));
+
+        __m128i v = sse_to_pixel16 (a, p1, p2, p3, vscale, vbias);
+        _mm_storeu_si128 ((__m128i *)(dst + i), _mm_or_si128 (v, alpha));
+    }
+#endif
+
+    for (; i < num; i ++)
+    {
+        unsigned int r = to_pixel (src[i * 3 + 0], scale, bias);
+        unsigned int g = to_pixel (src[i * 3 + 1], scale, bias);
+        unsigned int b = to_pixel (src[i * 3 + 2], scale, bias);
+        dst[i] = 0xff000000 | (b << 16) | (g << 8) | r;
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  Staging buffer
+ * -------------------------------------------------- */
+void *
+preproc_buf_reserve (preproc_buf_t *buf, int size)
+{
+    void *ptr;
+
+    if (buf->ptr && buf->size >= size)
+        return buf->ptr;
+
+    if (posix_memalign (&ptr, PREPROC_ALIGN, size) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return NULL;
+    }
+
+    if (buf->ptr)
+        free (buf->ptr);
+
+    buf->ptr  = ptr;
+    buf->size = size;
+    return ptr;
+}
+
+void
+preproc_buf_free (preproc_buf_t *buf)
+{
+    if (buf->ptr)
+        free (buf->ptr);
+
+    buf->ptr  = NULL;
+    buf->size = 0;
+}
@@ -0,0 +1,85 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_PREPROCESS_H_
+#define _UTIL_PREPROCESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  Conversion of RGBA8 images (e.g. the output of glReadPixels())
+ *  to DNN input tensors. alpha is dropped.
+ *
+ *    fp32 : dst = (src - mean) / std
+ *    uint8/int8 : dst = round (((src - mean) / std) / quant_scale) + quant_zerop
+ */
+#define PREPROC_FLAG_BGR    (1 << 0)    /* output in B, G, R order       */
+#define PREPROC_FLAG_CHW    (1 << 1)    /* output channel first (planar) */
+
+typedef struct _preproc_norm_t
+{
+    float   mean[3];                    /* per channel (R, G, B) */
+    float   std[3];
+} preproc_norm_t;
+
+extern const preproc_norm_t preproc_norm_unit;          /* [0, 255] --> [ 0, 1]  */
+extern const preproc_norm_t preproc_norm_signed_unit;   /* [0, 255] --> [-1, 1]  */
+extern const preproc_norm_t preproc_norm_imagenet;      /* ImageNet mean/std     */
+extern const preproc_norm_t preproc_norm_none;          /* [0, 255] as it is     */
+
+void preproc_norm_set (preproc_norm_t *norm, float mean, float std);
+
+/* src_stride is in bytes. 0 means (w * 4). */
+void preproc_rgba_to_fp32 (const unsigned char *src, int w, int h, float *dst,
+                           float mean, float std);
+void preproc_rgba_to_fp32_ex (const unsigned char *src, int w, int h, int src_stride,
+                              float *dst, const preproc_norm_t *norm, int flags);
+
+void preproc_rgba_to_uint8 (const unsigned char *src, int w, int h, int src_stride,
+                            unsigned char *dst, const preproc_norm_t *norm,
+                            float quant_scale, int quant_zerop, int flags);
+void preproc_rgba_to_int8  (const unsigned char *src, int w, int h, int src_stride,
+                            signed char *dst, const preproc_norm_t *norm,
+                            float quant_scale, int quant_zerop, int flags);
+
+
+/*
+ *  The other way round: fp32 output tensors (depth maps, heatmaps,
+ *  generated images) to 8bit pixels for the visualization.
+ *
+ *    dst = clamp (src * scale + bias, 0, 1) * 255    (truncated)
+ *
+ *  src_step is the distance of the pixels in floats, to pick one channel
+ *  of an HWC tensor. the contiguous case (src_step == 1) is vectorized.
+ */
+void preproc_fp32_minmax       (const float *src, int num, int src_step, float *min, float *max);
+
+void preproc_fp32_to_gray      (const float *src, int num, int src_step,
+                                float scale, float bias, unsigned char *dst);
+
+/* RGB (interleaved) --> RGBA8, A = 255 */
+void preproc_fp32_to_rgba      (const float *src, int num,
+                                float scale, float bias, unsigned int *dst);
+
+
+/*
+ *  Staging buffer for glReadPixels(). grows on demand and is aligned
+ *  for SIMD loads.
+ */
+typedef struct _preproc_buf_t
+{
+    void    *ptr;
+    int     size;
+} preproc_buf_t;
+
+void *preproc_buf_reserve (preproc_buf_t *buf, int size);
+void  preproc_buf_free    (preproc_buf_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_PREPROCESS_H_ */
@@ -3,6 +3,7 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
 #include <GLES2/gl2.h>
@@ -12,6 +13,7 @@
 #include "util_matrix.h"
 #include "util_render2d.h"
 #include "util_texture.h"
+#include "util_debugstr.h"
 
 /* ------------------------------------------------------ *
  *  shader for FillColor
@@ -252,6 +254,30 @@ void main (void)                                      \n\
     gl_FragColor *= u_Color;                          \n\
 }                                                     \n";
 
+/* ------------------------------------------------------ *
+ *  shader for batched primitives (per vertex color)
+ * ------------------------------------------------------ */
+static char vs_batch[] = "                            \n\
+attribute    vec4    a_Vertex;                        \n\
+attribute    vec4    a_Color;                         \n\
+varying      vec4    v_Color;                         \n\
+uniform      mat4    u_PMVMatrix;                     \n\
+                                                      \n\
+void main (void)                                      \n\
+{                                                     \n\
+    gl_Position = u_PMVMatrix * a_Vertex;             \n\
+    v_Color     = a_Color;                            \n\
+}                                                     \n";
+
+static char fs_batch[] = "                            \n\
+precision mediump float;                              \n\
+varying     vec4      v_Color;                        \n\
+                                                      \n\
+void main (void)                                      \n\
+{                                                     \n\
+    gl_FragColor = v_Color;                           \n\
+}                                                     \n";
+
 enum shader_type {
     SHADER_TYPE_FILL    = 0,    // 0
     SHADER_TYPE_TEX,            // 1
@@ -259,6 +285,7 @@ enum shader_type {
     SHADER_TYPE_CMAP_JET,       // 3
     SHADER_TYPE_TEX_YUYV,       // 4
     SHADER_TYPE_TEX_UYVY,       // 5
+    SHADER_TYPE_BATCH,          // 6
 
     SHADER_TYPE_MAX
 };
@@ -272,6 +299,7 @@ static char *s_shader[SHADER_NUM * 2] =
     vs_tex,    fs_cmap_jet,
     vs_tex_yuyv, fs_tex_yuyv,
     vs_tex_uyvy, fs_tex_uyvy,
+    vs_batch,  fs_batch,
 };
 
 static shader_obj_t s_sobj[SHADER_NUM];
@@ -285,10 +313,32 @@ static float varray[] =
     1.0, 0.0,
     1.0, 1.0 };
 
+/*
+ *  batched primitives.
+ *
+ *  the fill primitives (rect, line, circle) are converted to triangles
+ *  with the per-vertex color and accumulated in a vertex array, which is
+ *  drawn by one glDrawArrays() from a streaming VBO at the flush.
+ */
+#define BATCH_MAX_VTX   (6 * 1024)
+
+typedef struct _batch_vtx_t
+{
+    float           x, y;
+    unsigned char   color[4];
+} batch_vtx_t;
+
+static batch_vtx_t  s_batch_vtx[BATCH_MAX_VTX];
+static int          s_batch_num;
+static int          s_batch_depth;
+static GLuint       s_batch_vbo;
+
 static float s_matprj[16];
 int
 set_2d_projection_matrix (int w, int h)
 {
+    flush_2d_batch ();
+
     float mat_proj[] =
     {
        0.0f, 0.0f, 0.0f, 0.0f,
@@ -325,6 +375,12 @@ init_2d_renderer (int w, int h)
         s_loc_texdim[i] = glGetUniformLocation(s_sobj[i].program, "u_TexDim");
     }
 
+    if (s_batch_vbo == 0)
+        glGenBuffers (1, &s_batch_vbo);
+
+    /* the debug strings are drawn after the primitives batched so far. */
+    set_dbgstr_flush_hook (flush_2d_batch);
+
     set_2d_projection_matrix (w, h);
 
     return 0;
@@ -384,6 +440,9 @@ draw_2d_texture_in (texparam_t *tparam)
         1.0, 1.0 };
     float *uv = tarray;
 
+    /* keep the drawing order with the pending primitives */
+    flush_2d_batch ();
+
     glBindBuffer (GL_ARRAY_BUFFER, 0);
     glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
 
@@ -679,274 +738,286 @@ draw_2d_colormap (int texid, int x, int y, int w, int h, float alpha, int upside
 }
 
 
-int
-draw_2d_fillrect (int x, int y, int w, int h, float *color)
+/* ------------------------------------------------------ *
+ *  batched primitives
+ * ------------------------------------------------------ */
+void
+begin_2d_batch ()
 {
-    texparam_t tparam = {0};
-    tparam.x       = x;
-    tparam.y       = y;
-    tparam.w       = w;
-    tparam.h       = h;
-    tparam.textype = SHADER_TYPE_FILL;
-    tparam.color[0]= color[0];
-    tparam.color[1]= color[1];
-    tparam.color[2]= color[2];
-    tparam.color[3]= color[3];
-    draw_2d_texture_in (&tparam);
-
-    return 0;
+    s_batch_depth ++;
 }
 
+void
+end_2d_batch ()
+{
+    if (s_batch_depth > 0)
+        s_batch_depth --;
 
-int
-draw_2d_rect (int x, int y, int w, int h, float *color, float line_width)
+    if (s_batch_depth == 0)
+        flush_2d_batch ();
+}
+
+void
+flush_2d_batch ()
 {
-    int ttype = SHADER_TYPE_FILL;
+    int ttype = SHADER_TYPE_BATCH;
     shader_obj_t *sobj = &s_sobj[ttype];
-    float matrix[16];
 
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    if (s_batch_num == 0)
+        return;
 
     glUseProgram (sobj->program);
-    glUniform4fv (s_loc_color[ttype], 1, color);
+    glUniformMatrix4fv (s_loc_mtx[ttype], 1, GL_FALSE, s_matprj);
 
-    glEnable (GL_BLEND);
-    glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, 
-               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-
-    matrix_identity (matrix);
-    matrix_mult (matrix, s_matprj, matrix);
-    glUniformMatrix4fv (s_loc_mtx[ttype], 1, GL_FALSE, matrix);
+    /* respecify the whole store, so that the driver can orphan the one still in use. */
+    glBindBuffer (GL_ARRAY_BUFFER, s_batch_vbo);
+    glBufferData (GL_ARRAY_BUFFER, s_batch_num * sizeof (batch_vtx_t), s_batch_vtx, GL_STREAM_DRAW);
 
-    glLineWidth (line_width);
-    float x1 = x;
-    float x2 = x + w;
-    float y1 = y;
-    float y2 = y + h;
     if (sobj->loc_vtx >= 0)
     {
-        float vtx[] = {x1, y1,
-                       x2, y1,
-                       x2, y2,
-                       x1, y2,
-                       x1, y1};
-
         glEnableVertexAttribArray (sobj->loc_vtx);
-        glVertexAttribPointer (sobj->loc_vtx, 2, GL_FLOAT, GL_FALSE, 0, vtx);
-        glDrawArrays (GL_LINE_STRIP, 0, 5);
+        glVertexAttribPointer (sobj->loc_vtx, 2, GL_FLOAT, GL_FALSE, sizeof (batch_vtx_t),
+                               (void *)offsetof (batch_vtx_t, x));
+    }
+    if (sobj->loc_clr >= 0)
+    {
+        glEnableVertexAttribArray (sobj->loc_clr);
+        glVertexAttribPointer (sobj->loc_clr, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof (batch_vtx_t),
+                               (void *)offsetof (batch_vtx_t, color));
     }
 
+    glEnable (GL_BLEND);
+    glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glDrawArrays (GL_TRIANGLES, 0, s_batch_num);
+
     glDisable (GL_BLEND);
 
+    /* the other shaders feed the attributes from client arrays */
+    if (sobj->loc_clr >= 0)
+        glDisableVertexAttribArray (sobj->loc_clr);
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+
+    s_batch_num = 0;
+
     GLASSERT ();
-    return 0;
 }
 
-int
-draw_2d_rect_rot (int x, int y, int w, int h, float *color, float line_width,
-                  int px, int py, float rot_degree)
+/* outside of a batch, the primitive is drawn right away. */
+static void
+end_primitive ()
 {
-    int ttype = SHADER_TYPE_FILL;
-    shader_obj_t *sobj = &s_sobj[ttype];
-    float matrix[16];
+    if (s_batch_depth == 0)
+        flush_2d_batch ();
+}
 
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+static batch_vtx_t *
+alloc_batch_vtx (int num)
+{
+    batch_vtx_t *vtx;
 
-    glUseProgram (sobj->program);
-    glUniform4fv (s_loc_color[ttype], 1, color);
+    if (s_batch_num + num > BATCH_MAX_VTX)
+        flush_2d_batch ();
 
-    glEnable (GL_BLEND);
-    glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
-               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    vtx = &s_batch_vtx[s_batch_num];
+    s_batch_num += num;
 
-    matrix_identity (matrix);
-    if (rot_degree != 0)
+    return vtx;
+}
+
+static void
+set_batch_vtx (batch_vtx_t *vtx, float x, float y, const unsigned char *color)
+{
+    vtx->x = x;
+    vtx->y = y;
+    memcpy (vtx->color, color, 4);
+}
+
+static void
+pack_color (const float *color, unsigned char *dst)
+{
+    int i;
+
+    for (i = 0; i < 4; i ++)
     {
-        matrix_translate (matrix,  px,  py, 0);
-        matrix_rotate (matrix, rot_degree, 0.0f, 0.0f, 1.0f);
-        matrix_translate (matrix, -px, -py, 0);
+        float c = color[i];
+        c = (c < 0.0f) ? 0.0f : (c > 1.0f) ? 1.0f : c;
+        dst[i] = (unsigned char)(c * 255.0f + 0.5f);
     }
+}
 
-    matrix_mult (matrix, s_matprj, matrix);
-    glUniformMatrix4fv (s_loc_mtx[ttype], 1, GL_FALSE, matrix);
+/* quad (p0, p1, p2, p3) in the winding order */
+static void
+push_quad (const float *p0, const float *p1, const float *p2, const float *p3,
+           const unsigned char *color)
+{
+    batch_vtx_t *vtx = alloc_batch_vtx (6);
+
+    set_batch_vtx (&vtx[0], p0[0], p0[1], color);
+    set_batch_vtx (&vtx[1], p1[0], p1[1], color);
+    set_batch_vtx (&vtx[2], p2[0], p2[1], color);
+    set_batch_vtx (&vtx[3], p0[0], p0[1], color);
+    set_batch_vtx (&vtx[4], p2[0], p2[1], color);
+    set_batch_vtx (&vtx[5], p3[0], p3[1], color);
+}
 
-    glLineWidth (line_width);
-    float x1 = x;
-    float x2 = x + w;
-    float y1 = y;
-    float y2 = y + h;
-    if (sobj->loc_vtx >= 0)
+/* axis aligned box (x0, y0)-(x1, y1), rotated by (rot) around (px, py) */
+static void
+push_box (float x0, float y0, float x1, float y1, const unsigned char *color,
+          float px, float py, float cos_rot, float sin_rot)
+{
+    float p[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+    int i;
+
+    for (i = 0; i < 4; i ++)
     {
-        float vtx[10] = {x1, y1,
-                         x2, y1,
-                         x2, y2,
-                         x1, y2,
-                         x1, y1};
+        float dx = p[i][0] - px;
+        float dy = p[i][1] - py;
 
-        glEnableVertexAttribArray (sobj->loc_vtx);
-        glVertexAttribPointer (sobj->loc_vtx, 2, GL_FLOAT, GL_FALSE, 0, vtx);
-        glDrawArrays (GL_LINE_STRIP, 0, 5);
+        p[i][0] = px + dx * cos_rot - dy * sin_rot;
+        p[i][1] = py + dx * sin_rot + dy * cos_rot;
     }
 
-    glDisable (GL_BLEND);
+    push_quad (p[0], p[1], p[2], p[3], color);
+}
+
+/* outline of a box. the horizontal edges cover the corners, so no pixel is blended twice. */
+static void
+push_box_outline (float x0, float y0, float x1, float y1, float line_width,
+                  const unsigned char *color, float px, float py, float cos_rot, float sin_rot)
+{
+    float hw = 0.5f * line_width;
+    float t;
+
+    if (x0 > x1) { t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { t = y0; y0 = y1; y1 = t; }
+
+    push_box (x0 - hw, y0 - hw, x1 + hw, y0 + hw, color, px, py, cos_rot, sin_rot);
+    push_box (x0 - hw, y1 - hw, x1 + hw, y1 + hw, color, px, py, cos_rot, sin_rot);
+
+    if (y1 - hw > y0 + hw)
+    {
+        push_box (x0 - hw, y0 + hw, x0 + hw, y1 - hw, color, px, py, cos_rot, sin_rot);
+        push_box (x1 - hw, y0 + hw, x1 + hw, y1 - hw, color, px, py, cos_rot, sin_rot);
+    }
+}
+
+
+int
+draw_2d_fillrect (int x, int y, int w, int h, float *color)
+{
+    unsigned char col[4];
+
+    pack_color (color, col);
+    push_box (x, y, x + w, y + h, col, 0.0f, 0.0f, 1.0f, 0.0f);
+    end_primitive ();
 
-    GLASSERT ();
     return 0;
 }
 
 
 int
-draw_2d_line (int x0, int y0, int x1, int y1, float *color, float line_width)
+draw_2d_rect (int x, int y, int w, int h, float *color, float line_width)
 {
-    if (line_width == 1.0f)
-    {
-        int ttype = 0;
-        shader_obj_t *sobj = &s_sobj[ttype];
-        float matrix[16];
+    unsigned char col[4];
 
-        glUseProgram (sobj->program);
-        glUniform4fv (s_loc_color[ttype], 1, color);
+    pack_color (color, col);
+    push_box_outline (x, y, x + w, y + h, line_width, col, 0.0f, 0.0f, 1.0f, 0.0f);
+    end_primitive ();
 
-        glEnable (GL_BLEND);
-        glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
-                   GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    return 0;
+}
 
-        matrix_identity (matrix);
-        matrix_mult (matrix, s_matprj, matrix);
-        glUniformMatrix4fv (s_loc_mtx[ttype], 1, GL_FALSE, matrix);
+int
+draw_2d_rect_rot (int x, int y, int w, int h, float *color, float line_width,
+                  int px, int py, float rot_degree)
+{
+    float rad = DEG_TO_RAD (rot_degree);
+    unsigned char col[4];
+
+    pack_color (color, col);
+    push_box_outline (x, y, x + w, y + h, line_width, col, px, py, cosf (rad), sinf (rad));
+    end_primitive ();
 
-        glLineWidth (line_width);
-        if (sobj->loc_vtx >= 0)
-        {
-            float vtx[] = {x0, y0, x1, y1};
-            glEnableVertexAttribArray (sobj->loc_vtx);
-            glVertexAttribPointer (sobj->loc_vtx, 2, GL_FLOAT, GL_FALSE, 0, vtx);
-            glDrawArrays (GL_LINE_STRIP, 0, 2);
-        }
-        glDisable (GL_BLEND);
-    }
-    else
-    {
-        float dx = x1 - x0;
-        float dy = y1 - y0;
-        float len = sqrtf (dx * dx + dy * dy);
-        float theta = acosf (dx / len);
-
-        if (dy < 0)
-            theta = -theta;
-
-        texparam_t tparam = {0};
-        tparam.x       = x0;
-        tparam.y       = y0 - 0.5f * line_width;
-        tparam.w       = len;
-        tparam.h       = line_width;
-        tparam.rot     = RAD_TO_DEG (theta);
-        tparam.px      = 0;
-        tparam.py      = 0.5f * line_width;
-        tparam.textype = SHADER_TYPE_FILL;
-        tparam.color[0]= color[0];
-        tparam.color[1]= color[1];
-        tparam.color[2]= color[2];
-        tparam.color[3]= color[3];
-        draw_2d_texture_in (&tparam);
-    }
-    GLASSERT ();
     return 0;
 }
 
 
-#define CIRCLE_DIVNUM 15
 int
-draw_2d_fillcircle (int x, int y, int radius, float *color)
+draw_2d_line (int x0, int y0, int x1, int y1, float *color, float line_width)
 {
-    int ttype = SHADER_TYPE_FILL;
-    shader_obj_t *sobj = &s_sobj[ttype];
-    float matrix[16];
-    float vtx[(CIRCLE_DIVNUM+2) * 2];
+    float dx  = x1 - x0;
+    float dy  = y1 - y0;
+    float len = sqrtf (dx * dx + dy * dy);
+    unsigned char col[4];
 
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    if (len == 0.0f)
+        return 0;
 
-    glUseProgram (sobj->program);
-    glUniform4fv (s_loc_color[ttype], 1, color);
+    /* a box of (len x line_width) along the line */
+    pack_color (color, col);
+    push_box (x0, y0 - 0.5f * line_width, x0 + len, y0 + 0.5f * line_width, col,
+              x0, y0, dx / len, dy / len);
+    end_primitive ();
 
-    glEnable (GL_BLEND);
-    glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
-               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    return 0;
+}
 
-    matrix_identity (matrix);
-    matrix_mult (matrix, s_matprj, matrix);
-    glUniformMatrix4fv (s_loc_mtx[ttype], 1, GL_FALSE, matrix);
 
-    if (sobj->loc_vtx >= 0)
-    {
-        vtx[0] = x;
-        vtx[1] = y;
-        for (int i = 0; i <= CIRCLE_DIVNUM; i ++)
-        {
-            float delta = 2 * M_PI / (float)CIRCLE_DIVNUM;
-            float theta = delta * i;
+#define CIRCLE_DIVNUM 15
+int
+draw_2d_fillcircle (int x, int y, int radius, float *color)
+{
+    batch_vtx_t *vtx = alloc_batch_vtx (CIRCLE_DIVNUM * 3);
+    float delta = 2 * M_PI / (float)CIRCLE_DIVNUM;
+    unsigned char col[4];
 
-            vtx[(i+1) * 2 + 0] = radius * cos (theta) + x;
-            vtx[(i+1) * 2 + 1] = radius * sin (theta) + y;
-        }
+    pack_color (color, col);
 
-        glEnableVertexAttribArray (sobj->loc_vtx);
-        glVertexAttribPointer (sobj->loc_vtx, 2, GL_FLOAT, GL_FALSE, 0, vtx);
-        glDrawArrays (GL_TRIANGLE_FAN, 0, CIRCLE_DIVNUM + 2);
-    }
+    for (int i = 0; i < CIRCLE_DIVNUM; i ++)
+    {
+        float theta0 = delta * i;
+        float theta1 = delta * (i + 1);
 
-    glDisable (GL_BLEND);
+        set_batch_vtx (vtx ++, x, y, col);
+        set_batch_vtx (vtx ++, radius * cosf (theta0) + x, radius * sinf (theta0) + y, col);
+        set_batch_vtx (vtx ++, radius * cosf (theta1) + x, radius * sinf (theta1) + y, col);
+    }
+    end_primitive ();
 
-    GLASSERT ();
     return 0;
 }
 
 int
 draw_2d_circle (int x, int y, int radius, float *color, float line_width)
 {
-    int ttype = SHADER_TYPE_FILL;
-    shader_obj_t *sobj = &s_sobj[ttype];
-    float matrix[16];
-    float vtx[(CIRCLE_DIVNUM+2) * 2];
-
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    float delta = 2 * M_PI / (float)CIRCLE_DIVNUM;
+    float r0 = radius - 0.5f * line_width;
+    float r1 = radius + 0.5f * line_width;
+    unsigned char col[4];
 
-    glUseProgram (sobj->program);
-    glUniform4fv (s_loc_color[ttype], 1, color);
+    if (r0 < 0.0f)
+        r0 = 0.0f;
 
-    glEnable (GL_BLEND);
-    glBlendFuncSeparate (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
-               GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    pack_color (color, col);
 
-    matrix_identity (matrix);
-    matrix_mult (matrix, s_matprj, matrix);
-    glUniformMatrix4fv (s_loc_mtx[ttype], 1, GL_FALSE, matrix);
-
-    glLineWidth (line_width);
-    if (sobj->loc_vtx >= 0)
+    /* ring of quads between the inner and outer edges */
+    for (int i = 0; i < CIRCLE_DIVNUM; i ++)
     {
-        for (int i = 0; i <= CIRCLE_DIVNUM; i ++)
-        {
-            float delta = 2 * M_PI / (float)CIRCLE_DIVNUM;
-            float theta = delta * i;
-
-            vtx[i * 2 + 0] = radius * cos (theta) + x;
-            vtx[i * 2 + 1] = radius * sin (theta) + y;
-        }
-
-        glEnableVertexAttribArray (sobj->loc_vtx);
-        glVertexAttribPointer (sobj->loc_vtx, 2, GL_FLOAT, GL_FALSE, 0, vtx);
-        glDrawArrays (GL_LINE_STRIP, 0, CIRCLE_DIVNUM + 1);
+        float c0 = cosf (delta * i);
+        float s0 = sinf (delta * i);
+        float c1 = cosf (delta * (i + 1));
+        float s1 = sinf (delta * (i + 1));
+        float p0[2] = {r0 * c0 + x, r0 * s0 + y};
+        float p1[2] = {r1 * c0 + x, r1 * s0 + y};
+        float p2[2] = {r1 * c1 + x, r1 * s1 + y};
+        float p3[2] = {r0 * c1 + x, r0 * s1 + y};
+
+        push_quad (p0, p1, p2, p3, col);
     }
-    glLineWidth (1);
+    end_primitive ();
 
-    glDisable (GL_BLEND);
-
-    GLASSERT ();
     return 0;
 }
 
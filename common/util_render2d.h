@@ -16,7 +16,6 @@ extern "C" {
 int init_2d_renderer (int w, int h);
 int set_2d_projection_matrix (int w, int h);
 
-int draw_2d_fillrect (int x, int y, int w, int h, float *color);
 int draw_2d_texture (int texid, int x, int y, int w, int h, int upsidedown);
 int draw_2d_texture_ex (texture_2d_t *tex, int x, int y, int w, int h, int upsidedown);
 int draw_2d_texture_texcoord (int texid, int x, int y, int w, int h, float *user_texcoord);
@@ -29,6 +28,20 @@ int draw_2d_texture_modulate (int texid, int x, int y, int w, int h,
                            int upsidedown, float *color, unsigned int *blendfunc);
 int draw_2d_colormap (int texid, int x, int y, int w, int h, float alpha, int upsidedown);
 
+/*
+ *  the primitives below are batched between begin_2d_batch() and
+ *  end_2d_batch(), and drawn together at the end by one draw call.
+ *  outside of a batch, each of them is drawn right away.
+ *
+ *  the texture draws and draw_dbgstr() flush the batch first, so the
+ *  drawing order is kept. flush_2d_batch() before drawing anything else
+ *  (or switching the render target) inside a batch.
+ */
+void begin_2d_batch ();
+void end_2d_batch ();
+void flush_2d_batch ();
+
+int draw_2d_fillrect (int x, int y, int w, int h, float *color);
 int draw_2d_rect (int x, int y, int w, int h, float *color, float line_width);
 int draw_2d_rect_rot (int x, int y, int w, int h, float *color, float line_width,
                       int px, int py, float rot_degree);
@@ -0,0 +1,272 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "util_roi_track.h"
+#include "util_nms.h"
+#include "util_debug.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* tracked ROIs overlapping more than this are the same object. */
+#define ROI_TRACK_MERGE_IOU     0.5f
+
+
+/* -------------------------------------------------- *
+ *  ROI geometry
+ * -------------------------------------------------- */
+static float
+normalize_radians (float angle)
+{
+    return angle - 2 * M_PI * floorf ((angle - (-M_PI)) / (2 * M_PI));
+}
+
+static void
+rot_vec (float *x, float *y, float rotation)
+{
+    float sx = *x;
+    float sy = *y;
+    float c  = cosf (rotation);
+    float s  = sinf (rotation);
+
+    *x = sx * c - sy * s;
+    *y = sx * s + sy * c;
+}
+
+void
+roi_project_point (const roi_t *roi, float x, float y, float *dst_x, float *dst_y)
+{
+    float lx = (x - 0.5f) * roi->w;
+    float ly = (y - 0.5f) * roi->h;
+
+    rot_vec (&lx, &ly, roi->rotation);
+    *dst_x = roi->cx + lx;
+    *dst_y = roi->cy + ly;
+}
+
+void
+roi_get_quad (const roi_t *roi, float quad[4][2])
+{
+    roi_project_point (roi, 0.0f, 0.0f, &quad[0][0], &quad[0][1]);
+    roi_project_point (roi, 1.0f, 0.0f, &quad[1][0], &quad[1][1]);
+    roi_project_point (roi, 1.0f, 1.0f, &quad[2][0], &quad[2][1]);
+    roi_project_point (roi, 0.0f, 1.0f, &quad[3][0], &quad[3][1]);
+}
+
+/*
+ *  the rectangle which is rotated by (rotation) and encloses all the landmarks,
+ *  then shifted and scaled in the rotated frame.
+ */
+void
+roi_from_landmarks (roi_t *roi, const roi_t *cur, const float *lmk, int num, int stride,
+                    const roi_param_t *param)
+{
+    int   num_pts = param->subset ? param->num_subset : num;
+    float xmin = FLT_MAX, ymin = FLT_MAX;
+    float xmax = -FLT_MAX, ymax = -FLT_MAX;
+    float x0, y0, x1, y1, rotation, cx, cy, w, h;
+    int   i;
+
+    roi_project_point (cur, lmk[param->rot_idx0 * stride], lmk[param->rot_idx0 * stride + 1], &x0, &y0);
+    roi_project_point (cur, lmk[param->rot_idx1 * stride], lmk[param->rot_idx1 * stride + 1], &x1, &y1);
+    rotation = normalize_radians (param->target_angle - atan2f (-(y1 - y0), x1 - x0));
+
+    /* bounding box in the rotated frame */
+    for (i = 0; i < num_pts; i ++)
+    {
+        int   idx = param->subset ? param->subset[i] : i;
+        float x, y;
+
+        roi_project_point (cur, lmk[idx * stride], lmk[idx * stride + 1], &x, &y);
+        rot_vec (&x, &y, -rotation);
+
+        if (x < xmin) xmin = x;
+        if (x > xmax) xmax = x;
+        if (y < ymin) ymin = y;
+        if (y > ymax) ymax = y;
+    }
+
+    w  = xmax - xmin;
+    h  = ymax - ymin;
+    cx = (xmin + xmax) * 0.5f + w * param->shift_x;
+    cy = (ymin + ymax) * 0.5f + h * param->shift_y;
+    rot_vec (&cx, &cy, rotation);
+
+    if (param->square_long)
+    {
+        w = fmaxf (w, h);
+        h = w;
+    }
+
+    roi->cx       = cx;
+    roi->cy       = cy;
+    roi->w        = w * param->scale_x;
+    roi->h        = h * param->scale_y;
+    roi->rotation = rotation;
+}
+
+/* axis aligned bounds of the rotated ROI */
+static void
+roi_get_bounds (const roi_t *roi, nms_box_t *box)
+{
+    float quad[4][2];
+    int   i;
+
+    roi_get_quad (roi, quad);
+
+    box->x0 = box->x1 = quad[0][0];
+    box->y0 = box->y1 = quad[0][1];
+    for (i = 1; i < 4; i ++)
+    {
+        box->x0 = fminf (box->x0, quad[i][0]);
+        box->y0 = fminf (box->y0, quad[i][1]);
+        box->x1 = fmaxf (box->x1, quad[i][0]);
+        box->y1 = fmaxf (box->y1, quad[i][1]);
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  Tracker
+ * -------------------------------------------------- */
+int
+roi_track_init (roi_track_t *trk, int max_rois, int item_size,
+                float score_thresh, int redetect_interval)
+{
+    memset (trk, 0, sizeof (*trk));
+
+    if (max_rois <= 0 || max_rois > ROI_TRACK_MAX)
+    {
+        DBG_LOGE ("ERR: %s(%d): max_rois=%d (1..%d)\n", __FILE__, __LINE__, max_rois, ROI_TRACK_MAX);
+        return -1;
+    }
+
+    trk->items = calloc (max_rois, item_size);
+    if (trk->items == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    trk->max_rois          = max_rois;
+    trk->item_size         = item_size;
+    trk->score_thresh      = score_thresh;
+    trk->redetect_interval = redetect_interval;
+
+    return 0;
+}
+
+void
+roi_track_destroy (roi_track_t *trk)
+{
+    if (trk->items)
+        free (trk->items);
+
+    memset (trk, 0, sizeof (*trk));
+}
+
+void
+roi_track_reset (roi_track_t *trk)
+{
+    trk->num  = 0;
+    trk->lost = 0;
+}
+
+int
+roi_track_need_detect (roi_track_t *trk)
+{
+    int detect = 0;
+
+    if (trk->num == 0 || trk->lost)
+        detect = 1;
+
+    if (trk->redetect_interval > 0 && trk->since_detect >= trk->redetect_interval)
+        detect = 1;
+
+    trk->stats.frames ++;
+    if (detect)
+    {
+        trk->stats.detect_frames ++;
+        trk->since_detect = 0;
+    }
+    trk->since_detect ++;
+
+    return detect;
+}
+
+int
+roi_track_get (roi_track_t *trk, void *items)
+{
+    memcpy (items, trk->items, trk->num * trk->item_size);
+    return trk->num;
+}
+
+void
+roi_track_update (roi_track_t *trk, const roi_t *rois, const float *scores,
+                  const void *items, int num)
+{
+    nms_box_t box[ROI_TRACK_MAX];
+    float     kept_score[ROI_TRACK_MAX];
+    int       i, j;
+
+    trk->num  = 0;
+    trk->lost = 0;
+
+    for (i = 0; i < num; i ++)
+    {
+        nms_box_t cur_box;
+        int dup = -1;
+
+        if (scores[i] < trk->score_thresh)
+        {
+            trk->stats.misses ++;
+            trk->lost = 1;
+            continue;
+        }
+        trk->stats.hits ++;
+
+        /* two ROIs converged on the same object. keep the confident one. */
+        roi_get_bounds (&rois[i], &cur_box);
+        for (j = 0; j < trk->num; j ++)
+        {
+            if (nms_calc_iou (&box[j], &cur_box) > ROI_TRACK_MERGE_IOU)
+            {
+                dup = j;
+                break;
+            }
+        }
+
+        if (dup < 0)
+        {
+            if (trk->num >= trk->max_rois)
+                continue;
+            dup = trk->num ++;
+        }
+        else if (scores[i] <= kept_score[dup])
+        {
+            continue;
+        }
+
+        box[dup]        = cur_box;
+        kept_score[dup] = scores[i];
+        trk->rois[dup]  = rois[i];
+        memcpy ((char *)trk->items + dup * trk->item_size,
+                (const char *)items + i * trk->item_size, trk->item_size);
+    }
+}
+
+float
+roi_track_skip_ratio (const roi_track_t *trk)
+{
+    if (trk->stats.frames == 0)
+        return 0.0f;
+
+    return 1.0f - (float)trk->stats.detect_frames / (float)trk->stats.frames;
+}
@@ -0,0 +1,123 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_ROI_TRACK_H_
+#define _UTIL_ROI_TRACK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  ROI tracking for two-stage (detector + landmark) networks.
+ *
+ *  the ROI of the next frame is derived from the landmarks of the current
+ *  frame, like MediaPipe does. the detector runs only when a tracked ROI
+ *  is lost (low landmark score), or every (redetect_interval) frames to
+ *  find new objects.
+ *
+ *      if (roi_track_need_detect (&trk))
+ *          num = run_detector (items);
+ *      else
+ *          num = roi_track_get (&trk, items);
+ *
+ *      run_landmark (items, num);
+ *      (compute next_rois[], scores[], next_items[] from the landmarks)
+ *      roi_track_update (&trk, next_rois, scores, next_items, num);
+ *
+ *  all the coordinates are normalized to [0, 1] of the input frame.
+ */
+#define ROI_TRACK_MAX       16
+
+typedef struct _roi_t
+{
+    float   cx, cy;         /* center   */
+    float   w, h;           /* size     */
+    float   rotation;       /* [radian] */
+} roi_t;
+
+/* how to make a ROI from the landmarks (LandmarksToRect + RectTransformation) */
+typedef struct _roi_param_t
+{
+    const int   *subset;        /* landmarks to be enclosed. NULL: all */
+    int         num_subset;
+    int         rot_idx0;       /* the direction (rot_idx0 --> rot_idx1) */
+    int         rot_idx1;       /*   is turned to (target_angle)         */
+    float       target_angle;   /* [radian] */
+    float       shift_x;        /* in the unit of ROI size, before scaling */
+    float       shift_y;
+    float       scale_x;
+    float       scale_y;
+    int         square_long;    /* make it square with the long side */
+} roi_param_t;
+
+typedef struct _roi_track_stats_t
+{
+    int     frames;             /* number of roi_track_need_detect() calls */
+    int     detect_frames;      /* frames the detector ran          */
+    int     hits;               /* ROIs tracked to the next frame   */
+    int     misses;             /* ROIs lost by low landmark score  */
+} roi_track_stats_t;
+
+typedef struct _roi_track_t
+{
+    int                 max_rois;
+    int                 item_size;
+    float               score_thresh;
+    int                 redetect_interval;  /* 0: only when lost */
+
+    int                 num;
+    roi_t               rois[ROI_TRACK_MAX];
+    void                *items;             /* (item_size) bytes per ROI. e.g. face_t */
+    int                 since_detect;
+    int                 lost;
+
+    roi_track_stats_t   stats;
+} roi_track_t;
+
+int  roi_track_init    (roi_track_t *trk, int max_rois, int item_size,
+                        float score_thresh, int redetect_interval);
+void roi_track_destroy (roi_track_t *trk);
+
+/* drop all the tracked ROIs. the next frame runs the detector. */
+void roi_track_reset   (roi_track_t *trk);
+
+/* begin a frame. returns 1 if the detector should run in this frame. */
+int  roi_track_need_detect (roi_track_t *trk);
+
+/* copy the tracked items to (items), and returns the number of them. */
+int  roi_track_get     (roi_track_t *trk, void *items);
+
+/* ROIs with (scores) below the threshold are dropped, and the ROIs which
+ * overlap with the higher score one are merged. */
+void roi_track_update  (roi_track_t *trk, const roi_t *rois, const float *scores,
+                        const void *items, int num);
+
+/* the ratio of the frames without the detector. */
+float roi_track_skip_ratio (const roi_track_t *trk);
+
+
+/*
+ *  next ROI from the landmarks. (lmk) is [num][stride] floats, and (x, y)
+ *  of each landmark is normalized to [0, 1] of the current ROI (cur).
+ */
+void roi_from_landmarks (roi_t *roi, const roi_t *cur, const float *lmk, int num, int stride,
+                         const roi_param_t *param);
+
+/* landmark in the ROI --> the frame coordinate */
+void roi_project_point (const roi_t *roi, float x, float y, float *dst_x, float *dst_y);
+
+/*
+ *      0--------1
+ *      |        |
+ *      |        |
+ *      3--------2
+ */
+void roi_get_quad (const roi_t *roi, float quad[4][2]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_ROI_TRACK_H_ */
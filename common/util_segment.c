@@ -0,0 +1,346 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "util_segment.h"
+#include "util_bandpool.h"
+#include "util_debug.h"
+
+#if defined (__ARM_NEON__) || defined (__aarch64__)
+#include <arm_neon.h>
+#define SEGMENT_USE_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define SEGMENT_USE_SSE2
+#endif
+
+/* don't wake up the workers for tiny outputs. */
+#define SEGMENT_MIN_PIXELS_PER_THREAD   4096
+
+typedef struct _segment_job_t
+{
+    const segment_map_t *map;
+    int                 num_class;
+    unsigned char       *class_map;
+    float               *conf;
+    const uint32_t      *palette;
+    int                 num_palette;
+    uint32_t            *rgba;
+    int                 num_bands;
+} segment_job_t;
+
+static bandpool_t       s_pool = BANDPOOL_INITIALIZER;
+
+
+/* -------------------------------------------------- *
+ *  max over the channels of one pixel
+ * -------------------------------------------------- */
+static inline float
+max_fp32 (const float *p, int n)
+{
+    float vmax = p[0];
+    int i = 0;
+
+#if defined (SEGMENT_USE_NEON)
+    if (n >= 8)
+    {
+        float32x4_t vm = vld1q_f32 (p);
+        for (i = 4; i + 4 <= n; i += 4)
+            vm = vmaxq_f32 (vm, vld1q_f32 (p + i));
+#if defined (__aarch64__)
+        vmax = vmaxvq_f32 (vm);
+#else
+        float32x2_t vm2 = vpmax_f32 (vget_low_f32 (vm), vget_high_f32 (vm));
+        vm2  = vpmax_f32 (vm2, vm2);
+        vmax = vget_lane_f32 (vm2, 0);
+#endif
+    }
+#elif defined (SEGMENT_USE_SSE2)
+    if (n >= 8)
+    {
+        __m128 vm = _mm_loadu_ps (p);
+        for (i = 4; i + 4 <= n; i += 4)
+            vm = _mm_max_ps (vm, _mm_loadu_ps (p + i));
+        vm = _mm_max_ps (vm, _mm_shuffle_ps (vm, vm, _MM_SHUFFLE (1, 0, 3, 2)));
+        vm = _mm_max_ps (vm, _mm_shuffle_ps (vm, vm, _MM_SHUFFLE (2, 3, 0, 1)));
+        vmax = _mm_cvtss_f32 (vm);
+    }
+#endif
+
+    for (; i < n; i ++)
+    {
+        if (p[i] > vmax)
+            vmax = p[i];
+    }
+    return vmax;
+}
+
+/* int8 is compared as uint8 after flipping the sign bit. */
+static inline int
+max_u8 (const uint8_t *p, int n, int is_signed)
+{
+    int bias = is_signed ? 0x80 : 0;
+    int vmax = p[0] ^ bias;
+    int i = 0;
+
+#if defined (SEGMENT_USE_NEON)
+    if (n >= 16)
+    {
+        uint8x16_t vb = vdupq_n_u8 (bias);
+        uint8x16_t vm = veorq_u8 (vld1q_u8 (p), vb);
+        for (i = 16; i + 16 <= n; i += 16)
+            vm = vmaxq_u8 (vm, veorq_u8 (vld1q_u8 (p + i), vb));
+#if defined (__aarch64__)
+        vmax = vmaxvq_u8 (vm);
+#else
+        uint8x8_t vm8 = vpmax_u8 (vget_low_u8 (vm), vget_high_u8 (vm));
+        vm8  = vpmax_u8 (vm8, vm8);
+        vm8  = vpmax_u8 (vm8, vm8);
+        vm8  = vpmax_u8 (vm8, vm8);
+        vmax = vget_lane_u8 (vm8, 0);
+#endif
+    }
+#elif defined (SEGMENT_USE_SSE2)
+    if (n >= 16)
+    {
+        __m128i vb = _mm_set1_epi8 ((char)bias);
+        __m128i vm = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *)p), vb);
+        for (i = 16; i + 16 <= n; i += 16)
+            vm = _mm_max_epu8 (vm, _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *)(p + i)), vb));
+        vm = _mm_max_epu8 (vm, _mm_srli_si128 (vm, 8));
+        vm = _mm_max_epu8 (vm, _mm_srli_si128 (vm, 4));
+        vm = _mm_max_epu8 (vm, _mm_srli_si128 (vm, 2));
+        vm = _mm_max_epu8 (vm, _mm_srli_si128 (vm, 1));
+        vmax = _mm_cvtsi128_si32 (vm) & 0xff;
+    }
+#endif
+
+    for (; i < n; i ++)
+    {
+        int v = p[i] ^ bias;
+        if (v > vmax)
+            vmax = v;
+    }
+    return vmax;
+}
+
+
+/* -------------------------------------------------- *
+ *  one band of rows
+ * -------------------------------------------------- */
+static inline void
+store_pixel (const segment_job_t *job, int idx, int cls, float conf)
+{
+    if (job->class_map)
+        job->class_map[idx] = cls;
+    if (job->conf)
+        job->conf[idx] = conf;
+    if (job->rgba)
+        job->rgba[idx] = (cls < job->num_palette) ? job->palette[cls] : job->palette[0];
+}
+
+static void
+argmax_row_fp32 (const segment_job_t *job, int y)
+{
+    const segment_map_t *map = job->map;
+    const float *p = (const float *)map->buf + (size_t)y * map->w * map->c;
+    int n = job->num_class;
+    int x, c;
+
+    for (x = 0; x < map->w; x ++, p += map->c)
+    {
+        float vmax = max_fp32 (p, n);
+        float conf = 0.0f;
+        int   cls  = 0;
+
+        /* the first one wins a tie, like the scalar loop did. */
+        for (c = 0; c < n; c ++)
+        {
+            if (p[c] == vmax)
+            {
+                cls = c;
+                break;
+            }
+        }
+
+        if (job->conf)
+        {
+            float sum = 0.0f;
+            for (c = 0; c < n; c ++)
+                sum += expf (p[c] - vmax);
+            conf = 1.0f / sum;
+        }
+
+        store_pixel (job, y * map->w + x, cls, conf);
+    }
+}
+
+static void
+argmax_row_q8 (const segment_job_t *job, int y)
+{
+    const segment_map_t *map = job->map;
+    const uint8_t *p = (const uint8_t *)map->buf + (size_t)y * map->w * map->c;
+    int is_signed = (map->type == SEGMENT_TYPE_INT8);
+    int bias = is_signed ? 0x80 : 0;
+    int n = job->num_class;
+    int x, c;
+
+    for (x = 0; x < map->w; x ++, p += map->c)
+    {
+        int   vmax = max_u8 (p, n, is_signed);
+        float conf = 0.0f;
+        int   cls  = 0;
+
+        for (c = 0; c < n; c ++)
+        {
+            if ((p[c] ^ bias) == vmax)
+            {
+                cls = c;
+                break;
+            }
+        }
+
+        /* (q - zerop) * scale - (qmax - zerop) * scale = (q - qmax) * scale */
+        if (job->conf)
+        {
+            float sum = 0.0f;
+            for (c = 0; c < n; c ++)
+                sum += expf ((float)((p[c] ^ bias) - vmax) * map->quant_scale);
+            conf = 1.0f / sum;
+        }
+
+        store_pixel (job, y * map->w + x, cls, conf);
+    }
+}
+
+static void
+label_row_s64 (const segment_job_t *job, int y)
+{
+    const segment_map_t *map = job->map;
+    const int64_t *p = (const int64_t *)map->buf + (size_t)y * map->w;
+    int x;
+
+    for (x = 0; x < map->w; x ++)
+    {
+        int64_t cls = p[x];
+        if (cls < 0 || cls >= job->num_class)
+            cls = 0;
+
+        store_pixel (job, y * map->w + x, (int)cls, 1.0f);
+    }
+}
+
+static void
+segment_run_band (void *arg, int band)
+{
+    segment_job_t *job = (segment_job_t *)arg;
+    int h  = job->map->h;
+    int y0 = h * band       / job->num_bands;
+    int y1 = h * (band + 1) / job->num_bands;
+    int y;
+
+    for (y = y0; y < y1; y ++)
+    {
+        switch (job->map->type)
+        {
+        case SEGMENT_TYPE_UINT8:
+        case SEGMENT_TYPE_INT8:
+            argmax_row_q8 (job, y);
+            break;
+        case SEGMENT_TYPE_LABEL_S64:
+            label_row_s64 (job, y);
+            break;
+        default:
+            argmax_row_fp32 (job, y);
+            break;
+        }
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  worker threads
+ *
+ *  the rows are split into (num_bands) bands.
+ *  band 0 is processed by the calling thread.
+ * -------------------------------------------------- */
+int
+segment_init (int num_threads)
+{
+    if (num_threads > SEGMENT_MAX_THREADS)
+        num_threads = SEGMENT_MAX_THREADS;
+
+    return bandpool_init (&s_pool, num_threads);
+}
+
+void
+segment_terminate ()
+{
+    bandpool_terminate (&s_pool);
+}
+
+static void
+segment_run_job (segment_job_t *job)
+{
+    job->num_bands = bandpool_split (&s_pool, job->map->w * job->map->h, SEGMENT_MIN_PIXELS_PER_THREAD);
+    bandpool_run (&s_pool, segment_run_band, job, job->num_bands);
+}
+
+
+/* -------------------------------------------------- *
+ *  API
+ * -------------------------------------------------- */
+int
+segment_argmax (const segment_map_t *map, int num_class,
+                unsigned char *class_map, float *conf,
+                const uint32_t *palette, int num_palette, uint32_t *rgba)
+{
+    segment_job_t job;
+
+    if (map->buf == NULL || num_class <= 0 || num_class > 256)
+    {
+        DBG_LOGE ("ERR: %s(%d): num_class=%d\n", __FILE__, __LINE__, num_class);
+        return -1;
+    }
+
+    if (map->type != SEGMENT_TYPE_LABEL_S64 && num_class > map->c)
+    {
+        DBG_LOGE ("ERR: %s(%d): num_class=%d > channels=%d\n", __FILE__, __LINE__, num_class, map->c);
+        return -1;
+    }
+
+    if (rgba && (palette == NULL || num_palette <= 0))
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    job.map         = map;
+    job.num_class   = num_class;
+    job.class_map   = class_map;
+    job.conf        = conf;
+    job.palette     = palette;
+    job.num_palette = num_palette;
+    job.rgba        = rgba;
+    job.num_bands   = 1;
+
+    segment_run_job (&job);
+
+    return 0;
+}
+
+void
+segment_palette_from_fp32 (uint32_t *palette, const float *col)
+{
+    unsigned char r = ((int)(col[0] * 255)) & 0xff;
+    unsigned char g = ((int)(col[1] * 255)) & 0xff;
+    unsigned char b = ((int)(col[2] * 255)) & 0xff;
+    unsigned char a = ((int)(col[3] * 255)) & 0xff;
+
+    *palette = SEGMENT_RGBA (r, g, b, a);
+}
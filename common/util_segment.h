@@ -0,0 +1,69 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_SEGMENT_H_
+#define _UTIL_SEGMENT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  post-process of the segmentation outputs.
+ *
+ *  takes the per-pixel argmax over the class logits (HWC layout) and
+ *  colorizes the class map with a palette in one pass. the rows are
+ *  split among the worker threads.
+ *
+ *  quantized logits are compared as they are. the argmax doesn't change
+ *  with dequantization, so only the confidence needs (quant_scale).
+ */
+#define SEGMENT_TYPE_FP32       0
+#define SEGMENT_TYPE_UINT8      1
+#define SEGMENT_TYPE_INT8       2
+#define SEGMENT_TYPE_LABEL_S64  3       /* class index per pixel (argmax is done in the model) */
+
+#define SEGMENT_MAX_THREADS     8
+
+/* palette entry. the same byte order as GL_RGBA/GL_UNSIGNED_BYTE */
+#define SEGMENT_RGBA(r, g, b, a) \
+    ((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+
+typedef struct _segment_map_t
+{
+    const void  *buf;
+    int         type;           /* SEGMENT_TYPE_xxx */
+    int         w, h;
+    int         c;              /* channels per pixel (1 for SEGMENT_TYPE_LABEL_S64) */
+    float       quant_scale;    /* for SEGMENT_TYPE_UINT8, SEGMENT_TYPE_INT8 */
+    int         quant_zerop;
+} segment_map_t;
+
+/* start the worker threads. (num_threads = 0: number of online CPUs)
+ * without this, everything runs on the calling thread. */
+int  segment_init (int num_threads);
+void segment_terminate ();
+
+/*
+ *  argmax over the first (num_class) channels of each pixel.
+ *  any of the outputs can be NULL.
+ *
+ *    class_map: [h][w] class index
+ *    conf     : [h][w] softmax probability of the winner class
+ *    rgba     : [h][w] palette[class]. the classes out of the palette are palette[0].
+ */
+int  segment_argmax (const segment_map_t *map, int num_class,
+                     unsigned char *class_map, float *conf,
+                     const uint32_t *palette, int num_palette, uint32_t *rgba);
+
+/* palette from float RGBA [0, 1] colors. e.g. get_deeplab_class_color() */
+void segment_palette_from_fp32 (uint32_t *palette, const float *col);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_SEGMENT_H_ */
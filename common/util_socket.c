@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -15,11 +16,17 @@
 #define TMP_SAMPLE_SOCK   "/tmp/sample_sock"
 
 int
-create_server_socket ()
+open_unix_server_socket (const char *path)
 {
     struct sockaddr_un un;
     int s, ret;
 
+    if (strlen (path) >= sizeof (un.sun_path))
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
     s = socket (PF_UNIX, SOCK_STREAM, 0);
     if (s < 0)
     {
@@ -27,16 +34,17 @@ create_server_socket ()
         return -1;
     }
 
-    unlink (TMP_SAMPLE_SOCK);
+    unlink (path);
 
     memset (&un, 0, sizeof (un));
     un.sun_family = AF_UNIX;
-    strcpy (un.sun_path, TMP_SAMPLE_SOCK);
-    
+    strcpy (un.sun_path, path);
+
     ret = bind (s, (struct sockaddr *)&un, sizeof (un));
     if (ret < 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        close (s);
         return -1;
     }
 
@@ -45,6 +53,12 @@ create_server_socket ()
     return s;
 }
 
+int
+create_server_socket ()
+{
+    return open_unix_server_socket (TMP_SAMPLE_SOCK);
+}
+
 int
 connect_to_server ()
 {
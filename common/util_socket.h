@@ -1,6 +1,7 @@
 #ifndef _UTIL_SOCKET_H_
 #define _UTIL_SOCKET_H_
 
+int open_unix_server_socket (const char *path);
 int create_server_socket ();
 int send_fd_to_server (int stream_fd);
 int receive_fd_from_client (int socket);
@@ -0,0 +1,410 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "util_taskgraph.h"
+#include "util_debug.h"
+
+
+/* -------------------------------------------------- *
+ *  deque
+ *
+ *  every node is pushed once in a run, so the slots are not reused
+ *  until the next run resets the indices.
+ * -------------------------------------------------- */
+static void
+deque_push (taskdeque_t *dq, int node)
+{
+    pthread_mutex_lock (&dq->mutex);
+    dq->items[dq->tail ++] = node;
+    pthread_mutex_unlock (&dq->mutex);
+}
+
+/* the owner takes the newest one, which is likely to be hot in the cache. */
+static int
+deque_pop (taskdeque_t *dq)
+{
+    int node = -1;
+
+    pthread_mutex_lock (&dq->mutex);
+    if (dq->tail > dq->head)
+        node = dq->items[-- dq->tail];
+    pthread_mutex_unlock (&dq->mutex);
+
+    return node;
+}
+
+/* the thieves take the oldest one. */
+static int
+deque_steal (taskdeque_t *dq)
+{
+    int node = -1;
+
+    pthread_mutex_lock (&dq->mutex);
+    if (dq->tail > dq->head)
+        node = dq->items[dq->head ++];
+    pthread_mutex_unlock (&dq->mutex);
+
+    return node;
+}
+
+
+/* -------------------------------------------------- *
+ *  worker
+ * -------------------------------------------------- */
+static void
+push_ready (taskpool_t *pool, int worker, int node)
+{
+    deque_push (&pool->deques[worker], node);
+
+    pthread_mutex_lock (&pool->mutex);
+    __atomic_add_fetch (&pool->num_queued, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal (&pool->cond);
+    pthread_mutex_unlock (&pool->mutex);
+}
+
+static int
+find_task (taskpool_t *pool, int worker)
+{
+    int node, i;
+
+    node = deque_pop (&pool->deques[worker]);
+
+    for (i = 1; node < 0 && i < pool->num_workers; i ++)
+        node = deque_steal (&pool->deques[(worker + i) % pool->num_workers]);
+
+    if (node >= 0)
+        __atomic_sub_fetch (&pool->num_queued, 1, __ATOMIC_RELAXED);
+
+    return node;
+}
+
+static void
+run_node (taskpool_t *pool, taskgraph_t *graph, int worker, int node_id)
+{
+    taskgraph_node_t *node = &graph->nodes[node_id];
+    int i;
+
+    node->func (node->arg);
+
+    for (i = 0; i < node->num_succs; i ++)
+    {
+        int succ = node->succs[i];
+        if (__atomic_sub_fetch (&graph->nodes[succ].pending, 1, __ATOMIC_ACQ_REL) == 0)
+            push_ready (pool, worker, succ);
+    }
+
+    if (__atomic_sub_fetch (&graph->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        /* wake up the caller of taskgraph_run() */
+        pthread_mutex_lock (&pool->mutex);
+        pthread_cond_broadcast (&pool->cond);
+        pthread_mutex_unlock (&pool->mutex);
+    }
+}
+
+static void *
+worker_thread_main (void *arg)
+{
+    taskdeque_t *dq   = (taskdeque_t *)arg;
+    taskpool_t  *pool = dq->pool;
+
+    while (1)
+    {
+        int node;
+
+        pthread_mutex_lock (&pool->mutex);
+        while (pool->running && __atomic_load_n (&pool->num_queued, __ATOMIC_RELAXED) <= 0)
+            pthread_cond_wait (&pool->cond, &pool->mutex);
+
+        if (!pool->running)
+        {
+            pthread_mutex_unlock (&pool->mutex);
+            break;
+        }
+        pthread_mutex_unlock (&pool->mutex);
+
+        /* (pool->graph) is set before the first push of the run. */
+        while ((node = find_task (pool, dq->id)) >= 0)
+            run_node (pool, __atomic_load_n (&pool->graph, __ATOMIC_ACQUIRE), dq->id, node);
+    }
+
+    return NULL;
+}
+
+
+/* -------------------------------------------------- *
+ *  pool
+ * -------------------------------------------------- */
+int
+taskpool_init (taskpool_t *pool, int num_workers)
+{
+    int i;
+
+    memset (pool, 0, sizeof (*pool));
+
+    if (num_workers <= 0)
+        num_workers = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 0)
+        num_workers = 1;
+    if (num_workers > TASKPOOL_MAX_WORKERS)
+        num_workers = TASKPOOL_MAX_WORKERS;
+
+    pthread_mutex_init (&pool->mutex, NULL);
+    pthread_cond_init  (&pool->cond,  NULL);
+    pthread_mutex_init (&pool->run_mutex, NULL);
+    pool->num_workers = num_workers;
+    pool->running     = 1;
+
+    for (i = 0; i < num_workers; i ++)
+    {
+        pool->deques[i].pool = pool;
+        pool->deques[i].id   = i;
+        pthread_mutex_init (&pool->deques[i].mutex, NULL);
+    }
+
+    /* worker[0] is the caller of taskgraph_run() */
+    for (i = 1; i < num_workers; i ++)
+    {
+        if (pthread_create (&pool->threads[i], NULL, worker_thread_main, &pool->deques[i]) != 0)
+        {
+            DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+            pool->num_workers = i;
+            taskpool_destroy (pool);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+taskpool_destroy (taskpool_t *pool)
+{
+    int i;
+
+    pthread_mutex_lock (&pool->mutex);
+    pool->running = 0;
+    pthread_cond_broadcast (&pool->cond);
+    pthread_mutex_unlock (&pool->mutex);
+
+    for (i = 1; i < pool->num_workers; i ++)
+        pthread_join (pool->threads[i], NULL);
+
+    for (i = 0; i < pool->num_workers; i ++)
+        pthread_mutex_destroy (&pool->deques[i].mutex);
+
+    pthread_mutex_destroy (&pool->mutex);
+    pthread_cond_destroy  (&pool->cond);
+    pthread_mutex_destroy (&pool->run_mutex);
+    pool->num_workers = 0;
+}
+
+int
+taskpool_get_cpus_per_worker (taskpool_t *pool)
+{
+    int num_cpus = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    int cpus = num_cpus / pool->num_workers;
+
+    return (cpus > 0) ? cpus : 1;
+}
+
+
+/* -------------------------------------------------- *
+ *  graph
+ * -------------------------------------------------- */
+int
+taskgraph_init (taskgraph_t *graph, taskpool_t *pool)
+{
+    memset (graph, 0, sizeof (*graph));
+    graph->pool = pool;
+
+    return 0;
+}
+
+void
+taskgraph_destroy (taskgraph_t *graph)
+{
+    graph->num_nodes = 0;
+}
+
+void
+taskgraph_reset (taskgraph_t *graph)
+{
+    graph->num_nodes = 0;
+}
+
+int
+taskgraph_add_node (taskgraph_t *graph, taskgraph_func_t func, void *arg)
+{
+    taskgraph_node_t *node;
+    int id = graph->num_nodes;
+
+    if (id >= TASKGRAPH_MAX_NODES)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    node = &graph->nodes[id];
+    node->func      = func;
+    node->arg       = arg;
+    node->num_deps  = 0;
+    node->num_succs = 0;
+
+    graph->num_nodes ++;
+    return id;
+}
+
+int
+taskgraph_add_edge (taskgraph_t *graph, int from, int to)
+{
+    taskgraph_node_t *node;
+
+    /* the edges go forward only, so that the graph never has a cycle. */
+    if (from < 0 || to <= from || to >= graph->num_nodes)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    node = &graph->nodes[from];
+    if (node->num_succs >= TASKGRAPH_MAX_SUCCS)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    node->succs[node->num_succs ++] = to;
+    graph->nodes[to].num_deps ++;
+
+    return 0;
+}
+
+int
+taskgraph_run (taskgraph_t *graph)
+{
+    taskpool_t *pool = graph->pool;
+    int i, node;
+
+    if (graph->num_nodes == 0)
+        return 0;
+
+    pthread_mutex_lock (&pool->run_mutex);
+
+    /* the last run has drained all the deques. */
+    for (i = 0; i < pool->num_workers; i ++)
+    {
+        taskdeque_t *dq = &pool->deques[i];
+        pthread_mutex_lock (&dq->mutex);
+        dq->head = 0;
+        dq->tail = 0;
+        pthread_mutex_unlock (&dq->mutex);
+    }
+    __atomic_store_n (&pool->graph, graph, __ATOMIC_RELEASE);
+
+    for (i = 0; i < graph->num_nodes; i ++)
+        graph->nodes[i].pending = graph->nodes[i].num_deps;
+    __atomic_store_n (&graph->remaining, graph->num_nodes, __ATOMIC_RELEASE);
+
+    for (i = 0; i < graph->num_nodes; i ++)
+    {
+        if (graph->nodes[i].num_deps == 0)
+            push_ready (pool, 0, i);
+    }
+
+    while (1)
+    {
+        while ((node = find_task (pool, 0)) >= 0)
+            run_node (pool, graph, 0, node);
+
+        pthread_mutex_lock (&pool->mutex);
+        while (__atomic_load_n (&graph->remaining, __ATOMIC_ACQUIRE) > 0 &&
+               __atomic_load_n (&pool->num_queued, __ATOMIC_RELAXED) <= 0)
+        {
+            pthread_cond_wait (&pool->cond, &pool->mutex);
+        }
+        pthread_mutex_unlock (&pool->mutex);
+
+        if (__atomic_load_n (&graph->remaining, __ATOMIC_ACQUIRE) == 0)
+            break;
+    }
+
+    pthread_mutex_unlock (&pool->run_mutex);
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  instance pool
+ * -------------------------------------------------- */
+int
+instpool_init (instpool_t *pool)
+{
+    memset (pool, 0, sizeof (*pool));
+    pthread_mutex_init (&pool->mutex, NULL);
+    pthread_cond_init  (&pool->cond,  NULL);
+
+    return 0;
+}
+
+void
+instpool_destroy (instpool_t *pool)
+{
+    pthread_mutex_destroy (&pool->mutex);
+    pthread_cond_destroy  (&pool->cond);
+    pool->num_items = 0;
+    pool->num_free  = 0;
+}
+
+int
+instpool_add (instpool_t *pool, void *item)
+{
+    int ret = 0;
+
+    pthread_mutex_lock (&pool->mutex);
+    if (pool->num_items < INSTPOOL_MAX_ITEMS)
+    {
+        pool->items[pool->num_items ++]     = item;
+        pool->free_items[pool->num_free ++] = item;
+        pthread_cond_signal (&pool->cond);
+    }
+    else
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        ret = -1;
+    }
+    pthread_mutex_unlock (&pool->mutex);
+
+    return ret;
+}
+
+void *
+instpool_acquire (instpool_t *pool)
+{
+    void *item = NULL;
+
+    pthread_mutex_lock (&pool->mutex);
+    while (pool->num_free == 0 && pool->num_items > 0)
+        pthread_cond_wait (&pool->cond, &pool->mutex);
+
+    if (pool->num_free > 0)
+        item = pool->free_items[-- pool->num_free];
+    pthread_mutex_unlock (&pool->mutex);
+
+    return item;
+}
+
+void
+instpool_release (instpool_t *pool, void *item)
+{
+    pthread_mutex_lock (&pool->mutex);
+    pool->free_items[pool->num_free ++] = item;
+    pthread_cond_signal (&pool->cond);
+    pthread_mutex_unlock (&pool->mutex);
+}
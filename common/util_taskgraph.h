@@ -0,0 +1,138 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_TASKGRAPH_H_
+#define _UTIL_TASKGRAPH_H_
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  intra-frame task graph.
+ *
+ *  the independent inferences of a cascade (several faces, two eyes of a face)
+ *  are added as the nodes of a DAG, and dispatched to a pool of workers:
+ *
+ *      face_detect --> facemesh[0] --> iris[0][L]
+ *                  |               +-> iris[0][R]
+ *                  +-> facemesh[1] --> iris[1][L]
+ *                                  +-> iris[1][R]
+ *
+ *      taskgraph_reset (&graph);
+ *      mesh = taskgraph_add_node (&graph, run_facemesh, &task[i]);
+ *      iris = taskgraph_add_node (&graph, run_iris,     &task[i].eye[0]);
+ *      taskgraph_add_edge (&graph, mesh, iris);
+ *      taskgraph_run (&graph);
+ *
+ *  a ready node is pushed to the deque of the worker which released it, and
+ *  the idle workers steal from the others. the caller of taskgraph_run()
+ *  works as the worker[0] until all the nodes are done.
+ *
+ *  the nodes must not touch the GL context: they run on the worker threads.
+ */
+#define TASKPOOL_MAX_WORKERS    16
+#define TASKGRAPH_MAX_NODES     64
+#define TASKGRAPH_MAX_SUCCS     8
+
+typedef void (*taskgraph_func_t) (void *arg);
+
+typedef struct _taskdeque_t
+{
+    struct _taskpool_t  *pool;
+    int                 id;                             /* worker id */
+    pthread_mutex_t     mutex;
+    int                 items[TASKGRAPH_MAX_NODES];     /* node ids */
+    int                 head;                           /* stolen from here */
+    int                 tail;                           /* pushed/popped by the owner */
+} taskdeque_t;
+
+typedef struct _taskpool_t
+{
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    pthread_mutex_t     run_mutex;                      /* one graph at a time */
+    int                 num_workers;                    /* including the caller of taskgraph_run() */
+    int                 running;
+    int                 num_queued;                     /* ready nodes in the deques */
+    struct _taskgraph_t *graph;                         /* the graph being run */
+    pthread_t           threads[TASKPOOL_MAX_WORKERS];
+    taskdeque_t         deques[TASKPOOL_MAX_WORKERS];
+} taskpool_t;
+
+typedef struct _taskgraph_node_t
+{
+    taskgraph_func_t    func;
+    void                *arg;
+    int                 num_deps;
+    int                 pending;                        /* deps not done yet in this run */
+    int                 num_succs;
+    int                 succs[TASKGRAPH_MAX_SUCCS];
+} taskgraph_node_t;
+
+typedef struct _taskgraph_t
+{
+    taskpool_t          *pool;
+    int                 num_nodes;
+    int                 remaining;                      /* nodes not done yet in this run */
+    taskgraph_node_t    nodes[TASKGRAPH_MAX_NODES];
+} taskgraph_t;
+
+
+/* (num_workers) <= 0: the number of CPUs. */
+int   taskpool_init    (taskpool_t *pool, int num_workers);
+void  taskpool_destroy (taskpool_t *pool);
+
+/*
+ *  the CPUs for each worker. use it as the thread count of the interpreters
+ *  invoked in the nodes, so that the workers don't oversubscribe the cores.
+ */
+int   taskpool_get_cpus_per_worker (taskpool_t *pool);
+
+int   taskgraph_init    (taskgraph_t *graph, taskpool_t *pool);
+void  taskgraph_destroy (taskgraph_t *graph);
+void  taskgraph_reset   (taskgraph_t *graph);
+
+/* returns the node id, or -1 when the graph is full. */
+int   taskgraph_add_node (taskgraph_t *graph, taskgraph_func_t func, void *arg);
+
+/* (to) starts after (from) is done. (to) must be added after (from). */
+int   taskgraph_add_edge (taskgraph_t *graph, int from, int to);
+
+/* runs all the nodes and waits for them. */
+int   taskgraph_run (taskgraph_t *graph);
+
+
+/*
+ *  instance pool.
+ *
+ *  a set of interchangeable instances of a model (e.g. interpreters), so that
+ *  the nodes invoking the same model run in parallel, each on its own instance.
+ *  instpool_acquire() blocks while all the instances are in use.
+ */
+#define INSTPOOL_MAX_ITEMS      TASKPOOL_MAX_WORKERS
+
+typedef struct _instpool_t
+{
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    int                 num_items;
+    int                 num_free;
+    void                *items[INSTPOOL_MAX_ITEMS];
+    void                *free_items[INSTPOOL_MAX_ITEMS];
+} instpool_t;
+
+int   instpool_init    (instpool_t *pool);
+void  instpool_destroy (instpool_t *pool);
+int   instpool_add     (instpool_t *pool, void *item);
+void *instpool_acquire (instpool_t *pool);
+void  instpool_release (instpool_t *pool, void *item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_TASKGRAPH_H_ */
@@ -0,0 +1,587 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "util_telemetry.h"
+#include "util_socket.h"
+#include "util_debug.h"
+
+#define TELEM_EXPORT_MAX_CLIENTS    8
+#define TELEM_EXPORT_BUF_SIZE       (TELEM_MAX_METRICS * 256)
+
+/*
+ *  the samples are accumulated in integers of 1/1000 unit
+ *  ([us] for the timers), so that a sample is recorded by atomic adds.
+ */
+typedef struct _telem_metric_t
+{
+    char        name[TELEM_NAME_LEN];
+    int         type;
+    uint64_t    count;
+    uint64_t    sum;
+    uint64_t    max;
+    uint64_t    last;
+    uint32_t    hist[TELEM_HIST_NUM];
+} telem_metric_t;
+
+static telem_metric_t   s_metrics[TELEM_MAX_METRICS];
+static int              s_metric_num;
+static pthread_mutex_t  s_metric_mutex = PTHREAD_MUTEX_INITIALIZER;
+static double           s_window_t0;
+
+
+double
+telem_get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + (double)tv.tv_nsec / 1000000.0);
+}
+
+
+/* -------------------------------------------------- *
+ *  log-scale histogram
+ *
+ *    [0, 8)          : 1 bucket per value
+ *    [2^e, 2^(e+1))  : 8 buckets of 2^(e-3) width
+ * -------------------------------------------------- */
+static inline int
+hist_bucket (uint64_t v)
+{
+    int e, b;
+
+    if (v < 8)
+        return (int)v;
+
+    e = 63 - __builtin_clzll (v);
+    b = (e - 2) * 8 + (int)((v >> (e - 3)) & 7);
+
+    return (b < TELEM_HIST_NUM) ? b : TELEM_HIST_NUM - 1;
+}
+
+/* the center of the bucket */
+static double
+hist_value (int b)
+{
+    int e, sub;
+
+    if (b < 8)
+        return (double)b;
+
+    e   = b / 8 + 2;
+    sub = b % 8;
+    return (double)((uint64_t)(8 + sub) << (e - 3)) + (double)((uint64_t)1 << (e - 3)) * 0.5;
+}
+
+static double
+hist_percentile (const uint32_t *hist, uint64_t count, double p, double max)
+{
+    uint64_t rank = (uint64_t)(p * count + 0.5);
+    uint64_t acc = 0;
+    int b;
+
+    if (rank < 1)
+        rank = 1;
+
+    for (b = 0; b < TELEM_HIST_NUM; b ++)
+    {
+        acc += hist[b];
+        if (acc >= rank)
+        {
+            double v = hist_value (b);
+            return (v < max) ? v : max;
+        }
+    }
+    return max;
+}
+
+
+/* -------------------------------------------------- *
+ *  registry
+ * -------------------------------------------------- */
+#if !defined (TELEMETRY_DISABLE)
+static pthread_once_t   s_env_once = PTHREAD_ONCE_INIT;
+static void start_export_from_env ();
+#endif
+
+int
+telem_register (const char *name, int type)
+{
+#if defined (TELEMETRY_DISABLE)
+    (void)name;
+    (void)type;
+    return -1;
+#else
+    int i, id = -1;
+
+    pthread_once (&s_env_once, start_export_from_env);
+
+    pthread_mutex_lock (&s_metric_mutex);
+
+    for (i = 0; i < s_metric_num; i ++)
+    {
+        if (strncmp (s_metrics[i].name, name, TELEM_NAME_LEN - 1) == 0)
+        {
+            id = i;
+            break;
+        }
+    }
+
+    if (id < 0 && s_metric_num < TELEM_MAX_METRICS)
+    {
+        id = s_metric_num;
+        memset (&s_metrics[id], 0, sizeof (telem_metric_t));
+        snprintf (s_metrics[id].name, TELEM_NAME_LEN, "%s", name);
+        s_metrics[id].type = type;
+
+        if (s_metric_num == 0)
+            s_window_t0 = telem_get_time_ms ();
+
+        /* publish after the entry is filled. see telem_snapshot() */
+        __atomic_store_n (&s_metric_num, s_metric_num + 1, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock (&s_metric_mutex);
+
+    if (id < 0)
+        DBG_LOGE ("ERR: %s(%d): too many metrics (%s)\n", __FILE__, __LINE__, name);
+
+    return id;
+#endif
+}
+
+/*
+ *  the id is cached in (*cache) by the caller. TELEM_ID_UNREGISTERED (-1)
+ *  means not registered yet. a failed registration is cached as
+ *  TELEM_ID_FAILED, so that a full table doesn't take the lock every time.
+ */
+int
+telem_get_id (int *cache, const char *name, int type)
+{
+    int id = __atomic_load_n (cache, __ATOMIC_RELAXED);
+
+    if (id == TELEM_ID_UNREGISTERED)
+    {
+        id = telem_register (name, type);
+        if (id < 0)
+            id = TELEM_ID_FAILED;
+        __atomic_store_n (cache, id, __ATOMIC_RELAXED);
+    }
+    return (id < 0) ? -1 : id;
+}
+
+
+/* -------------------------------------------------- *
+ *  record
+ * -------------------------------------------------- */
+void
+telem_record (int id, double val)
+{
+    telem_metric_t *m;
+    uint64_t v, cur;
+
+    if (id < 0 || id >= TELEM_MAX_METRICS)
+        return;
+
+    m = &s_metrics[id];
+    v = (val > 0.0) ? (uint64_t)(val * 1000.0 + 0.5) : 0;
+
+    __atomic_fetch_add (&m->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&m->sum,   v, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&m->hist[hist_bucket (v)], 1, __ATOMIC_RELAXED);
+    __atomic_store_n   (&m->last,  v, __ATOMIC_RELAXED);
+
+    cur = __atomic_load_n (&m->max, __ATOMIC_RELAXED);
+    while (v > cur)
+    {
+        if (__atomic_compare_exchange_n (&m->max, &cur, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            break;
+    }
+}
+
+void
+telem_count (int id, int64_t n)
+{
+    if (id < 0 || id >= TELEM_MAX_METRICS)
+        return;
+
+    __atomic_fetch_add (&s_metrics[id].count, (uint64_t)n, __ATOMIC_RELAXED);
+}
+
+double
+telem_scope_end (int id, double t0)
+{
+    double ms = telem_get_time_ms () - t0;
+
+    telem_record (id, ms);
+    return ms;
+}
+
+
+/* -------------------------------------------------- *
+ *  snapshot
+ * -------------------------------------------------- */
+static inline uint64_t
+load_u64 (uint64_t *p, int reset)
+{
+    if (reset)
+        return __atomic_exchange_n (p, 0, __ATOMIC_RELAXED);
+    return __atomic_load_n (p, __ATOMIC_RELAXED);
+}
+
+/*
+ *  the fields are read one by one while the others keep recording,
+ *  so a sample recorded during the snapshot may be split across two windows.
+ */
+int
+telem_snapshot (telem_stat_t *stats, int max_num, int reset)
+{
+    uint32_t hist[TELEM_HIST_NUM];
+    int num = __atomic_load_n (&s_metric_num, __ATOMIC_ACQUIRE);
+    double now = telem_get_time_ms ();
+    double sec;
+    int i, b;
+
+    pthread_mutex_lock (&s_metric_mutex);
+    sec = (now - s_window_t0) / 1000.0;
+    if (reset)
+        s_window_t0 = now;
+    pthread_mutex_unlock (&s_metric_mutex);
+
+    if (num > max_num)
+        num = max_num;
+
+    for (i = 0; i < num; i ++)
+    {
+        telem_metric_t *m = &s_metrics[i];
+        telem_stat_t   *s = &stats[i];
+
+        memset (s, 0, sizeof (telem_stat_t));
+        memcpy (s->name, m->name, TELEM_NAME_LEN);
+        s->type  = m->type;
+        s->count = load_u64 (&m->count, reset);
+        s->rate  = (sec > 0.0) ? (double)s->count / sec : 0.0;
+
+        if (m->type == TELEM_COUNTER)
+            continue;
+
+        s->sum  = load_u64 (&m->sum,  reset) / 1000.0;
+        s->max  = load_u64 (&m->max,  reset) / 1000.0;
+        s->last = __atomic_load_n (&m->last, __ATOMIC_RELAXED) / 1000.0;
+
+        for (b = 0; b < TELEM_HIST_NUM; b ++)
+        {
+            if (reset)
+                hist[b] = __atomic_exchange_n (&m->hist[b], 0, __ATOMIC_RELAXED);
+            else
+                hist[b] = __atomic_load_n (&m->hist[b], __ATOMIC_RELAXED);
+        }
+
+        if (s->count > 0)
+        {
+            double max_raw = s->max * 1000.0;
+
+            s->mean = s->sum / s->count;
+            s->p50  = hist_percentile (hist, s->count, 0.50, max_raw) / 1000.0;
+            s->p95  = hist_percentile (hist, s->count, 0.95, max_raw) / 1000.0;
+            s->p99  = hist_percentile (hist, s->count, 0.99, max_raw) / 1000.0;
+        }
+    }
+
+    return num;
+}
+
+
+/* -------------------------------------------------- *
+ *  exporter
+ * -------------------------------------------------- */
+typedef struct _telem_export_t
+{
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             running;
+    int             period_ms;
+
+    FILE            *fp;                                    /* file output   */
+    int             listen_fd;                              /* socket output */
+    int             clients[TELEM_EXPORT_MAX_CLIENTS];
+
+    char            *buf;
+    telem_stat_t    stats[TELEM_MAX_METRICS];
+} telem_export_t;
+
+static telem_export_t   s_export;
+static int              s_export_started;
+
+static const char *
+type_str (int type)
+{
+    switch (type)
+    {
+    case TELEM_TIMER:   return "timer";
+    case TELEM_COUNTER: return "counter";
+    default:            return "value";
+    }
+}
+
+static int
+format_snapshot (telem_export_t *ex, int num, char *buf, int size)
+{
+    int len, i;
+
+    len = snprintf (buf, size, "{\"time_ms\":%.1f,\"metrics\":[", telem_get_time_ms ());
+
+    for (i = 0; i < num && len < size; i ++)
+    {
+        telem_stat_t *s = &ex->stats[i];
+
+        len += snprintf (buf + len, size - len,
+            "%s{\"name\":\"%s\",\"type\":\"%s\",\"count\":%llu,\"rate\":%.2f",
+            (i > 0) ? "," : "", s->name, type_str (s->type),
+            (unsigned long long)s->count, s->rate);
+
+        if (len < size && s->type != TELEM_COUNTER)
+        {
+            len += snprintf (buf + len, size - len,
+                ",\"mean\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"last\":%.3f",
+                s->mean, s->p50, s->p95, s->p99, s->max, s->last);
+        }
+
+        if (len < size)
+            len += snprintf (buf + len, size - len, "}");
+    }
+
+    if (len < size)
+        len += snprintf (buf + len, size - len, "]}\n");
+
+    /* truncated */
+    if (len >= size)
+        return -1;
+
+    return len;
+}
+
+static void
+accept_clients (telem_export_t *ex)
+{
+    int fd, i;
+
+    while ((fd = accept (ex->listen_fd, NULL, NULL)) >= 0)
+    {
+        for (i = 0; i < TELEM_EXPORT_MAX_CLIENTS; i ++)
+        {
+            if (ex->clients[i] < 0)
+            {
+                ex->clients[i] = fd;
+                break;
+            }
+        }
+
+        if (i == TELEM_EXPORT_MAX_CLIENTS)
+            close (fd);
+    }
+}
+
+/* a client which doesn't keep up (or has gone) is dropped. */
+static void
+send_to_clients (telem_export_t *ex, const char *buf, int len)
+{
+    int i;
+
+    for (i = 0; i < TELEM_EXPORT_MAX_CLIENTS; i ++)
+    {
+        if (ex->clients[i] < 0)
+            continue;
+
+        if (send (ex->clients[i], buf, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len)
+        {
+            close (ex->clients[i]);
+            ex->clients[i] = -1;
+        }
+    }
+}
+
+static void *
+export_thread_main (void *arg)
+{
+    telem_export_t *ex = (telem_export_t *)arg;
+
+    pthread_mutex_lock (&ex->mutex);
+    while (ex->running)
+    {
+        struct timespec ts;
+        int num, len;
+
+        clock_gettime (CLOCK_REALTIME, &ts);
+        ts.tv_sec  += ex->period_ms / 1000;
+        ts.tv_nsec += (long)(ex->period_ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000)
+        {
+            ts.tv_sec  += 1;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        while (ex->running)
+        {
+            if (pthread_cond_timedwait (&ex->cond, &ex->mutex, &ts) == ETIMEDOUT)
+                break;
+        }
+        if (!ex->running)
+            break;
+        pthread_mutex_unlock (&ex->mutex);
+
+        num = telem_snapshot (ex->stats, TELEM_MAX_METRICS, 1);
+        len = format_snapshot (ex, num, ex->buf, TELEM_EXPORT_BUF_SIZE);
+
+        if (len > 0 && ex->fp)
+        {
+            fwrite (ex->buf, 1, len, ex->fp);
+            fflush (ex->fp);
+        }
+
+        if (ex->listen_fd >= 0)
+        {
+            accept_clients (ex);
+            if (len > 0)
+                send_to_clients (ex, ex->buf, len);
+        }
+
+        pthread_mutex_lock (&ex->mutex);
+    }
+    pthread_mutex_unlock (&ex->mutex);
+
+    return NULL;
+}
+
+static void
+close_outputs (telem_export_t *ex)
+{
+    int i;
+
+    if (ex->fp)
+        fclose (ex->fp);
+    ex->fp = NULL;
+
+    for (i = 0; i < TELEM_EXPORT_MAX_CLIENTS; i ++)
+    {
+        if (ex->clients[i] >= 0)
+            close (ex->clients[i]);
+        ex->clients[i] = -1;
+    }
+
+    if (ex->listen_fd >= 0)
+        close (ex->listen_fd);
+    ex->listen_fd = -1;
+
+    if (ex->buf)
+        free (ex->buf);
+    ex->buf = NULL;
+}
+
+int
+telem_start_export (const char *path, int period_ms)
+{
+    telem_export_t *ex = &s_export;
+    int i;
+
+    if (s_export_started)
+        telem_stop_export ();
+
+    memset (ex, 0, sizeof (*ex));
+    ex->listen_fd = -1;
+    for (i = 0; i < TELEM_EXPORT_MAX_CLIENTS; i ++)
+        ex->clients[i] = -1;
+
+    ex->period_ms = (period_ms > 0) ? period_ms : 1000;
+    ex->buf = (char *)malloc (TELEM_EXPORT_BUF_SIZE);
+    if (ex->buf == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (strncmp (path, "unix:", 5) == 0)
+    {
+        ex->listen_fd = open_unix_server_socket (path + 5);
+        if (ex->listen_fd < 0 || fcntl (ex->listen_fd, F_SETFL, O_NONBLOCK) < 0)
+        {
+            DBG_LOGE ("ERR: %s(%d): %s\n", __FILE__, __LINE__, path);
+            close_outputs (ex);
+            return -1;
+        }
+    }
+    else
+    {
+        ex->fp = fopen (path, "a");
+        if (ex->fp == NULL)
+        {
+            DBG_LOGE ("ERR: %s(%d): %s\n", __FILE__, __LINE__, path);
+            close_outputs (ex);
+            return -1;
+        }
+    }
+
+    pthread_mutex_init (&ex->mutex, NULL);
+    pthread_cond_init  (&ex->cond,  NULL);
+    ex->running = 1;
+
+    if (pthread_create (&ex->thread, NULL, export_thread_main, ex) != 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        pthread_mutex_destroy (&ex->mutex);
+        pthread_cond_destroy  (&ex->cond);
+        close_outputs (ex);
+        return -1;
+    }
+
+    s_export_started = 1;
+    return 0;
+}
+
+void
+telem_stop_export ()
+{
+    telem_export_t *ex = &s_export;
+
+    if (!s_export_started)
+        return;
+
+    pthread_mutex_lock (&ex->mutex);
+    ex->running = 0;
+    pthread_cond_broadcast (&ex->cond);
+    pthread_mutex_unlock (&ex->mutex);
+
+    pthread_join (ex->thread, NULL);
+
+    pthread_mutex_destroy (&ex->mutex);
+    pthread_cond_destroy  (&ex->cond);
+    close_outputs (ex);
+
+    s_export_started = 0;
+}
+
+#if !defined (TELEMETRY_DISABLE)
+static void
+start_export_from_env ()
+{
+    char *path = getenv ("TELEMETRY_EXPORT");
+    char *period = getenv ("TELEMETRY_PERIOD_MS");
+
+    /* an exporter started by the app is left as it is. */
+    if (path == NULL || path[0] == '\0' || s_export_started)
+        return;
+
+    if (telem_start_export (path, period ? atoi (period) : 1000) == 0)
+        DBG_LOGI ("@@@@@@ TELEMETRY_EXPORT=%s\n", path);
+}
+#endif
@@ -0,0 +1,125 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_TELEMETRY_H_
+#define _UTIL_TELEMETRY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  named performance metrics.
+ *
+ *      TELEM_SCOPE_BEGIN (palm, "palm_detect");
+ *      invoke_palm_detection (&palm_ret, 0);
+ *      TELEM_SCOPE_END (palm);
+ *
+ *      TELEM_COUNT ("hand_lost", 1);
+ *      TELEM_VALUE ("num_hands", palm_ret.num);
+ *
+ *  a metric is registered by its name on the first use, and the id is
+ *  cached in a static variable at the call site. recording is a few
+ *  relaxed atomic adds, so any thread may record without a lock.
+ *
+ *  timers and values keep a log-scale histogram (8 buckets per power of 2,
+ *  ~6% resolution) to estimate p50/p95/p99.
+ *
+ *  the snapshots are exported periodically as JSON lines:
+ *      TELEMETRY_EXPORT=/tmp/telemetry.jsonl      (append to a file)
+ *      TELEMETRY_EXPORT=unix:/tmp/telemetry.sock  (stream to the connected clients)
+ *      TELEMETRY_PERIOD_MS=1000
+ *  the exporter is started by the first registration if $TELEMETRY_EXPORT is set.
+ *
+ *  build with -DTELEMETRY_DISABLE (ENABLE_TELEMETRY=false) to compile the
+ *  macros out.
+ */
+#define TELEM_MAX_METRICS       64
+#define TELEM_NAME_LEN          32
+#define TELEM_HIST_NUM          240
+
+/* values of the id cache given to telem_get_id() */
+#define TELEM_ID_UNREGISTERED   (-1)
+#define TELEM_ID_FAILED         (-2)
+
+enum telem_type_id {
+    TELEM_TIMER = 0,            /* [ms]      */
+    TELEM_COUNTER,              /* events    */
+    TELEM_VALUE,                /* any value */
+};
+
+typedef struct _telem_stat_t
+{
+    char        name[TELEM_NAME_LEN];
+    int         type;
+    uint64_t    count;          /* number of samples (TELEM_COUNTER: sum of the counts) */
+    double      rate;           /* count per second */
+    double      sum;
+    double      mean;
+    double      max;
+    double      last;
+    double      p50, p95, p99;
+} telem_stat_t;
+
+double telem_get_time_ms ();
+
+/* lookup or add. returns the id, or -1 when the table is full. */
+int    telem_register (const char *name, int type);
+int    telem_get_id   (int *cache, const char *name, int type);
+
+void   telem_record (int id, double val);
+void   telem_count  (int id, int64_t n);
+
+/* returns the elapsed time [ms] since (t0) and records it. */
+double telem_scope_end (int id, double t0);
+
+/*
+ *  statistics since the last reset. (reset) starts a new window.
+ *  the exporter resets the window on every export.
+ */
+int    telem_snapshot (telem_stat_t *stats, int max_num, int reset);
+
+/* (path): a file name, or "unix:<socket path>". */
+int    telem_start_export (const char *path, int period_ms);
+void   telem_stop_export ();
+
+
+#if !defined (TELEMETRY_DISABLE)
+
+#define TELEM_SCOPE_BEGIN(var, name)                                            \
+    static int var##_telem_id = TELEM_ID_UNREGISTERED;                          \
+    int    var##_telem_idx = telem_get_id (&var##_telem_id, name, TELEM_TIMER); \
+    double var##_telem_t0  = telem_get_time_ms ()
+
+#define TELEM_SCOPE_END(var)                                                    \
+    telem_scope_end (var##_telem_idx, var##_telem_t0)
+
+#define TELEM_COUNT(name, n)                                                    \
+    do {                                                                        \
+        static int s_telem_id = TELEM_ID_UNREGISTERED;                          \
+        telem_count (telem_get_id (&s_telem_id, name, TELEM_COUNTER), n);       \
+    } while (0)
+
+#define TELEM_VALUE(name, val)                                                  \
+    do {                                                                        \
+        static int s_telem_id = TELEM_ID_UNREGISTERED;                          \
+        telem_record (telem_get_id (&s_telem_id, name, TELEM_VALUE), val);      \
+    } while (0)
+
+#else
+
+#define TELEM_SCOPE_BEGIN(var, name)    ((void)0)
+#define TELEM_SCOPE_END(var)            ((void)0)
+#define TELEM_COUNT(name, n)            ((void)0)
+#define TELEM_VALUE(name, val)          ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_TELEMETRY_H_ */
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <GLES2/gl2.h>
 #include "util_texture.h"
 #include "assertgl.h"
@@ -75,6 +76,11 @@ create_2d_texture_ex (texture_2d_t *tex2d, void *imgbuf, int width, int height,
         glPixelStorei (GL_UNPACK_ALIGNMENT, 2);
         glw /= 2;
     }
+    else if (fmt == pixfmt_fourcc('Y', '8', '0', '0'))
+    {
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glfmt = GL_LUMINANCE;
+    }
     else
     {
         glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
@@ -89,6 +95,81 @@ create_2d_texture_ex (texture_2d_t *tex2d, void *imgbuf, int width, int height,
     return 0;
 }
 
+/*
+ *  streaming texture for the images updated every frame.
+ *
+ *  the textures are allocated at the first update (or when the size or
+ *  format has changed) and then only rewritten by glTexSubImage2D().
+ *  each update goes to the next texture of the ring, so that the driver
+ *  doesn't have to wait for (or shadow copy) the texture which the GPU
+ *  may still be reading for the previous frame.
+ */
+static int
+is_stream_texture_valid (texture_2d_t *tex2d, int width, int height, uint32_t fmt)
+{
+    if (tex2d->texid == 0)
+        return 0;
+
+    if (tex2d->width != width || tex2d->height != height || tex2d->format != fmt)
+        return 0;
+
+    return 1;
+}
+
+texture_2d_t *
+update_stream_texture (stream_texture_t *stex, void *imgbuf, int width, int height, uint32_t fmt)
+{
+    texture_2d_t *tex2d;
+
+    if (fmt != pixfmt_fourcc ('R', 'G', 'B', 'A') &&
+        fmt != pixfmt_fourcc ('Y', '8', '0', '0'))
+    {
+        fprintf (stderr, "ERR: %s(%d): unsupported format\n", __FILE__, __LINE__);
+        return NULL;
+    }
+
+    stex->cur = (stex->cur + 1) % STREAM_TEXTURE_RING;
+    tex2d = &stex->tex[stex->cur];
+
+    if (!is_stream_texture_valid (tex2d, width, height, fmt))
+    {
+        if (tex2d->texid)
+            glDeleteTextures (1, &tex2d->texid);
+
+        create_2d_texture_ex (tex2d, imgbuf, width, height, fmt);
+        return tex2d;
+    }
+
+    glBindTexture (GL_TEXTURE_2D, tex2d->texid);
+
+    if (fmt == pixfmt_fourcc ('Y', '8', '0', '0'))
+    {
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, width, height, GL_LUMINANCE, GL_UNSIGNED_BYTE, imgbuf);
+    }
+    else
+    {
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, imgbuf);
+    }
+
+    return tex2d;
+}
+
+void
+delete_stream_texture (stream_texture_t *stex)
+{
+    int i;
+
+    for (i = 0; i < STREAM_TEXTURE_RING; i ++)
+    {
+        if (stex->tex[i].texid)
+            glDeleteTextures (1, &stex->tex[i].texid);
+    }
+
+    memset (stex, 0, sizeof (*stex));
+}
+
 
 int
 load_png_texture (char *name, int *lpTexID, int *lpWidth, int *lpHeight)
@@ -116,8 +197,12 @@ load_png_texture (char *name, int *lpTexID, int *lpWidth, int *lpHeight)
     return 0;
 }
 
+/*
+ *  same as load_jpg_texture(), but keeps the decoded RGBA8888 pixels for
+ *  the CPU side processing when (lpImgBuf) is not NULL. release them with free().
+ */
 int
-load_jpg_texture (char *name, int *lpTexID, int *lpWidth, int *lpHeight)
+load_jpg_texture_ex (char *name, int *lpTexID, int *lpWidth, int *lpHeight, void **lpImgBuf)
 {
     int32_t width, height, channel_count;
     uint8_t *imgbuf;
@@ -136,12 +221,21 @@ load_jpg_texture (char *name, int *lpTexID, int *lpWidth, int *lpHeight)
     if (lpTexID)  *lpTexID  = texid;
     if (lpWidth)  *lpWidth  = width;
     if (lpHeight) *lpHeight = height;
-    stbi_image_free (imgbuf);
+    if (lpImgBuf)
+        *lpImgBuf = imgbuf;
+    else
+        stbi_image_free (imgbuf);
 
     GLASSERT();
     return 0;
 }
 
+int
+load_jpg_texture (char *name, int *lpTexID, int *lpWidth, int *lpHeight)
+{
+    return load_jpg_texture_ex (name, lpTexID, lpWidth, lpHeight, NULL);
+}
+
 
 int
 load_png_cube_texture (char *name[], int *lpTexID)
@@ -224,6 +318,10 @@ update_capture_texture (texture_2d_t *captex)
     uint32_t cap_fmt;
     void     *cap_buf;
 
+    /* upload only when a new frame has arrived */
+    if (acquire_capture_frame () == 0)
+        return;
+
     get_capture_dimension (&cap_w, &cap_h);
     get_capture_pixformat (&cap_fmt);
     get_capture_buffer (&cap_buf);
@@ -262,21 +360,39 @@ create_video_texture (texture_2d_t *vidtex, const char *fname)
     get_video_pixformat (&vid_fmt);
 
     create_2d_texture_ex (vidtex, NULL, vid_w, vid_h, vid_fmt);
-    start_video_decode ();
+    if (start_video_decode () < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
 
     return 0;
 }
 
-void
+/*
+ *  offline mode: waits for the next frame.
+ *  returns -1 when all the frames of the file have been uploaded.
+ */
+int
 update_video_texture (texture_2d_t *vidtex)
 {
     int   video_w, video_h;
     uint32_t video_fmt;
-    void *video_buf;
+    void *video_buf = NULL;
+    int   offline = is_video_decode_offline ();
 
     get_video_dimension (&video_w, &video_h);
     get_video_pixformat (&video_fmt);
-    get_video_buffer (&video_buf);
+
+    if (offline)
+    {
+        if (acquire_video_frame (&video_buf, NULL) < 0)
+            return -1;
+    }
+    else
+    {
+        get_video_buffer (&video_buf);
+    }
 
     if (video_buf)
     {
@@ -287,15 +403,27 @@ update_video_texture (texture_2d_t *vidtex)
         {
         case pixfmt_fourcc('Y', 'U', 'Y', 'V'):
         case pixfmt_fourcc('U', 'Y', 'V', 'Y'):
+            glPixelStorei (GL_UNPACK_ALIGNMENT, 2);
             texw = video_w / 2;
             break;
+        case pixfmt_fourcc('Y', '8', '0', '0'):
+            glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+            texfmt = GL_LUMINANCE;
+            break;
         default:
+            glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
             break;
         }
 
         glBindTexture (GL_TEXTURE_2D, vidtex->texid);
         glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, texw, texh, texfmt, GL_UNSIGNED_BYTE, video_buf);
     }
+
+    /* the texture has its own copy. */
+    if (offline)
+        release_video_frame ();
+
+    return 0;
 }
 
 #endif /* USE_INPUT_VIDEO_DECODE */
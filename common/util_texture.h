@@ -18,6 +18,18 @@ typedef struct _texture_2d_t
     uint32_t    format;
 } texture_2d_t;
 
+/*
+ *  ring of textures for the images which are updated every frame
+ *  (e.g. the output of the models). RGBA or Y800 (sampled as GL_LUMINANCE).
+ */
+#define STREAM_TEXTURE_RING     2
+
+typedef struct _stream_texture_t
+{
+    texture_2d_t    tex[STREAM_TEXTURE_RING];
+    int             cur;
+} stream_texture_t;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,11 +37,16 @@ extern "C" {
 
 int load_png_texture (char *name, int *lpTexID, int *width, int *height);
 int load_jpg_texture (char *name, int *lpTexID, int *width, int *height);
+int load_jpg_texture_ex (char *name, int *lpTexID, int *width, int *height, void **imgbuf);
 
 uint32_t create_2d_texture (void *imgbuf, int width, int height);
 
 int create_2d_texture_ex (texture_2d_t *tex2d, void *imgbuf, int w, int h, uint32_t fmt);
 
+/* returns the texture to draw in this frame. NULL on error. */
+texture_2d_t *update_stream_texture (stream_texture_t *stex, void *imgbuf, int w, int h, uint32_t fmt);
+void          delete_stream_texture (stream_texture_t *stex);
+
 #if defined (USE_INPUT_CAMERA_CAPTURE)
 int  create_capture_texture (texture_2d_t *captex);
 void update_capture_texture (texture_2d_t *captex);
@@ -37,7 +54,7 @@ void update_capture_texture (texture_2d_t *captex);
 
 #if defined (USE_INPUT_VIDEO_DECODE)
 int  create_video_texture (texture_2d_t *vidtex, const char *fname);
-void update_video_texture (texture_2d_t *vidtex);
+int  update_video_texture (texture_2d_t *vidtex);
 #endif
 
 #ifdef __cplusplus
@@ -4,7 +4,10 @@
  * ------------------------------------------------ */
 #include "util_tflite.h"
 #include "util_debug.h"
+#include "util_telemetry.h"
 #include <thread>
+#include <time.h>
+#include <string.h>
 
 using namespace tflite;
 
@@ -217,6 +220,9 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
         num_threads = atoi (env_tflite_num_threads);
         DBG_LOGI ("@@@@@@ FORCE_TFLITE_NUM_THREADS(XNNPACK)=%d\n", num_threads);
     }
+    /* the per-session budget (e.g. CPUs / pool workers) wins over the default. */
+    if (opt && opt->num_threads > 0)
+        num_threads = opt->num_threads;
 
     // IMPORTANT: initialize options with TfLiteXNNPackDelegateOptionsDefault() for
     // API-compatibility with future extensions of the TfLiteXNNPackDelegateOptions
@@ -244,6 +250,27 @@ modify_graph_with_delegate (tflite_interpreter_t *p, tflite_createopt_t *opt)
 }
 
 
+/* the Invoke() time is recorded as "invoke.<model file name without the extension>" */
+static int
+register_invoke_timer (const char *model_path)
+{
+    char name[TELEM_NAME_LEN];
+    const char *fname = "model";
+    const char *ext;
+
+    if (model_path)
+    {
+        fname = strrchr (model_path, '/');
+        fname = fname ? fname + 1 : model_path;
+    }
+
+    ext = strrchr (fname, '.');
+    snprintf (name, sizeof (name), "invoke.%.*s", ext ? (int)(ext - fname) : (int)strlen (fname), fname);
+
+    return telem_register (name, TELEM_TIMER);
+}
+
+
 int
 tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_path)
 {
@@ -289,6 +316,8 @@ tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_
     tflite_print_tensor_info (p->interpreter);
 #endif
 
+    p->telem_id = register_invoke_timer (model_path);
+
     return 0;
 }
 
@@ -316,6 +345,8 @@ tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *mod
         num_threads = atoi (env_tflite_num_threads);
         DBG_LOGI ("@@@@@@ FORCE_TFLITE_NUM_THREADS=%d\n", num_threads);
     }
+    if (opt && opt->num_threads > 0)
+        num_threads = opt->num_threads;
     DBG_LOG ("@@@@@@ TFLITE_NUM_THREADS=%d\n", num_threads);
     p->interpreter->SetNumThreads(num_threads);
 
@@ -343,6 +374,8 @@ tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *mod
     tflite_print_tensor_info (p->interpreter);
 #endif
 
+    p->telem_id = register_invoke_timer (model_path);
+
     return 0;
 }
 
@@ -392,6 +425,8 @@ tflite_create_interpreter (tflite_interpreter_t *p, const char *model_buf, size_
     tflite_print_tensor_info (p->interpreter);
 #endif
 
+    p->telem_id = register_invoke_timer (NULL);
+
     return 0;
 }
 
@@ -419,6 +454,8 @@ tflite_create_interpreter_ex (tflite_interpreter_t *p, const char *model_buf, si
         num_threads = atoi (env_tflite_num_threads);
         DBG_LOGI ("@@@@@@ FORCE_TFLITE_NUM_THREADS=%d\n", num_threads);
     }
+    if (opt && opt->num_threads > 0)
+        num_threads = opt->num_threads;
     DBG_LOG ("@@@@@@ TFLITE_NUM_THREADS=%d\n", num_threads);
     p->interpreter->SetNumThreads(num_threads);
 
@@ -446,6 +483,8 @@ tflite_create_interpreter_ex (tflite_interpreter_t *p, const char *model_buf, si
     tflite_print_tensor_info (p->interpreter);
 #endif
 
+    p->telem_id = register_invoke_timer (NULL);
+
     return 0;
 }
 
@@ -489,6 +528,10 @@ tflite_get_tensor_by_name (tflite_interpreter_t *p, int io, const char *name, tf
         ptr = (io == 0) ? interpreter->typed_input_tensor <uint8_t>(io_idx) :
                           interpreter->typed_output_tensor<uint8_t>(io_idx);
         break;
+    case kTfLiteInt8:
+        ptr = (io == 0) ? interpreter->typed_input_tensor <int8_t>(io_idx) :
+                          interpreter->typed_output_tensor<int8_t>(io_idx);
+        break;
     case kTfLiteFloat32:
         ptr = (io == 0) ? interpreter->typed_input_tensor <float>(io_idx) :
                           interpreter->typed_output_tensor<float>(io_idx);
@@ -518,3 +561,150 @@ tflite_get_tensor_by_name (tflite_interpreter_t *p, int io, const char *name, tf
     return 0;
 }
 
+
+void
+tflite_destroy_interpreter (tflite_interpreter_t *p)
+{
+    /* the interpreter refers to the model. */
+    p->interpreter.reset ();
+    p->model.reset ();
+}
+
+
+/* -------------------------------------------------- *
+ *  Session
+ * -------------------------------------------------- */
+int
+tflite_session_create (tflite_session_t *s, const char *model_path,
+                       const tflite_tensor_desc_t *descs, int num_descs, tflite_createopt_t *opt)
+{
+    if (num_descs > TFLITE_SESSION_MAX_TENSORS)
+    {
+        DBG_LOGE ("ERR: %s(%d): too many tensors (%d)\n", __FILE__, __LINE__, num_descs);
+        return -1;
+    }
+
+    if (tflite_create_interpreter_ex_from_file (&s->interpreter, model_path, opt) < 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (int i = 0; i < num_descs; i ++)
+    {
+        if (tflite_get_tensor_by_name (&s->interpreter, descs[i].io, descs[i].name, &s->tensors[i]) < 0)
+        {
+            tflite_destroy_interpreter (&s->interpreter);
+            return -1;
+        }
+    }
+    s->descs       = descs;
+    s->num_tensors = num_descs;
+    s->batch       = s->interpreter.interpreter->tensor (s->interpreter.interpreter->inputs()[0])->dims->data[0];
+
+    return 0;
+}
+
+void
+tflite_session_destroy (tflite_session_t *s)
+{
+    tflite_destroy_interpreter (&s->interpreter);
+    s->num_tensors = 0;
+}
+
+int
+tflite_session_invoke (tflite_session_t *s)
+{
+    return tflite_invoke (&s->interpreter);
+}
+
+/*
+ *  resize dims[0] of all the input tensors to (batch), so that multiple
+ *  ROIs are processed by one Invoke(). the tensor buffers are reallocated,
+ *  so the input/output pointers must be fetched again after this call.
+ */
+int
+tflite_session_set_batch (tflite_session_t *s, int batch)
+{
+    std::unique_ptr<Interpreter> &interpreter = s->interpreter.interpreter;
+
+    if (batch == s->batch)
+        return 0;
+
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* the GPU delegates are built for a fixed batch size. */
+    return -1;
+#endif
+
+    for (int i = 0; i < (int)interpreter->inputs().size(); i ++)
+    {
+        int tensor_idx = interpreter->inputs()[i];
+        TfLiteIntArray *dim = interpreter->tensor(tensor_idx)->dims;
+        std::vector<int> sizes (dim->data, dim->data + dim->size);
+
+        sizes[0] = batch;
+        if (interpreter->ResizeInputTensor (tensor_idx, sizes) != kTfLiteOk)
+        {
+            DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+    }
+
+    if (interpreter->AllocateTensors() != kTfLiteOk)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (int i = 0; i < s->num_tensors; i ++)
+    {
+        if (tflite_get_tensor_by_name (&s->interpreter, s->descs[i].io, s->descs[i].name, &s->tensors[i]) < 0)
+            return -1;
+    }
+    s->batch = batch;
+
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  Invoke
+ * -------------------------------------------------- */
+
+/* duration of the last Invoke() issued from the calling thread. */
+static thread_local double s_last_invoke_ms;
+
+static double
+tflite_get_time_ms ()
+{
+    struct timespec tv;
+    clock_gettime (CLOCK_MONOTONIC, &tv);
+    return (tv.tv_sec * 1000.0 + (double)tv.tv_nsec / 1000000.0);
+}
+
+int
+tflite_invoke (tflite_interpreter_t *p)
+{
+    double t0 = tflite_get_time_ms ();
+    TfLiteStatus ret = p->interpreter->Invoke();
+    s_last_invoke_ms = tflite_get_time_ms () - t0;
+    telem_record (p->telem_id, s_last_invoke_ms);
+
+    if (ret != kTfLiteOk)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ *  the post-processing time of invoke_xxx() APIs, which decode the output
+ *  tensors right after Invoke(), is (total time - tflite_get_last_invoke_ms()).
+ */
+double
+tflite_get_last_invoke_ms (void)
+{
+    return s_last_invoke_ms;
+}
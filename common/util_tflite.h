@@ -5,6 +5,8 @@
 #ifndef _UTIL_TFLITE_H_
 #define _UTIL_TFLITE_H_
 
+/* the interpreter API is for C++ sources only. */
+#ifdef __cplusplus
 #include "tensorflow/lite/kernels/register.h"
 #include "tensorflow/lite/model.h"
 #include "tensorflow/lite/optional_debug_tools.h"
@@ -34,11 +36,13 @@ typedef struct tflite_interpreter_t
     std::unique_ptr<tflite::FlatBufferModel> model;
     std::unique_ptr<tflite::Interpreter>     interpreter;
     tflite::ops::builtin::BuiltinOpResolver  resolver;
+    int                                      telem_id = -1;  /* Invoke() timer. see util_telemetry.h */
 } tflite_interpreter_t;
 
 typedef struct tflite_createopt_t
 {
     int gpubuffer;
+    int num_threads;        /* 0: number of CPUs (or $FORCE_TFLITE_NUM_THREADS) */
 } tflite_createopt_t;
 
 typedef struct tflite_tensor_t
@@ -54,6 +58,31 @@ typedef struct tflite_tensor_t
 } tflite_tensor_t;
 
 
+/*
+ *  inference session: an interpreter and the tensors resolved by name.
+ *
+ *  sessions don't share any state, so that multiple sessions of the same
+ *  model can be invoked in parallel on different threads.
+ *  custom ops must be added to (interpreter.resolver) before tflite_session_create().
+ */
+#define TFLITE_SESSION_MAX_TENSORS  8
+
+typedef struct tflite_tensor_desc_t
+{
+    int         io;         /* [0] input_tensor, [1] output_tensor */
+    const char  *name;
+} tflite_tensor_desc_t;
+
+typedef struct tflite_session_t
+{
+    tflite_interpreter_t        interpreter;
+    const tflite_tensor_desc_t  *descs;
+    int                         num_tensors;
+    tflite_tensor_t             tensors[TFLITE_SESSION_MAX_TENSORS];    /* in the order of (descs) */
+    int                         batch;                                  /* dims[0] of the inputs */
+} tflite_session_t;
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -64,7 +93,27 @@ int tflite_get_tensor_by_name (tflite_interpreter_t *p, int io, const char *name
 int tflite_create_interpreter_from_file (tflite_interpreter_t *p, const char *model_path);
 int tflite_create_interpreter_ex_from_file (tflite_interpreter_t *p, const char *model_path, tflite_createopt_t *opt);
 
+int tflite_invoke (tflite_interpreter_t *p);
+void tflite_destroy_interpreter (tflite_interpreter_t *p);
+
+int  tflite_session_create  (tflite_session_t *s, const char *model_path,
+                             const tflite_tensor_desc_t *descs, int num_descs, tflite_createopt_t *opt);
+void tflite_session_destroy (tflite_session_t *s);
+int  tflite_session_invoke  (tflite_session_t *s);
+int  tflite_session_set_batch (tflite_session_t *s, int batch);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+
+/* C interface */
+#ifdef __cplusplus
+extern "C" {
+#endif
 
+double tflite_get_last_invoke_ms (void);
 
 #ifdef __cplusplus
 }
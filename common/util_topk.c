@@ -0,0 +1,272 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "util_topk.h"
+
+#if defined (__ARM_NEON__) || defined (__aarch64__)
+#include <arm_neon.h>
+#define TOPK_USE_NEON
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define TOPK_USE_SSE2
+#endif
+
+
+/* -------------------------------------------------- *
+ *  heap
+ * -------------------------------------------------- */
+/* (a) comes before (b) */
+static inline int
+item_precedes (const topk_item_t *a, const topk_item_t *b)
+{
+    if (a->score != b->score) return a->score > b->score;
+    return a->idx < b->idx;
+}
+
+/* the root of the heap is the lowest one. */
+static void
+sift_down (topk_item_t *heap, int num, int i)
+{
+    topk_item_t item = heap[i];
+
+    while (1)
+    {
+        int child = 2 * i + 1;
+        if (child >= num)
+            break;
+
+        if (child + 1 < num && item_precedes (&heap[child], &heap[child + 1]))
+            child ++;
+
+        if (!item_precedes (&item, &heap[child]))
+            break;
+
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+/*
+ *  the items are pushed in the ascending order of the index, so a new item
+ *  which ties with the lowest one never replaces it.
+ */
+static int
+push_item (topk_item_t *heap, int num, int k, int idx, float score)
+{
+    topk_item_t item;
+    int i;
+
+    item.idx   = idx;
+    item.score = score;
+
+    if (num == k)
+    {
+        if (score > heap[0].score)
+        {
+            heap[0] = item;
+            sift_down (heap, num, 0);
+        }
+        return num;
+    }
+
+    /* sift up */
+    for (i = num; i > 0; )
+    {
+        int parent = (i - 1) / 2;
+        if (!item_precedes (&heap[parent], &item))
+            break;
+
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = item;
+
+    return num + 1;
+}
+
+/* heap sort. the lowest one goes to the tail first. */
+static void
+sort_items (topk_item_t *heap, int num)
+{
+    int i;
+
+    for (i = num - 1; i > 0; i --)
+    {
+        topk_item_t tmp = heap[0];
+        heap[0] = heap[i];
+        heap[i] = tmp;
+        sift_down (heap, i, 0);
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  skip the values which are not greater than (thresh).
+ *  returns the index of the block which may have a greater one.
+ * -------------------------------------------------- */
+static int
+skip_float (const float *val, int i, int num, float thresh)
+{
+#if defined (TOPK_USE_NEON)
+    float32x4_t vthresh = vdupq_n_f32 (thresh);
+    for (; i + 4 <= num; i += 4)
+    {
+        uint32x4_t mask = vcgtq_f32 (vld1q_f32 (&val[i]), vthresh);
+        uint32x2_t mor  = vorr_u32 (vget_low_u32 (mask), vget_high_u32 (mask));
+        if (vget_lane_u32 (vpmax_u32 (mor, mor), 0))
+            break;
+    }
+#elif defined (TOPK_USE_SSE2)
+    __m128 vthresh = _mm_set1_ps (thresh);
+    for (; i + 4 <= num; i += 4)
+    {
+        if (_mm_movemask_ps (_mm_cmpgt_ps (_mm_loadu_ps (&val[i]), vthresh)))
+            break;
+    }
+#endif
+    (void)thresh;
+    return i;
+}
+
+static int
+skip_uint8 (const unsigned char *val, int i, int num, int thresh)
+{
+#if defined (TOPK_USE_NEON)
+    uint8x16_t vthresh = vdupq_n_u8 (thresh);
+    for (; i + 16 <= num; i += 16)
+    {
+        uint8x16_t mask = vcgtq_u8 (vld1q_u8 (&val[i]), vthresh);
+        uint8x8_t  mor  = vorr_u8 (vget_low_u8 (mask), vget_high_u8 (mask));
+        if (vget_lane_u64 (vreinterpret_u64_u8 (mor), 0))
+            break;
+    }
+#elif defined (TOPK_USE_SSE2)
+    __m128i vthresh = _mm_set1_epi8 ((char)thresh);
+    __m128i vzero   = _mm_setzero_si128 ();
+    for (; i + 16 <= num; i += 16)
+    {
+        /* (val - thresh) saturates to 0 unless (val > thresh) */
+        __m128i diff = _mm_subs_epu8 (_mm_loadu_si128 ((const __m128i *)&val[i]), vthresh);
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (diff, vzero)) != 0xFFFF)
+            break;
+    }
+#endif
+    (void)thresh;
+    return i;
+}
+
+static int
+skip_int8 (const signed char *val, int i, int num, int thresh)
+{
+#if defined (TOPK_USE_NEON)
+    int8x16_t vthresh = vdupq_n_s8 (thresh);
+    for (; i + 16 <= num; i += 16)
+    {
+        uint8x16_t mask = vcgtq_s8 (vld1q_s8 (&val[i]), vthresh);
+        uint8x8_t  mor  = vorr_u8 (vget_low_u8 (mask), vget_high_u8 (mask));
+        if (vget_lane_u64 (vreinterpret_u64_u8 (mor), 0))
+            break;
+    }
+#elif defined (TOPK_USE_SSE2)
+    __m128i vthresh = _mm_set1_epi8 ((char)thresh);
+    for (; i + 16 <= num; i += 16)
+    {
+        __m128i mask = _mm_cmpgt_epi8 (_mm_loadu_si128 ((const __m128i *)&val[i]), vthresh);
+        if (_mm_movemask_epi8 (mask))
+            break;
+    }
+#endif
+    (void)thresh;
+    return i;
+}
+
+
+/* -------------------------------------------------- *
+ *  top-K
+ * -------------------------------------------------- */
+int
+topk_select_float (const float *val, int num, int k, topk_item_t *items)
+{
+    int cnt = 0;
+    int i;
+
+    if (k <= 0)
+        return 0;
+
+    for (i = 0; i < num; i ++)
+    {
+        if (cnt == k)
+        {
+            i = skip_float (val, i, num, items[0].score);
+            if (i >= num)
+                break;
+        }
+        cnt = push_item (items, cnt, k, i, val[i]);
+    }
+
+    sort_items (items, cnt);
+    return cnt;
+}
+
+int
+topk_select_uint8 (const unsigned char *val, int num, float quant_scale, int quant_zerop,
+                   int k, topk_item_t *items)
+{
+    int cnt = 0;
+    int i;
+
+    if (k <= 0)
+        return 0;
+
+    /* the raw values are kept in (score) until the end */
+    for (i = 0; i < num; i ++)
+    {
+        if (cnt == k)
+        {
+            i = skip_uint8 (val, i, num, (int)items[0].score);
+            if (i >= num)
+                break;
+        }
+        cnt = push_item (items, cnt, k, i, val[i]);
+    }
+
+    sort_items (items, cnt);
+
+    for (i = 0; i < cnt; i ++)
+        items[i].score = ((int)items[i].score - quant_zerop) * quant_scale;
+
+    return cnt;
+}
+
+int
+topk_select_int8 (const signed char *val, int num, float quant_scale, int quant_zerop,
+                  int k, topk_item_t *items)
+{
+    int cnt = 0;
+    int i;
+
+    if (k <= 0)
+        return 0;
+
+    for (i = 0; i < num; i ++)
+    {
+        if (cnt == k)
+        {
+            i = skip_int8 (val, i, num, (int)items[0].score);
+            if (i >= num)
+                break;
+        }
+        cnt = push_item (items, cnt, k, i, val[i]);
+    }
+
+    sort_items (items, cnt);
+
+    for (i = 0; i < cnt; i ++)
+        items[i].score = ((int)items[i].score - quant_zerop) * quant_scale;
+
+    return cnt;
+}
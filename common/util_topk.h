@@ -0,0 +1,44 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_TOPK_H_
+#define _UTIL_TOPK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  top-K selection of classifier outputs.
+ *
+ *  the best (k) are kept in a min-heap of size (k). once the heap is full,
+ *  the values not greater than the lowest one are skipped by SIMD compares,
+ *  so most of the tensor is scanned without touching the heap.
+ *
+ *  the results are in the descending order of the score. the ties are in
+ *  the ascending order of the index (the same as a stable sort).
+ */
+typedef struct _topk_item_t
+{
+    int     idx;
+    float   score;
+} topk_item_t;
+
+/* returns the number of items written to (items), min (k, num). */
+int topk_select_float (const float *val, int num, int k, topk_item_t *items);
+
+/*
+ *  quantized tensors. the values are compared as they are, and only the
+ *  results are dequantized: score = (val - quant_zerop) * quant_scale
+ */
+int topk_select_uint8 (const unsigned char *val, int num, float quant_scale, int quant_zerop,
+                       int k, topk_item_t *items);
+int topk_select_int8  (const signed char *val, int num, float quant_scale, int quant_zerop,
+                       int k, topk_item_t *items);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_TOPK_H_ */
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -23,7 +24,11 @@ get_capture_device_type (int v4l_fd)
     struct v4l2_capability caps = {0};
 
     ret = ioctl (v4l_fd, VIDIOC_QUERYCAP, &caps);
-    DBG_ASSERT (ret == 0, "VIDIOC_QUERYCAP failed: %s\n", ERRSTR);
+    if (ret < 0)
+    {
+        DBG_LOGE ("VIDIOC_QUERYCAP failed: %s\n", ERRSTR);
+        return 0;
+    }
 
     /* if DEVICE_CAPS is enabled, used it */
     if (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
@@ -58,22 +63,62 @@ get_capture_buftype (unsigned int capture_type)
     case V4L2_CAP_VIDEO_CAPTURE_MPLANE: return V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
     case V4L2_CAP_VIDEO_CAPTURE:        return V4L2_BUF_TYPE_VIDEO_CAPTURE;
     default:
-        DBG_ASSERT (0, "unknown capture_type");
         return 0;
     }
 }
 
-static struct v4l2_format
-get_capture_format (capture_dev_t *cap_dev, unsigned int cap_buftype)
+static int
+get_capture_format (capture_dev_t *cap_dev, unsigned int cap_buftype, struct v4l2_format *fmt)
 {
     int ret;
-    struct v4l2_format fmt = {0};
 
-    fmt.type = cap_buftype;
-    ret = ioctl (cap_dev->v4l_fd, VIDIOC_G_FMT, &fmt);
-    DBG_ASSERT (ret == 0, "VIDIOC_G_FMT failed: %s\n", ERRSTR);
+    memset (fmt, 0, sizeof (*fmt));
+    fmt->type = cap_buftype;
+    ret = ioctl (cap_dev->v4l_fd, VIDIOC_G_FMT, fmt);
+    if (ret < 0)
+    {
+        DBG_LOGE ("VIDIOC_G_FMT failed: %s\n", ERRSTR);
+        return -1;
+    }
 
-    return fmt;
+    return 0;
+}
+
+static int
+set_capture_format (capture_dev_t *cap_dev, int width, int height, unsigned int pixfmt)
+{
+    int ret;
+    unsigned int cap_buftype = get_capture_buftype (cap_dev->dev_type);
+    struct v4l2_format fmt;
+
+    if (width == 0 && height == 0 && pixfmt == 0)
+        return 0;
+
+    if (get_capture_format (cap_dev, cap_buftype, &fmt) < 0)
+        return -1;
+
+    if (cap_buftype == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+    {
+        if (width ) fmt.fmt.pix_mp.width       = width;
+        if (height) fmt.fmt.pix_mp.height      = height;
+        if (pixfmt) fmt.fmt.pix_mp.pixelformat = pixfmt;
+    }
+    else
+    {
+        if (width ) fmt.fmt.pix.width       = width;
+        if (height) fmt.fmt.pix.height      = height;
+        if (pixfmt) fmt.fmt.pix.pixelformat = pixfmt;
+        fmt.fmt.pix.bytesperline = 0;   /* let the driver decide */
+    }
+
+    ret = ioctl (cap_dev->v4l_fd, VIDIOC_S_FMT, &fmt);
+    if (ret < 0)
+    {
+        DBG_LOGE ("VIDIOC_S_FMT failed: %s\n", ERRSTR);
+        return -1;
+    }
+
+    return 0;
 }
 
 /* ------------------------------------------------------------------------ *
@@ -126,16 +171,26 @@ alloc_buffer_mmap (capture_dev_t *cap_dev)
         buf.memory = V4L2_MEMORY_MMAP;
 
         ret = ioctl (v4l_fd, VIDIOC_QUERYBUF, &buf);
-        DBG_ASSERT (ret == 0, "VIDIOC_QUERYBUF");
+        if (ret < 0)
+        {
+            DBG_LOGE ("VIDIOC_QUERYBUF failed: %s\n", ERRSTR);
+            return -1;
+        }
 
-        cap_frame->vaddr = mmap (NULL, buf.length, PROT_WRITE|PROT_READ, 
-                                 MAP_SHARED, v4l_fd, buf.m.offset);
+        void *vaddr = mmap (NULL, buf.length, PROT_WRITE|PROT_READ, 
+                            MAP_SHARED, v4l_fd, buf.m.offset);
+        if (vaddr == MAP_FAILED)
+        {
+            DBG_LOGE ("mmap failed: %s\n", ERRSTR);
+            return -1;
+        }
+
+        cap_frame->vaddr  = vaddr;
+        cap_frame->length = buf.length;
         
         cap_frame->v4l_buf.index  = i;
         cap_frame->v4l_buf.type   = buffer_type;
         cap_frame->v4l_buf.memory = V4L2_MEMORY_MMAP;
-
-        DBG_ASSERT (cap_frame->vaddr != MAP_FAILED, "mmap");
     }
     return 0;
 }
@@ -148,16 +203,18 @@ alloc_buffer (capture_dev_t *cap_dev)
 
     capture_frame_t *cap_frame;
     cap_frame = (capture_frame_t *)calloc (buf_count, sizeof (capture_frame_t));
-    DBG_ASSERT (cap_frame, "alloc failed");
+    if (cap_frame == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
 
     cap_stream->frames = cap_frame;
 
     if (cap_stream->memtype == V4L2_MEMORY_DMABUF)
-        alloc_buffer_drm (cap_dev);
+        return alloc_buffer_drm (cap_dev);
     else
-        alloc_buffer_mmap (cap_dev);
-
-    return 0;
+        return alloc_buffer_mmap (cap_dev);
 }
 
 static int
@@ -168,7 +225,11 @@ init_capture_stream (capture_dev_t *cap_dev, unsigned int buf_memtype, int buf_c
     capture_stream_t *cap_stream = &(cap_dev->stream);
 
     capture_buftype = get_capture_buftype (cap_dev->dev_type);
-    DBG_ASSERT (capture_buftype, "not a capture device.\n");
+    if (capture_buftype == 0)
+    {
+        DBG_LOGE ("%s: not a capture device.\n", cap_dev->dev_name);
+        return -1;
+    }
 
     struct v4l2_requestbuffers rqbufs = {0};
     rqbufs.type   = capture_buftype;
@@ -176,13 +237,25 @@ init_capture_stream (capture_dev_t *cap_dev, unsigned int buf_memtype, int buf_c
     rqbufs.memory = buf_memtype;
 
     ret = ioctl (cap_dev->v4l_fd, VIDIOC_REQBUFS, &rqbufs);
-    DBG_ASSERT (ret == 0, "VIDIOC_REQBUFS failed: %s\n", ERRSTR);
-    DBG_ASSERT (rqbufs.count >= buf_count, "VIDIOC_REQBUFS failed");
+    if (ret < 0)
+    {
+        DBG_LOGE ("VIDIOC_REQBUFS failed: %s\n", ERRSTR);
+        return -1;
+    }
 
+    /* from here, v4l2_close_capture_device() releases the buffers. */
     cap_stream->memtype  = buf_memtype;
     cap_stream->bufcount = buf_count;
     cap_stream->buftype  = capture_buftype;
-    cap_stream->format   = get_capture_format (cap_dev, capture_buftype);
+
+    if (rqbufs.count < (unsigned int)buf_count)
+    {
+        DBG_LOGE ("VIDIOC_REQBUFS: %d buffers requested, %d allocated.\n", buf_count, rqbufs.count);
+        return -1;
+    }
+
+    if (get_capture_format (cap_dev, capture_buftype, &cap_stream->format) < 0)
+        return -1;
 
     return 0;
 }
@@ -218,8 +291,41 @@ v4l2_get_capture_device ()
     return dev_id;
 }
 
+/* list the capture nodes (/dev/videoN). returns the number of them. */
+int
+v4l2_enum_capture_devices (int *devids, int max_num)
+{
+    int i, v4l_fd;
+    int num = 0;
+    char devname[64];
+
+    for (i = 0; num < max_num; i ++)
+    {
+        snprintf (devname, 64, "/dev/video%d", i);
+        if (access (devname, F_OK) < 0)
+            break;
+
+        v4l_fd = open (devname, O_RDWR | O_CLOEXEC);
+        if (v4l_fd < 0)
+            continue;           /* busy, or no permission */
+
+        if (get_capture_device_type (v4l_fd))
+            devids[num ++] = i;
+        close (v4l_fd);
+    }
+    return num;
+}
+
 capture_dev_t *
 v4l2_open_capture_device (int devid)
+{
+    /* the capture thread may hold 2 buffers (the newest one, and the one
+     * being displayed) without copying. */
+    return v4l2_open_capture_device_ex (devid, 0, 0, 0, 6);
+}
+
+capture_dev_t *
+v4l2_open_capture_device_ex (int devid, int width, int height, unsigned int pixfmt, int bufcount)
 {
     int v4l_fd;
     char devname[64];
@@ -236,24 +342,78 @@ v4l2_open_capture_device (int devid)
 
     snprintf (devname, 64, "/dev/video%d", devid);
     v4l_fd = open (devname, O_RDWR | O_CLOEXEC);
-    DBG_ASSERT (v4l_fd >= 0, "failed to open %s\n", devname);
+    if (v4l_fd < 0)
+    {
+        DBG_LOGE ("failed to open %s: %s\n", devname, ERRSTR);
+        return NULL;
+    }
 
     dev_type = get_capture_device_type (v4l_fd);
-    DBG_ASSERT (dev_type, "not a capture device.\n");
+    if (dev_type == 0)
+    {
+        DBG_LOGE ("%s: not a capture device.\n", devname);
+        close (v4l_fd);
+        return NULL;
+    }
 
     cap_dev = (capture_dev_t *)calloc (1, sizeof (capture_dev_t));
-    DBG_ASSERT (cap_dev, "alloc error.\n");
+    if (cap_dev == NULL)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        close (v4l_fd);
+        return NULL;
+    }
 
     snprintf (cap_dev->dev_name, sizeof (cap_dev->dev_name), "%s", devname);
     cap_dev->v4l_fd   = v4l_fd;
     cap_dev->dev_type = dev_type;
 
-    init_capture_stream (cap_dev, V4L2_MEMORY_MMAP, 4);
-    alloc_buffer (cap_dev);
+    if (set_capture_format (cap_dev, width, height, pixfmt) < 0)
+    {
+        v4l2_close_capture_device (cap_dev);
+        return NULL;
+    }
+
+    if (init_capture_stream (cap_dev, V4L2_MEMORY_MMAP, bufcount) < 0 ||
+        alloc_buffer (cap_dev) < 0)
+    {
+        v4l2_close_capture_device (cap_dev);
+        return NULL;
+    }
 
     return cap_dev;
 }
 
+void
+v4l2_close_capture_device (capture_dev_t *cap_dev)
+{
+    capture_stream_t *cap_stream = &cap_dev->stream;
+
+    if (cap_stream->frames)
+    {
+        for (int i = 0; i < cap_stream->bufcount; i ++)
+        {
+            capture_frame_t *cap_frame = &cap_stream->frames[i];
+            if (cap_stream->memtype == V4L2_MEMORY_MMAP && cap_frame->vaddr)
+                munmap (cap_frame->vaddr, cap_frame->length);
+        }
+        free (cap_stream->frames);
+    }
+
+    /* the buffers requested by init_capture_stream() */
+    if (cap_stream->bufcount > 0)
+    {
+        struct v4l2_requestbuffers rqbufs = {0};
+        rqbufs.type   = cap_stream->buftype;
+        rqbufs.count  = 0;
+        rqbufs.memory = cap_stream->memtype;
+        ioctl (cap_dev->v4l_fd, VIDIOC_REQBUFS, &rqbufs);
+    }
+
+    close (cap_dev->v4l_fd);
+    free (cap_dev);
+}
+
 
 /* ------------------------------------------------------------------------ *
  *  start/stop capture
@@ -265,7 +425,7 @@ v4l2_start_capture (capture_dev_t *cap_dev)
     int v4l_fd = cap_dev->v4l_fd;
     capture_stream_t *cap_stream = &cap_dev->stream;
 
-    for (i = 1; i < cap_stream->bufcount; i ++)
+    for (i = 0; i < cap_stream->bufcount; i ++)
     {
         struct v4l2_buffer buf = {0};
         capture_frame_t *cap_frame = &(cap_stream->frames[i]);
@@ -290,13 +450,38 @@ v4l2_start_capture (capture_dev_t *cap_dev)
         }
         
         ret = ioctl (v4l_fd, VIDIOC_QBUF, &buf);
-        DBG_ASSERT (ret == 0, "VIDIOC_QBUF for buffer %d failed: %s\n", i, ERRSTR);
+        if (ret < 0)
+        {
+            DBG_LOGE ("VIDIOC_QBUF for buffer %d failed: %s\n", i, ERRSTR);
+            return -1;
+        }
     }
 
     int type = cap_stream->buftype;
     ret = ioctl (v4l_fd, VIDIOC_STREAMON, &type);
-    DBG_ASSERT (ret == 0, "STREAMON failed: %s\n", ERRSTR);
+    if (ret < 0)
+    {
+        DBG_LOGE ("STREAMON failed: %s\n", ERRSTR);
+        return -1;
+    }
+
+    cap_stream->dead = 0;
+    return 0;
+}
+
+/* all the buffers, including the ones held by the application, return to the driver. */
+int
+v4l2_stop_capture (capture_dev_t *cap_dev)
+{
+    int ret;
+    int type = cap_dev->stream.buftype;
 
+    ret = ioctl (cap_dev->v4l_fd, VIDIOC_STREAMOFF, &type);
+    if (ret < 0)
+    {
+        DBG_LOGE ("STREAMOFF failed: %s\n", ERRSTR);
+        return -1;
+    }
 
     return 0;
 }
@@ -307,6 +492,13 @@ v4l2_start_capture (capture_dev_t *cap_dev)
  * ------------------------------------------------------------------------ */
 capture_frame_t *
 v4l2_acquire_capture_frame (capture_dev_t *cap_dev)
+{
+    return v4l2_acquire_capture_frame_timeout (cap_dev, -1);
+}
+
+/* returns NULL if no frame arrives in (timeout_ms). (-1: wait forever) */
+capture_frame_t *
+v4l2_acquire_capture_frame_timeout (capture_dev_t *cap_dev, int timeout_ms)
 {
     int ret;
     int v4l_fd = cap_dev->v4l_fd;
@@ -316,8 +508,11 @@ v4l2_acquire_capture_frame (capture_dev_t *cap_dev)
     fds[0].fd     = v4l_fd;
     fds[0].events = POLLIN | POLLERR;
 
+    if (cap_stream->dead)
+        return NULL;
+
     /* Wait & Dequeue buffer */
-    while ((ret = poll (fds, 1, -1)) > 0)
+    while ((ret = poll (fds, 1, timeout_ms)) > 0)
     {
         if (fds[0].revents & POLLIN) 
         {
@@ -325,11 +520,30 @@ v4l2_acquire_capture_frame (capture_dev_t *cap_dev)
             buf.type   = cap_stream->buftype;
             buf.memory = cap_stream->memtype;
             ret = ioctl (v4l_fd, VIDIOC_DQBUF, &buf);
-            DBG_ASSERT (ret == 0, "VIDIOC_DQBUF failed: %s\n", ERRSTR);
+            if (ret < 0)
+            {
+                if (errno == EAGAIN || errno == EINTR)
+                    continue;
+
+                DBG_LOGE ("VIDIOC_DQBUF failed: %s\n", ERRSTR);
+                cap_stream->dead = 1;
+                return NULL;
+            }
 
             capture_frame_t *frame = &(cap_stream->frames[buf.index]);
+            frame->timestamp = buf.timestamp;
+            frame->sequence  = buf.sequence;
+            frame->flags     = buf.flags;
             return frame;
         }
+
+        /* not streaming, or the device is gone */
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            DBG_LOGE ("%s: capture stream stopped\n", cap_dev->dev_name);
+            cap_stream->dead = 1;
+            break;
+        }
     }
 
     return 0;
@@ -343,11 +557,21 @@ v4l2_release_capture_frame (capture_dev_t *cap_dev, capture_frame_t *cap_frame)
 
     struct v4l2_buffer buf = cap_frame->v4l_buf;
     ret = ioctl (v4l_fd, VIDIOC_QBUF, &buf);
-    DBG_ASSERT (ret == 0, "VIDIOC_QBUF failed: %s\n", ERRSTR);
+    if (ret < 0)
+    {
+        DBG_LOGE ("VIDIOC_QBUF failed: %s\n", ERRSTR);
+        return -1;
+    }
 
     return 0;
 }
 
+int
+v4l2_capture_is_dead (capture_dev_t *cap_dev)
+{
+    return cap_dev->stream.dead;
+}
+
 
 
 /* ------------------------------------------------------------------------ *
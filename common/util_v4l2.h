@@ -9,9 +9,14 @@ typedef struct _capture_frame_t
     int     bo_handle;
     int     prime_fd;
     void    *vaddr;
+    unsigned int length;            /* of the mmap buffer */
     
     struct v4l2_buffer v4l_buf;
-    
+
+    /* filled by v4l2_acquire_capture_frame() */
+    struct timeval  timestamp;
+    unsigned int    sequence;
+    unsigned int    flags;
 } capture_frame_t;
 
 typedef struct _capture_stream_t
@@ -21,6 +26,7 @@ typedef struct _capture_stream_t
     int             bufcount;
     capture_frame_t *frames;
     struct v4l2_format format;
+    int             dead;           /* POLLERR or DQBUF failed. no more frames */
 } capture_stream_t;
 
 
@@ -36,11 +42,25 @@ typedef struct _capture_dev_t
 
 
 int              v4l2_get_capture_device ();
+int              v4l2_enum_capture_devices (int *devids, int max_num);
 capture_dev_t   *v4l2_open_capture_device (int devid);
+
+/* (width, height, pixfmt) = 0 keeps the current setting of the device.
+ * the driver may adjust the format. read back the result with
+ * v4l2_get_capture_wh() and v4l2_get_capture_pixelformat(). */
+capture_dev_t   *v4l2_open_capture_device_ex (int devid, int width, int height,
+                                              unsigned int pixfmt, int bufcount);
+void             v4l2_close_capture_device (capture_dev_t *cap_dev);
 int              v4l2_start_capture (capture_dev_t *cap_dev);
+int              v4l2_stop_capture (capture_dev_t *cap_dev);
 capture_frame_t *v4l2_acquire_capture_frame (capture_dev_t *cap_dev);
+capture_frame_t *v4l2_acquire_capture_frame_timeout (capture_dev_t *cap_dev, int timeout_ms);
 int              v4l2_release_capture_frame (capture_dev_t *cap_dev, capture_frame_t *cap_frame);
 
+/* nonzero once the stream stopped delivering frames (e.g. the device is unplugged).
+ * v4l2_acquire_capture_frame() returns NULL immediately until the capture is restarted. */
+int              v4l2_capture_is_dead (capture_dev_t *cap_dev);
+
 
 int v4l2_get_capture_pixelformat (capture_dev_t *cap_dev, unsigned int *pixfmt);
 int v4l2_get_capture_wh (capture_dev_t *cap_dev, int *w, int *h);
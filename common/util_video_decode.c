@@ -2,13 +2,17 @@
  * The MIT License (MIT)
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libavutil/time.h>
 #include <libavformat/avformat.h>
 #include <libswscale/swscale.h>
 #include "util_texture.h"
+#include "util_video_decode.h"
 
 /*
  *	control play speed.
@@ -30,6 +34,27 @@ static int64_t          s_duration_base;
 
 static void             *s_decode_buf = NULL;
 
+/*
+ *  offline mode.
+ *  the decoded frames are queued in the ring of (s_num_bufs) buffers.
+ *
+ *      [head] ... acquired or ready ... [tail] ... free ...
+ */
+static int              s_offline = 0;
+static int              s_out_w, s_out_h;
+static uint32_t         s_out_fmt;
+static int              s_num_bufs;
+static uint8_t          *s_queue_buf[VIDEO_QUEUE_MAX];
+static int64_t          s_queue_pts[VIDEO_QUEUE_MAX];
+static int              s_queue_head;
+static int              s_queue_tail;
+static int              s_queue_used;               /* ready + acquired */
+static int              s_queue_ready;
+static int              s_queue_eof;
+static int              s_num_decoded;
+static pthread_mutex_t  s_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   s_queue_cond  = PTHREAD_COND_INITIALIZER;
+
 int
 init_video_decode ()
 {
@@ -83,6 +108,13 @@ open_video_file (const char *fname)
     }
     avcodec_parameters_to_context (dec_ctx, fmt_ctx->streams[video_stream_index]->codecpar);
 
+    /* offline mode doesn't mind the latency of the frame threading. */
+    if (s_offline)
+    {
+        dec_ctx->thread_count = 0;  /* auto */
+        dec_ctx->thread_type  = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    }
+
     /* init the video decoder */
     ret = avcodec_open2 (dec_ctx, dec, NULL);
     if (ret < 0)
@@ -110,11 +142,20 @@ open_video_file (const char *fname)
     s_crop_h = s_video_h;
 #endif
 
+    /* offline mode without the scaling */
+    if (s_offline && (s_out_w <= 0 || s_out_h <= 0))
+    {
+        s_out_w = s_crop_w;
+        s_out_h = s_crop_h;
+    }
+
     fprintf (stderr, "-------------------------------------------\n");
     fprintf (stderr, " file  : %s\n", fname);
     fprintf (stderr, " format: %s\n", av_get_pix_fmt_name (s_video_fmt));
     fprintf (stderr, " size  : (%d, %d)\n", s_video_w, s_video_h);
     fprintf (stderr, " crop  : (%d, %d)\n", s_crop_w,  s_crop_h);
+    if (s_offline)
+    fprintf (stderr, " output: (%d, %d) offline, %d threads\n", s_out_w, s_out_h, dec_ctx->thread_count);
     fprintf (stderr, "-------------------------------------------\n");
 
     return 0;
@@ -124,6 +165,13 @@ open_video_file (const char *fname)
 int
 get_video_dimension (int *width, int *height)
 {
+    if (s_offline)
+    {
+        *width  = s_out_w;
+        *height = s_out_h;
+        return 0;
+    }
+
     *width  = s_crop_w;
     *height = s_crop_h;
 
@@ -131,8 +179,14 @@ get_video_dimension (int *width, int *height)
 }
 
 int 
-get_video_pixformat (int *pixformat)
+get_video_pixformat (uint32_t *pixformat)
 {
+    if (s_offline)
+    {
+        *pixformat = s_out_fmt;
+        return 0;
+    }
+
     *pixformat = pixfmt_fourcc('R', 'G', 'B', 'A');
     return 0;
 }
@@ -144,75 +198,178 @@ get_video_buffer (void ** buf)
     return 0;
 }
 
-static int 
-save_to_ppm (AVFrame *frame, int width, int height, int icnt)
+static enum AVPixelFormat
+get_av_pixformat (uint32_t pixformat)
 {
-    FILE *fp;
-    char fname[64];
-
-    sprintf (fname, "frame%08d.ppm", icnt);
-    fp = fopen (fname, "wb");
-    if (fp == NULL)
+    switch (pixformat)
     {
-        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-        return -1;
+    case pixfmt_fourcc('R', 'G', 'B', 'A'): return AV_PIX_FMT_RGBA;
+    case pixfmt_fourcc('Y', '8', '0', '0'): return AV_PIX_FMT_GRAY8;
+    case pixfmt_fourcc('Y', 'U', 'Y', 'V'): return AV_PIX_FMT_YUYV422;
+    case pixfmt_fourcc('U', 'Y', 'V', 'Y'): return AV_PIX_FMT_UYVY422;
+    default:
+        return AV_PIX_FMT_NONE;
     }
+}
+
+/*
+ *  the planes of the centered crop region. the origin is aligned to the
+ *  chroma subsampling, so that sws_scale() crops and scales in one pass.
+ */
+static void
+get_crop_planes (AVFrame *frame, const uint8_t *planes[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get (frame->format);
+    int pixsteps[4];
+    int ofstx = (s_video_w - s_crop_w) / 2;
+    int ofsty = (s_video_h - s_crop_h) / 2;
+    int i;
+
+    av_image_fill_max_pixsteps (pixsteps, NULL, desc);
+
+    ofstx &= ~((1 << desc->log2_chroma_w) - 1);
+    ofsty &= ~((1 << desc->log2_chroma_h) - 1);
 
-    fprintf (fp, "P6\n%d %d\n255\n", width, height);
-    for (int y = 0; y < height; y++)
+    for (i = 0; i < 4; i ++)
     {
-        fwrite (frame->data[0] + y * frame->linesize[0], 1, width * 3, fp);
+        int x = ofstx;
+        int y = ofsty;
+
+        planes[i] = NULL;
+        if (frame->data[i] == NULL)
+            continue;
+
+        if (i == 1 || i == 2)
+        {
+            x >>= desc->log2_chroma_w;
+            y >>= desc->log2_chroma_h;
+        }
+        planes[i] = frame->data[i] + y * frame->linesize[i] + x * pixsteps[i];
     }
+}
 
-    fclose (fp);
+static void
+convert_frame (struct SwsContext *sws_ctx, AVFrame *frame, uint8_t *dst_buf,
+               enum AVPixelFormat dst_fmt, int dst_w, int dst_h)
+{
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int dst_linesize[4];
 
-    return 0;
+    get_crop_planes (frame, src);
+    av_image_fill_arrays (dst, dst_linesize, dst_buf, dst_fmt, dst_w, dst_h, 1);
+
+    sws_scale (sws_ctx, src, frame->linesize, 0, s_crop_h, dst, dst_linesize);
 }
 
-static int
-convert_to_rgba8888 (AVFrame *frame, int ofstx, int ofsty, int width, int height)
+
+/* -------------------------------------------------- *
+ *  offline frame queue
+ * -------------------------------------------------- */
+/* waits for a free buffer. the decoder never drops a frame. */
+static uint8_t *
+get_free_buffer ()
 {
-    if (s_decode_buf == NULL)
-    {
-        s_decode_buf = (unsigned char *)malloc (width * height * 4);
-    }
+    uint8_t *buf;
+
+    pthread_mutex_lock (&s_queue_mutex);
+    while (s_queue_used >= s_num_bufs)
+        pthread_cond_wait (&s_queue_cond, &s_queue_mutex);
+    buf = s_queue_buf[s_queue_tail];
+    pthread_mutex_unlock (&s_queue_mutex);
+
+    return buf;
+}
+
+static void
+push_ready_buffer (int64_t pts_us)
+{
+    pthread_mutex_lock (&s_queue_mutex);
+    s_queue_pts[s_queue_tail] = pts_us;
+    s_queue_tail = (s_queue_tail + 1) % s_num_bufs;
+    s_queue_used  ++;
+    s_queue_ready ++;
+    s_num_decoded ++;
+    pthread_cond_broadcast (&s_queue_cond);
+    pthread_mutex_unlock (&s_queue_mutex);
+}
+
+static void
+signal_eof ()
+{
+    pthread_mutex_lock (&s_queue_mutex);
+    s_queue_eof = 1;
+    pthread_cond_broadcast (&s_queue_cond);
+    pthread_mutex_unlock (&s_queue_mutex);
+}
+
+int
+acquire_video_frame (void **buf, int64_t *pts_us)
+{
+    int ret = -1;
+
+    pthread_mutex_lock (&s_queue_mutex);
+    while (s_queue_ready == 0 && !s_queue_eof)
+        pthread_cond_wait (&s_queue_cond, &s_queue_mutex);
 
-    for (int y = 0; y < height; y ++)
+    /* the oldest one which is not acquired yet */
+    if (s_queue_ready > 0)
     {
-        unsigned char *dst8 = s_decode_buf + y * width * 4;
-        unsigned char *src8 = frame->data[0] + (y + ofsty) * frame->linesize[0];
-        src8 += ofstx * 3;
+        int idx = (s_queue_head + s_queue_used - s_queue_ready) % s_num_bufs;
 
-        for (int x = 0; x < width; x ++)
-        {
-           *dst8 ++ = *src8 ++;
-           *dst8 ++ = *src8 ++;
-           *dst8 ++ = *src8 ++;
-           *dst8 ++ = 255;
-        }
+        *buf = s_queue_buf[idx];
+        if (pts_us)
+            *pts_us = s_queue_pts[idx];
+        s_queue_ready --;
+        ret = 0;
     }
-    return 0;
+    pthread_mutex_unlock (&s_queue_mutex);
+
+    return ret;
 }
 
-static int
-on_frame_decoded (AVFrame *frame)
+void
+release_video_frame ()
 {
-    int dec_w = s_video_w;
-    int dec_h = s_video_h;
-    int ofstx = (s_video_w - s_crop_w) * 0.5f;
-    int ofsty = (s_video_h - s_crop_h) * 0.5f;
+    pthread_mutex_lock (&s_queue_mutex);
+    if (s_queue_used > s_queue_ready)
+    {
+        s_queue_head = (s_queue_head + 1) % s_num_bufs;
+        s_queue_used --;
+        pthread_cond_broadcast (&s_queue_cond);
+    }
+    pthread_mutex_unlock (&s_queue_mutex);
+}
 
-    if (0)
+int
+set_video_decode_offline (int width, int height, uint32_t pixformat, int num_bufs)
+{
+    if (get_av_pixformat (pixformat) == AV_PIX_FMT_NONE)
     {
-        static int i = 0;
-        save_to_ppm (frame, dec_w, dec_h, i++);
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
     }
 
-    convert_to_rgba8888 (frame, ofstx, ofsty, s_crop_w, s_crop_h);
+    if (num_bufs <= 0)
+        num_bufs = VIDEO_QUEUE_MAX;
+    if (num_bufs > VIDEO_QUEUE_MAX)
+        num_bufs = VIDEO_QUEUE_MAX;
+
+    s_offline  = 1;
+    s_out_w    = width;
+    s_out_h    = height;
+    s_out_fmt  = pixformat;
+    s_num_bufs = num_bufs;
 
     return 0;
 }
 
+int
+is_video_decode_offline ()
+{
+    return s_offline;
+}
+
 
 static void
 init_duration ()
@@ -228,13 +385,8 @@ get_duration_us ()
 }
 
 static void
-sleep_to_pts (AVPacket *packet)
+sleep_to_pts (int64_t pts_us)
 {
-    int64_t pts_us = 0;
-    if (packet->dts != AV_NOPTS_VALUE)
-        pts_us = packet->dts;
-
-    pts_us *= (av_q2d (s_video_st->time_base) * 1000 * 1000);
     pts_us /= PLAY_SPEED;
 
     int64_t delay_us = pts_us - get_duration_us ();
@@ -242,110 +394,160 @@ sleep_to_pts (AVPacket *packet)
         av_usleep (delay_us);
 }
 
-
-static void *
-decode_thread_main ()
+static int64_t
+get_frame_pts_us (AVFrame *frame)
 {
-    AVFrame *frame    = av_frame_alloc();
-    AVFrame *framergb = av_frame_alloc();
+    int64_t pts = frame->best_effort_timestamp;
 
-    if (frame == NULL || framergb == NULL)
-    {
-        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+    if (pts == AV_NOPTS_VALUE)
         return 0;
-    }
-
-    int dec_w = s_dec_ctx->width;
-    int dec_h = s_dec_ctx->height;
-    int numBytes = av_image_get_buffer_size (AV_PIX_FMT_RGB24, dec_w, dec_h, 1);
 
-    uint8_t *buffer = (uint8_t *) av_malloc (numBytes * sizeof(uint8_t));
+    return pts * av_q2d (s_video_st->time_base) * 1000 * 1000;
+}
 
-    av_image_fill_arrays (framergb->data, framergb->linesize, buffer, 
-                          AV_PIX_FMT_RGB24, dec_w, dec_h, 1);
+static void
+on_frame_decoded (struct SwsContext *sws_ctx, AVFrame *frame)
+{
+    int64_t pts_us = get_frame_pts_us (frame);
 
-    struct SwsContext *sws_ctx = sws_getContext(dec_w, dec_h, s_dec_ctx->pix_fmt,
-                                                dec_w, dec_h, AV_PIX_FMT_RGB24,
-                                                SWS_FAST_BILINEAR, NULL, NULL, NULL);
-    if (sws_ctx == NULL)
+    if (s_offline)
     {
-        fprintf(stderr, "Cannot initialize the sws context\n");
-        return 0;
+        uint8_t *buf = get_free_buffer ();
+
+        convert_frame (sws_ctx, frame, buf, get_av_pixformat (s_out_fmt), s_out_w, s_out_h);
+        push_ready_buffer (pts_us);
+        return;
     }
 
-    while (1)
-    {
-        AVPacket packet;
-        int ret;
+    if (s_decode_buf == NULL)
+        s_decode_buf = malloc (s_crop_w * s_crop_h * 4);
 
-        init_duration ();
+    sleep_to_pts (pts_us);
+    convert_frame (sws_ctx, frame, s_decode_buf, AV_PIX_FMT_RGBA, s_crop_w, s_crop_h);
+}
 
-        while (av_read_frame(s_fmt_ctx, &packet) >= 0)
+/* decode the whole file once. */
+static int
+decode_all_frames (struct SwsContext *sws_ctx, AVFrame *frame)
+{
+    AVPacket packet;
+    int ret;
+
+    while (av_read_frame(s_fmt_ctx, &packet) >= 0)
+    {
+        if (packet.stream_index == s_video_stream_index)
         {
-            if (packet.stream_index == s_video_stream_index)
+            ret = avcodec_send_packet (s_dec_ctx, &packet);
+            if (ret < 0)
             {
-                ret = avcodec_send_packet (s_dec_ctx, &packet);
-                if (ret < 0)
+                fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+                av_packet_unref(&packet);
+                break;
+            }
+
+            while (ret >= 0)
+            {
+                ret = avcodec_receive_frame (s_dec_ctx, frame);
+                if (ret == AVERROR(EAGAIN))
                 {
-                    fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+                    //fprintf (stderr, "retry.\n");
                     break;
                 }
-
-                while (ret >= 0)
+                else if (ret == AVERROR_EOF)
                 {
-                    ret = avcodec_receive_frame (s_dec_ctx, frame);
-                    if (ret == AVERROR(EAGAIN))
-                    {
-                        //fprintf (stderr, "retry.\n");
-                        break;
-                    }
-                    else if (ret == AVERROR_EOF)
-                    {
-                        fprintf (stderr, "EOF.\n");
-                        break;
-                    }
-                    else if (ret < 0)
-                    {
-                        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-                        return 0;
-                    }
-
-                    sws_scale(sws_ctx, (const uint8_t * const *) frame->data,
-                                       frame->linesize, 0, dec_h,
-                                       framergb->data, framergb->linesize);
-
-                    sleep_to_pts (&packet);
-                    on_frame_decoded (framergb);
+                    fprintf (stderr, "EOF.\n");
+                    break;
+                }
+                else if (ret < 0)
+                {
+                    fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+                    av_packet_unref(&packet);
+                    return -1;
                 }
-            }
 
-            av_packet_unref(&packet);
+                on_frame_decoded (sws_ctx, frame);
+            }
         }
 
-        /* flush decoder */
-        ret = avcodec_send_packet (s_dec_ctx, &packet);
-        if (ret < 0)
-        {
-            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-        }
+        av_packet_unref(&packet);
+    }
+
+    /* flush decoder. the frame threads hold the last frames until here. */
+    ret = avcodec_send_packet (s_dec_ctx, NULL);
+    if (ret < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+    }
+
+    while (avcodec_receive_frame(s_dec_ctx, frame) == 0)
+    {
+        on_frame_decoded (sws_ctx, frame);
+    }
 
-        while (avcodec_receive_frame(s_dec_ctx, frame) == 0)
+    return 0;
+}
+
+
+static void *
+decode_thread_main ()
+{
+    AVFrame *frame = av_frame_alloc();
+    int dst_w = s_crop_w;
+    int dst_h = s_crop_h;
+    enum AVPixelFormat dst_fmt = AV_PIX_FMT_RGBA;
+
+    if (frame == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        signal_eof ();
+        return 0;
+    }
+
+    if (s_offline)
+    {
+        dst_w   = s_out_w;
+        dst_h   = s_out_h;
+        dst_fmt = get_av_pixformat (s_out_fmt);
+    }
+
+    /* crop, scale and convert in one pass */
+    struct SwsContext *sws_ctx = sws_getContext(s_crop_w, s_crop_h, s_dec_ctx->pix_fmt,
+                                                dst_w, dst_h, dst_fmt,
+                                                SWS_FAST_BILINEAR, NULL, NULL, NULL);
+    if (sws_ctx == NULL)
+    {
+        fprintf(stderr, "Cannot initialize the sws context\n");
+        av_frame_free (&frame);
+        signal_eof ();
+        return 0;
+    }
+
+    if (s_offline)
+    {
+        int64_t t0 = av_gettime ();
+
+        decode_all_frames (sws_ctx, frame);
+        signal_eof ();
+
+        fprintf (stderr, "decoded %d frames in %.1f [s]\n",
+                 s_num_decoded, (av_gettime () - t0) / 1000000.0);
+    }
+    else
+    {
+        while (1)
         {
-            sws_scale(sws_ctx, (const uint8_t * const *) frame->data,
-                               frame->linesize, 0, dec_h,
-                               framergb->data, framergb->linesize);
+            init_duration ();
 
-            sleep_to_pts (&packet);
-            on_frame_decoded (framergb);
-        }
+            if (decode_all_frames (sws_ctx, frame) < 0)
+                break;
 
-        /* rewind to restart */
-        av_seek_frame (s_fmt_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
-        avcodec_flush_buffers (s_dec_ctx);
+            /* rewind to restart */
+            av_seek_frame (s_fmt_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
+            avcodec_flush_buffers (s_dec_ctx);
+        }
     }
 
-    av_free (buffer);
-    av_frame_free (&framergb);
+    sws_freeContext (sws_ctx);
     av_frame_free (&frame);
 
     return 0;
@@ -354,10 +556,49 @@ decode_thread_main ()
 
 
 
+static void
+free_queue_buffers ()
+{
+    int i;
+
+    for (i = 0; i < VIDEO_QUEUE_MAX; i ++)
+    {
+        av_freep (&s_queue_buf[i]);
+    }
+}
+
+/*
+ *  on failure, the offline queue is at EOF, so that
+ *  acquire_video_frame() returns -1 instead of waiting forever.
+ */
 int
 start_video_decode ()
 {
-    pthread_create (&s_decode_thread, NULL, decode_thread_main, NULL);
+    if (s_offline)
+    {
+        int size = av_image_get_buffer_size (get_av_pixformat (s_out_fmt), s_out_w, s_out_h, 1);
+        int i;
+
+        for (i = 0; i < s_num_bufs; i ++)
+        {
+            s_queue_buf[i] = (uint8_t *)av_malloc (size);
+            if (s_queue_buf[i] == NULL)
+            {
+                fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+                free_queue_buffers ();
+                signal_eof ();
+                return -1;
+            }
+        }
+    }
+
+    if (pthread_create (&s_decode_thread, NULL, decode_thread_main, NULL) != 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        free_queue_buffers ();
+        signal_eof ();
+        return -1;
+    }
+
     return 0;
 }
-
@@ -5,6 +5,8 @@
 #ifndef VIDEO_DECODE_H_
 #define VIDEO_DECODE_H_
 
+#include <stdint.h>
+
 int init_video_decode ();
 int open_video_file (const char *fname);
 int get_video_dimension (int *width, int *height);
@@ -14,4 +16,37 @@ int get_video_buffer (void ** buf);
 int start_video_decode ();
 
 
+/*
+ *  offline mode: for the batch processing of the recorded video.
+ *
+ *      set_video_decode_offline (w, h, pixfmt_fourcc ('R', 'G', 'B', 'A'), 4);
+ *      open_video_file (fname);
+ *      start_video_decode ();
+ *
+ *      while (acquire_video_frame (&buf, &pts_us) == 0)
+ *      {
+ *          ... process (buf) ...
+ *          release_video_frame ();
+ *      }
+ *
+ *  the file is decoded once with the codec threads, as fast as the consumer
+ *  takes the frames. no pacing, no frame drop, no loop.
+ *  each frame is cropped to the center square, scaled to (width x height) and
+ *  converted to (pixformat) in one sws pass. (width, height) = (0, 0) keeps the
+ *  crop size. (pixformat): RGBA, Y800, YUYV or UYVY.
+ *
+ *  the decoder waits while all of the (num_bufs) buffers are in the queue or
+ *  acquired. the acquired frames are released in the acquired order.
+ *  acquire_video_frame() returns -1 when all the frames have been taken.
+ *
+ *  must be called before open_video_file().
+ */
+#define VIDEO_QUEUE_MAX     8
+
+int  set_video_decode_offline (int width, int height, uint32_t pixformat, int num_bufs);
+int  is_video_decode_offline ();
+int  acquire_video_frame (void **buf, int64_t *pts_us);
+void release_video_frame ();
+
+
 #endif
@@ -0,0 +1,331 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "util_warp.h"
+#include "util_bandpool.h"
+
+/* don't wake up the workers for tiny outputs. */
+#define WARP_MIN_PIXELS_PER_THREAD  4096
+
+typedef struct _warp_job_t
+{
+    const warp_src_t    *src;
+    const float         *mat;
+    float               *dst;
+    int                 dst_w, dst_h;
+    float               scale[3];       /* dst = src * scale + bias */
+    float               bias[3];
+    int                 flags;
+    int                 num_bands;
+} warp_job_t;
+
+static bandpool_t       s_pool = BANDPOOL_INITIALIZER;
+
+
+/* -------------------------------------------------- *
+ *  bilinear sampling of one destination row
+ *
+ *  (sx, sy) is the source position of the first pixel and
+ *  (dx, dy) is the step per destination pixel.
+ *  R, G, B are written to (dr, dg, db) with (step) floats pitch.
+ * -------------------------------------------------- */
+#define CLAMP_COORD(sx, sy, src)                        \
+    do {                                                \
+        if (sx < 0.0f) sx = 0.0f;                       \
+        if (sy < 0.0f) sy = 0.0f;                       \
+        if (sx > (src)->w - 1) sx = (src)->w - 1;       \
+        if (sy > (src)->h - 1) sy = (src)->h - 1;       \
+    } while (0)
+
+static void
+warp_row_rgba (const warp_src_t *src, float sx0, float sy0, float dx, float dy, int n,
+               float *dr, float *dg, float *db, int step, const float *scale, const float *bias)
+{
+    const unsigned char *buf = src->buf;
+    int stride = src->stride;
+    int x;
+
+    for (x = 0; x < n; x ++)
+    {
+        float sx = sx0 + dx * x;
+        float sy = sy0 + dy * x;
+
+        CLAMP_COORD (sx, sy, src);
+
+        int x0 = (int)sx;
+        int y0 = (int)sy;
+        int x1 = (x0 + 1 < src->w) ? x0 + 1 : x0;
+        int y1 = (y0 + 1 < src->h) ? y0 + 1 : y0;
+        float fx = sx - x0;
+        float fy = sy - y0;
+
+        const unsigned char *p00 = buf + y0 * stride + x0 * 4;
+        const unsigned char *p01 = buf + y0 * stride + x1 * 4;
+        const unsigned char *p10 = buf + y1 * stride + x0 * 4;
+        const unsigned char *p11 = buf + y1 * stride + x1 * 4;
+
+        float t0 = p00[0] + (p01[0] - p00[0]) * fx;
+        float t1 = p00[1] + (p01[1] - p00[1]) * fx;
+        float t2 = p00[2] + (p01[2] - p00[2]) * fx;
+        float b0 = p10[0] + (p11[0] - p10[0]) * fx;
+        float b1 = p10[1] + (p11[1] - p10[1]) * fx;
+        float b2 = p10[2] + (p11[2] - p10[2]) * fx;
+
+        dr[x * step] = (t0 + (b0 - t0) * fy) * scale[0] + bias[0];
+        dg[x * step] = (t1 + (b1 - t1) * fy) * scale[1] + bias[1];
+        db[x * step] = (t2 + (b2 - t2) * fy) * scale[2] + bias[2];
+    }
+}
+
+/*
+ *  YUYV/UYVY: Y, U, V are interpolated first and converted to RGB once per
+ *  destination pixel. the conversion is BT.601 full range, the same as the
+ *  YUYV shader in util_render2d.c.
+ */
+static inline float
+clamp_255 (float v)
+{
+    if (v < 0.0f)   return 0.0f;
+    if (v > 255.0f) return 255.0f;
+    return v;
+}
+
+static void
+warp_row_yuyv (const warp_src_t *src, float sx0, float sy0, float dx, float dy, int n,
+               float *dr, float *dg, float *db, int step, const float *scale, const float *bias)
+{
+    const unsigned char *buf = src->buf;
+    int stride = src->stride;
+    int y_idx[2], u_idx, v_idx;
+    int x;
+
+    if (src->format == WARP_FMT_UYVY)
+    {
+        u_idx = 0;  y_idx[0] = 1;  v_idx = 2;  y_idx[1] = 3;
+    }
+    else
+    {
+        y_idx[0] = 0;  u_idx = 1;  y_idx[1] = 2;  v_idx = 3;
+    }
+
+    for (x = 0; x < n; x ++)
+    {
+        float sx = sx0 + dx * x;
+        float sy = sy0 + dy * x;
+
+        CLAMP_COORD (sx, sy, src);
+
+        int x0 = (int)sx;
+        int y0 = (int)sy;
+        int x1 = (x0 + 1 < src->w) ? x0 + 1 : x0;
+        int y1 = (y0 + 1 < src->h) ? y0 + 1 : y0;
+        float fx = sx - x0;
+        float fy = sy - y0;
+
+        /* macro pixel of each neighbor */
+        const unsigned char *m00 = buf + y0 * stride + (x0 >> 1) * 4;
+        const unsigned char *m01 = buf + y0 * stride + (x1 >> 1) * 4;
+        const unsigned char *m10 = buf + y1 * stride + (x0 >> 1) * 4;
+        const unsigned char *m11 = buf + y1 * stride + (x1 >> 1) * 4;
+        int yi0 = y_idx[x0 & 1];
+        int yi1 = y_idx[x1 & 1];
+
+        float ty = m00[yi0]   + (m01[yi1]   - m00[yi0])   * fx;
+        float tu = m00[u_idx] + (m01[u_idx] - m00[u_idx]) * fx;
+        float tv = m00[v_idx] + (m01[v_idx] - m00[v_idx]) * fx;
+        float by = m10[yi0]   + (m11[yi1]   - m10[yi0])   * fx;
+        float bu = m10[u_idx] + (m11[u_idx] - m10[u_idx]) * fx;
+        float bv = m10[v_idx] + (m11[v_idx] - m10[v_idx]) * fx;
+
+        float yy = ty + (by - ty) * fy;
+        float uu = tu + (bu - tu) * fy - 128.0f;
+        float vv = tv + (bv - tv) * fy - 128.0f;
+
+        float r = clamp_255 (yy                 + 1.402f   * vv);
+        float g = clamp_255 (yy - 0.34413f * uu - 0.71414f * vv);
+        float b = clamp_255 (yy + 1.772f   * uu);
+
+        dr[x * step] = r * scale[0] + bias[0];
+        dg[x * step] = g * scale[1] + bias[1];
+        db[x * step] = b * scale[2] + bias[2];
+    }
+}
+
+static void
+warp_run_band (void *arg, int band)
+{
+    const warp_job_t *job = (const warp_job_t *)arg;
+    const warp_src_t *src = job->src;
+    const float *m = job->mat;
+    int w  = job->dst_w;
+    int h  = job->dst_h;
+    int y_start = (int)((int64_t)h *  band      / job->num_bands);
+    int y_end   = (int)((int64_t)h * (band + 1) / job->num_bands);
+    int y;
+
+    for (y = y_start; y < y_end; y ++)
+    {
+        float sx0 = m[1] * y + m[2];
+        float sy0 = m[4] * y + m[5];
+        float *dr, *dg, *db;
+        int step;
+
+        if (job->flags & PREPROC_FLAG_CHW)
+        {
+            dr = job->dst + y * w;
+            dg = dr + w * h;
+            db = dg + w * h;
+            step = 1;
+        }
+        else
+        {
+            dr = job->dst + y * w * 3;
+            dg = dr + 1;
+            db = dr + 2;
+            step = 3;
+        }
+
+        if (job->flags & PREPROC_FLAG_BGR)
+        {
+            float *tmp = dr;
+            dr = db;
+            db = tmp;
+        }
+
+        if (src->format == WARP_FMT_RGBA)
+            warp_row_rgba (src, sx0, sy0, m[0], m[3], w, dr, dg, db, step, job->scale, job->bias);
+        else
+            warp_row_yuyv (src, sx0, sy0, m[0], m[3], w, dr, dg, db, step, job->scale, job->bias);
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  worker threads
+ *
+ *  the destination rows are split into (num_bands) bands.
+ *  band 0 is processed by the calling thread.
+ * -------------------------------------------------- */
+int
+warp_init (int num_threads)
+{
+    if (num_threads > WARP_MAX_THREADS)
+        num_threads = WARP_MAX_THREADS;
+
+    return bandpool_init (&s_pool, num_threads);
+}
+
+void
+warp_terminate ()
+{
+    bandpool_terminate (&s_pool);
+}
+
+static void
+warp_run_job (warp_job_t *job)
+{
+    job->num_bands = bandpool_split (&s_pool, job->dst_w * job->dst_h, WARP_MIN_PIXELS_PER_THREAD);
+    bandpool_run (&s_pool, warp_run_band, job, job->num_bands);
+}
+
+
+/* -------------------------------------------------- *
+ *  API
+ * -------------------------------------------------- */
+int
+warp_src_set (warp_src_t *src, const void *buf, int w, int h, int stride, uint32_t format)
+{
+    int bpp;
+
+    if (buf == NULL || w <= 0 || h <= 0)
+        return -1;
+
+    switch (format)
+    {
+    case WARP_FMT_RGBA:
+        bpp = 4;
+        break;
+    case WARP_FMT_YUYV:
+    case WARP_FMT_UYVY:
+        bpp = 2;
+        break;
+    default:
+        fprintf (stderr, "ERR: %s(%d): pixformat(%.4s) is not supported.\n",
+            __FILE__, __LINE__, (char *)&format);
+        return -1;
+    }
+
+    src->buf    = (const unsigned char *)buf;
+    src->w      = w;
+    src->h      = h;
+    src->stride = stride ? stride : w * bpp;
+    src->format = format;
+
+    return 0;
+}
+
+void
+warp_get_quad_matrix (const warp_src_t *src, const float quad[4][2],
+                      int dst_w, int dst_h, float *mat)
+{
+    float ox = quad[0][0] * src->w;
+    float oy = quad[0][1] * src->h;
+    float ux = (quad[1][0] - quad[0][0]) * src->w / dst_w;   /* one dst pixel to the right */
+    float uy = (quad[1][1] - quad[0][1]) * src->h / dst_w;
+    float vx = (quad[3][0] - quad[0][0]) * src->w / dst_h;   /* one dst pixel downward */
+    float vy = (quad[3][1] - quad[0][1]) * src->h / dst_h;
+
+    /* sample at the pixel centers */
+    mat[0] = ux;
+    mat[1] = vx;
+    mat[2] = ox + 0.5f * (ux + vx) - 0.5f;
+    mat[3] = uy;
+    mat[4] = vy;
+    mat[5] = oy + 0.5f * (uy + vy) - 0.5f;
+}
+
+void
+warp_affine_to_fp32 (const warp_src_t *src, const float *mat, float *dst,
+                     int dst_w, int dst_h, const preproc_norm_t *norm, int flags)
+{
+    warp_job_t job;
+    int i;
+
+    job.src   = src;
+    job.mat   = mat;
+    job.dst   = dst;
+    job.dst_w = dst_w;
+    job.dst_h = dst_h;
+    job.flags = flags;
+    for (i = 0; i < 3; i ++)
+    {
+        job.scale[i] = 1.0f / norm->std[i];
+        job.bias[i]  = -norm->mean[i] / norm->std[i];
+    }
+
+    warp_run_job (&job);
+}
+
+void
+warp_quad_to_fp32 (const warp_src_t *src, const float quad[4][2], float *dst,
+                   int dst_w, int dst_h, const preproc_norm_t *norm, int flags)
+{
+    float mat[6];
+
+    warp_get_quad_matrix (src, quad, dst_w, dst_h, mat);
+    warp_affine_to_fp32 (src, mat, dst, dst_w, dst_h, norm, flags);
+}
+
+void
+warp_resize_to_fp32 (const warp_src_t *src, float *dst,
+                     int dst_w, int dst_h, const preproc_norm_t *norm, int flags)
+{
+    float quad[4][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+
+    warp_quad_to_fp32 (src, quad, dst, dst_w, dst_h, norm, flags);
+}
@@ -0,0 +1,86 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_WARP_H_
+#define _UTIL_WARP_H_
+
+#include <stdint.h>
+#include "util_preprocess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  CPU warp-affine for DNN inputs.
+ *
+ *  crops a (rotated) rectangle out of the camera/video frame, resizes it
+ *  with bilinear filter and writes the normalized floats directly into
+ *  the input tensor. this replaces the GL draw + glReadPixels() round trip
+ *  and needs no EGL/GLES at all.
+ *
+ *  the source is sampled with clamp-to-edge, like the GL texture.
+ */
+#define WARP_FOURCC(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+/* same values as pixfmt_fourcc() in util_texture.h */
+#define WARP_FMT_RGBA       WARP_FOURCC ('R', 'G', 'B', 'A')
+#define WARP_FMT_YUYV       WARP_FOURCC ('Y', 'U', 'Y', 'V')
+#define WARP_FMT_UYVY       WARP_FOURCC ('U', 'Y', 'V', 'Y')
+
+#define WARP_MAX_THREADS    8
+
+typedef struct _warp_src_t
+{
+    const unsigned char *buf;
+    int                 w, h;           /* in pixels       */
+    int                 stride;         /* in bytes        */
+    uint32_t            format;         /* WARP_FMT_xxx    */
+} warp_src_t;
+
+/* start the worker threads. (num_threads = 0: number of online CPUs)
+ * without this, everything runs on the calling thread. */
+int  warp_init (int num_threads);
+void warp_terminate ();
+
+/* stride = 0 means a tightly packed image. returns -1 if (buf) is NULL or
+ * (format) is not supported. */
+int  warp_src_set (warp_src_t *src, const void *buf, int w, int h, int stride, uint32_t format);
+
+/*
+ *  (mat) maps the destination pixel (x, y) to the source pixel:
+ *
+ *      sx = mat[0] * x + mat[1] * y + mat[2]
+ *      sy = mat[3] * x + mat[4] * y + mat[5]
+ */
+void warp_get_quad_matrix (const warp_src_t *src, const float quad[4][2],
+                           int dst_w, int dst_h, float *mat);
+
+void warp_affine_to_fp32 (const warp_src_t *src, const float *mat, float *dst,
+                          int dst_w, int dst_h, const preproc_norm_t *norm, int flags);
+
+/*
+ *  crop the rectangle given by the normalized quad:
+ *
+ *      0--------1
+ *      |        |
+ *      |        |
+ *      3--------2
+ *
+ *  the edge (0 --> 1) becomes the first row of (dst).
+ *  flags: PREPROC_FLAG_BGR, PREPROC_FLAG_CHW
+ */
+void warp_quad_to_fp32 (const warp_src_t *src, const float quad[4][2], float *dst,
+                        int dst_w, int dst_h, const preproc_norm_t *norm, int flags);
+
+/* resize the whole frame */
+void warp_resize_to_fp32 (const warp_src_t *src, float *dst,
+                          int dst_w, int dst_h, const preproc_norm_t *norm, int flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_WARP_H_ */
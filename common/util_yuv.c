@@ -0,0 +1,686 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "util_yuv.h"
+#include "util_preprocess.h"
+#include "util_bandpool.h"
+
+#if defined (__ARM_NEON__) || defined (__aarch64__)
+#include <arm_neon.h>
+#define YUV_USE_NEON
+#elif defined (__AVX2__)
+#include <immintrin.h>
+#define YUV_USE_AVX2
+#define YUV_USE_SSE2                    /* for the last 8 pixels */
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#define YUV_USE_SSE2
+#endif
+
+/* don't wake up the workers for tiny outputs. */
+#define YUV_MIN_PIXELS_PER_THREAD   4096
+
+/*
+ *  R = cy * (Y - yoff) + crv * (V - 128)
+ *  G = cy * (Y - yoff) - cgu * (U - 128) - cgv * (V - 128)
+ *  B = cy * (Y - yoff) + cbu * (U - 128)
+ *
+ *  the inputs are scaled by 2^7 and the coefficients by 2^13, and the
+ *  products are the upper 16bits (Q4). the coefficients are even, so that
+ *  NEON vqdmulh with (coef / 2) gives the same results as SSE2 mulhi.
+ */
+typedef struct _yuv_coef_t
+{
+    int16_t     yoff;
+    int16_t     cy, crv, cgu, cgv, cbu;
+} yuv_coef_t;
+
+#define Q13(f)  ((int16_t)(2 * (int)((f) * 4096.0f + 0.5f)))
+
+static const yuv_coef_t s_coef_table[4] =
+{
+    {16, Q13(1.164383f), Q13(1.596027f), Q13(0.391762f), Q13(0.812968f), Q13(2.017232f)},   /* BT.601 limited */
+    {16, Q13(1.164383f), Q13(1.792741f), Q13(0.213249f), Q13(0.532909f), Q13(2.112402f)},   /* BT.709 limited */
+    { 0, Q13(1.000000f), Q13(1.402000f), Q13(0.344136f), Q13(0.714136f), Q13(1.772000f)},   /* BT.601 full    */
+    { 0, Q13(1.000000f), Q13(1.574800f), Q13(0.187324f), Q13(0.468124f), Q13(1.855600f)},   /* BT.709 full    */
+};
+
+typedef struct _yuv_job_t
+{
+    const unsigned char *base;          /* top-left of the crop */
+    int                 stride;
+    int                 uyvy;
+    int                 crop_w, crop_h;
+    unsigned char       *dst;
+    int                 dst_w, dst_h;
+    int                 bpp;
+    int                 flags;
+    const yuv_coef_t    *coef;
+    const int           *xtab;          /* horizontal sampling of each output column */
+    int                 num_bands;
+} yuv_job_t;
+
+static bandpool_t       s_pool = BANDPOOL_INITIALIZER;
+static pthread_mutex_t  s_call_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* guarded by s_call_mutex */
+static preproc_buf_t    s_xtab_buf;
+static preproc_buf_t    s_band_buf[YUV_MAX_THREADS];
+
+
+/* -------------------------------------------------- *
+ *  one pixel
+ * -------------------------------------------------- */
+static inline int
+clamp_u8 (int v)
+{
+    if (v < 0)   return 0;
+    if (v > 255) return 255;
+    return v;
+}
+
+static inline void
+yuv_pixel (int y, int u, int v, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    int y7 = (y - k->yoff) * 128;
+    int u7 = (u - 128) * 128;
+    int v7 = (v - 128) * 128;
+    int yy = (y7 * k->cy) >> 16;
+
+    d[0] = clamp_u8 ((yy + ((v7 * k->crv) >> 16) + 8) >> 4);
+    d[1] = clamp_u8 ((yy - ((u7 * k->cgu) >> 16) - ((v7 * k->cgv) >> 16) + 8) >> 4);
+    d[2] = clamp_u8 ((yy + ((u7 * k->cbu) >> 16) + 8) >> 4);
+    if (bpp == 4)
+        d[3] = 255;
+}
+
+
+/* -------------------------------------------------- *
+ *  8/16 pixels
+ *
+ *  (y, u, v): 16bit lanes, one pixel per lane.
+ * -------------------------------------------------- */
+#if defined (YUV_USE_SSE2)
+static inline void
+yuv_store_sse2 (__m128i y, __m128i u, __m128i v, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    __m128i round = _mm_set1_epi16 (8);
+    __m128i y7 = _mm_slli_epi16 (_mm_sub_epi16 (y, _mm_set1_epi16 (k->yoff)), 7);
+    __m128i u7 = _mm_slli_epi16 (_mm_sub_epi16 (u, _mm_set1_epi16 (128)), 7);
+    __m128i v7 = _mm_slli_epi16 (_mm_sub_epi16 (v, _mm_set1_epi16 (128)), 7);
+    __m128i yy = _mm_add_epi16 (_mm_mulhi_epi16 (y7, _mm_set1_epi16 (k->cy)), round);
+
+    __m128i r = _mm_add_epi16 (yy, _mm_mulhi_epi16 (v7, _mm_set1_epi16 (k->crv)));
+    __m128i g = _mm_sub_epi16 (yy, _mm_mulhi_epi16 (u7, _mm_set1_epi16 (k->cgu)));
+            g = _mm_sub_epi16 (g,  _mm_mulhi_epi16 (v7, _mm_set1_epi16 (k->cgv)));
+    __m128i b = _mm_add_epi16 (yy, _mm_mulhi_epi16 (u7, _mm_set1_epi16 (k->cbu)));
+
+    /* [r0 .. r7, r0 .. r7] */
+    __m128i r8 = _mm_packus_epi16 (_mm_srai_epi16 (r, 4), _mm_srai_epi16 (r, 4));
+    __m128i g8 = _mm_packus_epi16 (_mm_srai_epi16 (g, 4), _mm_srai_epi16 (g, 4));
+    __m128i b8 = _mm_packus_epi16 (_mm_srai_epi16 (b, 4), _mm_srai_epi16 (b, 4));
+
+    if (bpp == 4)
+    {
+        __m128i rg = _mm_unpacklo_epi8 (r8, g8);
+        __m128i ba = _mm_unpacklo_epi8 (b8, _mm_set1_epi8 ((char)0xFF));
+        _mm_storeu_si128 ((__m128i *)(d +  0), _mm_unpacklo_epi16 (rg, ba));
+        _mm_storeu_si128 ((__m128i *)(d + 16), _mm_unpackhi_epi16 (rg, ba));
+    }
+    else
+    {
+        unsigned char tmp[3][16];
+        int i;
+
+        _mm_storeu_si128 ((__m128i *)tmp[0], r8);
+        _mm_storeu_si128 ((__m128i *)tmp[1], g8);
+        _mm_storeu_si128 ((__m128i *)tmp[2], b8);
+        for (i = 0; i < 8; i ++)
+        {
+            *d ++ = tmp[0][i];
+            *d ++ = tmp[1][i];
+            *d ++ = tmp[2][i];
+        }
+    }
+}
+
+/* 8 pixels of YUYV/UYVY */
+static inline void
+yuv422_8px_sse2 (const unsigned char *s, int uyvy, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    __m128i m  = _mm_loadu_si128 ((const __m128i *)s);
+    __m128i lo = _mm_and_si128 (m, _mm_set1_epi16 (0x00FF));
+    __m128i hi = _mm_srli_epi16 (m, 8);
+    __m128i y  = uyvy ? hi : lo;
+    __m128i uv = uyvy ? lo : hi;                /* [u0 v0 u1 v1 u2 v2 u3 v3] */
+
+    __m128i u = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (uv, _MM_SHUFFLE (2, 2, 0, 0)), _MM_SHUFFLE (2, 2, 0, 0));
+    __m128i v = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (uv, _MM_SHUFFLE (3, 3, 1, 1)), _MM_SHUFFLE (3, 3, 1, 1));
+
+    yuv_store_sse2 (y, u, v, k, d, bpp);
+}
+
+/* 8 pixels of planar Y, U, V */
+static inline void
+yuv444_8px_sse2 (const unsigned char *sy, const unsigned char *su, const unsigned char *sv,
+                 const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i y = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)sy), zero);
+    __m128i u = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)su), zero);
+    __m128i v = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)sv), zero);
+
+    yuv_store_sse2 (y, u, v, k, d, bpp);
+}
+#endif /* YUV_USE_SSE2 */
+
+
+#if defined (YUV_USE_AVX2)
+static inline void
+yuv_store_avx2 (__m256i y, __m256i u, __m256i v, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    __m256i round = _mm256_set1_epi16 (8);
+    __m256i y7 = _mm256_slli_epi16 (_mm256_sub_epi16 (y, _mm256_set1_epi16 (k->yoff)), 7);
+    __m256i u7 = _mm256_slli_epi16 (_mm256_sub_epi16 (u, _mm256_set1_epi16 (128)), 7);
+    __m256i v7 = _mm256_slli_epi16 (_mm256_sub_epi16 (v, _mm256_set1_epi16 (128)), 7);
+    __m256i yy = _mm256_add_epi16 (_mm256_mulhi_epi16 (y7, _mm256_set1_epi16 (k->cy)), round);
+
+    __m256i r = _mm256_add_epi16 (yy, _mm256_mulhi_epi16 (v7, _mm256_set1_epi16 (k->crv)));
+    __m256i g = _mm256_sub_epi16 (yy, _mm256_mulhi_epi16 (u7, _mm256_set1_epi16 (k->cgu)));
+            g = _mm256_sub_epi16 (g,  _mm256_mulhi_epi16 (v7, _mm256_set1_epi16 (k->cgv)));
+    __m256i b = _mm256_add_epi16 (yy, _mm256_mulhi_epi16 (u7, _mm256_set1_epi16 (k->cbu)));
+
+    /* in each 128bit lane: [r0 .. r7, r0 .. r7], [r8 .. r15, r8 .. r15] */
+    __m256i r8 = _mm256_packus_epi16 (_mm256_srai_epi16 (r, 4), _mm256_srai_epi16 (r, 4));
+    __m256i g8 = _mm256_packus_epi16 (_mm256_srai_epi16 (g, 4), _mm256_srai_epi16 (g, 4));
+    __m256i b8 = _mm256_packus_epi16 (_mm256_srai_epi16 (b, 4), _mm256_srai_epi16 (b, 4));
+
+    if (bpp == 4)
+    {
+        __m256i rg = _mm256_unpacklo_epi8 (r8, g8);
+        __m256i ba = _mm256_unpacklo_epi8 (b8, _mm256_set1_epi8 ((char)0xFF));
+        __m256i p0 = _mm256_unpacklo_epi16 (rg, ba);    /* [px 0-3,  px 8-11] */
+        __m256i p1 = _mm256_unpackhi_epi16 (rg, ba);    /* [px 4-7,  px 12-15] */
+        _mm256_storeu_si256 ((__m256i *)(d +  0), _mm256_permute2x128_si256 (p0, p1, 0x20));
+        _mm256_storeu_si256 ((__m256i *)(d + 32), _mm256_permute2x128_si256 (p0, p1, 0x31));
+    }
+    else
+    {
+        unsigned char tmp[3][32];
+        int i;
+
+        _mm256_storeu_si256 ((__m256i *)tmp[0], r8);
+        _mm256_storeu_si256 ((__m256i *)tmp[1], g8);
+        _mm256_storeu_si256 ((__m256i *)tmp[2], b8);
+        for (i = 0; i < 16; i ++)
+        {
+            int j = (i < 8) ? i : i + 8;        /* skip the duplicated halves */
+            *d ++ = tmp[0][j];
+            *d ++ = tmp[1][j];
+            *d ++ = tmp[2][j];
+        }
+    }
+}
+
+static inline void
+yuv422_16px_avx2 (const unsigned char *s, int uyvy, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    __m256i m  = _mm256_loadu_si256 ((const __m256i *)s);
+    __m256i lo = _mm256_and_si256 (m, _mm256_set1_epi16 (0x00FF));
+    __m256i hi = _mm256_srli_epi16 (m, 8);
+    __m256i y  = uyvy ? hi : lo;
+    __m256i uv = uyvy ? lo : hi;
+
+    __m256i u = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (uv, _MM_SHUFFLE (2, 2, 0, 0)), _MM_SHUFFLE (2, 2, 0, 0));
+    __m256i v = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (uv, _MM_SHUFFLE (3, 3, 1, 1)), _MM_SHUFFLE (3, 3, 1, 1));
+
+    yuv_store_avx2 (y, u, v, k, d, bpp);
+}
+
+static inline void
+yuv444_16px_avx2 (const unsigned char *sy, const unsigned char *su, const unsigned char *sv,
+                  const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    __m256i y = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)sy));
+    __m256i u = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)su));
+    __m256i v = _mm256_cvtepu8_epi16 (_mm_loadu_si128 ((const __m128i *)sv));
+
+    yuv_store_avx2 (y, u, v, k, d, bpp);
+}
+#endif /* YUV_USE_AVX2 */
+
+
+#if defined (YUV_USE_NEON)
+static inline void
+yuv_store_neon (int16x8_t y, int16x8_t u, int16x8_t v, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    int16x8_t y7 = vshlq_n_s16 (vsubq_s16 (y, vdupq_n_s16 (k->yoff)), 7);
+    int16x8_t u7 = vshlq_n_s16 (vsubq_s16 (u, vdupq_n_s16 (128)), 7);
+    int16x8_t v7 = vshlq_n_s16 (vsubq_s16 (v, vdupq_n_s16 (128)), 7);
+    int16x8_t yy = vqdmulhq_n_s16 (y7, k->cy / 2);
+
+    int16x8_t r = vaddq_s16 (yy, vqdmulhq_n_s16 (v7, k->crv / 2));
+    int16x8_t g = vsubq_s16 (yy, vqdmulhq_n_s16 (u7, k->cgu / 2));
+              g = vsubq_s16 (g,  vqdmulhq_n_s16 (v7, k->cgv / 2));
+    int16x8_t b = vaddq_s16 (yy, vqdmulhq_n_s16 (u7, k->cbu / 2));
+
+    /* (x + 8) >> 4, saturated to [0, 255] */
+    uint8x8_t r8 = vqrshrun_n_s16 (r, 4);
+    uint8x8_t g8 = vqrshrun_n_s16 (g, 4);
+    uint8x8_t b8 = vqrshrun_n_s16 (b, 4);
+
+    if (bpp == 4)
+    {
+        uint8x8x4_t rgba;
+        rgba.val[0] = r8;
+        rgba.val[1] = g8;
+        rgba.val[2] = b8;
+        rgba.val[3] = vdup_n_u8 (255);
+        vst4_u8 (d, rgba);
+    }
+    else
+    {
+        uint8x8x3_t rgb;
+        rgb.val[0] = r8;
+        rgb.val[1] = g8;
+        rgb.val[2] = b8;
+        vst3_u8 (d, rgb);
+    }
+}
+
+static inline void
+yuv422_8px_neon (const unsigned char *s, int uyvy, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    uint8x8x2_t m  = vld2_u8 (s);                       /* even bytes, odd bytes */
+    uint8x8_t   y8 = uyvy ? m.val[1] : m.val[0];
+    uint8x8_t   c8 = uyvy ? m.val[0] : m.val[1];        /* [u0 v0 u1 v1 u2 v2 u3 v3] */
+    uint8x8x2_t uv = vuzp_u8 (c8, c8);                  /* [u0 u1 u2 u3 ..], [v0 v1 v2 v3 ..] */
+    uint8x8_t   u8 = vzip_u8 (uv.val[0], uv.val[0]).val[0];
+    uint8x8_t   v8 = vzip_u8 (uv.val[1], uv.val[1]).val[0];
+
+    yuv_store_neon (vreinterpretq_s16_u16 (vmovl_u8 (y8)),
+                    vreinterpretq_s16_u16 (vmovl_u8 (u8)),
+                    vreinterpretq_s16_u16 (vmovl_u8 (v8)), k, d, bpp);
+}
+
+static inline void
+yuv444_8px_neon (const unsigned char *sy, const unsigned char *su, const unsigned char *sv,
+                 const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    yuv_store_neon (vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (sy))),
+                    vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (su))),
+                    vreinterpretq_s16_u16 (vmovl_u8 (vld1_u8 (sv))), k, d, bpp);
+}
+#endif /* YUV_USE_NEON */
+
+
+/* -------------------------------------------------- *
+ *  one row
+ * -------------------------------------------------- */
+/* (n) pixels of YUYV/UYVY. (n) is even. */
+static void
+convert_row_422 (const unsigned char *s, int n, int uyvy, const yuv_coef_t *k,
+                 unsigned char *d, int bpp)
+{
+    int y0_idx = uyvy ? 1 : 0;
+    int u_idx  = uyvy ? 0 : 1;
+    int y1_idx = uyvy ? 3 : 2;
+    int v_idx  = uyvy ? 2 : 3;
+    int x = 0;
+
+#if defined (YUV_USE_AVX2)
+    for (; x + 16 <= n; x += 16, s += 32, d += 16 * bpp)
+        yuv422_16px_avx2 (s, uyvy, k, d, bpp);
+#endif
+#if defined (YUV_USE_SSE2)
+    for (; x + 8 <= n; x += 8, s += 16, d += 8 * bpp)
+        yuv422_8px_sse2 (s, uyvy, k, d, bpp);
+#elif defined (YUV_USE_NEON)
+    for (; x + 8 <= n; x += 8, s += 16, d += 8 * bpp)
+        yuv422_8px_neon (s, uyvy, k, d, bpp);
+#endif
+
+    for (; x < n; x += 2, s += 4, d += 2 * bpp)
+    {
+        yuv_pixel (s[y0_idx], s[u_idx], s[v_idx], k, d,       bpp);
+        yuv_pixel (s[y1_idx], s[u_idx], s[v_idx], k, d + bpp, bpp);
+    }
+}
+
+/* (n) pixels of planar Y, U, V */
+static void
+convert_row_444 (const unsigned char *sy, const unsigned char *su, const unsigned char *sv,
+                 int n, const yuv_coef_t *k, unsigned char *d, int bpp)
+{
+    int x = 0;
+
+#if defined (YUV_USE_AVX2)
+    for (; x + 16 <= n; x += 16, d += 16 * bpp)
+        yuv444_16px_avx2 (sy + x, su + x, sv + x, k, d, bpp);
+#endif
+#if defined (YUV_USE_SSE2)
+    for (; x + 8 <= n; x += 8, d += 8 * bpp)
+        yuv444_8px_sse2 (sy + x, su + x, sv + x, k, d, bpp);
+#elif defined (YUV_USE_NEON)
+    for (; x + 8 <= n; x += 8, d += 8 * bpp)
+        yuv444_8px_neon (sy + x, su + x, sv + x, k, d, bpp);
+#endif
+
+    for (; x < n; x ++, d += bpp)
+        yuv_pixel (sy[x], su[x], sv[x], k, d, bpp);
+}
+
+
+/* -------------------------------------------------- *
+ *  resize Y, U, V of one output row
+ *
+ *  box     : xtab[x] .. xtab[x + 1] are the source columns of the output
+ *            column (x). the source rows are summed up vertically first.
+ *  bilinear: xtab[4 * x] = {x0, fx, cx0, cfx}, the luma/chroma column and
+ *            its weight (0-256) of the output column (x).
+ * -------------------------------------------------- */
+static void
+resize_row_box (const yuv_job_t *job, int dy, unsigned char *scratch,
+                unsigned char *ry, unsigned char *ru, unsigned char *rv)
+{
+    int cw  = job->crop_w;
+    int sy0 = dy       * job->crop_h / job->dst_h;
+    int sy1 = (dy + 1) * job->crop_h / job->dst_h;
+    int yi0 = job->uyvy ? 1 : 0;
+    int ci0 = job->uyvy ? 0 : 1;
+    uint32_t *ysum = (uint32_t *)scratch;
+    uint32_t *csum = ysum + cw;         /* [u0 v0 u1 v1 ...] */
+    int x, sy;
+
+    if (sy1 <= sy0)
+        sy1 = sy0 + 1;
+
+    memset (ysum, 0, cw * 2 * sizeof (uint32_t));
+    for (sy = sy0; sy < sy1; sy ++)
+    {
+        const unsigned char *s = job->base + sy * job->stride;
+        for (x = 0; x < cw; x ++)
+        {
+            ysum[x] += s[2 * x + yi0];
+            csum[x] += s[2 * x + ci0];
+        }
+    }
+
+    for (x = 0; x < job->dst_w; x ++)
+    {
+        int sx0 = job->xtab[x];
+        int sx1 = job->xtab[x + 1];
+        uint32_t sum_y = 0, sum_u = 0, sum_v = 0;
+        uint32_t inv;
+        int sx;
+
+        if (sx1 <= sx0)
+            sx1 = sx0 + 1;
+
+        for (sx = sx0; sx < sx1; sx ++)
+        {
+            sum_y += ysum[sx];
+            sum_u += csum[(sx & ~1)    ];
+            sum_v += csum[(sx & ~1) + 1];
+        }
+
+        /* divide by the area */
+        inv = (65536 + (sx1 - sx0) * (sy1 - sy0) / 2) / ((sx1 - sx0) * (sy1 - sy0));
+        ry[x] = (sum_y * inv + 32768) >> 16;
+        ru[x] = (sum_u * inv + 32768) >> 16;
+        rv[x] = (sum_v * inv + 32768) >> 16;
+    }
+}
+
+static void
+resize_row_bilinear (const yuv_job_t *job, int dy,
+                     unsigned char *ry, unsigned char *ru, unsigned char *rv)
+{
+    int ch  = job->crop_h;
+    int fy  = ((2 * dy + 1) * ch * 128) / job->dst_h - 128;    /* (dy + 0.5) * scale - 0.5, 8bit fraction */
+    int yi0 = job->uyvy ? 1 : 0;
+    int ui  = job->uyvy ? 0 : 1;
+    int vi  = job->uyvy ? 2 : 3;
+    int sy0, sy1, x;
+    const unsigned char *s0, *s1;
+
+    if (fy < 0)
+        fy = 0;
+    sy0 = fy >> 8;
+    fy &= 0xFF;
+    sy1 = (sy0 + 1 < ch) ? sy0 + 1 : sy0;
+
+    s0 = job->base + sy0 * job->stride;
+    s1 = job->base + sy1 * job->stride;
+
+    for (x = 0; x < job->dst_w; x ++)
+    {
+        const int *t = &job->xtab[4 * x];
+        int lx0 = t[0], lx1 = t[0] + 1, fx = t[1];
+        int cx0 = t[2], cx1 = t[2] + 1, cfx = t[3];
+        int top, bot;
+
+        if (lx1 >= job->crop_w)     lx1 = lx0;
+        if (cx1 >= job->crop_w / 2) cx1 = cx0;
+
+#define LERP2(a, b, f)  ((a) * 256 + ((b) - (a)) * (f))
+        top = LERP2 (s0[2 * lx0 + yi0], s0[2 * lx1 + yi0], fx);
+        bot = LERP2 (s1[2 * lx0 + yi0], s1[2 * lx1 + yi0], fx);
+        ry[x] = (top * 256 + (bot - top) * fy + 32768) >> 16;
+
+        top = LERP2 (s0[4 * cx0 + ui], s0[4 * cx1 + ui], cfx);
+        bot = LERP2 (s1[4 * cx0 + ui], s1[4 * cx1 + ui], cfx);
+        ru[x] = (top * 256 + (bot - top) * fy + 32768) >> 16;
+
+        top = LERP2 (s0[4 * cx0 + vi], s0[4 * cx1 + vi], cfx);
+        bot = LERP2 (s1[4 * cx0 + vi], s1[4 * cx1 + vi], cfx);
+        rv[x] = (top * 256 + (bot - top) * fy + 32768) >> 16;
+#undef LERP2
+    }
+}
+
+
+static void
+yuv_run_band (void *arg, int band)
+{
+    const yuv_job_t *job = (const yuv_job_t *)arg;
+    int h  = job->dst_h;
+    int y0 = h * band       / job->num_bands;
+    int y1 = h * (band + 1) / job->num_bands;
+    int dst_pitch = job->dst_w * job->bpp;
+    unsigned char *scratch, *ry, *ru, *rv;
+    int y;
+
+    /* same size: no resampling */
+    if (job->dst_w == job->crop_w && job->dst_h == job->crop_h)
+    {
+        for (y = y0; y < y1; y ++)
+        {
+            convert_row_422 (job->base + y * job->stride, job->crop_w, job->uyvy,
+                             job->coef, job->dst + y * dst_pitch, job->bpp);
+        }
+        return;
+    }
+
+    /* [column sums for the box filter][Y row][U row][V row] */
+    scratch = (unsigned char *)s_band_buf[band].ptr;
+    ry = scratch + job->crop_w * 2 * sizeof (uint32_t);
+    ru = ry + job->dst_w;
+    rv = ru + job->dst_w;
+
+    for (y = y0; y < y1; y ++)
+    {
+        if (job->flags & YUV_SCALE_BILINEAR)
+            resize_row_bilinear (job, y, ry, ru, rv);
+        else
+            resize_row_box (job, y, scratch, ry, ru, rv);
+
+        convert_row_444 (ry, ru, rv, job->dst_w, job->coef, job->dst + y * dst_pitch, job->bpp);
+    }
+}
+
+
+/* -------------------------------------------------- *
+ *  worker threads
+ *
+ *  the rows are split into (num_bands) bands.
+ *  band 0 is processed by the calling thread.
+ * -------------------------------------------------- */
+int
+yuv_init (int num_threads)
+{
+    if (num_threads > YUV_MAX_THREADS)
+        num_threads = YUV_MAX_THREADS;
+
+    return bandpool_init (&s_pool, num_threads);
+}
+
+void
+yuv_terminate ()
+{
+    bandpool_terminate (&s_pool);
+}
+
+/* called with s_call_mutex locked. */
+static void
+yuv_run_job (yuv_job_t *job)
+{
+    job->num_bands = bandpool_split (&s_pool, job->dst_w * job->dst_h, YUV_MIN_PIXELS_PER_THREAD);
+    bandpool_run (&s_pool, yuv_run_band, job, job->num_bands);
+}
+
+
+/* -------------------------------------------------- *
+ *  API
+ * -------------------------------------------------- */
+int
+yuv_src_set (yuv_src_t *src, const void *buf, int w, int h, int stride, uint32_t format)
+{
+    if (buf == NULL || (format != YUV_FMT_YUYV && format != YUV_FMT_UYVY))
+        return -1;
+
+    src->buf    = (const unsigned char *)buf;
+    src->w      = w;
+    src->h      = h;
+    src->stride = stride ? stride : w * 2;
+    src->format = format;
+
+    return 0;
+}
+
+/* the source columns of each output column. */
+static int
+build_xtab (yuv_job_t *job)
+{
+    int cw = job->crop_w;
+    int dw = job->dst_w;
+    int *xtab;
+    int x;
+
+    if (job->flags & YUV_SCALE_BILINEAR)
+    {
+        xtab = (int *)preproc_buf_reserve (&s_xtab_buf, dw * 4 * sizeof (int));
+        if (xtab == NULL)
+            return -1;
+
+        for (x = 0; x < dw; x ++)
+        {
+            /* (x + 0.5) * scale - 0.5 with 8bit fraction. chroma is at the even luma. */
+            int fx  = ((2 * x + 1) * cw * 128) / dw - 128;
+            int cfx;
+
+            if (fx < 0)
+                fx = 0;
+            cfx = fx / 2;
+
+            xtab[4 * x + 0] = fx >> 8;
+            xtab[4 * x + 1] = fx & 0xFF;
+            xtab[4 * x + 2] = cfx >> 8;
+            xtab[4 * x + 3] = cfx & 0xFF;
+        }
+    }
+    else
+    {
+        xtab = (int *)preproc_buf_reserve (&s_xtab_buf, (dw + 1) * sizeof (int));
+        if (xtab == NULL)
+            return -1;
+
+        for (x = 0; x <= dw; x ++)
+            xtab[x] = x * cw / dw;
+    }
+
+    job->xtab = xtab;
+    return 0;
+}
+
+int
+yuv422_to_rgb (const yuv_src_t *src, int crop_x, int crop_y, int crop_w, int crop_h,
+               void *dst, int dst_w, int dst_h, int flags)
+{
+    yuv_job_t job;
+    int coef_idx, i, ret = 0;
+
+    if (crop_w <= 0 || crop_h <= 0)
+    {
+        crop_x = 0;
+        crop_y = 0;
+        crop_w = src->w;
+        crop_h = src->h;
+    }
+
+    crop_x &= ~1;
+    crop_w &= ~1;
+    if (crop_x < 0 || crop_y < 0 || crop_w <= 0 || dst_w <= 0 || dst_h <= 0 ||
+        crop_x + crop_w > src->w || crop_y + crop_h > src->h)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    coef_idx = ((flags & YUV_FULL_RANGE) ? 2 : 0) + ((flags & YUV_BT709) ? 1 : 0);
+
+    memset (&job, 0, sizeof (job));
+    job.base    = src->buf + crop_y * src->stride + crop_x * 2;
+    job.stride  = src->stride;
+    job.uyvy    = (src->format == YUV_FMT_UYVY);
+    job.crop_w  = crop_w;
+    job.crop_h  = crop_h;
+    job.dst     = (unsigned char *)dst;
+    job.dst_w   = dst_w;
+    job.dst_h   = dst_h;
+    job.bpp     = (flags & YUV_DST_RGB) ? 3 : 4;
+    job.flags   = flags;
+    job.coef    = &s_coef_table[coef_idx];
+
+    /* one job at a time. the workers and the scratch buffers are shared. */
+    pthread_mutex_lock (&s_call_mutex);
+
+    if (dst_w != crop_w || dst_h != crop_h)
+    {
+        int size = crop_w * 2 * sizeof (uint32_t) + dst_w * 3;
+
+        if (build_xtab (&job) < 0)
+            ret = -1;
+
+        for (i = 0; i < bandpool_get_num_threads (&s_pool) && ret == 0; i ++)
+        {
+            if (preproc_buf_reserve (&s_band_buf[i], size) == NULL)
+                ret = -1;
+        }
+    }
+
+    if (ret == 0)
+        yuv_run_job (&job);
+    else
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+
+    pthread_mutex_unlock (&s_call_mutex);
+
+    return ret;
+}
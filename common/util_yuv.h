@@ -0,0 +1,70 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef _UTIL_YUV_H_
+#define _UTIL_YUV_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  YUV 4:2:2 (YUYV/UYVY) to RGBA/RGB conversion for the camera frames.
+ *
+ *  a rectangle is cropped out of the frame and converted in one pass.
+ *  when the output size differs from the crop size, Y, U and V are resized
+ *  first (box: area average, or bilinear) and converted once per output
+ *  pixel, so the cost follows the output size rather than the frame size
+ *  (except the box filter, which reads every pixel in the crop).
+ *
+ *  the conversion is 16bit fixed point with SSE2/AVX2/NEON, and the rows
+ *  are split among the worker threads started by yuv_init().
+ */
+#define YUV_FOURCC(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+/* same values as pixfmt_fourcc() in util_texture.h */
+#define YUV_FMT_YUYV        YUV_FOURCC ('Y', 'U', 'Y', 'V')
+#define YUV_FMT_UYVY        YUV_FOURCC ('U', 'Y', 'V', 'Y')
+
+/* flags */
+#define YUV_BT709           (1 << 0)    /* BT.601 if not set */
+#define YUV_FULL_RANGE      (1 << 1)    /* limited range (Y:16-235, UV:16-240) if not set */
+#define YUV_DST_RGB         (1 << 2)    /* RGB888. RGBA8888 (A = 255) if not set */
+#define YUV_SCALE_BILINEAR  (1 << 3)    /* box filter if not set */
+
+#define YUV_MAX_THREADS     8
+
+typedef struct _yuv_src_t
+{
+    const unsigned char *buf;
+    int                 w, h;           /* in pixels */
+    int                 stride;         /* in bytes  */
+    uint32_t            format;         /* YUV_FMT_xxx */
+} yuv_src_t;
+
+/* start the worker threads. (num_threads = 0: number of online CPUs)
+ * without this, everything runs on the calling thread. */
+int  yuv_init (int num_threads);
+void yuv_terminate ();
+
+/* stride = 0 means a tightly packed image. returns -1 if (buf) is NULL or
+ * (format) is not supported. */
+int  yuv_src_set (yuv_src_t *src, const void *buf, int w, int h, int stride, uint32_t format);
+
+/*
+ *  convert the rectangle (crop_x, crop_y, crop_w, crop_h) to (dst_w x dst_h).
+ *  (crop_x) is rounded down to even. crop_w = 0 means the whole frame.
+ *  (dst) is tightly packed.
+ */
+int  yuv422_to_rgb (const yuv_src_t *src, int crop_x, int crop_y, int crop_w, int crop_h,
+                    void *dst, int dst_w, int dst_h, int flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _UTIL_YUV_H_ */
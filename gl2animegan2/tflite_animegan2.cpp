@@ -55,7 +55,7 @@ get_animegan2_input_buf (int *w, int *h)
 int
 invoke_animegan2 (animegan2_t *predict_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
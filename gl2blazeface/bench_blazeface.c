@@ -0,0 +1,137 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "util_tflite.h"
+#include "util_bench.h"
+#include "util_warp.h"
+#include "tflite_blazeface.h"
+
+/*
+ *  Headless benchmark of the blazeface detector (CPU only, no EGL/GLES).
+ *
+ *    $ make bench
+ *    $ ./gl2blazeface_bench -w 10 -n 200 -o result.json ./images/
+ */
+enum bench_stat_id {
+    STAT_DETECT_PRE = 0,
+    STAT_DETECT_INVOKE,
+    STAT_DETECT_POST,
+    STAT_FRAME,
+
+    STAT_NUM
+};
+
+static const char *s_stat_names[STAT_NUM] = {
+    "detect_preprocess",
+    "detect_invoke",
+    "detect_postprocess",
+    "frame",
+};
+
+static blazeface_config_t s_config;     /* defaults set by init_tflite_blazeface() */
+
+
+static void
+usage (const char *app)
+{
+    bench_opt_usage (app);
+    fprintf (stderr, "  -t num   : number of preprocess threads    (default: 1, 0: all CPUs)\n");
+    fprintf (stderr, "  -q       : use quantized models\n");
+}
+
+/* run one frame. record the latencies when stats != NULL. */
+static int
+run_frame (void *usr, bench_image_t *img, bench_stat_t *stats)
+{
+    warp_src_t src;
+    preproc_norm_t norm;
+    blazeface_result_t face_ret;
+    double t0, t1, t2;
+    int w, h;
+
+    (void)usr;
+
+    warp_src_set (&src, img->rgba, img->w, img->h, 0, WARP_FMT_RGBA);
+    preproc_norm_set (&norm, 128.0f, 128.0f);
+
+    float *det_input = (float *)get_blazeface_input_buf (&w, &h);
+
+    t0 = bench_get_time_ms ();
+    warp_resize_to_fp32 (&src, det_input, w, h, &norm, 0);
+    t1 = bench_get_time_ms ();
+    if (invoke_blazeface (&face_ret, &s_config) < 0)
+        return -1;
+    t2 = bench_get_time_ms ();
+
+    if (stats)
+    {
+        bench_stat_add_stage (stats, STAT_DETECT_PRE, t0, t1, t2, tflite_get_last_invoke_ms ());
+        bench_stat_add (&stats[STAT_FRAME], t2 - t0);
+    }
+
+    return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+    int num_threads = 1;
+    int use_quantized_tflite = 0;
+    bench_opt_t   opt;
+    bench_model_t model = {0};
+    int ret, c;
+
+    bench_opt_init (&opt);
+
+    while ((c = getopt (argc, argv, BENCH_OPTSTRING "t:qh")) != -1)
+    {
+        ret = bench_opt_parse (&opt, c, optarg);
+        if (ret > 0)
+            continue;
+        if (ret < 0)
+        {
+            usage (argv[0]);
+            return -1;
+        }
+
+        switch (c)
+        {
+        case 't':
+            num_threads = atoi (optarg);
+            break;
+        case 'q':
+            use_quantized_tflite = 1;
+            break;
+        default:
+            usage (argv[0]);
+            return -1;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage (argv[0]);
+        return -1;
+    }
+    opt.input = argv[optind];
+
+    if (init_tflite_blazeface (use_quantized_tflite, &s_config) < 0)
+        return -1;
+
+    warp_init (num_threads);
+
+    model.app        = "gl2blazeface";
+    model.num_stats  = STAT_NUM;
+    model.stat_names = s_stat_names;
+    model.run_frame  = run_frame;
+
+    ret = bench_run (&model, &opt);
+
+    warp_terminate ();
+
+    return ret;
+}
@@ -13,6 +13,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "tflite_blazeface.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
@@ -28,15 +29,10 @@
 void
 feed_blazeface_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_blazeface_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -46,23 +42,38 @@ feed_blazeface_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
 
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+/*
+ *  the capture thread has already scaled the frame to the network input
+ *  size (init_capture_ex), so the frame is converted without the GL readback.
+ *  returns -1 until the first frame arrives.
+ */
+static int
+feed_blazeface_image_from_capture ()
+{
+    int w, h, cap_w, cap_h;
+    float *buf_fp32 = (float *)get_blazeface_input_buf (&w, &h);
+    void  *cap_buf;
+
+    get_capture_dimension (&cap_w, &cap_h);
+    get_capture_buffer (&cap_buf);
+    if (cap_buf == NULL || cap_w != w || cap_h != h)
+        return -1;
+
+    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
+    float mean = 128.0f;
+    float std  = 128.0f;
+    preproc_rgba_to_fp32 ((unsigned char *)cap_buf, w, h, buf_fp32, mean, std);
+
+    return 0;
+}
+#endif
+
 
 static void
 render_detect_region (int ofstx, int ofsty, int texw, int texh,
@@ -197,6 +208,8 @@ main(int argc, char *argv[])
     double ttime[10] = {0}, interval, invoke_ms;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int capture_at_input_size = 0;
+    int cap_out_w = 0, cap_out_h = 0;
     imgui_data_t imgui_data = {0};
     UNUSED (argc);
     UNUSED (*argv);
@@ -206,7 +219,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "qsv:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -215,6 +228,9 @@ main(int argc, char *argv[])
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 's':
+                capture_at_input_size = 1;
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
@@ -250,6 +266,11 @@ main(int argc, char *argv[])
     glViewport (0, 0, win_w, win_h);
 #endif
 
+    /* -s: the capture thread scales the frame to the detector input size,
+     *     at the cost of the display resolution. */
+    if (capture_at_input_size)
+        get_blazeface_input_buf (&cap_out_w, &cap_out_h);
+
 #if defined (USE_INPUT_VIDEO_DECODE)
     /* initialize FFmpeg video decode */
     if (enable_video && init_video_decode () == 0)
@@ -263,7 +284,7 @@ main(int argc, char *argv[])
 #endif
 #if defined (USE_INPUT_CAMERA_CAPTURE)
     /* initialize V4L2 capture function */
-    if (enable_camera && init_capture (0) == 0)
+    if (enable_camera && init_capture_ex (0, cap_out_w, cap_out_h) == 0)
     {
         create_capture_texture (&captex);
         texw = captex.width;
@@ -318,6 +339,9 @@ main(int argc, char *argv[])
         /* --------------------------------------- *
          *  face detection
          * --------------------------------------- */
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+        if (!enable_camera || !capture_at_input_size || feed_blazeface_image_from_capture () < 0)
+#endif
         feed_blazeface_image (&captex, win_w, win_h);
 
         ttime[2] = pmeter_get_time_ms ();
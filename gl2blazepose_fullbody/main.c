@@ -13,6 +13,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "util_matrix.h"
 #include "tflite_blazepose.h"
 #include "util_camera_capture.h"
@@ -29,15 +30,10 @@
 void
 feed_pose_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_pose_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -47,19 +43,7 @@ feed_pose_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -67,15 +51,10 @@ feed_pose_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 void
 feed_pose_landmark_image(texture_2d_t *srctex, int win_w, int win_h, pose_detect_result_t *detection, unsigned int pose_id)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_pose_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -107,19 +86,7 @@ feed_pose_landmark_image(texture_2d_t *srctex, int win_w, int win_h, pose_detect
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -230,6 +197,8 @@ render_pose_landmark (int ofstx, int ofsty, int texw, int texh, pose_landmark_re
     float col_blue[]   = {0.0f, 0.5f, 1.0f, 1.0f};
     float col_white[]  = {1.0f, 1.0f, 1.0f, 1.0f};
 
+    begin_2d_batch ();
+
     float score = landmark->score;
     char buf[512];
     sprintf (buf, "score:%4.1f", score * 100);
@@ -292,6 +261,8 @@ render_pose_landmark (int ofstx, int ofsty, int texw, int texh, pose_landmark_re
         int r = 9;
         draw_2d_fillrect (x - (r/2), y - (r/2), r, r, col_red);
     }
+
+    end_2d_batch ();
 }
 
 
@@ -3,9 +3,10 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_anchor.h"
 #include "tflite_blazepose.h"
 #include "glue_mediapipe.h"
-#include <list>
+#include <algorithm>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/modules/pose_detection
@@ -26,7 +27,12 @@ static tflite_tensor_t      s_landmark_tensor_input;
 static tflite_tensor_t      s_landmark_tensor_landmark;
 static tflite_tensor_t      s_landmark_tensor_landmarkflag;
 
-static std::vector<Anchor>  s_anchors;
+static const anchor_table_t *s_anchors;
+
+/* region candidates (one slot per anchor), sized once at init time */
+static std::vector<detect_region_t> s_region_cands;
+static std::vector<nms_box_t>       s_region_boxes;
+static nms_t                        s_nms;
 
 
 static int
@@ -36,26 +42,24 @@ create_ssd_anchors(int input_w, int input_h)
      *  Anchor parameters are based on:
      *      mediapipe/modules/pose_detection/pose_detection_cpu.pbtxt
      */
-    SsdAnchorsCalculatorOptions anchor_options;
-    anchor_options.num_layers = 4;
-    anchor_options.min_scale = 0.1484375;
-    anchor_options.max_scale = 0.75;
-    anchor_options.input_size_height = 128;
-    anchor_options.input_size_width  = 128;
-    anchor_options.anchor_offset_x  = 0.5f;
-    anchor_options.anchor_offset_y  = 0.5f;
-//  anchor_options.feature_map_width .push_back(0);
-//  anchor_options.feature_map_height.push_back(0);
-    anchor_options.strides.push_back( 8);
-    anchor_options.strides.push_back(16);
-    anchor_options.strides.push_back(16);
-    anchor_options.strides.push_back(16);
-    anchor_options.aspect_ratios.push_back(1.0);
-    anchor_options.reduce_boxes_in_lowest_layer = false;
-    anchor_options.interpolated_scale_aspect_ratio = 1.0;
-    anchor_options.fixed_anchor_size = true;
-
-    GenerateAnchors (&s_anchors, anchor_options);
+    anchor_ssd_opt_t anchor_opt = anchor_ssd_opt_pose;
+    anchor_opt.input_w = input_w;
+    anchor_opt.input_h = input_h;
+
+    s_anchors = anchor_table_get_ssd (&anchor_opt);
+    if (s_anchors == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    s_region_cands.resize (s_anchors->num);
+    s_region_boxes.resize (s_anchors->num);
+    if (nms_init (&s_nms, s_anchors->num) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
 
     return 0;
 }
@@ -147,15 +151,16 @@ get_bbox_ptr (int anchor_idx)
 }
 
 static int
-decode_bounds (std::list<detect_region_t> &region_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (float score_thresh, int input_img_w, int input_img_h)
 {
-    detect_region_t region;
+    int    num_regions = 0;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
 
-    int i = 0;
-    for (auto itr = s_anchors.begin(); itr != s_anchors.end(); i ++, itr ++)
+    const float *anchor_cx = s_anchors->cx;
+    const float *anchor_cy = s_anchors->cy;
+
+    for (int i = 0; i < s_anchors->num; i ++)
     {
-        Anchor anchor = *itr;
         float score0 = scores_ptr[i];
         float score = 1.0f / (1.0f + exp(-score0));
 
@@ -169,8 +174,8 @@ decode_bounds (std::list<detect_region_t> &region_list, float score_thresh, int
             float w  = p[2];
             float h  = p[3];
 
-            float cx = sx + anchor.x_center * input_img_w;
-            float cy = sy + anchor.y_center * input_img_h;
+            float cx = sx + anchor_cx[i] * input_img_w;
+            float cy = sy + anchor_cy[i] * input_img_h;
 
             cx /= (float)input_img_w;
             cy /= (float)input_img_h;
@@ -183,6 +188,7 @@ decode_bounds (std::list<detect_region_t> &region_list, float score_thresh, int
             btmright.x = cx + w * 0.5f;
             btmright.y = cy + h * 0.5f;
 
+            detect_region_t &region = s_region_cands[num_regions];
             region.score    = score;
             region.topleft  = topleft;
             region.btmright = btmright;
@@ -192,8 +198,8 @@ decode_bounds (std::list<detect_region_t> &region_list, float score_thresh, int
             {
                 float lx = p[4 + (2 * j) + 0];
                 float ly = p[4 + (2 * j) + 1];
-                lx += anchor.x_center * input_img_w;
-                ly += anchor.y_center * input_img_h;
+                lx += anchor_cx[i] * input_img_w;
+                ly += anchor_cy[i] * input_img_h;
                 lx /= (float)input_img_w;
                 ly /= (float)input_img_h;
 
@@ -201,10 +207,10 @@ decode_bounds (std::list<detect_region_t> &region_list, float score_thresh, int
                 region.keys[j].y = ly;
             }
 
-            region_list.push_back (region);
+            num_regions ++;
         }
     }
-    return 0;
+    return num_regions;
 }
 
 
@@ -322,23 +328,16 @@ compute_detect_to_roi (detect_region_t &region)
 
 
 static void
-pack_detect_result (pose_detect_result_t *detect_result, std::list<detect_region_t> &region_list)
+pack_detect_result (pose_detect_result_t *detect_result, int num_regions)
 {
-    int num_regions = 0;
-    for (auto itr = region_list.begin(); itr != region_list.end(); itr ++)
+    for (int i = 0; i < num_regions; i ++)
     {
-        detect_region_t region = *itr;
+        detect_region_t &region = detect_result->poses[i];
 
         compute_rotation (region);
         compute_detect_to_roi (region);
-
-        memcpy (&detect_result->poses[num_regions], &region, sizeof (region));
-        num_regions ++;
-        detect_result->num = num_regions;
-
-        if (num_regions >= MAX_POSE_NUM)
-            break;
     }
+    detect_result->num = num_regions;
 }
 
 
@@ -348,7 +347,7 @@ pack_detect_result (pose_detect_result_t *detect_result, std::list<detect_region
 int
 invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t *config)
 {
-    if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_detect_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -356,22 +355,24 @@ invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t *con
 
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<detect_region_t> region_list;
+    int   num_regions;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
-    decode_bounds (region_list, score_thresh, input_img_w, input_img_h);
+    int num_dets = decode_bounds (score_thresh, input_img_w, input_img_h);
 
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<detect_region_t> region_nms_list;
 
-    non_max_suppression (region_list, region_nms_list, iou_thresh);
-    pack_detect_result (detect_result, region_nms_list);
+    num_regions = non_max_suppression (&s_nms, s_region_boxes.data(), s_region_cands.data(),
+                                       num_dets, detect_result->poses, iou_thresh);
 #else
-    pack_detect_result (detect_result, region_list);
+    num_regions = std::min (num_dets, MAX_POSE_NUM);
+    for (int i = 0; i < num_regions; i ++)
+        memcpy (&detect_result->poses[i], &s_region_cands[i], sizeof (detect_region_t));
 #endif
+    pack_detect_result (detect_result, num_regions);
 
     return 0;
 }
@@ -384,7 +385,7 @@ invoke_pose_detect (pose_detect_result_t *detect_result, blazepose_config_t *con
 int
 invoke_pose_landmark (pose_landmark_result_t *landmark_result)
 {
-    if (s_landmark_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_landmark_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
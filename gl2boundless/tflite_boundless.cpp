@@ -57,7 +57,7 @@ get_boundless_input_buf (int *w, int *h)
 int
 invoke_boundless (boundless_t *predict_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
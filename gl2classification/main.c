@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -13,9 +14,14 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "tflite_classification.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+#include "util_capture_mgr.h"
+#include "util_yuv.h"
+#endif
 
 #define UNUSED(x) (void)(x)
 
@@ -27,35 +33,17 @@
 void
 feed_classification_image_uint8 (texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     uint8_t *buf_u8 = (uint8_t *)get_classification_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
     glPixelStorei (GL_PACK_ALIGNMENT, 4);
     glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-
-            *buf_u8 ++ = r;
-            *buf_u8 ++ = g;
-            *buf_u8 ++ = b;
-        }
-    }
+    preproc_rgba_to_uint8 (buf_ui8, w, h, 0, buf_u8, &preproc_norm_none, 1.0f, 0, 0);
 
     return;
 }
@@ -63,15 +51,10 @@ feed_classification_image_uint8 (texture_2d_t *srctex, int win_w, int win_h)
 void
 feed_classification_image_float (texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_classification_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -81,19 +64,7 @@ feed_classification_image_float (texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -133,6 +104,149 @@ render_classification_result (int ofstx, int ofsty, int texw, int texh,
 }
 
 
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+/*
+ *  classify the frames of all the cameras with one model, without rendering.
+ *  (devlist): comma separated device numbers of /dev/videoN. "v" is a virtual camera.
+ */
+static int
+run_multi_camera (char *devlist)
+{
+    int w, h, count;
+    void *inbuf = get_classification_input_buf (&w, &h);
+    int type = get_classification_input_type ();
+    static preproc_buf_t s_rgbabuf;
+    unsigned char *rgba = (unsigned char *)preproc_buf_reserve (&s_rgbabuf, w * h * 4);
+    double stat_time = pmeter_get_time_ms ();
+
+    for (char *tok = strtok (devlist, ","); tok; tok = strtok (NULL, ","))
+    {
+        capmgr_config_t cfg;
+
+        capmgr_config_default (&cfg, (tok[0] == 'v') ? CAPMGR_VIRTUAL_DEVICE : atoi (tok));
+        cfg.queue_depth = 1;    /* the newest frame only */
+
+        if (capmgr_open_stream (&cfg) < 0)
+        {
+            capmgr_terminate ();
+            return -1;
+        }
+    }
+
+    yuv_init (0);
+
+    for (count = 0; ; count ++)
+    {
+        classification_result_t class_ret = {0};
+        capmgr_frame_t frame;
+        yuv_src_t src;
+        int ret;
+
+        /* the camera waiting the longest goes first. */
+        if (capmgr_acquire_any_frame (&frame, 1000) < 0)
+        {
+            fprintf (stderr, "ERR: %s(%d): no frame from the cameras.\n", __FILE__, __LINE__);
+            break;
+        }
+
+        /* resize the whole frame to the network input size, as the GL path does. */
+        ret = yuv_src_set (&src, frame.buf, frame.width, frame.height, frame.stride, frame.pixformat);
+        if (ret == 0)
+            ret = yuv422_to_rgb (&src, 0, 0, 0, 0, rgba, w, h, 0);
+        capmgr_release_frame (&frame);
+
+        if (ret < 0)
+        {
+            fprintf (stderr, "ERR: %s(%d): pixformat(%.4s) is not supported.\n",
+                __FILE__, __LINE__, (char *)&frame.pixformat);
+            break;
+        }
+
+        if (type)
+            preproc_rgba_to_uint8 (rgba, w, h, 0, (uint8_t *)inbuf, &preproc_norm_none, 1.0f, 0, 0);
+        else
+            preproc_rgba_to_fp32 (rgba, w, h, (float *)inbuf, 128.0f, 128.0f);
+
+        invoke_classification (&class_ret);
+
+        if (class_ret.num > 0)
+        {
+            classify_t *top = &class_ret.classify[0];
+            printf ("cam%d %u: %s (%.3f)\n", frame.stream, frame.seq, top->name, top->score);
+        }
+
+        if (pmeter_get_time_ms () - stat_time > 5000)
+        {
+            for (int i = 0; i < capmgr_get_num_streams (); i ++)
+            {
+                capmgr_stats_t stats;
+
+                capmgr_get_stats (i, &stats);
+                fprintf (stderr, "cam%d: %5.1f fps, dropped %u, overwritten %u, latency %.1f (max %.1f) [ms]\n",
+                         i, stats.fps, stats.num_dropped, stats.num_overwritten,
+                         stats.latency_avg_ms, stats.latency_max_ms);
+            }
+            stat_time = pmeter_get_time_ms ();
+        }
+    }
+
+    capmgr_terminate ();
+    yuv_terminate ();
+    return 0;
+}
+#endif
+
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+/*
+ *  classify every frame of the video once, as fast as possible, without rendering.
+ *  the decoder scales the frames to the network input size, so they are fed directly.
+ */
+static int
+run_video_batch (const char *fname)
+{
+    int w, h, count;
+    void *inbuf = get_classification_input_buf (&w, &h);
+    int type = get_classification_input_type ();
+    unsigned char *rgba;
+    double t0, total_ms;
+
+    if (set_video_decode_offline (w, h, pixfmt_fourcc ('R', 'G', 'B', 'A'), 4) < 0 ||
+        open_video_file (fname) < 0 ||
+        start_video_decode () < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    t0 = pmeter_get_time_ms ();
+    for (count = 0; acquire_video_frame ((void **)&rgba, NULL) == 0; count ++)
+    {
+        classification_result_t class_ret = {0};
+
+        if (type)
+            preproc_rgba_to_uint8 (rgba, w, h, 0, (uint8_t *)inbuf, &preproc_norm_none, 1.0f, 0, 0);
+        else
+            preproc_rgba_to_fp32 (rgba, w, h, (float *)inbuf, 128.0f, 128.0f);
+        release_video_frame ();
+
+        invoke_classification (&class_ret);
+
+        if (class_ret.num > 0)
+        {
+            classify_t *top = &class_ret.classify[0];
+            printf ("%d: %s (%.3f)\n", count, top->name, top->score);
+        }
+    }
+
+    total_ms = pmeter_get_time_ms () - t0;
+    fprintf (stderr, "processed %d frames in %.1f [s] (%.1f fps)\n",
+             count, total_ms / 1000, count * 1000 / total_ms);
+    return 0;
+}
+#endif
+
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -193,15 +307,19 @@ main(int argc, char *argv[])
     double ttime[10] = {0}, interval, invoke_ms;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    char *multi_camera = NULL;  /* "0,2,..." classify several cameras in turn */
+#endif
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
     int enable_video = 0;
+    int enable_batch = 0;   /* process every frame of the video once, as fast as possible */
 #endif
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "bm:qv:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -210,7 +328,15 @@ main(int argc, char *argv[])
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+            case 'm':
+                multi_camera = optarg;
+                break;
+#endif
 #if defined (USE_INPUT_VIDEO_DECODE)
+            case 'b':
+                enable_batch = 1;
+                break;
             case 'v':
                 enable_video = 1;
                 input_name = optarg;
@@ -243,10 +369,18 @@ main(int argc, char *argv[])
     glViewport (0, 0, win_w, win_h);
 #endif
 
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    if (multi_camera)
+        return run_multi_camera (multi_camera);
+#endif
+
 #if defined (USE_INPUT_VIDEO_DECODE)
     /* initialize FFmpeg video decode */
     if (enable_video && init_video_decode () == 0)
     {
+        if (enable_batch)
+            return run_video_batch (input_name);
+
         create_video_texture (&captex, input_name);
         texw = captex.width;
         texh = captex.height;
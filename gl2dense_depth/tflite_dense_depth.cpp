@@ -60,7 +60,7 @@ get_dense_depth_input_buf (int *w, int *h)
 int
 invoke_dense_depth (dense_depth_result_t *dense_depth_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <limits>
+#include "util_arena.h"
 #include "detect_postprocess.h"
 
 static float    *s_anchors;
@@ -16,6 +18,7 @@ static int      s_anchors_count;
 
 static float    *s_decoded_boxes;
 static uint8_t  *s_active_candidate;
+static uint8_t  *s_valid_anchor;        /* anchors which have a score above the threshold */
 
 /* Attrubutes of TFLite_Detection_PostProcess */
 #define ATTR_X_SCALE                      10.0
@@ -63,8 +66,86 @@ struct CenterSizeEncoding {
     float w;
 };
 
-int
-DecodeCenterSizeBoxes (float *decoded_boxes, const float *input_box_encodings) 
+
+/*
+ *  the scores are compared in the type of the output tensor (float/uint8/int8).
+ *  the score threshold is converted to the type once, and only the scores of
+ *  the selected boxes are dequantized. the order of the values doesn't change
+ *  with dequantization as (quant_scale) is positive.
+ */
+template <typename T> struct ScoreType        { typedef int   thresh_t; };
+template <>           struct ScoreType<float> { typedef float thresh_t; };
+
+template <typename T> static inline float
+Dequantize (T val, const QuantParam &q)
+{
+    return (val - q.zerop) * q.scale;
+}
+
+template <> inline float
+Dequantize<float> (float val, const QuantParam &q)
+{
+    return val;
+}
+
+/* the minimum (qval) which satisfies (Dequantize (qval) >= thresh) */
+template <typename T> static typename ScoreType<T>::thresh_t
+QuantizeThreshold (float thresh, const QuantParam &q)
+{
+    const int qmin = std::numeric_limits<T>::min();
+    const int qmax = std::numeric_limits<T>::max();
+
+    float fval = std::ceil (thresh / q.scale) + q.zerop;
+    fval = std::min<float> (std::max<float> (fval, qmin), qmax + 1);
+    int   qval = (int)fval;
+
+    /* absorb the rounding error of the division */
+    while (qval > qmin && Dequantize<T> ((T)(qval - 1), q) >= thresh)
+        qval --;
+    while (qval <= qmax && Dequantize<T> ((T)qval, q) < thresh)
+        qval ++;
+
+    return qval;
+}
+
+template <> float
+QuantizeThreshold<float> (float thresh, const QuantParam &q)
+{
+    return thresh;
+}
+
+
+/*
+ *  the max class score of each anchor. the anchors whose max score is below
+ *  the threshold can't be selected by either NMS, so their boxes are not decoded.
+ */
+template <typename T> static int
+SelectValidAnchors (const T *scores, typename ScoreType<T>::thresh_t threshold,
+                    T *max_scores, uint8_t *valid_anchor)
+{
+    const int num_boxes   = s_anchors_count;
+    const int num_classes = ATTR_NUM_CLASSES;
+    const int label_offset = 1;
+    const int num_classes_with_background = num_classes + label_offset;
+    int num_valid = 0;
+
+    for (int row = 0; row < num_boxes; row++) {
+        const T* box_scores = scores + row * num_classes_with_background + label_offset;
+        T max_score = box_scores[0];
+        for (int col = 1; col < num_classes; col++)
+            max_score = std::max (max_score, box_scores[col]);
+
+        max_scores[row]   = max_score;
+        valid_anchor[row] = (max_score >= threshold);
+        num_valid += valid_anchor[row];
+    }
+    return num_valid;
+}
+
+
+template <typename T> static int
+DecodeCenterSizeBoxes (float *decoded_boxes, const T *input_box_encodings,
+                       const QuantParam &q, const uint8_t *valid_anchor)
 {
     int num_boxes        = s_anchors_count;
     float *input_anchors = s_anchors;
@@ -77,8 +158,15 @@ DecodeCenterSizeBoxes (float *decoded_boxes, const float *input_box_encodings)
 
     for (int idx = 0; idx < num_boxes; ++idx) 
     {
-        box_centersize = reinterpret_cast<const CenterSizeEncoding*>(input_box_encodings)[idx];
-        anchor         = reinterpret_cast<const CenterSizeEncoding*>(input_anchors)[idx];
+        if (!valid_anchor[idx])
+            continue;
+
+        const T *encoding = &input_box_encodings[idx * 4];
+        box_centersize.y = Dequantize<T> (encoding[0], q);
+        box_centersize.x = Dequantize<T> (encoding[1], q);
+        box_centersize.h = Dequantize<T> (encoding[2], q);
+        box_centersize.w = Dequantize<T> (encoding[3], q);
+        anchor           = reinterpret_cast<const CenterSizeEncoding*>(input_anchors)[idx];
 
         float ycenter = box_centersize.y / scale_values.y * anchor.h + anchor.y;
         float xcenter = box_centersize.x / scale_values.x * anchor.w + anchor.x;
@@ -99,7 +187,8 @@ DecodeCenterSizeBoxes (float *decoded_boxes, const float *input_box_encodings)
 }
 
 
-void DecreasingPartialArgSort(const float* values, int num_values,
+template <typename T>
+void DecreasingPartialArgSort(const T* values, int num_values,
                               int num_to_sort, int* indices) {
   std::iota(indices, indices + num_values, 0);
   std::partial_sort(
@@ -108,16 +197,44 @@ void DecreasingPartialArgSort(const float* values, int num_values,
 }
 
 
-void SelectDetectionsAboveScoreThreshold(const std::vector<float>& values,
-                                         const float threshold,
-                                         std::vector<float>* keep_values,
-                                         std::vector<int>* keep_indices) {
-  for (unsigned int i = 0; i < values.size(); i++) {
+template <typename T>
+int SelectDetectionsAboveScoreThreshold(const T* values, int num_values,
+                                        const typename ScoreType<T>::thresh_t threshold,
+                                        T* keep_values, int* keep_indices) {
+  int num_kept = 0;
+  for (int i = 0; i < num_values; i++) {
     if (values[i] >= threshold) {
-      keep_values->emplace_back(values[i]);
-      keep_indices->emplace_back(i);
+      keep_values[num_kept] = values[i];
+      keep_indices[num_kept] = i;
+      num_kept++;
     }
   }
+  return num_kept;
+}
+
+
+/*
+ *  work buffers of NonMaxSuppressionSingleClassHelper() for (num_boxes) scores.
+ *  taken from the frame arena once, and shared by the per-class calls.
+ */
+template <typename T>
+struct NmsScratch {
+  T   *keep_scores;
+  int *keep_indices;
+  int *sorted_indices;
+};
+
+template <typename T> static int
+InitNmsScratch (NmsScratch<T> *scratch, arena_t *arena, int num_boxes)
+{
+    scratch->keep_scores    = (T   *)arena_alloc (arena, num_boxes * sizeof (T));
+    scratch->keep_indices   = (int *)arena_alloc (arena, num_boxes * sizeof (int));
+    scratch->sorted_indices = (int *)arena_alloc (arena, num_boxes * sizeof (int));
+
+    if (!scratch->keep_scores || !scratch->keep_indices || !scratch->sorted_indices)
+        return -1;
+
+    return 0;
 }
 
 
@@ -145,30 +262,29 @@ float ComputeIntersectionOverUnion(const float* decoded_boxes,
 // If lower-scoring box has too much overlap with a higher-scoring box,
 // we get rid of the lower-scoring box.
 // Complexity is O(N^2) pairwise comparison between boxes
-int
+//
+// (selected) has room for (max_detections). returns the number of the selected boxes.
+template <typename T> int
 NonMaxSuppressionSingleClassHelper(const float *decoded_boxes,
-                                   const std::vector<float>& scores, 
-                                   std::vector<int>* selected, int max_detections) {
+                                   const T* scores, int num_scores,
+                                   NmsScratch<T> *scratch,
+                                   int* selected, int max_detections,
+                                   const typename ScoreType<T>::thresh_t non_max_suppression_score_threshold) {
 
-    const float non_max_suppression_score_threshold = ATTR_NMS_SCORE_THRESHOLD;
     const float intersection_over_union_threshold   = ATTR_NMS_IOU_THRESHOLD;
 
     // threshold scores
-    std::vector<int> keep_indices;
-    // TODO (chowdhery): Remove the dynamic allocation and replace it
-    // with temporaries, esp for std::vector<float>
-    std::vector<float> keep_scores;
-    SelectDetectionsAboveScoreThreshold(
-        scores, non_max_suppression_score_threshold, &keep_scores, &keep_indices);
-
-    int num_scores_kept = keep_scores.size();
-    std::vector<int> sorted_indices;
-    sorted_indices.resize(num_scores_kept);
-    DecreasingPartialArgSort(keep_scores.data(), num_scores_kept, num_scores_kept,
-                                sorted_indices.data());
+    int *keep_indices   = scratch->keep_indices;
+    T   *keep_scores    = scratch->keep_scores;
+    int *sorted_indices = scratch->sorted_indices;
+    int num_scores_kept = SelectDetectionsAboveScoreThreshold(
+        scores, num_scores, non_max_suppression_score_threshold, keep_scores, keep_indices);
+
+    DecreasingPartialArgSort(keep_scores, num_scores_kept, num_scores_kept,
+                                sorted_indices);
     const int num_boxes_kept = num_scores_kept;
-    const unsigned int output_size = std::min(num_boxes_kept, max_detections);
-    selected->clear();
+    const int output_size = std::min(num_boxes_kept, max_detections);
+    int num_selected = 0;
 
     int num_active_candidate = num_boxes_kept;
     uint8_t* active_box_candidate = s_active_candidate;
@@ -177,9 +293,9 @@ NonMaxSuppressionSingleClassHelper(const float *decoded_boxes,
     }
 
     for (int i = 0; i < num_boxes_kept; ++i) {
-        if (num_active_candidate == 0 || selected->size() >= output_size) break;
+        if (num_active_candidate == 0 || num_selected >= output_size) break;
         if (active_box_candidate[i] == 1) {
-            selected->push_back(keep_indices[sorted_indices[i]]);
+            selected[num_selected++] = keep_indices[sorted_indices[i]];
             active_box_candidate[i] = 0;
             num_active_candidate--;
         } else {
@@ -199,7 +315,7 @@ NonMaxSuppressionSingleClassHelper(const float *decoded_boxes,
             }
         }
     }
-    return 0;
+    return num_selected;
 }
 
 
@@ -210,9 +326,11 @@ NonMaxSuppressionSingleClassHelper(const float *decoded_boxes,
 // 3) The worst runtime of the regular NMS is O(K*N^2)
 // where N is the number of anchors and K the number of
 // classes.
-int
-NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_boxes, 
-                                         const float *decoded_boxes, const float* scores) {
+template <typename T> int
+NonMaxSuppressionMultiClassRegularHelper(arena_vec_t *detection_boxes, arena_t *arena,
+                                         const float *decoded_boxes, const T* scores,
+                                         const QuantParam &scores_q,
+                                         const typename ScoreType<T>::thresh_t score_threshold) {
     const int num_boxes   = s_anchors_count;
     const int num_classes = ATTR_NUM_CLASSES;
     const int num_detections_per_class = ATTR_DETECTIONS_PER_CLASS;
@@ -223,16 +341,23 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
     const int num_classes_with_background = num_classes + label_offset;
 
     // For each class, perform non-max suppression.
-    std::vector<float> class_scores(num_boxes);
+    T   *class_scores = (T *)arena_alloc (arena, num_boxes * sizeof (T));
 
-    std::vector<int> box_indices_after_regular_non_max_suppression(num_boxes + max_detections);
-    std::vector<float> scores_after_regular_non_max_suppression(num_boxes +  max_detections);
+    int *box_indices_after_regular_non_max_suppression =
+                    (int *)arena_alloc (arena, (num_boxes + max_detections) * sizeof (int));
+    T   *scores_after_regular_non_max_suppression =
+                    (T   *)arena_alloc (arena, (num_boxes + max_detections) * sizeof (T));
 
     int size_of_sorted_indices = 0;
-    std::vector<int> sorted_indices;
-    sorted_indices.resize(num_boxes + max_detections);
-    std::vector<float> sorted_values;
-    sorted_values.resize(max_detections);
+    int *sorted_indices = (int *)arena_alloc (arena, (num_boxes + max_detections) * sizeof (int));
+    T   *sorted_values  = (T   *)arena_alloc (arena, max_detections * sizeof (T));
+    int *selected       = (int *)arena_alloc (arena, num_detections_per_class * sizeof (int));
+
+    NmsScratch<T> scratch;
+    if (!class_scores || !box_indices_after_regular_non_max_suppression ||
+        !scores_after_regular_non_max_suppression || !sorted_indices || !sorted_values ||
+        !selected || InitNmsScratch (&scratch, arena, num_boxes) < 0)
+        return -1;
 
     for (int col = 0; col < num_classes; col++) {
         for (int row = 0; row < num_boxes; row++) {
@@ -241,12 +366,14 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
                 *(scores + row * num_classes_with_background + col + label_offset);
         }
         // Perform non-maximal suppression on single class
-        std::vector<int> selected;
-        NonMaxSuppressionSingleClassHelper(decoded_boxes, class_scores, &selected, num_detections_per_class);
+        int num_selected = NonMaxSuppressionSingleClassHelper(decoded_boxes, class_scores, num_boxes,
+                                           &scratch, selected, num_detections_per_class,
+                                           score_threshold);
 
         // Add selected indices from non-max suppression of boxes in this class
         int output_index = size_of_sorted_indices;
-        for (const auto& selected_index : selected) {
+        for (int i = 0; i < num_selected; i++) {
+            const int selected_index = selected[i];
             box_indices_after_regular_non_max_suppression[output_index] =
                 (selected_index * num_classes_with_background + col + label_offset);
             scores_after_regular_non_max_suppression[output_index] =
@@ -257,9 +384,9 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
         // Sort the max scores among the selected indices
         // Get the indices for top scores
         int num_indices_to_sort = std::min(output_index, max_detections);
-        DecreasingPartialArgSort(scores_after_regular_non_max_suppression.data(),
+        DecreasingPartialArgSort(scores_after_regular_non_max_suppression,
                              output_index, num_indices_to_sort,
-                             sorted_indices.data());
+                             sorted_indices);
 
         // Copy values to temporary vectors
         for (int row = 0; row < num_indices_to_sort; row++) {
@@ -284,21 +411,21 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
             const int class_index =
                         box_indices_after_regular_non_max_suppression[output_box_index] -
                         anchor_index * num_classes_with_background - label_offset;
-            const float selected_score =
-                        scores_after_regular_non_max_suppression[output_box_index];
+            const float selected_score = Dequantize<T> (
+                        scores_after_regular_non_max_suppression[output_box_index], scores_q);
 
             BoxCornerEncoding box = reinterpret_cast<const BoxCornerEncoding*>(s_decoded_boxes)[anchor_index];
 
-            detection_boxes.push_back({box.xmin, box.ymin,
-                                       box.xmax, box.ymax,
-                                       selected_score, class_index});
+            DetectionBox *det = (DetectionBox *)arena_vec_push (detection_boxes);
+            if (det == NULL)
+                return -1;
+            *det = {box.xmin, box.ymin,
+                    box.xmax, box.ymax,
+                    selected_score, class_index};
         } else {
         }
     }
 
-    box_indices_after_regular_non_max_suppression.clear();
-    scores_after_regular_non_max_suppression.clear();
-
     return 0;
 }
 
@@ -310,9 +437,12 @@ NonMaxSuppressionMultiClassRegularHelper(std::vector<DetectionBox> &detection_bo
 // 3) Compared to standard NMS, the worst runtime of this version is O(N^2)
 // instead of O(KN^2) where N is the number of anchors and K the number of
 // classes.
-int
-NonMaxSuppressionMultiClassFastHelper (std::vector<DetectionBox> &detection_boxes, 
-                                       const float *decoded_boxes, const float* scores) {
+template <typename T> int
+NonMaxSuppressionMultiClassFastHelper (arena_vec_t *detection_boxes, arena_t *arena,
+                                       const float *decoded_boxes, const T* scores,
+                                       const QuantParam &scores_q,
+                                       const typename ScoreType<T>::thresh_t score_threshold,
+                                       const T *max_scores) {
     const int num_boxes   = s_anchors_count;
     const int num_classes = ATTR_NUM_CLASSES;
     const int max_categories_per_anchor = ATTR_MAX_CLASSES_PER_DETECTION;
@@ -322,30 +452,37 @@ NonMaxSuppressionMultiClassFastHelper (std::vector<DetectionBox> &detection_boxe
     const int num_classes_with_background = num_classes + label_offset;
     const int num_categories_per_anchor   = std::min(max_categories_per_anchor, num_classes);
 
-    std::vector<float> max_scores;
-    max_scores.resize(num_boxes);
-    std::vector<int> sorted_class_indices;
-    sorted_class_indices.resize(num_boxes * num_classes);
+    int *sorted_class_indices = (int *)arena_alloc (arena, num_boxes * num_classes * sizeof (int));
+    int *selected = (int *)arena_alloc (arena, ATTR_MAX_DETECTIONS * sizeof (int));
+
+    NmsScratch<T> scratch;
+    if (!sorted_class_indices || !selected || InitNmsScratch (&scratch, arena, num_boxes) < 0)
+        return -1;
 
+    // (max_scores) are given by SelectValidAnchors(). only the anchors above
+    // the threshold can be selected, so the classes of the others are not sorted.
     for (int row = 0; row < num_boxes; row++) {
-        const float* box_scores =
+        if (!s_valid_anchor[row])
+            continue;
+        const T* box_scores =
                     scores + row * num_classes_with_background + label_offset;
-        int* class_indices = sorted_class_indices.data() + row * num_classes;
+        int* class_indices = sorted_class_indices + row * num_classes;
         DecreasingPartialArgSort(box_scores, num_classes, num_categories_per_anchor,
                              class_indices);
-        max_scores[row] = box_scores[class_indices[0]];
     }
 
     // Perform non-maximal suppression on max scores
-    std::vector<int> selected;
-    NonMaxSuppressionSingleClassHelper(decoded_boxes, max_scores, &selected, ATTR_MAX_DETECTIONS);
+    int num_selected = NonMaxSuppressionSingleClassHelper(decoded_boxes, max_scores, num_boxes,
+                                       &scratch, selected, ATTR_MAX_DETECTIONS,
+                                       score_threshold);
 
     // Allocate output tensors
-    for (const auto& selected_index : selected) {
-        const float* box_scores =
+    for (int i = 0; i < num_selected; i++) {
+        const int selected_index = selected[i];
+        const T* box_scores =
                 scores + selected_index * num_classes_with_background + label_offset;
         const int* class_indices =
-                sorted_class_indices.data() + selected_index * num_classes;
+                sorted_class_indices + selected_index * num_classes;
 
         for (int col = 0; col < num_categories_per_anchor; ++col) {
 
@@ -356,11 +493,14 @@ NonMaxSuppressionMultiClassFastHelper (std::vector<DetectionBox> &detection_boxe
             int class_index = class_indices[col];
 
             // detection_scores
-            float score = box_scores[class_index];
-
-            detection_boxes.push_back({box.xmin, box.ymin,
-                                       box.xmax, box.ymax,
-                                       score, class_index});
+            float score = Dequantize<T> (box_scores[class_index], scores_q);
+
+            DetectionBox *det = (DetectionBox *)arena_vec_push (detection_boxes);
+            if (det == NULL)
+                return -1;
+            *det = {box.xmin, box.ymin,
+                    box.xmax, box.ymax,
+                    score, class_index};
         }
     }
 
@@ -415,33 +555,68 @@ init_detect_postprocess (std::string filename)
 
     s_decoded_boxes    = new float  [s_anchors_count * 4];
     s_active_candidate = new uint8_t[s_anchors_count];
+    s_valid_anchor     = new uint8_t[s_anchors_count];
 
     return 0;
 }
 
 
-int
-invoke_detection_postprocess (std::vector<DetectionBox> &detection_boxes,  /* [OUT] */
-                              const float *boxes_ptr,                      /* [IN ] */
-                              const float *scores_ptr)                     /* [IN ] */
+template <typename T> static int
+InvokeDetectionPostprocess (arena_vec_t *detection_boxes,
+                            const T *boxes_ptr,  const QuantParam &boxes_q,
+                            const T *scores_ptr, const QuantParam &scores_q)
 {
+    arena_t *arena = detection_boxes->arena;
     float *decoded_boxes = s_decoded_boxes;
+    T *max_scores = (T *)arena_alloc (arena, s_anchors_count * sizeof (T));
+    if (max_scores == NULL)
+        return -1;
+
+    typename ScoreType<T>::thresh_t score_thresh =
+        QuantizeThreshold<T> (ATTR_NMS_SCORE_THRESHOLD, scores_q);
+
+    SelectValidAnchors (scores_ptr, score_thresh, max_scores, s_valid_anchor);
 
     /*
      *  decode detected bbox. 
      *      (decoded_boxes) = (boxes_ptr) * (anchor.wh) + (anchor.xy);
      */
-    DecodeCenterSizeBoxes (decoded_boxes, boxes_ptr);
+    DecodeCenterSizeBoxes (decoded_boxes, boxes_ptr, boxes_q, s_valid_anchor);
 
     if (ATTR_USE_REGULAR_NMS)
     {
-        NonMaxSuppressionMultiClassRegularHelper(detection_boxes, decoded_boxes, scores_ptr);
+        return NonMaxSuppressionMultiClassRegularHelper (detection_boxes, arena, decoded_boxes,
+                                                         scores_ptr, scores_q, score_thresh);
     }
     else
     {
-        NonMaxSuppressionMultiClassFastHelper (detection_boxes, decoded_boxes, scores_ptr);
+        return NonMaxSuppressionMultiClassFastHelper (detection_boxes, arena, decoded_boxes,
+                                                      scores_ptr, scores_q, score_thresh, max_scores);
     }
+}
 
-    return 0;
+int
+invoke_detection_postprocess (arena_vec_t *detection_boxes,                /* [OUT] */
+                              const float *boxes_ptr,                      /* [IN ] */
+                              const float *scores_ptr)                     /* [IN ] */
+{
+    QuantParam q = {1.0f, 0};
+
+    return InvokeDetectionPostprocess (detection_boxes, boxes_ptr, q, scores_ptr, q);
+}
+
+int
+invoke_detection_postprocess (arena_vec_t *detection_boxes,
+                              const uint8_t *boxes_ptr,  const QuantParam &boxes_q,
+                              const uint8_t *scores_ptr, const QuantParam &scores_q)
+{
+    return InvokeDetectionPostprocess (detection_boxes, boxes_ptr, boxes_q, scores_ptr, scores_q);
 }
 
+int
+invoke_detection_postprocess (arena_vec_t *detection_boxes,
+                              const int8_t *boxes_ptr,  const QuantParam &boxes_q,
+                              const int8_t *scores_ptr, const QuantParam &scores_q)
+{
+    return InvokeDetectionPostprocess (detection_boxes, boxes_ptr, boxes_q, scores_ptr, scores_q);
+}
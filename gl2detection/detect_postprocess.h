@@ -5,6 +5,7 @@
 #ifndef _DETECT_POSTPROCESS_H_
 #define _DETECT_POSTPROCESS_H_
 
+#include "util_arena.h"
 
 struct DetectionBox {
     float x1;
@@ -15,11 +16,35 @@ struct DetectionBox {
     int   class_id;
 };
 
+/* quantization of a uint8/int8 tensor: real = (qval - zerop) * scale */
+struct QuantParam {
+    float scale;
+    int   zerop;
+};
+
 int init_detect_postprocess (std::string filename);
 
+/*
+ *  (detection_boxes) is a vector of DetectionBox. the work buffers are
+ *  taken from its arena too, so reset the arena at the frame boundary.
+ */
 int
-invoke_detection_postprocess (std::vector<DetectionBox> &detection_boxes,  /* [OUT] */
+invoke_detection_postprocess (arena_vec_t *detection_boxes,                /* [OUT] */
                               const float *boxes_ptr,                      /* [IN ] */
                               const float *_scores_ptr);                   /* [IN ] */
 
+/*
+ *  for the full-integer models. the scores are thresholded and sorted
+ *  without dequantization, and only the boxes of the anchors above
+ *  the score threshold are decoded.
+ */
+int
+invoke_detection_postprocess (arena_vec_t *detection_boxes,
+                              const uint8_t *boxes_ptr,  const QuantParam &boxes_q,
+                              const uint8_t *scores_ptr, const QuantParam &scores_q);
+int
+invoke_detection_postprocess (arena_vec_t *detection_boxes,
+                              const int8_t *boxes_ptr,  const QuantParam &boxes_q,
+                              const int8_t *scores_ptr, const QuantParam &scores_q);
+
 #endif /* _DETECT_POSTPROCESS_H_ */
@@ -3,6 +3,7 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_arena.h"
 #include "util_debug.h"
 #include "tflite_detect.h"
 #include "detect_postprocess.h"
@@ -41,8 +42,6 @@ static tflite_tensor_t  s_tensor_input;
 #if defined (INVOKE_POSTPROCESS_AFTER_TFLITE)
 static tflite_tensor_t  s_tensor_boxes;
 static tflite_tensor_t  s_tensor_scores;
-static float            *s_boxes_buf;
-static float            *s_scores_buf;
 #else
 static tflite_tensor_t  s_tensor_boxes;
 static tflite_tensor_t  s_tensor_scores;
@@ -187,16 +186,6 @@ init_tflite_detection(int use_quantized_tflite)
     tflite_get_tensor_by_name (&s_interpreter, 1, "raw_outputs/box_encodings",     &s_tensor_boxes);
     tflite_get_tensor_by_name (&s_interpreter, 1, "raw_outputs/class_predictions", &s_tensor_scores);
 
-    /* if it's a quantized model, allocate buffers for (uint8 -> float) convertion */
-    if (s_tensor_scores.type == kTfLiteUInt8)
-    {
-        int num_anchors = s_tensor_scores.dims[1];
-        int num_classes = s_tensor_scores.dims[2];
-
-        s_scores_buf = new float[num_anchors * num_classes];
-        s_boxes_buf  = new float[num_anchors * 4]; /* float4 {x0, y0, x1, y1} */
-    }
-
     init_detect_postprocess (ANCHORS_FILE);
 #else
     /* get output tensor */
@@ -245,49 +234,59 @@ get_detect_class_color (int class_idx)
 int
 invoke_detect (detect_result_t *detection)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
 #if defined (INVOKE_POSTPROCESS_AFTER_TFLITE)
-    std::vector<DetectionBox> detection_boxes = {};
-    float *scores = (float *)s_tensor_scores.ptr;
-    float *boxes  = (float *)s_tensor_boxes.ptr;
+    arena_t *arena = arena_get_thread ();
+    arena_reset (arena);
 
-    /* if it's a quantized model, convert uint8 -> float */
-    if (s_tensor_scores.type == kTfLiteUInt8)
-    {
-        int num_anchors = s_tensor_scores.dims[1];
-        int num_classes = s_tensor_scores.dims[2];
-        uint8_t *scores_u8 = (uint8_t *)s_tensor_scores.ptr;
-        uint8_t *boxes_u8  = (uint8_t *)s_tensor_boxes.ptr;
-
-        scores = s_scores_buf;
-        boxes  = s_boxes_buf;
+    arena_vec_t detection_boxes;
+    int ret;
+    arena_vec_init (&detection_boxes, arena, sizeof (DetectionBox), MAX_DETECT_OBJS);
 
-        for (int i = 0; i < num_anchors * num_classes; i ++)
-            scores[i] = (scores_u8[i] - s_tensor_scores.quant_zerop) * s_tensor_scores.quant_scale;
+    QuantParam boxes_q  = {s_tensor_boxes .quant_scale, s_tensor_boxes .quant_zerop};
+    QuantParam scores_q = {s_tensor_scores.quant_scale, s_tensor_scores.quant_zerop};
 
-        for (int i = 0; i < num_anchors * 4; i ++)
-            boxes[i] = (boxes_u8[i] - s_tensor_boxes.quant_zerop) * s_tensor_boxes.quant_scale;
+    /* quantized models are post-processed without dequantizing the whole tensors */
+    if (s_tensor_scores.type == kTfLiteUInt8)
+    {
+        ret = invoke_detection_postprocess (&detection_boxes, (uint8_t *)s_tensor_boxes .ptr, boxes_q,
+                                                              (uint8_t *)s_tensor_scores.ptr, scores_q);
+    }
+    else if (s_tensor_scores.type == kTfLiteInt8)
+    {
+        ret = invoke_detection_postprocess (&detection_boxes, (int8_t *)s_tensor_boxes .ptr, boxes_q,
+                                                              (int8_t *)s_tensor_scores.ptr, scores_q);
+    }
+    else
+    {
+        ret = invoke_detection_postprocess (&detection_boxes, (float *)s_tensor_boxes .ptr,
+                                                              (float *)s_tensor_scores.ptr);
+    }
+    if (ret < 0)
+    {
+        DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
     }
 
-    invoke_detection_postprocess (detection_boxes, boxes, scores);
-
-    int num = detection_boxes.size();
+    int num = detection_boxes.num;
     num = std::min (num, MAX_DETECT_OBJS);
 
     detection->num = num;
     for (int i = 0; i < num; i ++)
     {
-        detection->obj[i].x1        = detection_boxes[i].x1;
-        detection->obj[i].y1        = detection_boxes[i].y1;
-        detection->obj[i].x2        = detection_boxes[i].x2;
-        detection->obj[i].y2        = detection_boxes[i].y2;
-        detection->obj[i].score     = detection_boxes[i].score;
-        detection->obj[i].det_class = detection_boxes[i].class_id;
+        DetectionBox *box = &ARENA_VEC_AT (&detection_boxes, DetectionBox, i);
+
+        detection->obj[i].x1        = box->x1;
+        detection->obj[i].y1        = box->y1;
+        detection->obj[i].x2        = box->x2;
+        detection->obj[i].y2        = box->y2;
+        detection->obj[i].score     = box->score;
+        detection->obj[i].det_class = box->class_id;
     }
 #else
     float *boxes   = (float *)s_tensor_boxes.ptr;
@@ -14,6 +14,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "util_matrix.h"
 #include "tflite_face_portrait.h"
 #include "util_camera_capture.h"
@@ -29,15 +30,10 @@
 void
 feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -47,19 +43,7 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -67,15 +51,10 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 void
 feed_portrait_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_portrait_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -108,24 +87,13 @@ feed_portrait_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_resu
     /* convert UI8 [0, 255] ==> FP32 [-2, 2] */
     float mean = 128.0f;
     float std  = 128.0f / 2.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 #else
     /* 
      * normalize input image based on
      *   https://github.com/NathanUA/U-2-Net/blob/master/u2net_portrait_demo.py
      */
+    int x, y;
     int maxr = 0, maxg = 0, maxb = 0;
     for (y = 0; y < h; y ++)
     {
@@ -141,27 +109,10 @@ feed_portrait_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_resu
         }
     }
 
-    buf_ui8 = pui8;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-
-            float fr = r/(float)maxr;
-            float fg = g/(float)maxg;
-            float fb = b/(float)maxb;
-            fr = (fr - 0.406f) / 0.225f;
-            fg = (fg - 0.456f) / 0.224f;
-            fb = (fb - 0.485f) / 0.229f;
-            *buf_fp32 ++ = fr;
-            *buf_fp32 ++ = fg;
-            *buf_fp32 ++ = fb;
-        }
-    }
+    /* ((r / maxr) - 0.406) / 0.225  ==  (r - 0.406 * maxr) / (0.225 * maxr) */
+    preproc_norm_t norm = {{0.406f * maxr, 0.456f * maxg, 0.485f * maxb},
+                           {0.225f * maxr, 0.224f * maxg, 0.229f * maxb}};
+    preproc_rgba_to_fp32_ex ((unsigned char *)s_readbuf.ptr, w, h, 0, buf_fp32, &norm, 0);
 #endif
     return;
 }
@@ -231,14 +182,6 @@ render_cropped_face_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw,
     draw_2d_texture_ex_texcoord (srctex, ofstx, ofsty, texw, texh, texcoord);
 }
 
-float
-fclampf (float val)
-{
-    val = fmaxf (0.0f, val);
-    val = fminf (1.0f, val);
-    return val;
-}
-
 static void
 render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int texh,
                        face_detect_result_t *detection, unsigned int face_id, portrait_result_t *portrait_ret)
@@ -246,43 +189,19 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     if (detection->num <= face_id)
         return;
 
+    static stream_texture_t s_animtex[MAX_FACE_NUM];
     float *pimg = portrait_ret->portrait_img;
     int pimg_w  = portrait_ret->portrait_img_dims[0];
     int pimg_h  = portrait_ret->portrait_img_dims[1];
-    int x, y;
-    unsigned int imgbuf[pimg_h][pimg_w];
-
-    /* find the min/max value for normalization. */
-    float colmax = -FLT_MAX;
-    float colmin =  FLT_MAX;
-    for (y = 0; y < pimg_h; y ++)
-    {
-        for (x = 0; x < pimg_w; x ++)
-        {
-            float col = pimg[(y * pimg_w + x)];
-            if (col > colmax) colmax = col;
-            if (col < colmin) colmin = col;
-        }
-    }
+    unsigned char imgbuf[pimg_h][pimg_w];
 
-    /* normalize portrait image */
-    for (y = 0; y < pimg_h; y ++)
-    {
-        for (x = 0; x < pimg_w; x ++)
-        {
-            float col = pimg[(y * pimg_w + x)];
-            col = (col - colmin)/(colmax - colmin);
-            col = 1.0f - col;
-            col = fclampf (col) * 255;
-
-            unsigned char r = ((unsigned int)col) & 0xff;
-            unsigned char g = ((unsigned int)col) & 0xff;
-            unsigned char b = ((unsigned int)col) & 0xff;
-            unsigned char a = 0xff;
+    /* normalize portrait image, and invert it. */
+    float colmin, colmax, scale = 0.0f;
+    preproc_fp32_minmax (pimg, pimg_w * pimg_h, 1, &colmin, &colmax);
+    if (colmax > colmin)
+        scale = 1.0f / (colmax - colmin);
 
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
-    }
+    preproc_fp32_to_gray (pimg, pimg_w * pimg_h, 1, -scale, 1.0f + colmin * scale, &imgbuf[0][0]);
 
     face_t *face = &(detection->faces[face_id]);
     float cx     = face->face_cx * texw; //    0--------1
@@ -293,11 +212,11 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     float by     = cy - face_h * 0.5f;
     float rot    = RAD_TO_DEG (face->rotation);
 
-    texture_2d_t animtex;
-    create_2d_texture_ex (&animtex, imgbuf, pimg_w, pimg_h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
-    draw_2d_texture_ex_texcoord_rot (&animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
+    texture_2d_t *animtex = update_stream_texture (&s_animtex[face_id], imgbuf, pimg_w, pimg_h, pixfmt_fourcc ('Y', '8', '0', '0'));
+    if (animtex == NULL)
+        return;
 
-    glDeleteTextures (1, &animtex.texid);
+    draw_2d_texture_ex_texcoord_rot (animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
 }
 
 /* Adjust the texture size to fit the window size
@@ -13,6 +13,8 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
+#include "util_segment.h"
 #include "util_matrix.h"
 #include "tflite_face_segmentation.h"
 #include "util_camera_capture.h"
@@ -28,15 +30,10 @@
 void
 feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -46,19 +43,7 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -66,15 +51,10 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 void
 feed_bisenetv2_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_bisenetv2_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -106,19 +86,7 @@ feed_bisenetv2_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_res
     /* convert UI8 [0, 255] ==> FP32 [0, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -203,11 +171,11 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     if (detection->num <= face_id)
         return;
 
-    int64_t *segmap = bisenetv2_ret->segmentmap;
-    int segmap_w  = bisenetv2_ret->segmentmap_dims[0];
-    int segmap_h  = bisenetv2_ret->segmentmap_dims[1];
-    int x, y;
-    unsigned int imgbuf[segmap_h][segmap_w];
+    segment_map_t segmap = {0};
+    static stream_texture_t s_animtex[MAX_FACE_NUM];
+    static preproc_buf_t s_imgbuf;
+    uint32_t palette[19];
+    int i;
 
 #if 1
     unsigned char alpha = 200;
@@ -258,23 +226,18 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
         0,   192, 0,   0,      /* [18] hat */
     };
 #endif
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
-    {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            int64_t val = segmap[y * segmap_w + x];
-            if (val > 18)
-                val = 0;
-            
-            unsigned char r = color[4 * val + 0];
-            unsigned char g = color[4 * val + 1];
-            unsigned char b = color[4 * val + 2];
-            unsigned char a = color[4 * val + 3];
-
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
-    }
+    for (i = 0; i < 19; i ++)
+        palette[i] = SEGMENT_RGBA (color[4 * i + 0], color[4 * i + 1], color[4 * i + 2], color[4 * i + 3]);
+
+    segmap.buf  = bisenetv2_ret->segmentmap;
+    segmap.type = SEGMENT_TYPE_LABEL_S64;
+    segmap.w    = bisenetv2_ret->segmentmap_dims[0];
+    segmap.h    = bisenetv2_ret->segmentmap_dims[1];
+    segmap.c    = 1;
+
+    /* the class index is given by the model. the unknown ones are background. */
+    uint32_t *imgbuf = (uint32_t *)preproc_buf_reserve (&s_imgbuf, segmap.w * segmap.h * 4);
+    segment_argmax (&segmap, 19, NULL, NULL, palette, 19, imgbuf);
 
     face_t *face = &(detection->faces[face_id]);
     float cx     = face->face_cx * texw; //    0--------1
@@ -285,11 +248,11 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     float by     = cy - face_h * 0.5f;
     float rot    = RAD_TO_DEG (face->rotation);
 
-    texture_2d_t animtex;
-    create_2d_texture_ex (&animtex, imgbuf, segmap_w, segmap_h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
-    draw_2d_texture_ex_texcoord_rot (&animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
+    texture_2d_t *animtex = update_stream_texture (&s_animtex[face_id], imgbuf, segmap.w, segmap.h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
+    if (animtex == NULL)
+        return;
 
-    glDeleteTextures (1, &animtex.texid);
+    draw_2d_texture_ex_texcoord_rot (animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
 }
 
 /* Adjust the texture size to fit the window size
@@ -399,6 +362,7 @@ main(int argc, char *argv[])
     init_dbgstr (win_w, win_h);
 
     init_tflite_bisenetv2 (use_quantized_tflite);
+    segment_init (0);
 
 #if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
     /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
@@ -0,0 +1,117 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_tflite.h"
+#include "util_bench.h"
+#include "tflite_facemesh.h"
+
+/*
+ *  Headless benchmark of the facemesh pipeline (CPU only, no EGL/GLES).
+ *
+ *    $ make bench
+ *    $ ./gl2facemesh_bench -w 10 -n 200 -o result.json ./images/
+ */
+static void *
+session_create (int use_quantized)
+{
+    return facemesh_session_create (use_quantized, 0);
+}
+
+static void
+session_destroy (void *sess)
+{
+    facemesh_session_destroy ((facemesh_session_t *)sess);
+}
+
+static void *
+get_detect_input (void *sess, int *w, int *h)
+{
+    return facemesh_get_detect_input_buf ((facemesh_session_t *)sess, w, h);
+}
+
+static int
+invoke_detect (void *sess, void *items)
+{
+    face_detect_result_t face_ret;
+
+    if (facemesh_invoke_detect ((facemesh_session_t *)sess, &face_ret) < 0)
+        return -1;
+
+    memcpy (items, face_ret.faces, face_ret.num * sizeof (face_t));
+    return face_ret.num;
+}
+
+static void
+get_item_quad (const void *item, float quad[4][2])
+{
+    const face_t *face = (const face_t *)item;
+    int i;
+
+    for (i = 0; i < 4; i ++)
+    {
+        quad[i][0] = face->face_pos[i].x;
+        quad[i][1] = face->face_pos[i].y;
+    }
+}
+
+static void *
+get_landmark_input (void *sess, int *w, int *h)
+{
+    return facemesh_get_landmark_input_buf ((facemesh_session_t *)sess, w, h);
+}
+
+static int
+invoke_landmark (void *sess, void *result)
+{
+    return facemesh_invoke_landmark ((facemesh_session_t *)sess, (face_landmark_result_t *)result);
+}
+
+static void *
+get_landmark_batch_input (void *sess, int num, int *w, int *h)
+{
+    return facemesh_get_landmark_batch_input_buf ((facemesh_session_t *)sess, num, w, h);
+}
+
+static int
+invoke_landmark_batch (void *sess, void *results, int num)
+{
+    return facemesh_invoke_landmark_batch ((facemesh_session_t *)sess,
+                                                (face_landmark_result_t *)results, num);
+}
+
+static float
+landmark_to_item (const void *item, const void *result, void *next_item, roi_t *next_roi)
+{
+    return facemesh_landmark_to_face ((const face_t *)item, (const face_landmark_result_t *)result,
+                                      (face_t *)next_item, next_roi);
+}
+
+int
+main (int argc, char *argv[])
+{
+    bench_cascade_t cas = {0};
+
+    cas.app         = "gl2facemesh";
+    cas.item_name   = "faces";
+    cas.max_items   = MAX_FACE_NUM;
+    cas.item_size   = sizeof (face_t);
+    cas.result_size = sizeof (face_landmark_result_t);
+
+    cas.session_create           = session_create;
+    cas.session_destroy          = session_destroy;
+    cas.get_invoke_ms            = tflite_get_last_invoke_ms;
+    cas.get_detect_input         = get_detect_input;
+    cas.invoke_detect            = invoke_detect;
+    cas.get_item_quad            = get_item_quad;
+    cas.get_landmark_input       = get_landmark_input;
+    cas.invoke_landmark          = invoke_landmark;
+    cas.get_landmark_batch_input = get_landmark_batch_input;
+    cas.invoke_landmark_batch    = invoke_landmark_batch;
+    cas.landmark_to_item         = landmark_to_item;
+
+    return bench_cascade_main (&cas, argc, argv);
+}
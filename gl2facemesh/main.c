@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -14,7 +15,12 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
+#include "util_warp.h"
 #include "util_matrix.h"
+#include "util_render_target.h"
+#include "util_pipeline.h"
+#include "util_roi_track.h"
 #include "tflite_facemesh.h"
 #include "render_facemesh.h"
 #include "util_camera_capture.h"
@@ -42,61 +48,79 @@ static maskimage_t s_maskimages[] =
 
 static int s_num_maskimages = sizeof (s_maskimages) / sizeof (maskimage_t);
 
+/* RGBA pixels of the input image file (for the CPU crop) */
+static void *s_still_img;
+static int  s_still_w, s_still_h;
 
 
 
 
-/* resize image to DNN network input size and convert to fp32. */
-void
-feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
-{
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
 
-    draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
+/* read back the rendered image and convert UI8 [0, 255] ==> FP32 [-1, 1] */
+static void
+readback_to_fp32 (float *buf_fp32, int w, int h)
+{
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     glPixelStorei (GL_PACK_ALIGNMENT, 4);
     glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
+}
+
+/* resize image to DNN network input size and convert to fp32. */
+static void
+feed_face_detect_image_buf (texture_2d_t *srctex, int win_w, int win_h, float *buf_fp32)
+{
+    int w, h;
+
+    get_face_detect_input_buf (&w, &h);
 
-    return;
+    draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
+    readback_to_fp32 (buf_fp32, w, h);
 }
 
 void
-feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
+feed_face_detect_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h)
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
+    int w, h;
+    float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+    if (cpusrc)
+    {
+        preproc_norm_t norm;
+        preproc_norm_set (&norm, 128.0f, 128.0f);
+        warp_resize_to_fp32 (cpusrc, buf_fp32, w, h, &norm, 0);
+        return;
+    }
 
-    buf_ui8 = pui8;
+    feed_face_detect_image_buf (srctex, win_w, win_h, buf_fp32);
+}
+
+static void
+feed_face_landmark_image_buf (texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                              face_detect_result_t *detection, unsigned int face_id,
+                              float *buf_fp32, int w, int h)
+{
+    /* crop, rotate, resize and normalize in one pass on CPU. */
+    if (cpusrc && detection->num > face_id)
+    {
+        face_t *face = &(detection->faces[face_id]);
+        float quad[4][2];
+        preproc_norm_t norm;
+
+        for (int i = 0; i < 4; i ++)
+        {
+            quad[i][0] = face->face_pos[i].x;
+            quad[i][1] = face->face_pos[i].y;
+        }
+        preproc_norm_set (&norm, 128.0f, 128.0f);
+        warp_quad_to_fp32 (cpusrc, quad, buf_fp32, w, h, &norm, 0);
+        return;
+    }
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -121,28 +145,287 @@ feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect
     }
 
     draw_2d_texture_ex_texcoord (srctex, 0, win_h - h, w, h, texcoord);
+    readback_to_fp32 (buf_fp32, w, h);
+}
 
-    glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+void
+feed_face_landmark_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                         face_detect_result_t *detection, unsigned int face_id)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
-    float mean = 128.0f;
-    float std  = 128.0f;
-    for (y = 0; y < h; y ++)
+    feed_face_landmark_image_buf (srctex, cpusrc, win_w, win_h, detection, face_id, buf_fp32, w, h);
+}
+
+/*
+ *  crop all the detected faces into one [num][h][w][3] input, and run the
+ *  landmark model once. returns -1 if the model can't take a batch (GPU
+ *  delegate), then the caller goes one by one.
+ */
+static int
+invoke_face_landmark_batch_all (texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                            face_detect_result_t *detection, face_landmark_result_t *face_mesh,
+                            double *invoke_ms)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_facemesh_landmark_batch_input_buf (detection->num, &w, &h);
+
+    if (buf_fp32 == NULL)
+        return -1;
+
+    for (int face_id = 0; face_id < detection->num; face_id ++)
+    {
+        feed_face_landmark_image_buf (srctex, cpusrc, win_w, win_h, detection, face_id,
+                                      buf_fp32 + face_id * w * h * 3, w, h);
+    }
+
+    double ttime0 = pmeter_get_time_ms ();
+    invoke_facemesh_landmark_batch (face_mesh, detection->num);
+    *invoke_ms = pmeter_get_time_ms () - ttime0;
+
+    return 0;
+}
+
+
+/* the current input frame on CPU. returns NULL if it is not available yet. */
+static warp_src_t *
+get_cpu_frame (warp_src_t *src, int enable_camera, int enable_video)
+{
+    void     *buf = s_still_img;
+    int      w    = s_still_w;
+    int      h    = s_still_h;
+    uint32_t fmt  = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+    if (enable_video)
+    {
+        get_video_buffer (&buf);
+        get_video_dimension (&w, &h);
+        get_video_pixformat (&fmt);
+    }
+#endif
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    if (enable_camera)
     {
-        for (x = 0; x < w; x ++)
+        get_capture_buffer (&buf);
+        get_capture_dimension (&w, &h);
+        get_capture_pixformat (&fmt);
+    }
+#endif
+
+    if (warp_src_set (src, buf, w, h, 0, fmt) < 0)
+        return NULL;
+
+    return src;
+}
+
+
+/* -------------------------------------------------- *
+ *  ROI tracking
+ *    the faces of the next frame come from the landmarks of this frame,
+ *    so the face detector runs only when a face is lost.
+ * -------------------------------------------------- */
+static void
+update_face_track (roi_track_t *trk, face_detect_result_t *detection, face_landmark_result_t *face_mesh)
+{
+    face_t next_faces[MAX_FACE_NUM];
+    roi_t  next_rois[MAX_FACE_NUM];
+    float  scores[MAX_FACE_NUM];
+
+    for (int face_id = 0; face_id < detection->num; face_id ++)
+    {
+        scores[face_id] = facemesh_landmark_to_face (&detection->faces[face_id], &face_mesh[face_id],
+                                                     &next_faces[face_id], &next_rois[face_id]);
+    }
+
+    roi_track_update (trk, next_rois, scores, next_faces, detection->num);
+}
+
+
+/* -------------------------------------------------- *
+ *  Pipelined execution
+ *
+ *    [source ] GL thread : snapshot camera image, preprocess for face detection
+ *    [detect ] worker    : face detection
+ *    [crop   ] GL thread : crop detected faces for landmark
+ *    [mesh   ] worker    : face landmark
+ *    [display] GL thread : render the newest finished frame
+ * -------------------------------------------------- */
+#define PIPE_FRAME_NUM      6
+
+enum pipe_stage_id {
+    PIPE_STAGE_SOURCE = 0,
+    PIPE_STAGE_DETECT,
+    PIPE_STAGE_CROP,
+    PIPE_STAGE_MESH,
+    PIPE_STAGE_DISPLAY,
+};
+
+typedef struct _pipe_frame_t
+{
+    render_target_t         rtarget;        /* snapshot of the camera image */
+    texture_2d_t            tex;
+    float                   *detect_input;
+    float                   *landmark_input[MAX_FACE_NUM];
+    face_detect_result_t    face_detect_ret;
+    face_landmark_result_t  face_mesh_ret[MAX_FACE_NUM];
+    double                  invoke_ms0;
+    double                  invoke_ms1;
+} pipe_frame_t;
+
+static pipe_frame_t s_pipe_frames[PIPE_FRAME_NUM];
+static int          s_lmk_w, s_lmk_h;   /* the landmark worker may resize the model at any time */
+static pipe_frame_t *s_pipe_disp_frame;
+
+static int
+pipe_face_detect (void *frame, void *usr)
+{
+    pipe_frame_t *pf = (pipe_frame_t *)frame;
+    int w, h;
+    void *buf_fp32 = get_face_detect_input_buf (&w, &h);
+
+    memcpy (buf_fp32, pf->detect_input, w * h * 3 * sizeof (float));
+
+    double ttime0 = pmeter_get_time_ms ();
+    invoke_face_detect (&pf->face_detect_ret);
+    pf->invoke_ms0 = pmeter_get_time_ms () - ttime0;
+
+    return 0;
+}
+
+static int
+pipe_face_landmark (void *frame, void *usr)
+{
+    pipe_frame_t *pf = (pipe_frame_t *)frame;
+    int num = pf->face_detect_ret.num;
+    int w, h;
+    float *buf_fp32;
+
+    pf->invoke_ms1 = 0;
+    if (num == 0)
+        return 0;
+
+    /* all the faces in one Invoke() */
+    buf_fp32 = (float *)get_facemesh_landmark_batch_input_buf (num, &w, &h);
+    if (buf_fp32)
+    {
+        for (int face_id = 0; face_id < num; face_id ++)
+        {
+            memcpy (buf_fp32 + face_id * w * h * 3, pf->landmark_input[face_id],
+                    w * h * 3 * sizeof (float));
+        }
+
+        double ttime0 = pmeter_get_time_ms ();
+        invoke_facemesh_landmark_batch (pf->face_mesh_ret, num);
+        pf->invoke_ms1 = pmeter_get_time_ms () - ttime0;
+        return 0;
+    }
+
+    buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
+    for (int face_id = 0; face_id < num; face_id ++)
+    {
+        memcpy (buf_fp32, pf->landmark_input[face_id], w * h * 3 * sizeof (float));
+
+        double ttime0 = pmeter_get_time_ms ();
+        invoke_facemesh_landmark (&pf->face_mesh_ret[face_id]);
+        pf->invoke_ms1 += pmeter_get_time_ms () - ttime0;
+    }
+
+    return 0;
+}
+
+static int
+init_pipeline (pipeline_t *pipe, int policy, int texw, int texh)
+{
+    void *frames[PIPE_FRAME_NUM];
+    int det_w, det_h, lmk_w, lmk_h;
+
+    get_face_detect_input_buf (&det_w, &det_h);
+    get_facemesh_landmark_input_buf (&lmk_w, &lmk_h);
+    s_lmk_w = lmk_w;
+    s_lmk_h = lmk_h;
+
+    for (int i = 0; i < PIPE_FRAME_NUM; i ++)
+    {
+        pipe_frame_t *pf = &s_pipe_frames[i];
+
+        create_render_target (&pf->rtarget, texw, texh, RTARGET_COLOR);
+        pf->tex.texid  = pf->rtarget.texc_id;
+        pf->tex.width  = texw;
+        pf->tex.height = texh;
+        pf->tex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+        pf->detect_input = (float *)malloc (det_w * det_h * 3 * sizeof (float));
+        if (pf->detect_input == NULL)
+            return -1;
+
+        for (int face_id = 0; face_id < MAX_FACE_NUM; face_id ++)
         {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
+            pf->landmark_input[face_id] = (float *)malloc (lmk_w * lmk_h * 3 * sizeof (float));
+            if (pf->landmark_input[face_id] == NULL)
+                return -1;
         }
+        frames[i] = pf;
     }
 
-    return;
+    pipeline_init (pipe, frames, PIPE_FRAME_NUM, policy);
+    pipeline_add_stage (pipe, "detect",  pipe_face_detect,   NULL);
+    pipeline_add_stage (pipe, "crop",    NULL,               NULL);
+    pipeline_add_stage (pipe, "mesh",    pipe_face_landmark, NULL);
+    pipeline_add_stage (pipe, "display", NULL,               NULL);
+
+    return pipeline_start (pipe);
+}
+
+/* serve the GL thread stages, and return the frame to be displayed. */
+static pipe_frame_t *
+update_pipeline (pipeline_t *pipe, texture_2d_t *captex, int win_w, int win_h)
+{
+    pipe_frame_t *pf;
+
+    if (pipe->policy == PIPELINE_POLICY_BLOCK)
+        pipeline_wait_inline (pipe);
+
+    /* take a snapshot of the camera image, so that the later stages and the display
+     * see the same picture, then preprocess it for face detection. */
+    pf = (pipe_frame_t *)pipeline_get_frame (pipe, PIPE_STAGE_SOURCE, 0);
+    if (pf)
+    {
+        set_render_target (&pf->rtarget);
+        draw_2d_texture_ex (captex, 0, 0, win_w, win_h, 1);
+        glBindFramebuffer (GL_FRAMEBUFFER, 0);
+        glViewport (0, 0, win_w, win_h);
+
+        feed_face_detect_image_buf (&pf->tex, win_w, win_h, pf->detect_input);
+        pipeline_put_frame (pipe, PIPE_STAGE_SOURCE, pf);
+    }
+
+    /* crop the detected faces */
+    while ((pf = (pipe_frame_t *)pipeline_get_frame (pipe, PIPE_STAGE_CROP, 0)) != NULL)
+    {
+        for (int face_id = 0; face_id < pf->face_detect_ret.num; face_id ++)
+        {
+            feed_face_landmark_image_buf (&pf->tex, NULL, win_w, win_h, &pf->face_detect_ret, face_id,
+                                          pf->landmark_input[face_id], s_lmk_w, s_lmk_h);
+        }
+        pipeline_put_frame (pipe, PIPE_STAGE_CROP, pf);
+    }
+
+    /* finished frame */
+    if (pipe->policy == PIPELINE_POLICY_DROP_OLDEST)
+        pf = (pipe_frame_t *)pipeline_get_latest_frame (pipe, PIPE_STAGE_DISPLAY);
+    else
+        pf = (pipe_frame_t *)pipeline_get_frame (pipe, PIPE_STAGE_DISPLAY, 0);
+
+    if (pf)
+    {
+        if (s_pipe_disp_frame)
+            pipeline_put_frame (pipe, PIPE_STAGE_DISPLAY, s_pipe_disp_frame);
+        s_pipe_disp_frame = pf;
+    }
+
+    return s_pipe_disp_frame;
 }
 
 
@@ -415,12 +698,19 @@ main(int argc, char *argv[])
     int enable_video = 0;
     int enable_camera = 1;
     int mask_eye_hole = 0;
+    int enable_pipeline = 0;
+    int enable_gl_crop = 0;
+    int enable_track = 0;
+    int redetect_interval = 0;
+    int pipe_policy = PIPELINE_POLICY_DROP_OLDEST;
+    pipeline_t pipe;
+    roi_track_t track;
     UNUSED (argc);
     UNUSED (*argv);
 
     {
         int c;
-        const char *optstring = "eqv:x";
+        const char *optstring = "egpPqr:v:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -429,9 +719,24 @@ main(int argc, char *argv[])
             case 'e':
                 mask_eye_hole = 1;
                 break;
+            case 'g':
+                enable_gl_crop = 1;
+                break;
+            case 'p':
+                enable_pipeline = 1;
+                pipe_policy = PIPELINE_POLICY_DROP_OLDEST;
+                break;
+            case 'P':
+                enable_pipeline = 1;
+                pipe_policy = PIPELINE_POLICY_BLOCK;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 'r':
+                enable_track = 1;
+                redetect_interval = atoi (optarg);
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
@@ -495,7 +800,9 @@ main(int argc, char *argv[])
 #endif
     {
         int texid;
-        load_jpg_texture (input_name, &texid, &texw, &texh);
+        load_jpg_texture_ex (input_name, &texid, &texw, &texh, &s_still_img);
+        s_still_w = texw;
+        s_still_h = texh;
         captex.texid  = texid;
         captex.width  = texw;
         captex.height = texh;
@@ -504,6 +811,8 @@ main(int argc, char *argv[])
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
+    warp_init (0);
+
     glClearColor (0.f, 0.f, 0.f, 1.0f);
     glClear (GL_COLOR_BUFFER_BIT);
     glViewport (0, 0, win_w, win_h);
@@ -536,11 +845,11 @@ main(int argc, char *argv[])
             masktex.height = th;
             masktex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
 
-            feed_face_detect_image (&masktex, win_w, win_h);
+            feed_face_detect_image (&masktex, NULL, win_w, win_h);
             invoke_face_detect (&face_detect_mask[mask_id]);
 
             int face_id = 0;
-            feed_face_landmark_image (&masktex, win_w, win_h, &face_detect_mask[mask_id], face_id);
+            feed_face_landmark_image (&masktex, NULL, win_w, win_h, &face_detect_mask[mask_id], face_id);
 
             invoke_facemesh_landmark (&face_mesh_mask[mask_id]);
         }
@@ -550,6 +859,25 @@ main(int argc, char *argv[])
         }
     }
 
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* GPU Delegate must be invoked on the GL thread. */
+    enable_pipeline = 0;
+#endif
+    if (enable_pipeline && init_pipeline (&pipe, pipe_policy, texw, texh) < 0)
+    {
+        fprintf (stderr, "failed to start pipeline. fall back to serial execution.\n");
+        enable_pipeline = 0;
+    }
+
+    /* the detector stage runs ahead of the landmark stage in the pipelined mode. */
+    if (enable_track && enable_pipeline)
+    {
+        fprintf (stderr, "ROI tracking is not available in the pipelined mode.\n");
+        enable_track = 0;
+    }
+    if (enable_track && roi_track_init (&track, MAX_FACE_NUM, sizeof (face_t), 0.5f, redetect_interval) < 0)
+        enable_track = 0;
+
 
     /* --------------------------------------- *
      *  Render Loop
@@ -558,6 +886,7 @@ main(int argc, char *argv[])
     {
         face_detect_result_t    face_detect_ret = {0};
         face_landmark_result_t  face_mesh_ret[MAX_FACE_NUM] = {0};
+        texture_2d_t            *disptex = &captex;
 
         int mask_id = (count / 100) % s_num_maskimages;
         mask_id = s_gui_prop.cur_mask_id;
@@ -591,28 +920,63 @@ main(int argc, char *argv[])
         }
 #endif
 
-        /* --------------------------------------- *
-         *  face detection
-         * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
+        if (enable_pipeline)
+        {
+            pipe_frame_t *pf = update_pipeline (&pipe, &captex, win_w, win_h);
+            if (pf)
+            {
+                memcpy (&face_detect_ret, &pf->face_detect_ret, sizeof (face_detect_ret));
+                memcpy (face_mesh_ret, pf->face_mesh_ret, face_detect_ret.num * sizeof (face_landmark_result_t));
+                invoke_ms0 = pf->invoke_ms0;
+                invoke_ms1 = pf->invoke_ms1;
+                disptex    = &pf->tex;
+            }
+        }
+        else
+        {
+            warp_src_t cpu_frame, *cpusrc = NULL;
+            if (!enable_gl_crop)
+                cpusrc = get_cpu_frame (&cpu_frame, enable_camera, enable_video);
+
+            /* --------------------------------------- *
+             *  face detection (skipped while the faces are tracked)
+             * --------------------------------------- */
+            if (!enable_track || roi_track_need_detect (&track))
+            {
+                feed_face_detect_image (&captex, cpusrc, win_w, win_h);
 
-        ttime[2] = pmeter_get_time_ms ();
-        invoke_face_detect (&face_detect_ret);
-        ttime[3] = pmeter_get_time_ms ();
-        invoke_ms0 = ttime[3] - ttime[2];
+                ttime[2] = pmeter_get_time_ms ();
+                invoke_face_detect (&face_detect_ret);
+                ttime[3] = pmeter_get_time_ms ();
+                invoke_ms0 = ttime[3] - ttime[2];
+            }
+            else
+            {
+                face_detect_ret.num = roi_track_get (&track, face_detect_ret.faces);
+                invoke_ms0 = 0;
+            }
 
-        /* --------------------------------------- *
-         *  face landmark
-         * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
-        {
-            feed_face_landmark_image (&captex, win_w, win_h, &face_detect_ret, face_id);
+            /* --------------------------------------- *
+             *  face landmark
+             * --------------------------------------- */
+            invoke_ms1 = 0;
+            if (face_detect_ret.num <= 1 ||
+                invoke_face_landmark_batch_all (&captex, cpusrc, win_w, win_h, &face_detect_ret,
+                                            face_mesh_ret, &invoke_ms1) < 0)
+            {
+                for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+                {
+                    feed_face_landmark_image (&captex, cpusrc, win_w, win_h, &face_detect_ret, face_id);
+
+                    ttime[4] = pmeter_get_time_ms ();
+                    invoke_facemesh_landmark (&face_mesh_ret[face_id]);
+                    ttime[5] = pmeter_get_time_ms ();
+                    invoke_ms1 += ttime[5] - ttime[4];
+                }
+            }
 
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_facemesh_landmark (&face_mesh_ret[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            if (enable_track)
+                update_face_track (&track, &face_detect_ret, face_mesh_ret);
         }
 
         /* --------------------------------------- *
@@ -621,7 +985,7 @@ main(int argc, char *argv[])
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         /* visualize the face pose estimation results. */
-        draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        draw_2d_texture_ex (disptex, draw_x, draw_y, draw_w, draw_h, 0);
 
         for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
         {
@@ -642,7 +1006,7 @@ main(int argc, char *argv[])
                 float y = h * face_id + 10;
                 float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-                render_cropped_face_image (&captex, x, y, w, h, &face_detect_ret, face_id);
+                render_cropped_face_image (disptex, x, y, w, h, &face_detect_ret, face_id);
                 draw_2d_rect (x, y, w, h, col_white, 2.0f);
             }
         }
@@ -684,6 +1048,11 @@ main(int argc, char *argv[])
 
         sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]",
             interval, invoke_ms0, invoke_ms1);
+        if (enable_track)
+        {
+            sprintf (strbuf + strlen (strbuf), "\nTrack   :%5.1f [%%] (hit:%d miss:%d)",
+                roi_track_skip_ratio (&track) * 100.0f, track.stats.hits, track.stats.misses);
+        }
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
@@ -432,8 +432,8 @@ draw_facemesh_line (fvec3 *joint, float *color, int drill_eye_hole)
     int num_idx;
     int *mesh_tris = get_facemesh_tri_indicies (&num_idx, drill_eye_hole);
 
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    /* ~2700 edges in one draw call */
+    begin_2d_batch ();
 
     for (int i = 0; i < num_idx/3; i ++)
     {
@@ -452,6 +452,8 @@ draw_facemesh_line (fvec3 *joint, float *color, int drill_eye_hole)
         draw_2d_line (x3, y3, x1, y1, color, 1.0f);
     }
 
+    end_2d_batch ();
+
     GLASSERT ();
     return 0;
 }
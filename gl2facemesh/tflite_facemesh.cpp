@@ -3,8 +3,11 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_anchor.h"
+#include "util_nms.h"
 #include "tflite_facemesh.h"
-#include <list>
+#include <algorithm>
+#include <cfloat>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/models/face_detection_front.tflite
@@ -16,66 +19,60 @@
 #define FACE_DETECTL_QUANT_MODEL_PATH    "./facemesh_model/face_detection_front_128_full_integer_quant.tflite"
 #define FACE_LANDMARK_QUANT_MODEL_PATH   "./facemesh_model/face_landmark_192_full_integer_quant.tflite"
 
-static tflite_interpreter_t s_detect_interpreter;
-static tflite_tensor_t      s_detect_tensor_input;
-static tflite_tensor_t      s_detect_tensor_scores;
-static tflite_tensor_t      s_detect_tensor_bboxes;
+enum detect_tensor_id {
+    DETECT_INPUT = 0,
+    DETECT_BBOXES,
+    DETECT_SCORES,
+    DETECT_TENSOR_NUM
+};
 
-static tflite_interpreter_t s_mesh_interpreter;
-static tflite_tensor_t      s_mesh_tensor_input;
-static tflite_tensor_t      s_mesh_tensor_landmark;
-static tflite_tensor_t      s_mesh_tensor_score;
+static const tflite_tensor_desc_t s_detect_tensor_descs[DETECT_TENSOR_NUM] = {
+    {0, "input"},
+    {1, "regressors"},
+    {1, "classificators"},
+};
 
-static std::list<fvec2> s_anchors;
+enum mesh_tensor_id {
+    MESH_INPUT = 0,
+    MESH_LANDMARK,
+    MESH_SCORE,
+    MESH_TENSOR_NUM
+};
 
-/*
- * determine where the anchor points are scatterd.
- *   https://github.com/tensorflow/tfjs-models/blob/master/blazeface/src/face.ts
- */
-static int
-create_blazeface_anchors(int input_w, int input_h)
-{
-    /* ANCHORS_CONFIG  */
-    int strides[2] = {8, 16};
-    int anchors[2] = {2,  6};
+static const tflite_tensor_desc_t s_mesh_tensor_descs[MESH_TENSOR_NUM] = {
+    {0, "input_1"},
+    {1, "conv2d_20"},
+    {1, "conv2d_30"},
+};
 
-    int numtotal = 0;
+#define MAX_FACE_CANDIDATE_NUM  128
 
-    for (int i = 0; i < 2; i ++)
-    {
-        int stride = strides[i];
-        int gridCols = (input_w + stride -1) / stride;
-        int gridRows = (input_h + stride -1) / stride;
-        int anchorNum = anchors[i];
+struct _facemesh_session_t
+{
+    tflite_session_t    detect;
+    tflite_session_t    mesh;
+
+    /* post-process */
+    anchor_table_t      anchors;
+    anchor_detect_t     anchor_dets[MAX_FACE_CANDIDATE_NUM];
+    nms_box_t           nms_boxes[MAX_FACE_CANDIDATE_NUM];
+    nms_t               nms;
+};
 
-        fvec2 anchor;
-        for (int gridY = 0; gridY < gridRows; gridY ++)
-        {
-            anchor.y = stride * (gridY + 0.5f);
-            for (int gridX = 0; gridX < gridCols; gridX ++)
-            {
-                anchor.x = stride * (gridX + 0.5f);
-                for (int n = 0; n < anchorNum; n ++)
-                {
-                    s_anchors.push_back (anchor);
-                    numtotal ++;
-                }
-            }
-        }
-    }
-    return numtotal;
-}
+/* for the single instance APIs */
+static facemesh_session_t *s_session;
 
 
 
 /* -------------------------------------------------- *
  *  Create TFLite Interpreter
  * -------------------------------------------------- */
-int
-init_tflite_facemesh (int use_quantized_tflite)
+facemesh_session_t *
+facemesh_session_create (int use_quantized_tflite, int num_threads)
 {
     const char *detect_model;
     const char *mesh_model;
+    tflite_createopt_t opt = {0};
 
     if (use_quantized_tflite)
     {
@@ -88,196 +85,123 @@ init_tflite_facemesh (int use_quantized_tflite)
         mesh_model   = FACE_LANDMARK_MODEL_PATH;
     }
 
+    opt.num_threads = num_threads;
+
+    /* value-initialized: the anchor table and nms buffers start empty. */
+    facemesh_session_t *sess = new facemesh_session_t ();
+
     /* Face detect */
-    tflite_create_interpreter_from_file (&s_detect_interpreter, detect_model);
-    tflite_get_tensor_by_name (&s_detect_interpreter, 0, "input",          &s_detect_tensor_input);
-    tflite_get_tensor_by_name (&s_detect_interpreter, 1, "regressors",     &s_detect_tensor_bboxes);
-    tflite_get_tensor_by_name (&s_detect_interpreter, 1, "classificators", &s_detect_tensor_scores);
+    if (tflite_session_create (&sess->detect, detect_model,
+                               s_detect_tensor_descs, DETECT_TENSOR_NUM, &opt) < 0)
+        goto err;
 
     /* Facemesh Landmark */
-    tflite_create_interpreter_from_file (&s_mesh_interpreter, mesh_model);
-    tflite_get_tensor_by_name (&s_mesh_interpreter, 0, "input_1",   &s_mesh_tensor_input);
-    tflite_get_tensor_by_name (&s_mesh_interpreter, 1, "conv2d_20", &s_mesh_tensor_landmark);
-    tflite_get_tensor_by_name (&s_mesh_interpreter, 1, "conv2d_30", &s_mesh_tensor_score);
+    if (tflite_session_create (&sess->mesh, mesh_model,
+                               s_mesh_tensor_descs, MESH_TENSOR_NUM, &opt) < 0)
+        goto err;
 
-    int det_input_w = s_detect_tensor_input.dims[2];
-    int det_input_h = s_detect_tensor_input.dims[1];
-    create_blazeface_anchors (det_input_w, det_input_h);
+    {
+        int det_input_w = sess->detect.tensors[DETECT_INPUT].dims[2];
+        int det_input_h = sess->detect.tensors[DETECT_INPUT].dims[1];
+        if (anchor_table_create_blazeface (&sess->anchors, det_input_w, det_input_h) < 0)
+            goto err;
+        if (nms_init (&sess->nms, MAX_FACE_CANDIDATE_NUM) < 0)
+            goto err;
+    }
 
-    return 0;
+    return sess;
+
+err:
+    fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+    facemesh_session_destroy (sess);
+    return NULL;
 }
 
-void *
-get_face_detect_input_buf (int *w, int *h)
+void
+facemesh_session_destroy (facemesh_session_t *sess)
 {
-    *w = s_detect_tensor_input.dims[2];
-    *h = s_detect_tensor_input.dims[1];
-    return s_detect_tensor_input.ptr;
+    if (sess == NULL)
+        return;
+
+    tflite_session_destroy (&sess->mesh);
+    tflite_session_destroy (&sess->detect);
+    anchor_table_free (&sess->anchors);
+    nms_destroy (&sess->nms);
+    delete sess;
 }
 
 void *
-get_facemesh_landmark_input_buf (int *w, int *h)
+facemesh_get_detect_input_buf (facemesh_session_t *sess, int *w, int *h)
 {
-    *w = s_mesh_tensor_input.dims[2];
-    *h = s_mesh_tensor_input.dims[1];
-    return s_mesh_tensor_input.ptr;
+    tflite_tensor_t *input = &sess->detect.tensors[DETECT_INPUT];
+
+    *w = input->dims[2];
+    *h = input->dims[1];
+    return input->ptr;
 }
 
+void *
+facemesh_get_landmark_input_buf (facemesh_session_t *sess, int *w, int *h)
+{
+    return facemesh_get_landmark_batch_input_buf (sess, 1, w, h);
+}
 
-/* -------------------------------------------------- *
- * Invoke TensorFlow Lite (Face detection)
- * -------------------------------------------------- */
-static float *
-get_bbox_ptr (int anchor_idx)
+/*
+ *  input buffer for (num) faces: [num][h][w][3].
+ *  the model is resized only when (num) changes from the previous call.
+ *  returns NULL if the batch can't be resized (e.g. GPU delegate).
+ */
+void *
+facemesh_get_landmark_batch_input_buf (facemesh_session_t *sess, int num, int *w, int *h)
 {
-    int idx = 16 * anchor_idx;
-    float *bboxes_ptr = (float *)s_detect_tensor_bboxes.ptr;
+    tflite_tensor_t *input = &sess->mesh.tensors[MESH_INPUT];
 
-    return &bboxes_ptr[idx];
+    if (tflite_session_set_batch (&sess->mesh, num) < 0)
+        return NULL;
+
+    *w = input->dims[2];
+    *h = input->dims[1];
+    return input->ptr;
 }
 
+
+/* -------------------------------------------------- *
+ * Invoke TensorFlow Lite (Face detection)
+ * -------------------------------------------------- */
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (facemesh_session_t *sess, float score_thresh, int input_img_w, int input_img_h)
 {
-    face_t face_item;
-    float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
-    
-    int i = 0;
-    for (auto itr = s_anchors.begin(); itr != s_anchors.end(); i ++, itr ++)
-    {
-        fvec2 anchor = *itr;
-        float score0 = scores_ptr[i];
-        float score = 1.0f / (1.0f + exp(-score0));
-
-        if (score > score_thresh)
-        {
-            float *p = get_bbox_ptr (i);
-
-            /* boundary box */
-            float sx = p[0];
-            float sy = p[1];
-            float w  = p[2];
-            float h  = p[3];
-
-            float cx = sx + anchor.x;
-            float cy = sy + anchor.y;
-
-            cx /= (float)input_img_w;
-            cy /= (float)input_img_h;
-            w  /= (float)input_img_w;
-            h  /= (float)input_img_h;
-
-            fvec2 topleft, btmright;
-            topleft.x  = cx - w * 0.5f;
-            topleft.y  = cy - h * 0.5f;
-            btmright.x = cx + w * 0.5f;
-            btmright.y = cy + h * 0.5f;
-
-            face_item.score    = score;
-            face_item.topleft  = topleft;
-            face_item.btmright = btmright;
-
-            /* landmark positions (6 keys) */
-            for (int j = 0; j < kFaceKeyNum; j ++)
-            {
-                float lx = p[4 + (2 * j) + 0];
-                float ly = p[4 + (2 * j) + 1];
-                lx += anchor.x;
-                ly += anchor.y;
-                lx /= (float)input_img_w;
-                ly /= (float)input_img_h;
-
-                face_item.keys[j].x = lx;
-                face_item.keys[j].y = ly;
-            }
-
-            face_list.push_back (face_item);
-        }
-    }
-    return 0;
+    float *scores_ptr = (float *)sess->detect.tensors[DETECT_SCORES].ptr;
+    float *bboxes_ptr = (float *)sess->detect.tensors[DETECT_BBOXES].ptr;
+    anchor_decode_opt_t opt;
+
+    opt.score_thresh = score_thresh;
+    opt.num_keys     = kFaceKeyNum;
+    opt.num_coords   = 16;
+    opt.input_w      = input_img_w;
+    opt.input_h      = input_img_h;
+
+    return anchor_decode_blazeface (&sess->anchors, scores_ptr, bboxes_ptr, &opt,
+                                    sess->anchor_dets, MAX_FACE_CANDIDATE_NUM);
 }
 
 /* -------------------------------------------------- *
  *  Apply NonMaxSuppression:
  *      https://github.com/tensorflow/tfjs/blob/master/tfjs-core/src/ops/image_ops.ts
  * -------------------------------------------------- */
-static float
-calc_intersection_over_union (face_t &face0, face_t &face1)
-{
-    float sx0 = face0.topleft.x;
-    float sy0 = face0.topleft.y;
-    float ex0 = face0.btmright.x;
-    float ey0 = face0.btmright.y;
-    float sx1 = face1.topleft.x;
-    float sy1 = face1.topleft.y;
-    float ex1 = face1.btmright.x;
-    float ey1 = face1.btmright.y;
-    
-    float xmin0 = std::min (sx0, ex0);
-    float ymin0 = std::min (sy0, ey0);
-    float xmax0 = std::max (sx0, ex0);
-    float ymax0 = std::max (sy0, ey0);
-    float xmin1 = std::min (sx1, ex1);
-    float ymin1 = std::min (sy1, ey1);
-    float xmax1 = std::max (sx1, ex1);
-    float ymax1 = std::max (sy1, ey1);
-    
-    float area0 = (ymax0 - ymin0) * (xmax0 - xmin0);
-    float area1 = (ymax1 - ymin1) * (xmax1 - xmin1);
-    if (area0 <= 0 || area1 <= 0)
-        return 0.0f;
-
-    float intersect_xmin = std::max (xmin0, xmin1);
-    float intersect_ymin = std::max (ymin0, ymin1);
-    float intersect_xmax = std::min (xmax0, xmax1);
-    float intersect_ymax = std::min (ymax0, ymax1);
-
-    float intersect_area = std::max (intersect_ymax - intersect_ymin, 0.0f) *
-                           std::max (intersect_xmax - intersect_xmin, 0.0f);
-    
-    return intersect_area / (area0 + area1 - intersect_area);
-}
-
-static bool
-compare (face_t &v1, face_t &v2)
-{
-    if (v1.score > v2.score)
-        return true;
-    else
-        return false;
-}
-
 static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+non_max_suppression (facemesh_session_t *sess, int num_dets, int *face_idx, float iou_thresh)
 {
-    face_list.sort (compare);
-
-    for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
+    for (int i = 0; i < num_dets; i ++)
     {
-        face_t face_candidate = *itr;
-
-        int ignore_candidate = false;
-        for (auto itr_sel = face_sel_list.rbegin(); itr_sel != face_sel_list.rend(); itr_sel ++)
-        {
-            face_t face_sel = *itr_sel;
-
-            float iou = calc_intersection_over_union (face_candidate, face_sel);
-            if (iou >= iou_thresh)
-            {
-                ignore_candidate = true;
-                break;
-            }
-        }
-
-        if (!ignore_candidate)
-        {
-            face_sel_list.push_back(face_candidate);
-            if (face_sel_list.size() >= MAX_FACE_NUM)
-                break;
-        }
+        sess->nms_boxes[i].x0    = sess->anchor_dets[i].x0;
+        sess->nms_boxes[i].y0    = sess->anchor_dets[i].y0;
+        sess->nms_boxes[i].x1    = sess->anchor_dets[i].x1;
+        sess->nms_boxes[i].y1    = sess->anchor_dets[i].y1;
+        sess->nms_boxes[i].score = sess->anchor_dets[i].score;
     }
 
-    return 0;
+    return nms_hard (&sess->nms, sess->nms_boxes, num_dets, iou_thresh, MAX_FACE_NUM, face_idx);
 }
 
 /* -------------------------------------------------- *
@@ -369,23 +293,30 @@ compute_face_rect (face_t &face)
 
 
 static void
-pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_list)
+pack_face_result (facemesh_session_t *sess, face_detect_result_t *facedet_result, int *face_idx, int num_faces)
 {
-    int num_faces = 0;
-    for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
+    for (int i = 0; i < num_faces; i ++)
     {
-        face_t face = *itr;
+        anchor_detect_t *det = &sess->anchor_dets[face_idx[i]];
+        face_t *face = &facedet_result->faces[i];
 
-        compute_rotation (face);
-        compute_face_rect (face);
+        face->score      = det->score;
+        face->topleft.x  = det->x0;
+        face->topleft.y  = det->y0;
+        face->btmright.x = det->x1;
+        face->btmright.y = det->y1;
 
-        memcpy (&facedet_result->faces[num_faces], &face, sizeof (face));
-        num_faces ++;
-        facedet_result->num = num_faces;
+        /* landmark positions (6 keys) */
+        for (int j = 0; j < kFaceKeyNum; j ++)
+        {
+            face->keys[j].x = det->keys[j][0];
+            face->keys[j].y = det->keys[j][1];
+        }
 
-        if (num_faces >= MAX_FACE_NUM)
-            break;
+        compute_rotation (*face);
+        compute_face_rect (*face);
     }
+    facedet_result->num = num_faces;
 }
 
 
@@ -393,9 +324,9 @@ pack_face_result (face_detect_result_t *facedet_result, std::list<face_t> &face_
  * Invoke TensorFlow Lite
  * -------------------------------------------------- */
 int
-invoke_face_detect (face_detect_result_t *facedet_result)
+facemesh_invoke_detect (facemesh_session_t *sess, face_detect_result_t *facedet_result)
 {
-    if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_session_invoke (&sess->detect) < 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -403,22 +334,24 @@ invoke_face_detect (face_detect_result_t *facedet_result)
 
     /* decode boundary box and landmark keypoints */
     float score_thresh = 0.75f;
-    std::list<face_t> face_list;
+    int   face_idx[MAX_FACE_NUM];
+    int   num_faces;
 
-    int input_img_w = s_detect_tensor_input.dims[2];
-    int input_img_h = s_detect_tensor_input.dims[1];
-    decode_bounds (face_list, score_thresh, input_img_w, input_img_h);
+    int input_img_w = sess->detect.tensors[DETECT_INPUT].dims[2];
+    int input_img_h = sess->detect.tensors[DETECT_INPUT].dims[1];
+    int num_dets = decode_bounds (sess, score_thresh, input_img_w, input_img_h);
 
 
 #if 1 /* USE NMS */
     float iou_thresh = 0.3f;
-    std::list<face_t> face_nms_list;
 
-    non_max_suppression (face_list, face_nms_list, iou_thresh);
-    pack_face_result (facedet_result, face_nms_list);
+    num_faces = non_max_suppression (sess, num_dets, face_idx, iou_thresh);
 #else
-    pack_face_result (facedet_result, face_list);
+    num_faces = std::min (num_dets, MAX_FACE_NUM);
+    for (int i = 0; i < num_faces; i ++)
+        face_idx[i] = i;
 #endif
+    pack_face_result (sess, facedet_result, face_idx, num_faces);
 
     return 0;
 }
@@ -427,20 +360,17 @@ invoke_face_detect (face_detect_result_t *facedet_result)
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite (Facemesh landmark)
  * -------------------------------------------------- */
-int
-invoke_facemesh_landmark (face_landmark_result_t *facemesh_result)
+static void
+decode_landmark (facemesh_session_t *sess, int batch_idx, face_landmark_result_t *facemesh_result)
 {
-    if (s_mesh_interpreter.interpreter->Invoke() != kTfLiteOk)
-    {
-        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-        return -1;
-    }
+    float *meshscore_ptr = (float *)sess->mesh.tensors[MESH_SCORE].ptr;
+    float *landmark_ptr  = (float *)sess->mesh.tensors[MESH_LANDMARK].ptr;
+    int img_w = sess->mesh.tensors[MESH_INPUT].dims[2];
+    int img_h = sess->mesh.tensors[MESH_INPUT].dims[1];
+
+    meshscore_ptr += batch_idx;
+    landmark_ptr  += batch_idx * FACE_KEY_NUM * 3;
 
-    float *meshscore_ptr = (float *)s_mesh_tensor_score.ptr;
-    float *landmark_ptr  = (float *)s_mesh_tensor_landmark.ptr;
-    int img_w = s_mesh_tensor_input.dims[2];
-    int img_h = s_mesh_tensor_input.dims[1];
-    
     facemesh_result->score = *meshscore_ptr;
     //fprintf (stderr, "meshscore = %f\n", *meshscore_ptr);
     
@@ -452,10 +382,168 @@ invoke_facemesh_landmark (face_landmark_result_t *facemesh_result)
         //fprintf (stderr, "[%2d] (%8.1f, %8.1f, %8.1f)\n", i, 
         //    landmark_ptr[3 * i + 0], landmark_ptr[3 * i + 1], landmark_ptr[3 * i + 2]);
     }
+}
+
+int
+facemesh_invoke_landmark (facemesh_session_t *sess, face_landmark_result_t *facemesh_result)
+{
+    return facemesh_invoke_landmark_batch (sess, facemesh_result, 1);
+}
+
+/* (num) must be the same as the facemesh_get_landmark_batch_input_buf() call. */
+int
+facemesh_invoke_landmark_batch (facemesh_session_t *sess, face_landmark_result_t *facemesh_result, int num)
+{
+    if (num != sess->mesh.batch)
+    {
+        fprintf (stderr, "ERR: %s(%d): batch size mismatch (%d, %d)\n", __FILE__, __LINE__,
+                 num, sess->mesh.batch);
+        return -1;
+    }
+
+    if (tflite_session_invoke (&sess->mesh) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (int i = 0; i < num; i ++)
+        decode_landmark (sess, i, &facemesh_result[i]);
+
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  ROI tracking (face rect of the next frame from the landmarks)
+ * -------------------------------------------------- */
+static const roi_param_t s_face_roi_param = {
+    NULL, 0,                /* enclose all the landmarks             */
+    33, 263,                /* right eye --> left eye (outer corner) */
+    0.0f,                   /* ... becomes horizontal                */
+    0.0f, 0.0f,             /* shift                                 */
+    1.5f, 1.5f,             /* scale, same as compute_face_rect()    */
+    1,
+};
+
+/* landmarks which stand for the keypoints of the face detector */
+static const int s_face_key_landmark[kFaceKeyNum] = {
+    33,                     /* kRightEye  */
+    263,                    /* kLeftEye   */
+    1,                      /* kNose      */
+    13,                     /* kMouth     */
+    234,                    /* kRightEar  */
+    454,                    /* kLeftEar   */
+};
+
+/*
+ *  make the face of the next frame from the landmarks of (face).
+ *  returns the face presence in [0, 1]. (the face flag of the model is a logit)
+ */
+float
+facemesh_landmark_to_face (const face_t *face, const face_landmark_result_t *facemesh,
+                           face_t *next_face, roi_t *next_roi)
+{
+    roi_t cur;
+
+    cur.cx       = face->face_cx;
+    cur.cy       = face->face_cy;
+    cur.w        = face->face_w;
+    cur.h        = face->face_h;
+    cur.rotation = face->rotation;
+
+    roi_from_landmarks (next_roi, &cur, &facemesh->joint[0].x, FACE_KEY_NUM, 3, &s_face_roi_param);
+
+    float score = 1.0f / (1.0f + std::exp (-facemesh->score));
+
+    memset (next_face, 0, sizeof (*next_face));
+    next_face->score      = score;
+    next_face->topleft.x  = next_face->topleft.y  =  FLT_MAX;
+    next_face->btmright.x = next_face->btmright.y = -FLT_MAX;
+    for (int i = 0; i < FACE_KEY_NUM; i ++)
+    {
+        float x, y;
+        roi_project_point (&cur, facemesh->joint[i].x, facemesh->joint[i].y, &x, &y);
+
+        next_face->topleft.x  = std::min (next_face->topleft.x,  x);
+        next_face->topleft.y  = std::min (next_face->topleft.y,  y);
+        next_face->btmright.x = std::max (next_face->btmright.x, x);
+        next_face->btmright.y = std::max (next_face->btmright.y, y);
+    }
+
+    for (int i = 0; i < kFaceKeyNum; i ++)
+    {
+        const fvec3 *key = &facemesh->joint[s_face_key_landmark[i]];
+        roi_project_point (&cur, key->x, key->y, &next_face->keys[i].x, &next_face->keys[i].y);
+    }
+
+    float quad[4][2];
+    roi_get_quad (next_roi, quad);
+
+    next_face->rotation = next_roi->rotation;
+    next_face->face_cx  = next_roi->cx;
+    next_face->face_cy  = next_roi->cy;
+    next_face->face_w   = next_roi->w;
+    next_face->face_h   = next_roi->h;
+    for (int i = 0; i < 4; i ++)
+    {
+        next_face->face_pos[i].x = quad[i][0];
+        next_face->face_pos[i].y = quad[i][1];
+    }
+
+    return score;
+}
+
+
+/* -------------------------------------------------- *
+ *  Single instance APIs (default session)
+ * -------------------------------------------------- */
+int
+init_tflite_facemesh (int use_quantized_tflite)
+{
+    s_session = facemesh_session_create (use_quantized_tflite, 0);
+    if (s_session == NULL)
+        return -1;
 
     return 0;
 }
 
+void *
+get_face_detect_input_buf (int *w, int *h)
+{
+    return facemesh_get_detect_input_buf (s_session, w, h);
+}
+
+int
+invoke_face_detect (face_detect_result_t *facedet_result)
+{
+    return facemesh_invoke_detect (s_session, facedet_result);
+}
+
+void *
+get_facemesh_landmark_input_buf (int *w, int *h)
+{
+    return facemesh_get_landmark_input_buf (s_session, w, h);
+}
+
+int
+invoke_facemesh_landmark (face_landmark_result_t *facemesh_result)
+{
+    return facemesh_invoke_landmark (s_session, facemesh_result);
+}
+
+void *
+get_facemesh_landmark_batch_input_buf (int num, int *w, int *h)
+{
+    return facemesh_get_landmark_batch_input_buf (s_session, num, w, h);
+}
+
+int
+invoke_facemesh_landmark_batch (face_landmark_result_t *facemesh_result, int num)
+{
+    return facemesh_invoke_landmark_batch (s_session, facemesh_result, num);
+}
+
 
 /*
  * Mesh Indices.
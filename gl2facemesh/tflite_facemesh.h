@@ -5,6 +5,8 @@
 #ifndef TFLITE_HAND_LANDMARK_H_
 #define TFLITE_HAND_LANDMARK_H_
 
+#include "util_roi_track.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -72,6 +74,31 @@ typedef struct _face_landmark_result_t
 
 
 
+/*
+ *  each session owns its interpreters, tensors and post-process buffers,
+ *  so that multiple sessions can run in parallel (e.g. one per camera).
+ *  num_threads: TFLite threads per interpreter (0: number of CPUs)
+ */
+typedef struct _facemesh_session_t facemesh_session_t;
+
+facemesh_session_t *facemesh_session_create  (int use_quantized_tflite, int num_threads);
+void                facemesh_session_destroy (facemesh_session_t *sess);
+
+void *facemesh_get_detect_input_buf   (facemesh_session_t *sess, int *w, int *h);
+int   facemesh_invoke_detect          (facemesh_session_t *sess, face_detect_result_t *facedet_result);
+void *facemesh_get_landmark_input_buf (facemesh_session_t *sess, int *w, int *h);
+int   facemesh_invoke_landmark        (facemesh_session_t *sess, face_landmark_result_t *facemesh_result);
+
+/* batched landmark: (num) faces in one Invoke(). the input is [num][h][w][3]. */
+void *facemesh_get_landmark_batch_input_buf (facemesh_session_t *sess, int num, int *w, int *h);
+int   facemesh_invoke_landmark_batch        (facemesh_session_t *sess, face_landmark_result_t *facemesh_result, int num);
+
+/* ROI tracking: the face of the next frame from the landmarks. returns the face presence [0, 1]. */
+float facemesh_landmark_to_face (const face_t *face, const face_landmark_result_t *facemesh_result,
+                                 face_t *next_face, roi_t *next_roi);
+
+
+/* single instance APIs. they work on the session created by init_tflite_facemesh(). */
 int  init_tflite_facemesh (int use_quantized_tflite);
 
 void *get_face_detect_input_buf (int *w, int *h);
@@ -80,6 +107,9 @@ int  invoke_face_detect (face_detect_result_t *facedet_result);
 void *get_facemesh_landmark_input_buf (int *w, int *h);
 int  invoke_facemesh_landmark (face_landmark_result_t *facemesh_result);
 
+void *get_facemesh_landmark_batch_input_buf (int num, int *w, int *h);
+int  invoke_facemesh_landmark_batch (face_landmark_result_t *facemesh_result, int num);
+
 int
 get_static_facemesh_landmark (face_detect_result_t   *facedet_result,
                               face_landmark_result_t *facemesh_result);
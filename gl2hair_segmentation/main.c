@@ -14,6 +14,8 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
+#include "util_segment.h"
 #include "util_matrix.h"
 #include "tflite_hair_segmentation.h"
 #include "render_hair.h"
@@ -32,13 +34,8 @@ feed_segmentation_image (texture_2d_t *srctex, int win_w, int win_h)
 {
     int x, y, w, h;
     float *buf_fp32 = (float *)get_segmentation_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -147,12 +144,10 @@ void
 render_segment_result (int ofstx, int ofsty, int draw_w, int draw_h, 
                        texture_2d_t *srctex, segmentation_result_t *segment_ret)
 {
-    float *segmap = segment_ret->segmentmap;
-    int segmap_w  = segment_ret->segmentmap_dims[0];
-    int segmap_h  = segment_ret->segmentmap_dims[1];
-    int segmap_c  = segment_ret->segmentmap_dims[2];
-    int x, y, c;
-    unsigned int imgbuf[segmap_h][segmap_w];
+    segment_map_t segmap = {0};
+    static stream_texture_t s_segtex;
+    static preproc_buf_t s_imgbuf;
+    uint32_t palette[MAX_SEGMENT_CLASS];
     float hair_color[4] = {0};
     float back_color[4] = {0};
     static float s_hsv_h = 0.0f;
@@ -168,47 +163,24 @@ render_segment_result (int ofstx, int ofsty, int draw_w, int draw_h,
     hair_color[3] = lumi;
 #endif
 
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
-    {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            int max_id;
-            float conf_max = 0;
-            for (c = 0; c < MAX_SEGMENT_CLASS; c ++)
-            {
-                float confidence = segmap[(y * segmap_w * segmap_c)+ (x * segmap_c) + c];
-                if (c == 0 || confidence > conf_max)
-                {
-                    conf_max = confidence;
-                    max_id = c;
-                }
-            }
+    segmap.buf  = segment_ret->segmentmap;
+    segmap.type = SEGMENT_TYPE_FP32;
+    segmap.w    = segment_ret->segmentmap_dims[0];
+    segmap.h    = segment_ret->segmentmap_dims[1];
+    segmap.c    = segment_ret->segmentmap_dims[2];
 
-            float *col = (max_id > 0) ? hair_color : back_color;
-            unsigned char r = ((int)(col[0] * 255)) & 0xff;
-            unsigned char g = ((int)(col[1] * 255)) & 0xff;
-            unsigned char b = ((int)(col[2] * 255)) & 0xff;
-            unsigned char a = ((int)(col[3] * 255)) & 0xff;
+    segment_palette_from_fp32 (&palette[0], back_color);
+    segment_palette_from_fp32 (&palette[1], hair_color);
 
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
-    }
-
-    GLuint texid;
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
-
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    /* find the most confident class for each pixel. */
+    uint32_t *imgbuf = (uint32_t *)preproc_buf_reserve (&s_imgbuf, segmap.w * segmap.h * 4);
+    segment_argmax (&segmap, MAX_SEGMENT_CLASS, NULL, NULL, palette, MAX_SEGMENT_CLASS, imgbuf);
 
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    texture_2d_t *segtex = update_stream_texture (&s_segtex, imgbuf, segmap.w, segmap.h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
+    if (segtex == NULL)
+        return;
 
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,
-        segmap_w, segmap_h, 0, GL_RGBA,
-        GL_UNSIGNED_BYTE, imgbuf);
+    GLuint texid = segtex->texid;
 
 #if !defined (RENDER_BY_BLEND)
     draw_colored_hair (srctex, texid, ofstx, ofsty, draw_w, draw_h, 0, hair_color);
@@ -219,8 +191,6 @@ render_segment_result (int ofstx, int ofsty, int draw_w, int draw_h,
     draw_2d_texture_blendfunc (texid, ofstx, ofsty, draw_w, draw_h, 0, blend_add);
 #endif
 
-    glDeleteTextures (1, &texid);
-
     render_hsv_circle (ofstx + draw_w - 100, ofsty + 100, s_hsv_h);
 }
 
@@ -328,6 +298,7 @@ main(int argc, char *argv[])
     init_pmeter (win_w, win_h, 500);
     init_dbgstr (win_w, win_h);
     init_tflite_segmentation ();
+    segment_init (0);
 
 #if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
     /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
@@ -53,7 +53,7 @@ get_segmentation_input_buf (int *w, int *h)
 int
 invoke_segmentation (segmentation_result_t *segment_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -0,0 +1,117 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util_tflite.h"
+#include "util_bench.h"
+#include "tflite_handpose.h"
+
+/*
+ *  Headless benchmark of the handpose pipeline (CPU only, no EGL/GLES).
+ *
+ *    $ make bench
+ *    $ ./gl2handpose_bench -w 10 -n 200 -o result.json ./images/
+ */
+static void *
+session_create (int use_quantized)
+{
+    return handpose_session_create (use_quantized, 0);
+}
+
+static void
+session_destroy (void *sess)
+{
+    handpose_session_destroy ((handpose_session_t *)sess);
+}
+
+static void *
+get_detect_input (void *sess, int *w, int *h)
+{
+    return handpose_get_palm_detection_input_buf ((handpose_session_t *)sess, w, h);
+}
+
+static int
+invoke_detect (void *sess, void *items)
+{
+    palm_detection_result_t palm_ret;
+
+    if (handpose_invoke_palm_detection ((handpose_session_t *)sess, &palm_ret, 0) < 0)
+        return -1;
+
+    memcpy (items, palm_ret.palms, palm_ret.num * sizeof (palm_t));
+    return palm_ret.num;
+}
+
+static void
+get_item_quad (const void *item, float quad[4][2])
+{
+    const palm_t *palm = (const palm_t *)item;
+    int i;
+
+    for (i = 0; i < 4; i ++)
+    {
+        quad[i][0] = palm->hand_pos[i].x;
+        quad[i][1] = palm->hand_pos[i].y;
+    }
+}
+
+static void *
+get_landmark_input (void *sess, int *w, int *h)
+{
+    return handpose_get_hand_landmark_input_buf ((handpose_session_t *)sess, w, h);
+}
+
+static int
+invoke_landmark (void *sess, void *result)
+{
+    return handpose_invoke_hand_landmark ((handpose_session_t *)sess, (hand_landmark_result_t *)result);
+}
+
+static void *
+get_landmark_batch_input (void *sess, int num, int *w, int *h)
+{
+    return handpose_get_hand_landmark_batch_input_buf ((handpose_session_t *)sess, num, w, h);
+}
+
+static int
+invoke_landmark_batch (void *sess, void *results, int num)
+{
+    return handpose_invoke_hand_landmark_batch ((handpose_session_t *)sess,
+                                                (hand_landmark_result_t *)results, num);
+}
+
+static float
+landmark_to_item (const void *item, const void *result, void *next_item, roi_t *next_roi)
+{
+    return handpose_landmark_to_palm ((const palm_t *)item, (const hand_landmark_result_t *)result,
+                                      (palm_t *)next_item, next_roi);
+}
+
+int
+main (int argc, char *argv[])
+{
+    bench_cascade_t cas = {0};
+
+    cas.app         = "gl2handpose";
+    cas.item_name   = "hands";
+    cas.max_items   = MAX_PALM_NUM;
+    cas.item_size   = sizeof (palm_t);
+    cas.result_size = sizeof (hand_landmark_result_t);
+
+    cas.session_create           = session_create;
+    cas.session_destroy          = session_destroy;
+    cas.get_invoke_ms            = tflite_get_last_invoke_ms;
+    cas.get_detect_input         = get_detect_input;
+    cas.invoke_detect            = invoke_detect;
+    cas.get_item_quad            = get_item_quad;
+    cas.get_landmark_input       = get_landmark_input;
+    cas.invoke_landmark          = invoke_landmark;
+    cas.get_landmark_batch_input = get_landmark_batch_input;
+    cas.invoke_landmark_batch    = invoke_landmark_batch;
+    cas.landmark_to_item         = landmark_to_item;
+
+    return bench_cascade_main (&cas, argc, argv);
+}
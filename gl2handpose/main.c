@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -13,7 +14,12 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
+#include "util_warp.h"
 #include "util_matrix.h"
+#include "util_render_target.h"
+#include "util_pipeline.h"
+#include "util_roi_track.h"
 #include "tflite_handpose.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
@@ -25,60 +31,78 @@
 
 static imgui_data_t s_gui_prop = {0};
 
+/* RGBA pixels of the input image file (for the CPU crop) */
+static void *s_still_img;
+static int  s_still_w, s_still_h;
 
 
 
-/* resize image to DNN network input size and convert to fp32. */
-void
-feed_palm_detection_image(texture_2d_t *srctex, int win_w, int win_h)
-{
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_palm_detection_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
 
-    draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
+/* read back the rendered image and convert UI8 [0, 255] ==> FP32 [-1, 1] */
+static void
+readback_to_fp32 (float *buf_fp32, int w, int h)
+{
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     glPixelStorei (GL_PACK_ALIGNMENT, 4);
     glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
+}
+
+/* resize image to DNN network input size and convert to fp32. */
+static void
+feed_palm_detection_image_buf (texture_2d_t *srctex, int win_w, int win_h, float *buf_fp32)
+{
+    int w, h;
 
-    return;
+    get_palm_detection_input_buf (&w, &h);
+
+    draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
+    readback_to_fp32 (buf_fp32, w, h);
 }
 
 void
-feed_hand_landmark_image(texture_2d_t *srctex, int win_w, int win_h, palm_detection_result_t *detection, unsigned int hand_id)
+feed_palm_detection_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h)
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_hand_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
+    int w, h;
+    float *buf_fp32 = (float *)get_palm_detection_input_buf (&w, &h);
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+    if (cpusrc)
+    {
+        preproc_norm_t norm;
+        preproc_norm_set (&norm, 128.0f, 128.0f);
+        warp_resize_to_fp32 (cpusrc, buf_fp32, w, h, &norm, 0);
+        return;
+    }
+
+    feed_palm_detection_image_buf (srctex, win_w, win_h, buf_fp32);
+}
 
-    buf_ui8 = pui8;
+static void
+feed_hand_landmark_image_buf (texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                              palm_detection_result_t *detection, unsigned int hand_id,
+                              float *buf_fp32, int w, int h)
+{
+    /* crop, rotate, resize and normalize in one pass on CPU. */
+    if (cpusrc && detection->num > hand_id)
+    {
+        palm_t *palm = &(detection->palms[hand_id]);
+        float quad[4][2];
+        preproc_norm_t norm;
+
+        for (int i = 0; i < 4; i ++)
+        {
+            quad[i][0] = palm->hand_pos[i].x;
+            quad[i][1] = palm->hand_pos[i].y;
+        }
+        preproc_norm_set (&norm, 128.0f, 128.0f);
+        warp_quad_to_fp32 (cpusrc, quad, buf_fp32, w, h, &norm, 0);
+        return;
+    }
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -103,28 +127,297 @@ feed_hand_landmark_image(texture_2d_t *srctex, int win_w, int win_h, palm_detect
     }
 
     draw_2d_texture_ex_texcoord (srctex, 0, win_h - h, w, h, texcoord);
+    readback_to_fp32 (buf_fp32, w, h);
+}
 
-    glPixelStorei (GL_PACK_ALIGNMENT, 4);
-    glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
+void
+feed_hand_landmark_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                         palm_detection_result_t *detection, unsigned int hand_id)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_hand_landmark_input_buf (&w, &h);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
-    float mean = 128.0f;
-    float std  = 128.0f;
-    for (y = 0; y < h; y ++)
+    feed_hand_landmark_image_buf (srctex, cpusrc, win_w, win_h, detection, hand_id, buf_fp32, w, h);
+}
+
+/*
+ *  crop all the detected hands into one [num][h][w][3] input, and run the
+ *  landmark model once. returns -1 if the model can't take a batch (GPU
+ *  delegate), then the caller goes one by one.
+ */
+static int
+invoke_hand_landmark_batch_all (texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                                palm_detection_result_t *detection, hand_landmark_result_t *hand_ret,
+                                double *invoke_ms)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_hand_landmark_batch_input_buf (detection->num, &w, &h);
+
+    if (buf_fp32 == NULL)
+        return -1;
+
+    for (int hand_id = 0; hand_id < detection->num; hand_id ++)
     {
-        for (x = 0; x < w; x ++)
+        feed_hand_landmark_image_buf (srctex, cpusrc, win_w, win_h, detection, hand_id,
+                                      buf_fp32 + hand_id * w * h * 3, w, h);
+    }
+
+    double ttime0 = pmeter_get_time_ms ();
+    invoke_hand_landmark_batch (hand_ret, detection->num);
+    *invoke_ms = pmeter_get_time_ms () - ttime0;
+
+    return 0;
+}
+
+/* the current input frame on CPU. returns NULL if it is not available yet. */
+static warp_src_t *
+get_cpu_frame (warp_src_t *src, int enable_camera, int enable_video)
+{
+    void     *buf = s_still_img;
+    int      w    = s_still_w;
+    int      h    = s_still_h;
+    uint32_t fmt  = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+    if (enable_video)
+    {
+        get_video_buffer (&buf);
+        get_video_dimension (&w, &h);
+        get_video_pixformat (&fmt);
+    }
+#endif
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    if (enable_camera)
+    {
+        get_capture_buffer (&buf);
+        get_capture_dimension (&w, &h);
+        get_capture_pixformat (&fmt);
+    }
+#endif
+
+    if (warp_src_set (src, buf, w, h, 0, fmt) < 0)
+        return NULL;
+
+    return src;
+}
+
+
+/* -------------------------------------------------- *
+ *  ROI tracking
+ *    the hands of the next frame come from the landmarks of this frame,
+ *    so the palm detector runs only when a hand is lost.
+ * -------------------------------------------------- */
+static void
+update_hand_track (roi_track_t *trk, palm_detection_result_t *detection, hand_landmark_result_t *hand_ret)
+{
+    palm_t next_palms[MAX_PALM_NUM];
+    roi_t  next_rois[MAX_PALM_NUM];
+    float  scores[MAX_PALM_NUM];
+
+    for (int hand_id = 0; hand_id < detection->num; hand_id ++)
+    {
+        scores[hand_id] = handpose_landmark_to_palm (&detection->palms[hand_id], &hand_ret[hand_id],
+                                                     &next_palms[hand_id], &next_rois[hand_id]);
+    }
+
+    roi_track_update (trk, next_rois, scores, next_palms, detection->num);
+}
+
+
+/* -------------------------------------------------- *
+ *  Pipelined execution
+ *
+ *    [source  ] GL thread : snapshot camera image, preprocess for palm detection
+ *    [detect  ] worker    : palm detection
+ *    [crop    ] GL thread : crop detected hands for landmark
+ *    [landmark] worker    : hand landmark
+ *    [display ] GL thread : render the newest finished frame
+ * -------------------------------------------------- */
+#define PIPE_FRAME_NUM      6
+
+enum pipe_stage_id {
+    PIPE_STAGE_SOURCE = 0,
+    PIPE_STAGE_DETECT,
+    PIPE_STAGE_CROP,
+    PIPE_STAGE_LANDMARK,
+    PIPE_STAGE_DISPLAY,
+};
+
+typedef struct _pipe_frame_t
+{
+    render_target_t         rtarget;        /* snapshot of the camera image */
+    texture_2d_t            tex;
+    float                   *detect_input;
+    float                   *landmark_input[MAX_PALM_NUM];
+    palm_detection_result_t palm_ret;
+    hand_landmark_result_t  hand_ret[MAX_PALM_NUM];
+    double                  invoke_ms0;
+    double                  invoke_ms1;
+} pipe_frame_t;
+
+static pipe_frame_t s_pipe_frames[PIPE_FRAME_NUM];
+static int          s_lmk_w, s_lmk_h;   /* the landmark worker may resize the model at any time */
+static pipe_frame_t *s_pipe_disp_frame;
+static int          s_pipe_palm_detect;
+
+static int
+pipe_palm_detect (void *frame, void *usr)
+{
+    pipe_frame_t *pf = (pipe_frame_t *)frame;
+    int w, h;
+
+    if (s_pipe_palm_detect)
+    {
+        void *buf_fp32 = get_palm_detection_input_buf (&w, &h);
+        memcpy (buf_fp32, pf->detect_input, w * h * 3 * sizeof (float));
+
+        double ttime0 = pmeter_get_time_ms ();
+        invoke_palm_detection (&pf->palm_ret, 0);
+        pf->invoke_ms0 = pmeter_get_time_ms () - ttime0;
+    }
+    else
+    {
+        invoke_palm_detection (&pf->palm_ret, 1);
+        pf->invoke_ms0 = 0;
+    }
+
+    return 0;
+}
+
+static int
+pipe_hand_landmark (void *frame, void *usr)
+{
+    pipe_frame_t *pf = (pipe_frame_t *)frame;
+    int num = pf->palm_ret.num;
+    int w, h;
+    float *buf_fp32;
+
+    pf->invoke_ms1 = 0;
+    if (num == 0)
+        return 0;
+
+    /* all the hands in one Invoke() */
+    buf_fp32 = (float *)get_hand_landmark_batch_input_buf (num, &w, &h);
+    if (buf_fp32)
+    {
+        for (int hand_id = 0; hand_id < num; hand_id ++)
         {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
+            memcpy (buf_fp32 + hand_id * w * h * 3, pf->landmark_input[hand_id],
+                    w * h * 3 * sizeof (float));
         }
+
+        double ttime0 = pmeter_get_time_ms ();
+        invoke_hand_landmark_batch (pf->hand_ret, num);
+        pf->invoke_ms1 = pmeter_get_time_ms () - ttime0;
+        return 0;
     }
 
-    return;
+    buf_fp32 = (float *)get_hand_landmark_input_buf (&w, &h);
+    for (int hand_id = 0; hand_id < num; hand_id ++)
+    {
+        memcpy (buf_fp32, pf->landmark_input[hand_id], w * h * 3 * sizeof (float));
+
+        double ttime0 = pmeter_get_time_ms ();
+        invoke_hand_landmark (&pf->hand_ret[hand_id]);
+        pf->invoke_ms1 += pmeter_get_time_ms () - ttime0;
+    }
+
+    return 0;
+}
+
+static int
+init_pipeline (pipeline_t *pipe, int policy, int texw, int texh, int enable_palm_detect)
+{
+    void *frames[PIPE_FRAME_NUM];
+    int det_w, det_h, lmk_w, lmk_h;
+
+    get_palm_detection_input_buf (&det_w, &det_h);
+    get_hand_landmark_input_buf (&lmk_w, &lmk_h);
+    s_lmk_w = lmk_w;
+    s_lmk_h = lmk_h;
+
+    for (int i = 0; i < PIPE_FRAME_NUM; i ++)
+    {
+        pipe_frame_t *pf = &s_pipe_frames[i];
+
+        create_render_target (&pf->rtarget, texw, texh, RTARGET_COLOR);
+        pf->tex.texid  = pf->rtarget.texc_id;
+        pf->tex.width  = texw;
+        pf->tex.height = texh;
+        pf->tex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+        pf->detect_input = (float *)malloc (det_w * det_h * 3 * sizeof (float));
+        if (pf->detect_input == NULL)
+            return -1;
+
+        for (int hand_id = 0; hand_id < MAX_PALM_NUM; hand_id ++)
+        {
+            pf->landmark_input[hand_id] = (float *)malloc (lmk_w * lmk_h * 3 * sizeof (float));
+            if (pf->landmark_input[hand_id] == NULL)
+                return -1;
+        }
+        frames[i] = pf;
+    }
+    s_pipe_palm_detect = enable_palm_detect;
+
+    pipeline_init (pipe, frames, PIPE_FRAME_NUM, policy);
+    pipeline_add_stage (pipe, "detect",   pipe_palm_detect,   NULL);
+    pipeline_add_stage (pipe, "crop",     NULL,               NULL);
+    pipeline_add_stage (pipe, "landmark", pipe_hand_landmark, NULL);
+    pipeline_add_stage (pipe, "display",  NULL,               NULL);
+
+    return pipeline_start (pipe);
+}
+
+/* serve the GL thread stages, and return the frame to be displayed. */
+static pipe_frame_t *
+update_pipeline (pipeline_t *pipe, texture_2d_t *captex, int win_w, int win_h)
+{
+    pipe_frame_t *pf;
+
+    if (pipe->policy == PIPELINE_POLICY_BLOCK)
+        pipeline_wait_inline (pipe);
+
+    /* take a snapshot of the camera image, so that the later stages and the display
+     * see the same picture, then preprocess it for palm detection. */
+    pf = (pipe_frame_t *)pipeline_get_frame (pipe, PIPE_STAGE_SOURCE, 0);
+    if (pf)
+    {
+        set_render_target (&pf->rtarget);
+        draw_2d_texture_ex (captex, 0, 0, win_w, win_h, 1);
+        glBindFramebuffer (GL_FRAMEBUFFER, 0);
+        glViewport (0, 0, win_w, win_h);
+
+        if (s_pipe_palm_detect)
+            feed_palm_detection_image_buf (&pf->tex, win_w, win_h, pf->detect_input);
+        pipeline_put_frame (pipe, PIPE_STAGE_SOURCE, pf);
+    }
+
+    /* crop the detected hands */
+    while ((pf = (pipe_frame_t *)pipeline_get_frame (pipe, PIPE_STAGE_CROP, 0)) != NULL)
+    {
+        for (int hand_id = 0; hand_id < pf->palm_ret.num; hand_id ++)
+        {
+            feed_hand_landmark_image_buf (&pf->tex, NULL, win_w, win_h, &pf->palm_ret, hand_id,
+                                          pf->landmark_input[hand_id], s_lmk_w, s_lmk_h);
+        }
+        pipeline_put_frame (pipe, PIPE_STAGE_CROP, pf);
+    }
+
+    /* finished frame */
+    if (pipe->policy == PIPELINE_POLICY_DROP_OLDEST)
+        pf = (pipe_frame_t *)pipeline_get_latest_frame (pipe, PIPE_STAGE_DISPLAY);
+    else
+        pf = (pipe_frame_t *)pipeline_get_frame (pipe, PIPE_STAGE_DISPLAY, 0);
+
+    if (pf)
+    {
+        if (s_pipe_disp_frame)
+            pipeline_put_frame (pipe, PIPE_STAGE_DISPLAY, s_pipe_disp_frame);
+        s_pipe_disp_frame = pf;
+    }
+
+    return s_pipe_disp_frame;
 }
 
 
@@ -223,6 +516,8 @@ render_skelton_2d (int ofstx, int ofsty, int texw, int texh, palm_t *palm,
     float col_cyan[]  = {0.0f, 1.0f, 1.0f, 1.0f};
     float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
+    begin_2d_batch ();
+
     /* transform to global coordinate */
     hand_landmark_result_t hand_draw;
     compute_2d_skelton_pos (&hand_draw, hand_landmark, palm);
@@ -264,6 +559,8 @@ render_skelton_2d (int ofstx, int ofsty, int texw, int texh, palm_t *palm,
         render_2d_bone (ofstx, ofsty, texw, texh, &hand_draw, idx0+1, idx1+1);
         render_2d_bone (ofstx, ofsty, texw, texh, &hand_draw, idx0+2, idx1+2);
     }
+
+    end_2d_batch ();
 }
 
 
@@ -682,26 +979,46 @@ main(int argc, char *argv[])
     int use_quantized_tflite = 0;
     int enable_palm_detect = 0;
     int enable_camera = 1;
+    int enable_pipeline = 0;
+    int enable_gl_crop = 0;
+    int enable_track = 0;
+    int redetect_interval = 0;
+    int pipe_policy = PIPELINE_POLICY_DROP_OLDEST;
+    pipeline_t pipe;
+    roi_track_t track;
     UNUSED (argc);
     UNUSED (*argv);
-#if defined (USE_INPUT_VIDEO_DECODE)
     int enable_video = 0;
-#endif
 
     {
         int c;
-        const char *optstring = "mqv:x";
+        const char *optstring = "gmpPqr:v:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'g':
+                enable_gl_crop = 1;
+                break;
             case 'm':
                 enable_palm_detect = 1;
                 break;
+            case 'p':
+                enable_pipeline = 1;
+                pipe_policy = PIPELINE_POLICY_DROP_OLDEST;
+                break;
+            case 'P':
+                enable_pipeline = 1;
+                pipe_policy = PIPELINE_POLICY_BLOCK;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
+            case 'r':
+                enable_track = 1;
+                redetect_interval = atoi (optarg);
+                break;
 #if defined (USE_INPUT_VIDEO_DECODE)
             case 'v':
                 enable_video = 1;
@@ -760,7 +1077,9 @@ main(int argc, char *argv[])
 #endif
     {
         int texid;
-        load_jpg_texture (input_name, &texid, &texw, &texh);
+        load_jpg_texture_ex (input_name, &texid, &texw, &texh, &s_still_img);
+        s_still_w = texw;
+        s_still_h = texh;
         captex.texid  = texid;
         captex.width  = texw;
         captex.height = texh;
@@ -769,8 +1088,29 @@ main(int argc, char *argv[])
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
+    warp_init (0);
+
     glClearColor (0.f, 0.f, 0.f, 1.0f);
 
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* GPU Delegate must be invoked on the GL thread. */
+    enable_pipeline = 0;
+#endif
+    if (enable_pipeline && init_pipeline (&pipe, pipe_policy, texw, texh, enable_palm_detect) < 0)
+    {
+        fprintf (stderr, "failed to start pipeline. fall back to serial execution.\n");
+        enable_pipeline = 0;
+    }
+
+    /* the detector stage runs ahead of the landmark stage in the pipelined mode. */
+    if (enable_track && enable_pipeline)
+    {
+        fprintf (stderr, "ROI tracking is not available in the pipelined mode.\n");
+        enable_track = 0;
+    }
+    if (enable_track && roi_track_init (&track, MAX_PALM_NUM, sizeof (palm_t), 0.5f, redetect_interval) < 0)
+        enable_track = 0;
+
     /* --------------------------------------- *
      *  Render Loop
      * --------------------------------------- */
@@ -778,6 +1118,7 @@ main(int argc, char *argv[])
     {
         palm_detection_result_t palm_ret = {0};
         hand_landmark_result_t  hand_ret[MAX_PALM_NUM] = {0};
+        texture_2d_t            *disptex = &captex;
         char strbuf[512];
 
         PMETER_RESET_LAP ();
@@ -804,35 +1145,67 @@ main(int argc, char *argv[])
         }
 #endif
 
-        /* --------------------------------------- *
-         *  palm detection
-         * --------------------------------------- */
-        if (enable_palm_detect)
+        if (enable_pipeline)
         {
-            feed_palm_detection_image (&captex, win_w, win_h);
-
-            ttime[2] = pmeter_get_time_ms ();
-            invoke_palm_detection (&palm_ret, 0);
-            ttime[3] = pmeter_get_time_ms ();
-            invoke_ms0 = ttime[3] - ttime[2];
+            pipe_frame_t *pf = update_pipeline (&pipe, &captex, win_w, win_h);
+            if (pf)
+            {
+                memcpy (&palm_ret, &pf->palm_ret, sizeof (palm_ret));
+                memcpy (hand_ret, pf->hand_ret, sizeof (hand_ret));
+                invoke_ms0 = pf->invoke_ms0;
+                invoke_ms1 = pf->invoke_ms1;
+                disptex    = &pf->tex;
+            }
         }
         else
         {
-            invoke_palm_detection (&palm_ret, 1);
-        }
+            warp_src_t cpu_frame, *cpusrc = NULL;
+            if (!enable_gl_crop)
+                cpusrc = get_cpu_frame (&cpu_frame, enable_camera, enable_video);
+
+            /* --------------------------------------- *
+             *  palm detection (skipped while the hands are tracked)
+             * --------------------------------------- */
+            if (enable_track && !roi_track_need_detect (&track))
+            {
+                palm_ret.num = roi_track_get (&track, palm_ret.palms);
+                invoke_ms0 = 0;
+            }
+            else if (enable_palm_detect)
+            {
+                feed_palm_detection_image (&captex, cpusrc, win_w, win_h);
 
-        /* --------------------------------------- *
-         *  hand landmark
-         * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int hand_id = 0; hand_id < palm_ret.num; hand_id ++)
-        {
-            feed_hand_landmark_image (&captex, win_w, win_h, &palm_ret, hand_id);
+                ttime[2] = pmeter_get_time_ms ();
+                invoke_palm_detection (&palm_ret, 0);
+                ttime[3] = pmeter_get_time_ms ();
+                invoke_ms0 = ttime[3] - ttime[2];
+            }
+            else
+            {
+                invoke_palm_detection (&palm_ret, 1);
+            }
+
+            /* --------------------------------------- *
+             *  hand landmark
+             * --------------------------------------- */
+            invoke_ms1 = 0;
+            if (palm_ret.num <= 1 ||
+                invoke_hand_landmark_batch_all (&captex, cpusrc, win_w, win_h, &palm_ret,
+                                                hand_ret, &invoke_ms1) < 0)
+            {
+                for (int hand_id = 0; hand_id < palm_ret.num; hand_id ++)
+                {
+                    feed_hand_landmark_image (&captex, cpusrc, win_w, win_h, &palm_ret, hand_id);
 
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_hand_landmark (&hand_ret[hand_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+                    ttime[4] = pmeter_get_time_ms ();
+                    invoke_hand_landmark (&hand_ret[hand_id]);
+                    ttime[5] = pmeter_get_time_ms ();
+                    invoke_ms1 += ttime[5] - ttime[4];
+                }
+            }
+
+            if (enable_track)
+                update_hand_track (&track, &palm_ret, hand_ret);
         }
 
         /* --------------------------------------- *
@@ -841,7 +1214,7 @@ main(int argc, char *argv[])
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         /* visualize the hand pose estimation results. */
-        draw_2d_texture_ex (&captex, draw_x, draw_y, draw_w, draw_h, 0);
+        draw_2d_texture_ex (disptex, draw_x, draw_y, draw_w, draw_h, 0);
 
         for (int hand_id = 0; hand_id < palm_ret.num; hand_id ++)
         {
@@ -859,7 +1232,7 @@ main(int argc, char *argv[])
             float y = h * hand_id + 10;
             float col_white[] = {1.0f, 1.0f, 1.0f, 1.0f};
 
-            render_cropped_hand_image (&captex, x, y, w, h, &palm_ret, hand_id);
+            render_cropped_hand_image (disptex, x, y, w, h, &palm_ret, hand_id);
             draw_2d_rect (x, y, w, h, col_white, 2.0f);
         }
 
@@ -882,6 +1255,11 @@ main(int argc, char *argv[])
 
         sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite0 :%5.1f [ms]\nTFLite1 :%5.1f [ms]",
             interval, invoke_ms0, invoke_ms1);
+        if (enable_track)
+        {
+            sprintf (strbuf + strlen (strbuf), "\nTrack   :%5.1f [%%] (hit:%d miss:%d)",
+                roi_track_skip_ratio (&track) * 100.0f, track.stats.hits, track.stats.misses);
+        }
         draw_dbgstr (strbuf, 10, 10);
 
 #if defined (USE_IMGUI)
@@ -3,9 +3,12 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_nms.h"
+#include "util_anchor.h"
 #include "tflite_handpose.h"
 #include "custom_ops/transpose_conv_bias.h"
-#include <list>
+#include <algorithm>
+#include <cfloat>
 
 /* 
  * https://github.com/google/mediapipe/tree/master/mediapipe/models/hand_landmark_3d.tflite
@@ -16,195 +19,79 @@
 #define PALM_DETECTION_QUANT_MODEL_PATH  "./handpose_model/palm_detection_builtin_256_integer_quant.tflite"
 #define HAND_LANDMARK_QUANT_MODEL_PATH   "./handpose_model/hand_landmark_3d_256_integer_quant.tflite"
 
-static tflite_interpreter_t s_palm_interpreter;
-static tflite_tensor_t      s_palm_tensor_input;
-static tflite_tensor_t      s_palm_tensor_scores;
-static tflite_tensor_t      s_palm_tensor_points;
-
-static tflite_interpreter_t s_hand_interpreter;
-static tflite_tensor_t      s_hand_tensor_input;
-static tflite_tensor_t      s_hand_tensor_landmark;
-static tflite_tensor_t      s_hand_tensor_handflag;
-
-
-typedef struct Anchor
+enum palm_tensor_id {
+    PALM_INPUT = 0,
+    PALM_SCORES,
+    PALM_POINTS,
+    PALM_TENSOR_NUM
+};
+
+static const tflite_tensor_desc_t s_palm_tensor_descs[PALM_TENSOR_NUM] = {
+    {0, "input"},
+    {1, "classificators"},
+    {1, "regressors"},
+};
+
+enum hand_tensor_id {
+    HAND_INPUT = 0,
+    HAND_LANDMARK,
+    HAND_HANDFLAG,
+    HAND_TENSOR_NUM
+};
+
+static const tflite_tensor_desc_t s_hand_tensor_descs[HAND_TENSOR_NUM] = {
+    {0, "input_1"},
+    {1, "ld_21_3d"},
+    {1, "output_handflag"},
+};
+
+
+struct _handpose_session_t
 {
-    float x_center, y_center, w, h;
-} Anchor;
+    tflite_session_t        palm;
+    tflite_session_t        hand;
 
-static std::vector<Anchor>  s_anchors;
+    /* post-process */
+    const anchor_table_t    *anchors;   /* shared by the sessions */
 
-typedef struct SsdAnchorsCalculatorOptions 
-{
-    int input_size_width;
-    int input_size_height;
-    float min_scale;
-    float max_scale;
-    float anchor_offset_x;
-    float anchor_offset_y;
-
-    int num_layers;
-    std::vector<int> feature_map_width;
-    std::vector<int> feature_map_height;
-
-    std::vector<int>   strides;
-    std::vector<float> aspect_ratios;
-    bool reduce_boxes_in_lowest_layer;
-    float interpolated_scale_aspect_ratio;
-    bool fixed_anchor_size;
-
-} SsdAnchorsCalculatorOptions;
-
-
-
-/* ---------------------------------------------------------------------- *
- *   mediapipe/calculators/tflite/ssd_anchors_calculator_test.cc
- * ---------------------------------------------------------------------- */
- 
-// Copyright 2019 The MediaPipe Authors.
-//
-// Licensed under the Apache License, Version 2.0 (the "License");
-// you may not use this file except in compliance with the License.
-// You may obtain a copy of the License at
-//
-//      http://www.apache.org/licenses/LICENSE-2.0
-//
-// Unless required by applicable law or agreed to in writing, software
-// distributed under the License is distributed on an "AS IS" BASIS,
-// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-// See the License for the specific language governing permissions and
-// limitations under the License.
+    /* palm candidates (one slot per anchor), sized once at init time */
+    std::vector<palm_t>     palm_cands;
+    std::vector<nms_box_t>  palm_boxes;
+    nms_t                   nms;
+};
 
-
-float
-CalculateScale(float min_scale, float max_scale, int stride_index, int num_strides) 
-{
-    return min_scale + (max_scale - min_scale) * 1.0 * stride_index / (num_strides - 1.0f);
-}
+/* for the single instance APIs */
+static handpose_session_t *s_session;
 
 
-int
-GenerateAnchors(std::vector<Anchor>* anchors, const SsdAnchorsCalculatorOptions& options)
+static int
+generate_ssd_anchors (handpose_session_t *sess)
 {
-    int layer_id = 0;
-    while (layer_id < (int)options.strides.size()) {
-        std::vector<float> anchor_height;
-        std::vector<float> anchor_width;
-        std::vector<float> aspect_ratios;
-        std::vector<float> scales;
-
-        // For same strides, we merge the anchors in the same order.
-        int last_same_stride_layer = layer_id;
-        while (last_same_stride_layer < (int)options.strides.size() &&
-               options.strides[last_same_stride_layer] == options.strides[layer_id]) 
-        {
-          const float scale =
-              CalculateScale(options.min_scale, options.max_scale,
-                last_same_stride_layer, options.strides.size());
-          if (last_same_stride_layer == 0 && options.reduce_boxes_in_lowest_layer) {
-            // For first layer, it can be specified to use predefined anchors.
-            aspect_ratios.push_back(1.0);
-            aspect_ratios.push_back(2.0);
-            aspect_ratios.push_back(0.5);
-            scales.push_back(0.1);
-            scales.push_back(scale);
-            scales.push_back(scale);
-          } else {
-            for (int aspect_ratio_id = 0;
-                aspect_ratio_id < (int)options.aspect_ratios.size();
-                 ++aspect_ratio_id) {
-              aspect_ratios.push_back(options.aspect_ratios[aspect_ratio_id]);
-              scales.push_back(scale);
-            }
-            if (options.interpolated_scale_aspect_ratio > 0.0) {
-              const float scale_next =
-                last_same_stride_layer == (int)options.strides.size() - 1
-                      ? 1.0f
-                      : CalculateScale(options.min_scale, options.max_scale,
-                                       last_same_stride_layer + 1,
-                                       options.strides.size());
-              scales.push_back(std::sqrt(scale * scale_next));
-              aspect_ratios.push_back(options.interpolated_scale_aspect_ratio);
-            }
-          }
-          last_same_stride_layer++;
-        }
-
-        for (int i = 0; i < (int)aspect_ratios.size(); ++i) {
-          const float ratio_sqrts = std::sqrt(aspect_ratios[i]);
-          anchor_height.push_back(scales[i] / ratio_sqrts);
-          anchor_width .push_back(scales[i] * ratio_sqrts);
-        }
+    /* mediapipe/modules/palm_detection/palm_detection_cpu.pbtxt */
+    anchor_ssd_opt_t anchor_opt = anchor_ssd_opt_palm;
+    anchor_opt.input_w = sess->palm.tensors[PALM_INPUT].dims[2];
+    anchor_opt.input_h = sess->palm.tensors[PALM_INPUT].dims[1];
 
-        int feature_map_height = 0;
-        int feature_map_width  = 0;
-        if (options.feature_map_height.size()) {
-          feature_map_height = options.feature_map_height[layer_id];
-          feature_map_width  = options.feature_map_width [layer_id];
-        } else {
-          const int stride = options.strides[layer_id];
-          feature_map_height = std::ceil(1.0f * options.input_size_height / stride);
-          feature_map_width  = std::ceil(1.0f * options.input_size_width  / stride);
-        }
-
-        for (int y = 0; y < feature_map_height; ++y) {
-          for (int x = 0; x < feature_map_width; ++x) {
-            for (int anchor_id = 0; anchor_id < (int)anchor_height.size(); ++anchor_id) {
-              // TODO: Support specifying anchor_offset_x, anchor_offset_y.
-              const float x_center = (x + options.anchor_offset_x) * 1.0f / feature_map_width;
-              const float y_center = (y + options.anchor_offset_y) * 1.0f / feature_map_height;
-
-              Anchor new_anchor;
-              new_anchor.x_center = x_center;
-              new_anchor.y_center = y_center;
-
-              if (options.fixed_anchor_size) {
-                new_anchor.w = 1.0f;
-                new_anchor.h = 1.0f;
-              } else {
-                new_anchor.w = anchor_width [anchor_id];
-                new_anchor.h = anchor_height[anchor_id];
-              }
-              anchors->push_back(new_anchor);
-            }
-          }
-        }
-        layer_id = last_same_stride_layer;
+    sess->anchors = anchor_table_get_ssd (&anchor_opt);
+    if (sess->anchors == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
     }
-    return 0;
-}
-
 
-static int
-generate_ssd_anchors ()
-{
-    SsdAnchorsCalculatorOptions anchor_options;
-    anchor_options.num_layers = 5;
-    anchor_options.min_scale = 0.1171875;
-    anchor_options.max_scale = 0.75;
-    anchor_options.input_size_height = 256;
-    anchor_options.input_size_width  = 256;
-    anchor_options.anchor_offset_x  = 0.5f;
-    anchor_options.anchor_offset_y  = 0.5f;
-//  anchor_options.feature_map_width .push_back(0);
-//  anchor_options.feature_map_height.push_back(0);
-    anchor_options.strides.push_back( 8);
-    anchor_options.strides.push_back(16);
-    anchor_options.strides.push_back(32);
-    anchor_options.strides.push_back(32);
-    anchor_options.strides.push_back(32);
-    anchor_options.aspect_ratios.push_back(1.0);
-    anchor_options.reduce_boxes_in_lowest_layer = false;
-    anchor_options.interpolated_scale_aspect_ratio = 1.0;
-    anchor_options.fixed_anchor_size = true;
-
-    GenerateAnchors (&s_anchors, anchor_options);
+    sess->palm_cands.resize (sess->anchors->num);
+    sess->palm_boxes.resize (sess->anchors->num);
+    if (nms_init (&sess->nms, sess->anchors->num) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
 
 #if 0
-    for (int i = 0; i < (int)s_anchors.size(); i ++)
+    for (int i = 0; i < sess->anchors->num; i ++)
     {
         fprintf (stderr, "[%4d](%f, %f, %f, %f)\n", i,
-            s_anchors[i].x_center, s_anchors[i].y_center, s_anchors[i].w, s_anchors[i].h);
+            sess->anchors->cx[i], sess->anchors->cy[i], sess->anchors->w[i], sess->anchors->h[i]);
     }
 #endif
 
@@ -215,11 +102,12 @@ generate_ssd_anchors ()
 /* -------------------------------------------------- *
  *  Create TFLite Interpreter
  * -------------------------------------------------- */
-int
-init_tflite_hand_landmark(int use_quantized_tflite)
+handpose_session_t *
+handpose_session_create (int use_quantized_tflite, int num_threads)
 {
     const char *palm_model;
     const char *hand_model;
+    tflite_createopt_t opt = {0};
 
     if (use_quantized_tflite)
     {
@@ -232,58 +120,97 @@ init_tflite_hand_landmark(int use_quantized_tflite)
         hand_model = HAND_LANDMARK_MODEL_PATH;
     }
 
+    opt.num_threads = num_threads;
+
+    handpose_session_t *sess = new handpose_session_t ();
+
     /* Palm Detection */
-    s_palm_interpreter.resolver.AddCustom("Convolution2DTransposeBias",
+    sess->palm.interpreter.resolver.AddCustom("Convolution2DTransposeBias",
             mediapipe::tflite_operations::RegisterConvolution2DTransposeBias());
 
-    tflite_create_interpreter_from_file (&s_palm_interpreter, palm_model);
-    tflite_get_tensor_by_name (&s_palm_interpreter, 0, "input",           &s_palm_tensor_input);
-    tflite_get_tensor_by_name (&s_palm_interpreter, 1, "classificators",  &s_palm_tensor_scores);
-    tflite_get_tensor_by_name (&s_palm_interpreter, 1, "regressors",      &s_palm_tensor_points);
+    if (tflite_session_create (&sess->palm, palm_model,
+                               s_palm_tensor_descs, PALM_TENSOR_NUM, &opt) < 0)
+        goto err;
 
     /* Hand Landmark */
-    tflite_create_interpreter_from_file (&s_hand_interpreter, hand_model);
-    tflite_get_tensor_by_name (&s_hand_interpreter, 0, "input_1",         &s_hand_tensor_input);
-    tflite_get_tensor_by_name (&s_hand_interpreter, 1, "ld_21_3d",        &s_hand_tensor_landmark);
-    tflite_get_tensor_by_name (&s_hand_interpreter, 1, "output_handflag", &s_hand_tensor_handflag);
+    if (tflite_session_create (&sess->hand, hand_model,
+                               s_hand_tensor_descs, HAND_TENSOR_NUM, &opt) < 0)
+        goto err;
 
-    generate_ssd_anchors ();
+    if (generate_ssd_anchors (sess) < 0)
+        goto err;
 
-    return 0;
+    return sess;
+
+err:
+    fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+    handpose_session_destroy (sess);
+    return NULL;
+}
+
+void
+handpose_session_destroy (handpose_session_t *sess)
+{
+    if (sess == NULL)
+        return;
+
+    tflite_session_destroy (&sess->hand);
+    tflite_session_destroy (&sess->palm);
+    nms_destroy (&sess->nms);
+    delete sess;
 }
 
 void *
-get_palm_detection_input_buf (int *w, int *h)
+handpose_get_palm_detection_input_buf (handpose_session_t *sess, int *w, int *h)
 {
-    *w = s_palm_tensor_input.dims[2];
-    *h = s_palm_tensor_input.dims[1];
-    return s_palm_tensor_input.ptr;
+    tflite_tensor_t *input = &sess->palm.tensors[PALM_INPUT];
+
+    *w = input->dims[2];
+    *h = input->dims[1];
+    return input->ptr;
 }
 
 void *
-get_hand_landmark_input_buf (int *w, int *h)
+handpose_get_hand_landmark_input_buf (handpose_session_t *sess, int *w, int *h)
 {
-    *w = s_hand_tensor_input.dims[2];
-    *h = s_hand_tensor_input.dims[1];
-    return s_hand_tensor_input.ptr;
+    return handpose_get_hand_landmark_batch_input_buf (sess, 1, w, h);
+}
+
+/*
+ *  input buffer for (num) hands: [num][h][w][3].
+ *  the model is resized only when (num) changes from the previous call.
+ *  returns NULL if the batch can't be resized (e.g. GPU delegate).
+ */
+void *
+handpose_get_hand_landmark_batch_input_buf (handpose_session_t *sess, int num, int *w, int *h)
+{
+    tflite_tensor_t *input = &sess->hand.tensors[HAND_INPUT];
+
+    if (tflite_session_set_batch (&sess->hand, num) < 0)
+        return NULL;
+
+    *w = input->dims[2];
+    *h = input->dims[1];
+    return input->ptr;
 }
 
 
 /* -------------------------------------------------- *
  *  Decode palm detection result
  * -------------------------------------------------- */static int
-decode_keypoints (std::list<palm_t> &palm_list, float score_thresh)
+decode_keypoints (handpose_session_t *sess, float score_thresh)
 {
-    palm_t palm_item;
-    float *scores_ptr = (float *)s_palm_tensor_scores.ptr;
-    float *points_ptr = (float *)s_palm_tensor_points.ptr;
-    int img_w = s_palm_tensor_input.dims[2];
-    int img_h = s_palm_tensor_input.dims[1];
-
-    int i = 0;
-    for (auto itr = s_anchors.begin(); itr != s_anchors.end(); i ++, itr ++)
+    int num_dets = 0;
+    float *scores_ptr = (float *)sess->palm.tensors[PALM_SCORES].ptr;
+    float *points_ptr = (float *)sess->palm.tensors[PALM_POINTS].ptr;
+    int img_w = sess->palm.tensors[PALM_INPUT].dims[2];
+    int img_h = sess->palm.tensors[PALM_INPUT].dims[1];
+
+    const float *anchor_cx = sess->anchors->cx;
+    const float *anchor_cy = sess->anchors->cy;
+
+    for (int i = 0; i < sess->anchors->num; i ++)
     {
-        Anchor anchor = *itr;
         float score0 = scores_ptr[i];
         float score = 1.0f / (1.0f + exp(-score0));
 
@@ -297,8 +224,8 @@ decode_keypoints (std::list<palm_t> &palm_list, float score_thresh)
             float w  = p[2];
             float h  = p[3];
 
-            float cx = sx + anchor.x_center * img_w;
-            float cy = sy + anchor.y_center * img_h;
+            float cx = sx + anchor_cx[i] * img_w;
+            float cy = sy + anchor_cy[i] * img_h;
 
             cx /= (float)img_w;
             cy /= (float)img_h;
@@ -311,112 +238,73 @@ decode_keypoints (std::list<palm_t> &palm_list, float score_thresh)
             btmright.x = cx + w * 0.5f;
             btmright.y = cy + h * 0.5f;
 
-            palm_item.score         = score;
-            palm_item.rect.topleft  = topleft;
-            palm_item.rect.btmright = btmright;
+            palm_t *palm_item = &sess->palm_cands[num_dets];
+            palm_item->score         = score;
+            palm_item->rect.topleft  = topleft;
+            palm_item->rect.btmright = btmright;
 
             /* landmark positions (7 keys) */
             for (int j = 0; j < 7; j ++)
             {
                 float lx = p[4 + (2 * j) + 0];
                 float ly = p[4 + (2 * j) + 1];
-                lx += anchor.x_center * img_w;
-                ly += anchor.y_center * img_h;
+                lx += anchor_cx[i] * img_w;
+                ly += anchor_cy[i] * img_h;
                 lx /= (float)img_w;
                 ly /= (float)img_h;
 
-                palm_item.keys[j].x = lx;
-                palm_item.keys[j].y = ly;
+                palm_item->keys[j].x = lx;
+                palm_item->keys[j].y = ly;
             }
 
-            palm_list.push_back (palm_item);
+            nms_box_t *box = &sess->palm_boxes[num_dets];
+            box->x0    = topleft.x;
+            box->y0    = topleft.y;
+            box->x1    = btmright.x;
+            box->y1    = btmright.y;
+            box->score = score;
+
+            num_dets ++;
         }
     }
-    return 0;
+    return num_dets;
 }
 
 
 
 /* -------------------------------------------------- *
- *  Apply NonMaxSuppression:
+ *  Apply Weighted NonMaxSuppression:
+ *      mediapipe/modules/palm_detection/palm_detection_cpu.pbtxt
+ *        (algorithm: WEIGHTED)
+ *
+ *  the overlapping candidates are blended into one palm, keypoints
+ *  included. the results are written to palms[].
  * -------------------------------------------------- */
-static float
-calc_intersection_over_union (rect_t &rect0, rect_t &rect1)
-{
-    float sx0 = rect0.topleft.x;
-    float sy0 = rect0.topleft.y;
-    float ex0 = rect0.btmright.x;
-    float ey0 = rect0.btmright.y;
-    float sx1 = rect1.topleft.x;
-    float sy1 = rect1.topleft.y;
-    float ex1 = rect1.btmright.x;
-    float ey1 = rect1.btmright.y;
-    
-    float xmin0 = std::min (sx0, ex0);
-    float ymin0 = std::min (sy0, ey0);
-    float xmax0 = std::max (sx0, ex0);
-    float ymax0 = std::max (sy0, ey0);
-    float xmin1 = std::min (sx1, ex1);
-    float ymin1 = std::min (sy1, ey1);
-    float xmax1 = std::max (sx1, ex1);
-    float ymax1 = std::max (sy1, ey1);
-    
-    float area0 = (ymax0 - ymin0) * (xmax0 - xmin0);
-    float area1 = (ymax1 - ymin1) * (xmax1 - xmin1);
-    if (area0 <= 0 || area1 <= 0)
-        return 0.0f;
-
-    float intersect_xmin = std::max (xmin0, xmin1);
-    float intersect_ymin = std::max (ymin0, ymin1);
-    float intersect_xmax = std::min (xmax0, xmax1);
-    float intersect_ymax = std::min (ymax0, ymax1);
-
-    float intersect_area = std::max (intersect_ymax - intersect_ymin, 0.0f) *
-                           std::max (intersect_xmax - intersect_xmin, 0.0f);
-    
-    return intersect_area / (area0 + area1 - intersect_area);
-}
-
-static bool
-compare (palm_t &v1, palm_t &v2)
-{
-    if (v1.score > v2.score)
-        return true;
-    else
-        return false;
-}
-
 static int
-non_max_suppression (std::list<palm_t> &face_list, std::list<palm_t> &face_sel_list, float iou_thresh)
+non_max_suppression (handpose_session_t *sess, int num_dets, palm_t *palms, float iou_thresh)
 {
-    face_list.sort (compare);
-
-    for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
-    {
-        palm_t face_candidate = *itr;
-
-        int ignore_candidate = false;
-        for (auto itr_sel = face_sel_list.rbegin(); itr_sel != face_sel_list.rend(); itr_sel ++)
-        {
-            palm_t face_sel = *itr_sel;
+    nms_box_t out_boxes[MAX_PALM_NUM];
+    fvec2     out_keys[MAX_PALM_NUM][7];
 
-            float iou = calc_intersection_over_union (face_candidate.rect, face_sel.rect);
-            if (iou >= iou_thresh)
-            {
-                ignore_candidate = true;
-                break;
-            }
-        }
+    int num_out = nms_weighted (&sess->nms, sess->palm_boxes.data(), num_dets, iou_thresh,
+                                MAX_PALM_NUM, out_boxes,
+                                &sess->palm_cands[0].keys[0].x, 7 * 2,
+                                sizeof (palm_t), &out_keys[0][0].x);
 
-        if (!ignore_candidate)
-        {
-            face_sel_list.push_back(face_candidate);
-            if (face_sel_list.size() >= MAX_PALM_NUM)
-                break;
-        }
+    for (int i = 0; i < num_out; i ++)
+    {
+        palm_t *palm = &palms[i];
+
+        palm->score           = out_boxes[i].score;
+        palm->rect.topleft.x  = out_boxes[i].x0;
+        palm->rect.topleft.y  = out_boxes[i].y0;
+        palm->rect.btmright.x = out_boxes[i].x1;
+        palm->rect.btmright.y = out_boxes[i].y1;
+        for (int j = 0; j < 7; j ++)
+            palm->keys[j] = out_keys[i][j];
     }
 
-    return 0;
+    return num_out;
 }
 
 
@@ -508,23 +396,16 @@ compute_hand_rect (palm_t &palm)
 }
 
 static void
-pack_palm_result (palm_detection_result_t *palm_result, std::list<palm_t> &palm_list)
+pack_palm_result (palm_detection_result_t *palm_result, int num_palms)
 {
-    int num_palms = 0;
-    for (auto itr = palm_list.begin(); itr != palm_list.end(); itr ++)
+    for (int i = 0; i < num_palms; i ++)
     {
-        palm_t palm = *itr;
-        
-        compute_rotation (palm);
-        compute_hand_rect (palm);
+        palm_t *palm = &palm_result->palms[i];
 
-        memcpy (&palm_result->palms[num_palms], &palm, sizeof (palm));
-        num_palms ++;
-        palm_result->num = num_palms;
-
-        if (num_palms >= MAX_PALM_NUM)
-            break;
+        compute_rotation (*palm);
+        compute_hand_rect (*palm);
     }
+    palm_result->num = num_palms;
 }
 
 
@@ -533,28 +414,29 @@ pack_palm_result (palm_detection_result_t *palm_result, std::list<palm_t> &palm_
  * Invoke TensorFlow Lite (Palm detection)
  * -------------------------------------------------- */
 static int
-detect_palm (palm_detection_result_t *palm_result)
+detect_palm (handpose_session_t *sess, palm_detection_result_t *palm_result)
 {
-    if (s_palm_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_session_invoke (&sess->palm) < 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
     }
 
     float score_thresh = 0.7f;
-    std::list<palm_t> palm_list;
+    int   num_palms;
 
-    decode_keypoints (palm_list, score_thresh);
+    int num_dets = decode_keypoints (sess, score_thresh);
 
 #if 1 /* USE NMS */
-    float iou_thresh = 0.03f;
-    std::list<palm_t> palm_nms_list;
+    float iou_thresh = 0.3f;
 
-    non_max_suppression (palm_list, palm_nms_list, iou_thresh);
-    pack_palm_result (palm_result, palm_nms_list);
+    num_palms = non_max_suppression (sess, num_dets, palm_result->palms, iou_thresh);
 #else
-    pack_palm_result (palm_result, palm_list);
+    num_palms = std::min (num_dets, MAX_PALM_NUM);
+    for (int i = 0; i < num_palms; i ++)
+        memcpy (&palm_result->palms[i], &sess->palm_cands[i], sizeof (palm_t));
 #endif
+    pack_palm_result (palm_result, num_palms);
 
     return 0;
 }
@@ -579,11 +461,11 @@ detect_palm_stub (palm_detection_result_t *palm_result)
 }
 
 int
-invoke_palm_detection (palm_detection_result_t *palm_result, int flag)
+handpose_invoke_palm_detection (handpose_session_t *sess, palm_detection_result_t *palm_result, int flag)
 {
     if (flag == 0)
     {
-        return detect_palm (palm_result);
+        return detect_palm (sess, palm_result);
     }
     else
     {
@@ -596,19 +478,16 @@ invoke_palm_detection (palm_detection_result_t *palm_result, int flag)
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite (Hand landmark)
  * -------------------------------------------------- */
-int
-invoke_hand_landmark (hand_landmark_result_t *hand_result)
+static void
+decode_landmark (handpose_session_t *sess, int batch_idx, hand_landmark_result_t *hand_result)
 {
-    if (s_hand_interpreter.interpreter->Invoke() != kTfLiteOk)
-    {
-        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-        return -1;
-    }
+    float *handflag_ptr = (float *)sess->hand.tensors[HAND_HANDFLAG].ptr;
+    float *landmark_ptr = (float *)sess->hand.tensors[HAND_LANDMARK].ptr;
+    int img_w = sess->hand.tensors[HAND_INPUT].dims[2];
+    int img_h = sess->hand.tensors[HAND_INPUT].dims[1];
 
-    float *handflag_ptr = (float *)s_hand_tensor_handflag.ptr;
-    float *landmark_ptr = (float *)s_hand_tensor_landmark.ptr;
-    int img_w = s_hand_tensor_input.dims[2];
-    int img_h = s_hand_tensor_input.dims[1];
+    handflag_ptr += batch_idx;
+    landmark_ptr += batch_idx * HAND_JOINT_NUM * 3;
     
     hand_result->score = *handflag_ptr;
     //fprintf (stderr, "handflag = %f\n", *handflag_ptr);
@@ -621,7 +500,158 @@ invoke_hand_landmark (hand_landmark_result_t *hand_result)
         //fprintf (stderr, "[%2d] (%8.1f, %8.1f, %8.1f)\n", i, 
         //    landmark_ptr[3 * i + 0], landmark_ptr[3 * i + 1], landmark_ptr[3 * i + 2]);
     }
+}
+
+int
+handpose_invoke_hand_landmark (handpose_session_t *sess, hand_landmark_result_t *hand_result)
+{
+    return handpose_invoke_hand_landmark_batch (sess, hand_result, 1);
+}
+
+/* (num) must be the same as the handpose_get_hand_landmark_batch_input_buf() call. */
+int
+handpose_invoke_hand_landmark_batch (handpose_session_t *sess, hand_landmark_result_t *hand_result, int num)
+{
+    if (num != sess->hand.batch)
+    {
+        fprintf (stderr, "ERR: %s(%d): batch size mismatch (%d, %d)\n", __FILE__, __LINE__,
+                 num, sess->hand.batch);
+        return -1;
+    }
+
+    if (tflite_session_invoke (&sess->hand) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (int i = 0; i < num; i ++)
+        decode_landmark (sess, i, &hand_result[i]);
+
+    return 0;
+}
+
+
+/* -------------------------------------------------- *
+ *  ROI tracking (hand rect of the next frame from the landmarks)
+ * -------------------------------------------------- */
+/* wrist, and the two lower joints of each finger. (fingertips swing too much) */
+static const int s_hand_roi_subset[] = {0, 1, 2, 3, 5, 6, 9, 10, 13, 14, 17, 18};
+
+static const roi_param_t s_hand_roi_param = {
+    s_hand_roi_subset, sizeof (s_hand_roi_subset) / sizeof (int),
+    0, 9,                   /* wrist --> MCP of middle finger */
+    M_PI * 0.5f,            /* ... points upward              */
+    0.0f, -0.1f,            /* shift                          */
+    2.0f, 2.0f,             /* scale                          */
+    1,
+};
+
+/* landmarks which stand for the keypoints of the palm detector */
+static const int s_palm_key_landmark[7] = {0, 5, 9, 13, 17, 1, 2};
+
+/*
+ *  make the palm of the next frame from the landmarks of (palm).
+ *  returns the hand presence in [0, 1].
+ */
+float
+handpose_landmark_to_palm (const palm_t *palm, const hand_landmark_result_t *hand_result,
+                           palm_t *next_palm, roi_t *next_roi)
+{
+    roi_t cur;
+
+    cur.cx       = palm->hand_cx;
+    cur.cy       = palm->hand_cy;
+    cur.w        = palm->hand_w;
+    cur.h        = palm->hand_h;
+    cur.rotation = palm->rotation;
+
+    roi_from_landmarks (next_roi, &cur, &hand_result->joint[0].x, HAND_JOINT_NUM, 3, &s_hand_roi_param);
+
+    memset (next_palm, 0, sizeof (*next_palm));
+    next_palm->score           = hand_result->score;
+    next_palm->rect.topleft.x  = next_palm->rect.topleft.y  =  FLT_MAX;
+    next_palm->rect.btmright.x = next_palm->rect.btmright.y = -FLT_MAX;
+    for (int i = 0; i < HAND_JOINT_NUM; i ++)
+    {
+        float x, y;
+        roi_project_point (&cur, hand_result->joint[i].x, hand_result->joint[i].y, &x, &y);
+
+        next_palm->rect.topleft.x  = std::min (next_palm->rect.topleft.x,  x);
+        next_palm->rect.topleft.y  = std::min (next_palm->rect.topleft.y,  y);
+        next_palm->rect.btmright.x = std::max (next_palm->rect.btmright.x, x);
+        next_palm->rect.btmright.y = std::max (next_palm->rect.btmright.y, y);
+    }
+
+    for (int i = 0; i < 7; i ++)
+    {
+        const fvec3 *key = &hand_result->joint[s_palm_key_landmark[i]];
+        roi_project_point (&cur, key->x, key->y, &next_palm->keys[i].x, &next_palm->keys[i].y);
+    }
+
+    float quad[4][2];
+    roi_get_quad (next_roi, quad);
+
+    next_palm->rotation = next_roi->rotation;
+    next_palm->hand_cx  = next_roi->cx;
+    next_palm->hand_cy  = next_roi->cy;
+    next_palm->hand_w   = next_roi->w;
+    next_palm->hand_h   = next_roi->h;
+    for (int i = 0; i < 4; i ++)
+    {
+        next_palm->hand_pos[i].x = quad[i][0];
+        next_palm->hand_pos[i].y = quad[i][1];
+    }
+
+    return hand_result->score;
+}
+
+
+/* -------------------------------------------------- *
+ *  Single instance APIs (default session)
+ * -------------------------------------------------- */
+int
+init_tflite_hand_landmark (int use_quantized_tflite)
+{
+    s_session = handpose_session_create (use_quantized_tflite, 0);
+    if (s_session == NULL)
+        return -1;
 
     return 0;
 }
 
+void *
+get_palm_detection_input_buf (int *w, int *h)
+{
+    return handpose_get_palm_detection_input_buf (s_session, w, h);
+}
+
+int
+invoke_palm_detection (palm_detection_result_t *palm_result, int flag)
+{
+    return handpose_invoke_palm_detection (s_session, palm_result, flag);
+}
+
+void *
+get_hand_landmark_input_buf (int *w, int *h)
+{
+    return handpose_get_hand_landmark_input_buf (s_session, w, h);
+}
+
+int
+invoke_hand_landmark (hand_landmark_result_t *hand_result)
+{
+    return handpose_invoke_hand_landmark (s_session, hand_result);
+}
+
+void *
+get_hand_landmark_batch_input_buf (int num, int *w, int *h)
+{
+    return handpose_get_hand_landmark_batch_input_buf (s_session, num, w, h);
+}
+
+int
+invoke_hand_landmark_batch (hand_landmark_result_t *hand_result, int num)
+{
+    return handpose_invoke_hand_landmark_batch (s_session, hand_result, num);
+}
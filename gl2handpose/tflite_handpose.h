@@ -5,6 +5,8 @@
 #ifndef TFLITE_HAND_LANDMARK_H_
 #define TFLITE_HAND_LANDMARK_H_
 
+#include "util_roi_track.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -62,6 +64,31 @@ typedef struct _pose3d_config_t
     float iou_thresh;
 } pose3d_config_t;
 
+/*
+ *  each session owns its interpreters, tensors and post-process buffers,
+ *  so that multiple sessions can run in parallel (e.g. one per camera).
+ *  num_threads: TFLite threads per interpreter (0: number of CPUs)
+ */
+typedef struct _handpose_session_t handpose_session_t;
+
+handpose_session_t *handpose_session_create  (int use_quantized_tflite, int num_threads);
+void                handpose_session_destroy (handpose_session_t *sess);
+
+void *handpose_get_palm_detection_input_buf (handpose_session_t *sess, int *w, int *h);
+int   handpose_invoke_palm_detection        (handpose_session_t *sess, palm_detection_result_t *palm_result, int flag);
+void *handpose_get_hand_landmark_input_buf  (handpose_session_t *sess, int *w, int *h);
+int   handpose_invoke_hand_landmark         (handpose_session_t *sess, hand_landmark_result_t *hand_landmark_result);
+
+/* batched landmark: (num) hands in one Invoke(). the input is [num][h][w][3]. */
+void *handpose_get_hand_landmark_batch_input_buf (handpose_session_t *sess, int num, int *w, int *h);
+int   handpose_invoke_hand_landmark_batch        (handpose_session_t *sess, hand_landmark_result_t *hand_landmark_result, int num);
+
+/* ROI tracking: the palm of the next frame from the landmarks. returns the hand presence [0, 1]. */
+float handpose_landmark_to_palm (const palm_t *palm, const hand_landmark_result_t *hand_landmark_result,
+                                 palm_t *next_palm, roi_t *next_roi);
+
+
+/* single instance APIs. they work on the session created by init_tflite_hand_landmark(). */
 int   init_tflite_hand_landmark (int use_quantized_tflite);
 
 void  *get_palm_detection_input_buf (int *w, int *h);
@@ -70,6 +97,9 @@ int   invoke_palm_detection (palm_detection_result_t *palm_result, int flag);
 void  *get_hand_landmark_input_buf (int *w, int *h);
 int   invoke_hand_landmark (hand_landmark_result_t *hand_landmark_result);
 
+void  *get_hand_landmark_batch_input_buf (int num, int *w, int *h);
+int   invoke_hand_landmark_batch (hand_landmark_result_t *hand_landmark_result, int num);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,30 +14,41 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
+#include "util_warp.h"
 #include "util_matrix.h"
+#include "util_taskgraph.h"
 #include "tflite_facemesh.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
 #define UNUSED(x) (void)(x)
 
+/* RGBA pixels of the input image file (for the CPU crop) */
+static void *s_still_img;
+static int  s_still_w, s_still_h;
+
 
 
 
 
 /* resize image to DNN network input size and convert to fp32. */
 void
-feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
+feed_face_detect_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+    if (cpusrc)
+    {
+        preproc_norm_t norm;
+        preproc_norm_set (&norm, 128.0f, 128.0f);
+        warp_resize_to_fp32 (cpusrc, buf_fp32, w, h, &norm, 0);
+        return;
+    }
 
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -47,35 +58,40 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
 
+/* crop, rotate, resize and normalize in one pass on CPU. */
+static void
+crop_face_landmark_image (warp_src_t *cpusrc, face_t *face, float *buf_fp32, int w, int h)
+{
+    float quad[4][2];
+
+    for (int i = 0; i < 4; i ++)
+    {
+        quad[i][0] = face->face_pos[i].x;
+        quad[i][1] = face->face_pos[i].y;
+    }
+    warp_quad_to_fp32 (cpusrc, quad, buf_fp32, w, h, &preproc_norm_unit, 0);
+}
+
 void
-feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
+feed_face_landmark_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                         face_detect_result_t *detection, unsigned int face_id)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_facemesh_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
+    if (cpusrc && detection->num > face_id)
+    {
+        crop_face_landmark_image (cpusrc, &detection->faces[face_id], buf_fp32, w, h);
+        return;
+    }
 
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -107,57 +123,28 @@ feed_face_landmark_image(texture_2d_t *srctex, int win_w, int win_h, face_detect
     /* convert UI8 [0, 255] ==> FP32 [0, 1] */
     float mean = 0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
 
 
-void
-feed_iris_landmark_image(texture_2d_t *srctex, int win_w, int win_h, 
-                         face_t *face, face_landmark_result_t *facemesh, int eye_id)
+/* the eye region in the image coordinates.
+ *    0--------1
+ *    |        |
+ *    |        |
+ *    3--------2
+ */
+static void
+get_eye_quad (face_t *face, face_landmark_result_t *facemesh, int eye_id, float quad[4][2])
 {
-    int x, y, w, h;
-    float *buf_fp32 = (float *)get_irismesh_landmark_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
-
-    float texcoord[8];
-
     float scale_x = face->face_w;
     float scale_y = face->face_h;
     float pivot_x = face->face_cx;
     float pivot_y = face->face_cy;
     float rotation= face->rotation;
-    
-    float x0 = facemesh->eye_pos[eye_id][0].x;
-    float y0 = facemesh->eye_pos[eye_id][0].y;
-    float x1 = facemesh->eye_pos[eye_id][1].x; //    0--------1
-    float y1 = facemesh->eye_pos[eye_id][1].y; //    |        |
-    float x2 = facemesh->eye_pos[eye_id][2].x; //    |        |
-    float y2 = facemesh->eye_pos[eye_id][2].y; //    3--------2
-    float x3 = facemesh->eye_pos[eye_id][3].x;
-    float y3 = facemesh->eye_pos[eye_id][3].y;
 
     float mat[16];
-    float vec[4][2] = {{x0, y0}, {x1, y1}, {x2, y2}, {x3, y3}};
     matrix_identity (mat);
     
     matrix_translate (mat, pivot_x, pivot_y, 0);
@@ -165,15 +152,53 @@ feed_iris_landmark_image(texture_2d_t *srctex, int win_w, int win_h,
     matrix_scale (mat, scale_x, scale_y, 1.0f);
     matrix_translate (mat, -0.5f, -0.5f, 0);
 
-    matrix_multvec2 (mat, vec[0], vec[0]);
-    matrix_multvec2 (mat, vec[1], vec[1]);
-    matrix_multvec2 (mat, vec[2], vec[2]);
-    matrix_multvec2 (mat, vec[3], vec[3]);
+    for (int i = 0; i < 4; i ++)
+    {
+        float vec[2] = {facemesh->eye_pos[eye_id][i].x, facemesh->eye_pos[eye_id][i].y};
+        matrix_multvec2 (mat, vec, quad[i]);
+    }
+}
 
-    x0 = vec[0][0];  y0 = vec[0][1];
-    x1 = vec[1][0];  y1 = vec[1][1];
-    x2 = vec[2][0];  y2 = vec[2][1];
-    x3 = vec[3][0];  y3 = vec[3][1];
+/* need to horizontal flip for right eye */
+static void
+crop_iris_landmark_image (warp_src_t *cpusrc, face_t *face, face_landmark_result_t *facemesh, int eye_id,
+                          float *buf_fp32, int w, int h)
+{
+    float q[4][2];
+
+    get_eye_quad (face, facemesh, eye_id, q);
+
+    float quad[2][4][2] = {{{q[0][0], q[0][1]}, {q[1][0], q[1][1]}, {q[2][0], q[2][1]}, {q[3][0], q[3][1]}},
+                           {{q[1][0], q[1][1]}, {q[0][0], q[0][1]}, {q[3][0], q[3][1]}, {q[2][0], q[2][1]}}};
+
+    warp_quad_to_fp32 (cpusrc, quad[eye_id], buf_fp32, w, h, &preproc_norm_unit, 0);
+}
+
+void
+feed_iris_landmark_image(texture_2d_t *srctex, warp_src_t *cpusrc, int win_w, int win_h,
+                         face_t *face, face_landmark_result_t *facemesh, int eye_id)
+{
+    int w, h;
+    float *buf_fp32 = (float *)get_irismesh_landmark_input_buf (&w, &h);
+
+    if (cpusrc)
+    {
+        crop_iris_landmark_image (cpusrc, face, facemesh, eye_id, buf_fp32, w, h);
+        return;
+    }
+
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
+
+    float texcoord[8];
+    float q[4][2];
+
+    get_eye_quad (face, facemesh, eye_id, q);
+
+    float x0 = q[0][0];  float y0 = q[0][1];
+    float x1 = q[1][0];  float y1 = q[1][1];
+    float x2 = q[2][0];  float y2 = q[2][1];
+    float x3 = q[3][0];  float y3 = q[3][1];
 
     /* Upside down */
     if (eye_id == 0)
@@ -199,21 +224,42 @@ feed_iris_landmark_image(texture_2d_t *srctex, int win_w, int win_h,
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
+
+    return;
+}
+
+
+/* the current input frame on CPU. returns NULL if it is not available yet. */
+static warp_src_t *
+get_cpu_frame (warp_src_t *src, int enable_camera, int enable_video)
+{
+    void     *buf = s_still_img;
+    int      w    = s_still_w;
+    int      h    = s_still_h;
+    uint32_t fmt  = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+    if (enable_video)
     {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
+        get_video_buffer (&buf);
+        get_video_dimension (&w, &h);
+        get_video_pixformat (&fmt);
     }
+#endif
+#if defined (USE_INPUT_CAMERA_CAPTURE)
+    if (enable_camera)
+    {
+        get_capture_buffer (&buf);
+        get_capture_dimension (&w, &h);
+        get_capture_pixformat (&fmt);
+    }
+#endif
 
-    return;
+    if (warp_src_set (src, buf, w, h, 0, fmt) < 0)
+        return NULL;
+
+    return src;
 }
 
 
@@ -361,6 +407,8 @@ render_iris_landmark (int ofstx, int ofsty, int texw, int texh, irismesh_result_
     fvec3 *iris = irismesh->iris_landmark;
     float mat[16];
 
+    begin_2d_batch ();
+
     matrix_identity (mat);
 
     for (int i = 0; i < 71; i ++)
@@ -395,6 +443,8 @@ render_iris_landmark (int ofstx, int ofsty, int texw, int texh, irismesh_result_
         float len = sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
         draw_2d_circle (x0, y0, len, col_green, 4);
     }
+
+    end_2d_batch ();
 }
 
 static void
@@ -403,6 +453,8 @@ render_iris_landmark_on_face (int ofstx, int ofsty, int texw, int texh,
 {
     float col_green[] = {0.0f, 1.0f, 0.0f, 1.0f};
 
+    begin_2d_batch ();
+
     for (int eye_id = 0; eye_id < 2; eye_id ++)
     {
         fvec3 *iris = irismesh[eye_id].iris_landmark;
@@ -469,6 +521,8 @@ render_iris_landmark_on_face (int ofstx, int ofsty, int texw, int texh,
             draw_2d_line (x3, y3, x0, y0, col_red, 1.0f);
         }
     }
+
+    end_2d_batch ();
 }
 
 static void
@@ -492,6 +546,8 @@ render_iris_landmark_on_main (int ofstx, int ofsty, int texw, int texh,
 {
     float col_green[] = {0.0f, 1.0f, 0.0f, 1.0f};
 
+    begin_2d_batch ();
+
     float mat_face[16];
     {
         float scale_x = face->face_w;
@@ -588,6 +644,8 @@ render_iris_landmark_on_main (int ofstx, int ofsty, int texw, int texh,
             draw_2d_circle (x0, y0, len, col_green, 4);
         }
     }
+
+    end_2d_batch ();
 }
 
 static void
@@ -609,6 +667,168 @@ flip_horizontal_iris_landmark (irismesh_result_t *irismesh)
 }
 
 
+/* -------------------------------------------------- *
+ *  landmark cascade on the CPU frame
+ *
+ *  the facemesh of each face, and the iris of each eye after it,
+ *  run in parallel on the task graph. each node borrows a session
+ *  of its model from the pool.
+ * -------------------------------------------------- */
+#define CASCADE_MAX_WORKERS     4
+
+typedef struct _cascade_t
+{
+    taskpool_t      pool;
+    taskgraph_t     graph;
+    instpool_t      mesh_sessions;
+    instpool_t      iris_sessions;
+} cascade_t;
+
+typedef struct _landmark_task_t
+{
+    cascade_t               *cascade;
+    warp_src_t              *cpusrc;
+    face_t                  *face;
+    face_landmark_result_t  *facemesh;
+    irismesh_result_t       *irismesh;
+    int                     eye_id;
+    double                  invoke_ms;
+} landmark_task_t;
+
+static void
+destroy_cascade (cascade_t *cascade)
+{
+    for (int i = 0; i < cascade->mesh_sessions.num_items; i ++)
+        mesh_session_destroy ((mesh_session_t *)cascade->mesh_sessions.items[i]);
+
+    for (int i = 0; i < cascade->iris_sessions.num_items; i ++)
+        iris_session_destroy ((iris_session_t *)cascade->iris_sessions.items[i]);
+
+    instpool_destroy  (&cascade->mesh_sessions);
+    instpool_destroy  (&cascade->iris_sessions);
+    taskgraph_destroy (&cascade->graph);
+    taskpool_destroy  (&cascade->pool);
+}
+
+static int
+init_cascade (cascade_t *cascade, int use_quantized_tflite)
+{
+    int num_workers = (int)sysconf (_SC_NPROCESSORS_ONLN);
+
+    if (num_workers > CASCADE_MAX_WORKERS)
+        num_workers = CASCADE_MAX_WORKERS;
+
+    if (taskpool_init (&cascade->pool, num_workers) < 0)
+        return -1;
+
+    taskgraph_init (&cascade->graph, &cascade->pool);
+    instpool_init (&cascade->mesh_sessions);
+    instpool_init (&cascade->iris_sessions);
+
+    /* share the CPUs among the workers, not (workers x CPUs) TFLite threads. */
+    int num_threads = taskpool_get_cpus_per_worker (&cascade->pool);
+
+    for (int i = 0; i < cascade->pool.num_workers; i ++)
+    {
+        mesh_session_t *mesh = mesh_session_create (use_quantized_tflite, num_threads);
+        iris_session_t *iris = iris_session_create (num_threads);
+        if (mesh == NULL || iris == NULL)
+        {
+            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+            mesh_session_destroy (mesh);
+            iris_session_destroy (iris);
+            destroy_cascade (cascade);
+            return -1;
+        }
+        instpool_add (&cascade->mesh_sessions, mesh);
+        instpool_add (&cascade->iris_sessions, iris);
+    }
+
+    return 0;
+}
+
+static void
+run_facemesh_task (void *arg)
+{
+    landmark_task_t *task = (landmark_task_t *)arg;
+    mesh_session_t  *sess = (mesh_session_t *)instpool_acquire (&task->cascade->mesh_sessions);
+    int w, h;
+
+    float *buf_fp32 = (float *)mesh_session_get_input_buf (sess, &w, &h);
+    crop_face_landmark_image (task->cpusrc, task->face, buf_fp32, w, h);
+
+    double ttime0 = pmeter_get_time_ms ();
+    mesh_session_invoke (sess, task->facemesh);
+    task->invoke_ms = pmeter_get_time_ms () - ttime0;
+
+    instpool_release (&task->cascade->mesh_sessions, sess);
+}
+
+static void
+run_iris_task (void *arg)
+{
+    landmark_task_t *task = (landmark_task_t *)arg;
+    iris_session_t  *sess = (iris_session_t *)instpool_acquire (&task->cascade->iris_sessions);
+    int w, h;
+
+    float *buf_fp32 = (float *)iris_session_get_input_buf (sess, &w, &h);
+    crop_iris_landmark_image (task->cpusrc, task->face, task->facemesh, task->eye_id, buf_fp32, w, h);
+
+    double ttime0 = pmeter_get_time_ms ();
+    iris_session_invoke (sess, task->irismesh);
+    task->invoke_ms = pmeter_get_time_ms () - ttime0;
+
+    /* need to horizontal flip for right eye */
+    if (task->eye_id == 1)
+        flip_horizontal_iris_landmark (task->irismesh);
+
+    instpool_release (&task->cascade->iris_sessions, sess);
+}
+
+/* returns the sum of the Invoke() time of each model. */
+static void
+invoke_cascade (cascade_t *cascade, warp_src_t *cpusrc, face_detect_result_t *detection,
+                face_landmark_result_t *facemesh, irismesh_result_t (*irismesh)[2],
+                double *mesh_ms, double *iris_ms)
+{
+    landmark_task_t mesh_task[MAX_FACE_NUM];
+    landmark_task_t iris_task[MAX_FACE_NUM][2];
+
+    taskgraph_reset (&cascade->graph);
+
+    for (int face_id = 0; face_id < detection->num; face_id ++)
+    {
+        landmark_task_t task = {0};
+        task.cascade  = cascade;
+        task.cpusrc   = cpusrc;
+        task.face     = &detection->faces[face_id];
+        task.facemesh = &facemesh[face_id];
+
+        mesh_task[face_id] = task;
+        int mesh_node = taskgraph_add_node (&cascade->graph, run_facemesh_task, &mesh_task[face_id]);
+
+        for (int eye_id = 0; eye_id < 2; eye_id ++)
+        {
+            iris_task[face_id][eye_id] = task;
+            iris_task[face_id][eye_id].irismesh = &irismesh[face_id][eye_id];
+            iris_task[face_id][eye_id].eye_id   = eye_id;
+
+            int iris_node = taskgraph_add_node (&cascade->graph, run_iris_task, &iris_task[face_id][eye_id]);
+            taskgraph_add_edge (&cascade->graph, mesh_node, iris_node);
+        }
+    }
+
+    taskgraph_run (&cascade->graph);
+
+    *mesh_ms = 0;
+    *iris_ms = 0;
+    for (int face_id = 0; face_id < detection->num; face_id ++)
+    {
+        *mesh_ms += mesh_task[face_id].invoke_ms;
+        *iris_ms += iris_task[face_id][0].invoke_ms + iris_task[face_id][1].invoke_ms;
+    }
+}
+
 /* Adjust the texture size to fit the window size
  *
  *                      Portrait
@@ -670,17 +890,22 @@ main(int argc, char *argv[])
     int use_quantized_tflite = 0;
     int enable_video = 0;
     int enable_camera = 1;
+    int enable_gl_crop = 0;
+    cascade_t cascade;
     UNUSED (argc);
     UNUSED (*argv);
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "gqv:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
             switch (c)
             {
+            case 'g':
+                enable_gl_crop = 1;
+                break;
             case 'q':
                 use_quantized_tflite = 1;
                 break;
@@ -714,6 +939,13 @@ main(int argc, char *argv[])
 
     init_tflite_facemesh (use_quantized_tflite);
 
+#if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
+    /* the GPU delegate needs the EGL context of this thread, which the cascade workers don't have. */
+    enable_gl_crop = 1;
+#endif
+    if (!enable_gl_crop && init_cascade (&cascade, use_quantized_tflite) < 0)
+        enable_gl_crop = 1;
+
 #if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
     /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
     glBindFramebuffer (GL_FRAMEBUFFER, 0);
@@ -743,7 +975,9 @@ main(int argc, char *argv[])
 #endif
     {
         int texid;
-        load_jpg_texture (input_name, &texid, &texw, &texh);
+        load_jpg_texture_ex (input_name, &texid, &texw, &texh, &s_still_img);
+        s_still_w = texw;
+        s_still_h = texh;
         captex.texid  = texid;
         captex.width  = texw;
         captex.height = texh;
@@ -752,6 +986,8 @@ main(int argc, char *argv[])
     }
     adjust_texture (win_w, win_h, texw, texh, &draw_x, &draw_y, &draw_w, &draw_h);
 
+    warp_init (0);
+
 
     glClearColor (0.5f, 0.5f, 0.5f, 1.0f);
     glClear (GL_COLOR_BUFFER_BIT);
@@ -792,10 +1028,14 @@ main(int argc, char *argv[])
         }
 #endif
 
+        warp_src_t cpu_frame, *cpusrc = NULL;
+        if (!enable_gl_crop)
+            cpusrc = get_cpu_frame (&cpu_frame, enable_camera, enable_video);
+
         /* --------------------------------------- *
          *  face detection
          * --------------------------------------- */
-        feed_face_detect_image (&captex, win_w, win_h);
+        feed_face_detect_image (&captex, cpusrc, win_w, win_h);
 
         ttime[2] = pmeter_get_time_ms ();
         invoke_face_detect (&face_detect_ret);
@@ -803,36 +1043,44 @@ main(int argc, char *argv[])
         invoke_ms0 = ttime[3] - ttime[2];
 
         /* --------------------------------------- *
-         *  face landmark
+         *  face landmark --> Iris landmark
          * --------------------------------------- */
-        invoke_ms1 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        if (cpusrc)
         {
-            feed_face_landmark_image (&captex, win_w, win_h, &face_detect_ret, face_id);
-
-            ttime[4] = pmeter_get_time_ms ();
-            invoke_facemesh_landmark (&face_mesh_ret[face_id]);
-            ttime[5] = pmeter_get_time_ms ();
-            invoke_ms1 += ttime[5] - ttime[4];
+            invoke_cascade (&cascade, cpusrc, &face_detect_ret, face_mesh_ret, iris_mesh_ret,
+                            &invoke_ms1, &invoke_ms2);
         }
-
-        /* --------------------------------------- *
-         *  Iris landmark
-         * --------------------------------------- */
-        invoke_ms2 = 0;
-        for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+        else
         {
-            for (int eye_id = 0; eye_id < 2; eye_id ++)
+            invoke_ms1 = 0;
+            for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
             {
-                feed_iris_landmark_image (&captex, win_w, win_h, &face_detect_ret.faces[face_id], &face_mesh_ret[face_id], eye_id);
+                feed_face_landmark_image (&captex, cpusrc, win_w, win_h, &face_detect_ret, face_id);
 
-                ttime[6] = pmeter_get_time_ms ();
-                invoke_irismesh_landmark (&iris_mesh_ret[face_id][eye_id]);
-                ttime[7] = pmeter_get_time_ms ();
-                invoke_ms2 += ttime[7] - ttime[6];
+                ttime[4] = pmeter_get_time_ms ();
+                invoke_facemesh_landmark (&face_mesh_ret[face_id]);
+                ttime[5] = pmeter_get_time_ms ();
+                invoke_ms1 += ttime[5] - ttime[4];
+            }
+
+            /* --------------------------------------- *
+             *  Iris landmark
+             * --------------------------------------- */
+            invoke_ms2 = 0;
+            for (int face_id = 0; face_id < face_detect_ret.num; face_id ++)
+            {
+                for (int eye_id = 0; eye_id < 2; eye_id ++)
+                {
+                    feed_iris_landmark_image (&captex, cpusrc, win_w, win_h, &face_detect_ret.faces[face_id], &face_mesh_ret[face_id], eye_id);
+
+                    ttime[6] = pmeter_get_time_ms ();
+                    invoke_irismesh_landmark (&iris_mesh_ret[face_id][eye_id]);
+                    ttime[7] = pmeter_get_time_ms ();
+                    invoke_ms2 += ttime[7] - ttime[6];
+                }
+                /* need to horizontal flip for right eye */
+                flip_horizontal_iris_landmark (&iris_mesh_ret[face_id][1]);
             }
-            /* need to horizontal flip for right eye */
-            flip_horizontal_iris_landmark (&iris_mesh_ret[face_id][1]);
         }
 
 
@@ -87,6 +87,26 @@ typedef struct _irismesh_result_t
 } irismesh_result_t;
 
 
+/*
+ *  landmark sessions. each session owns an interpreter and its tensors,
+ *  so that different sessions can be invoked on different threads at the same time.
+ *  num_threads: TFLite threads per interpreter (0: number of CPUs)
+ */
+typedef struct _mesh_session_t mesh_session_t;
+typedef struct _iris_session_t iris_session_t;
+
+mesh_session_t *mesh_session_create  (int use_quantized_tflite, int num_threads);
+void            mesh_session_destroy (mesh_session_t *sess);
+void           *mesh_session_get_input_buf (mesh_session_t *sess, int *w, int *h);
+int             mesh_session_invoke        (mesh_session_t *sess, face_landmark_result_t *facemesh_result);
+
+iris_session_t *iris_session_create  (int num_threads);
+void            iris_session_destroy (iris_session_t *sess);
+void           *iris_session_get_input_buf (iris_session_t *sess, int *w, int *h);
+int             iris_session_invoke        (iris_session_t *sess, irismesh_result_t *irismesh_result);
+
+
+/* single instance APIs. they work on the sessions created by init_tflite_facemesh(). */
 int  init_tflite_facemesh (int use_quantized_tflite);
 
 void *get_face_detect_input_buf (int *w, int *h);
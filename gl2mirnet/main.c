@@ -14,6 +14,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "tflite_mirnet.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
@@ -28,15 +29,10 @@
 void
 feed_tflite_image (texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = get_mirnet_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -46,67 +42,33 @@ feed_tflite_image (texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [ 0, 1] */
     float mean =   0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
 
-static float
-clamp (float s)
-{
-    s = fmax (s, 0.0f);
-    s = fmin (s, 1.0f);
-    return s;
-}
-
 /* upload style transfered image to OpenGLES texture */
 static int
 update_style_transfered_texture (mirnet_t *transfer)
 {
-    static int s_texid = 0;
-    static uint8_t *s_texbuf = NULL;
+    static stream_texture_t s_transtex;
+    static preproc_buf_t    s_texbuf;
     int img_w = transfer->w;
     int img_h = transfer->h;
 
-    if (s_texid == 0)
-    {
-        s_texbuf = (uint8_t *)calloc (1, img_w * img_h * 4);
-        s_texid  = create_2d_texture (s_texbuf, img_w, img_h);
-    }
-
-    uint8_t *d = s_texbuf;
-    float   *s = transfer->param;
+    unsigned int *imgbuf = (unsigned int *)preproc_buf_reserve (&s_texbuf, img_w * img_h * 4);
+    if (imgbuf == NULL)
+        return 0;
 
-    for (int y = 0; y < img_h; y ++)
-    {
-        for (int x = 0; x < img_w; x ++)
-        {
-            float r = *s ++;
-            float g = *s ++;
-            float b = *s ++;
-            *d ++ = (uint8_t)(clamp(r) * 255);
-            *d ++ = (uint8_t)(clamp(g) * 255);
-            *d ++ = (uint8_t)(clamp(b) * 255);
-            *d ++ = 0xFF;
-        }
-    }
+    /* RGB [0, 1] --> RGBA8 */
+    preproc_fp32_to_rgba (transfer->param, img_w * img_h, 1.0f, 0.0f, imgbuf);
 
-    glBindTexture (GL_TEXTURE_2D, s_texid);
-    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, 0, img_w, img_h, GL_RGBA, GL_UNSIGNED_BYTE, s_texbuf);
+    texture_2d_t *tex = update_stream_texture (&s_transtex, imgbuf, img_w, img_h,
+                                               pixfmt_fourcc ('R', 'G', 'B', 'A'));
+    if (tex == NULL)
+        return 0;
 
-    return s_texid;
+    return tex->texid;
 }
 
 
@@ -51,7 +51,7 @@ get_mirnet_input_buf (int *w, int *h)
 int
 invoke_mirnet (mirnet_t *predict_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -14,6 +14,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "util_matrix.h"
 #include "tflite_objectron.h"
 #include "util_camera_capture.h"
@@ -29,15 +30,10 @@
 void
 feed_objectron_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_objectron_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -47,19 +43,7 @@ feed_objectron_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [0, 1] */
     float mean =   0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -104,6 +88,8 @@ render_detect_region (int ofstx, int ofsty, int texw, int texh,
     float col_blue[]  = {0.0f, 0.0f, 1.0f, 1.0f};
     float col_cyan[]  = {0.0f, 1.0f, 1.0f, 1.0f};
 
+    begin_2d_batch ();
+
     for (int i = 0; i < detection->num; i ++)
     {
         object_t *obj = &(detection->objects[i]);
@@ -139,6 +125,7 @@ render_detect_region (int ofstx, int ofsty, int texw, int texh,
         draw_dbgstr_ex (buf, x, y, 1.0f, col_white, col_red);
     }
 
+    end_2d_batch ();
 }
 
 
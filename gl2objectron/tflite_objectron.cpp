@@ -20,7 +20,8 @@
 
 #include "util_tflite.h"
 #include "tflite_objectron.h"
-#include <list>
+#include "util_heatmap.h"
+#include "util_arena.h"
 #include "Eigen/Dense"
 
 /* 
@@ -42,6 +43,7 @@ static tflite_tensor_t      s_detect_tensor_offsetmap;
 static tflite_tensor_t      s_detect_tensor_heatmap;
 
 static int s_need_post_logistic = 0;
+static heatmap_t s_heatmap;          /* after the logistic */
 
 /*
  * https://github.com/google/mediapipe/tree/master/mediapipe/graphs/object_detection_3d/calculators/tflite_tensors_to_objects_calculator.cc
@@ -100,98 +102,20 @@ get_objectron_input_buf (int *w, int *h)
 static float
 get_heatmap_val (int x, int y)
 {
-    int hmp_w = s_detect_tensor_heatmap.dims[2];
-    float *heatmap = (float *)s_detect_tensor_heatmap.ptr;
-
-    float val = heatmap[hmp_w * y + x];
-
-    if (s_need_post_logistic)
-    {
-        const float cutoff_upper = 16.619047164916992188f;
-        const float cutoff_lower = -9.f;
-
-        if (val > cutoff_upper)
-            val = 1.0f;
-        else if (val < cutoff_lower)
-            val = std::exp(val);
-        else
-            val = 1.f / (1.f + std::exp(-val));
-    }
-
-    return val;
+    return heatmap_get (&s_heatmap, x, y, 0);
 }
 
-static float
-get_max_value (int cx, int cy, int hmp_w, int hmp_h, int kern_size)
-{
-    int sx = cx - (kern_size / 2);
-    int ex = cx + (kern_size / 2) + 1;
-    int sy = cy - (kern_size / 2);
-    int ey = cy + (kern_size / 2) + 1;
-
-    sx = std::max (sx, 0);
-    ex = std::min (ex, hmp_w);
-    sy = std::max (sy, 0);
-    ey = std::min (ey, hmp_h);
-
-    float max_val = 0;
-    for (int y = sy; y < ey; y ++)
-    {
-        for (int x = sx; x < ex; x ++)
-        {
-            float val = get_heatmap_val (x, y);
-            max_val = std::max (val, max_val);
-        }
-    }
+#define MAX_CENTER_PEAKS    128
 
-    return max_val;
-}
-
-static void
-dilate_heatmap (float *dst_hmp, int hmp_w, int hmp_h, int kern_size)
-{
-    for (int y = 0; y < hmp_h; y ++)
-    {
-        for (int x = 0; x < hmp_w; x ++)
-        {
-            dst_hmp[hmp_w * y + x] = get_max_value (x, y, hmp_w, hmp_h, kern_size);
-        }
-    }
-}
-
-static void
-extract_center_keypoints (std::list<fvec2> &center_points)
+/* local maxima in (5x5) window, the highest first */
+static int
+extract_center_keypoints (heatmap_peak_t *peaks, int max_peaks)
 {
-    int hmp_w = s_detect_tensor_heatmap.dims[2];
-    int hmp_h = s_detect_tensor_heatmap.dims[1];
-
-    float *max_filtered_heatmap = (float *)malloc (hmp_w * hmp_h * sizeof (float));
-
-    /* apply (5x5) MAX filter */
     int local_max_distance = 2;
-    int kernel_size = static_cast<int>(local_max_distance * 2 + 1 + 0.5f);
-    dilate_heatmap (max_filtered_heatmap, hmp_w, hmp_h, kernel_size);
-
     float heatmap_threshold = 0.6f;
-    for (int y = 0; y < hmp_h; y ++)
-    {
-        for (int x = 0; x < hmp_w; x ++)
-        {
-            float center_hmp_val = get_heatmap_val (x, y);
-            float max_hmp_val    = max_filtered_heatmap[hmp_w * y + x];
 
-            if ((center_hmp_val >= heatmap_threshold) &&
-                (center_hmp_val >= max_hmp_val))
-            {
-                fvec2 locations;
-                locations.x = x;
-                locations.y = y;
-                center_points.push_back (locations);
-            }
-        }
-    }
-
-    free (max_filtered_heatmap);
+    return heatmap_find_peaks (&s_heatmap, local_max_distance, heatmap_threshold,
+                               peaks, max_peaks);
 }
 
 /*
@@ -206,7 +130,7 @@ decode_by_voting (int cx, int cy, float offset_scale_x, float offset_scale_y, ob
     float *center_offset = &offsetmap[16 * ((cy * map_w) + cx)];
 
     /* transform BBOX offsetmap. (relative offset) --> (absolute offset) */
-    float *center_votes = (float *)malloc (16 * map_w * map_h * sizeof (float));
+    float center_votes[16];
     for (int i = 0; i < 8; i ++)
     {
         center_votes[2 * i    ] = cx + center_offset[2 * i    ] * offset_scale_x;
@@ -259,8 +183,6 @@ decode_by_voting (int cx, int cy, float offset_scale_x, float offset_scale_y, ob
         obj->bbox[i].x = x_sum / votes;
         obj->bbox[i].y = y_sum / votes;
     }
-
-    free (center_votes);
 }
 
 
@@ -282,10 +204,11 @@ IsIdentical (const object_t& box_1, const object_t& box_2)
 
 
 static bool
-IsNewBox (std::list<object_t> *obj_list, object_t *obj_item)
+IsNewBox (arena_vec_t *obj_list, object_t *obj_item)
 {
-    for (auto& b : *obj_list)
+    for (int i = 0; i < obj_list->num; i ++)
     {
+        object_t &b = ARENA_VEC_AT (obj_list, object_t, i);
         if (IsIdentical (b, *obj_item))
         {
             if (b.belief < obj_item->belief)
@@ -419,21 +342,14 @@ Project3DTo2D (bool portrait, object_t *object)
 
 
 static void
-pack_objectron_result (objectron_result_t *objectron_result, std::list<object_t> &bbox_list)
+pack_objectron_result (objectron_result_t *objectron_result, arena_vec_t *bbox_list)
 {
-    int num_obj = 0;
-    for (auto itr = bbox_list.begin(); itr != bbox_list.end(); itr ++)
-    {
-        object_t obj_item = *itr;
+    int num_obj = std::min (bbox_list->num, MAX_OBJECT_NUM);
 
-        memcpy (&objectron_result->objects[num_obj], &obj_item, sizeof (obj_item));
+    for (int i = 0; i < num_obj; i ++)
+        objectron_result->objects[i] = ARENA_VEC_AT (bbox_list, object_t, i);
 
-        num_obj++;
-        objectron_result->num = num_obj;
-
-        if (num_obj >= MAX_OBJECT_NUM)
-            break;
-    }
+    objectron_result->num = num_obj;
 }
 
 
@@ -443,7 +359,7 @@ pack_objectron_result (objectron_result_t *objectron_result, std::list<object_t>
 int
 invoke_objectron (objectron_result_t *objectron_result)
 {
-    if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_detect_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -459,14 +375,34 @@ invoke_objectron (objectron_result_t *objectron_result)
     float offset_scaley = ofstmap_h;
 #endif
 
-    std::list<fvec2> center_points;
-    extract_center_keypoints (center_points);
+    /* apply the logistic once for all the lookups below */
+    int hmp_w = s_detect_tensor_heatmap.dims[2];
+    int hmp_h = s_detect_tensor_heatmap.dims[1];
+    if (heatmap_load (&s_heatmap, (float *)s_detect_tensor_heatmap.ptr, hmp_w, hmp_h, 1,
+                      s_need_post_logistic ? HEATMAP_FLAG_LOGISTIC : 0) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    /* all the scratch of this frame comes from the arena */
+    arena_t *arena = arena_get_thread ();
+    arena_reset (arena);
+
+    heatmap_peak_t *center_points = (heatmap_peak_t *)arena_alloc (arena, MAX_CENTER_PEAKS * sizeof (heatmap_peak_t));
+    if (center_points == NULL)
+        return -1;
+
+    int num_center = extract_center_keypoints (center_points, MAX_CENTER_PEAKS);
+
+    arena_vec_t obj_list;
+    arena_vec_init (&obj_list, arena, sizeof (object_t), MAX_OBJECT_NUM);
 
-    std::list<object_t> obj_list;
-    for (auto &center_point : center_points)
+    for (int n = 0; n < num_center; n ++)
     {
-        int cx = static_cast<int>(std::round(center_point.x));
-        int cy = static_cast<int>(std::round(center_point.y));
+        heatmap_peak_t &center_point = center_points[n];
+        int cx = center_point.x;
+        int cy = center_point.y;
         object_t obj_item = {0};
 
         obj_item.belief = get_heatmap_val (cx, cy);
@@ -489,10 +425,12 @@ invoke_objectron (objectron_result_t *objectron_result)
 
         obj_item.center_x = center_point.x / (float)ofstmap_w;
         obj_item.center_y = center_point.y / (float)ofstmap_h;
-        obj_list.push_back (obj_item);
+        object_t *obj = (object_t *)arena_vec_push (&obj_list);
+        if (obj)
+            *obj = obj_item;
     }
 
-    pack_objectron_result (objectron_result, obj_list);
+    pack_objectron_result (objectron_result, &obj_list);
 
     return 0;
 }
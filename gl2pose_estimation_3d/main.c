@@ -13,6 +13,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "util_matrix.h"
 #include "tflite_pose3d.h"
 #include "util_camera_capture.h"
@@ -46,7 +47,7 @@ feed_pose3d_image(texture_2d_t *srctex, int win_w, int win_h)
     int dst_w, dst_h;
     float *buf_fp32 = (float *)get_pose3d_input_buf (&dst_w, &dst_h);
     unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
+    static preproc_buf_t s_readbuf;
 
     float dst_aspect = (float)dst_w / (float)dst_h;
     float tex_aspect = (float)srctex->width / (float)srctex->height;
@@ -70,10 +71,7 @@ feed_pose3d_image(texture_2d_t *srctex, int win_w, int win_h)
         offset_y = (dst_h - scaled_h) * 0.5;
     }
 
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(dst_w * dst_h * 4);
-
-    buf_ui8 = pui8;
+    buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, dst_w * dst_h * 4);
 
     /* draw valid texture area */
     float dx = offset_x;
@@ -87,19 +85,7 @@ feed_pose3d_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [0, 1] */
     float mean =   0.0f;
     float std  = 255.0f;
-    for (int y = 0; y < dst_h; y ++)
-    {
-        for (int x = 0; x < dst_w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, dst_w, dst_h, buf_fp32, mean, std);
 
     s_srctex_region.width  = dst_w;     /* full rect width  with margin */
     s_srctex_region.height = dst_h;     /* full rect height with margin */
@@ -143,6 +129,8 @@ render_2d_scene (int x, int y, int w, int h, posenet_result_t *pose_ret)
     float col_violet[] = {1.0f, 0.0f, 1.0f, 1.0f};
     float col_blue[]   = {0.0f, 0.5f, 1.0f, 1.0f};
 
+    begin_2d_batch ();
+
     {
         float ratio_w = s_srctex_region.width  / s_srctex_region.tex_w;
         float ratio_h = s_srctex_region.height / s_srctex_region.tex_h;
@@ -205,64 +193,33 @@ render_2d_scene (int x, int y, int w, int h, posenet_result_t *pose_ret)
             colj[3] = 1.0;
         }
     }
+
+    end_2d_batch ();
 }
 
 void
 render_posenet_heatmap (int ofstx, int ofsty, int draw_w, int draw_h, posenet_result_t *pose_ret)
 {
+    static stream_texture_t s_hmaptex;
     float *heatmap = pose_ret->pose[0].heatmap;
     int heatmap_w  = pose_ret->pose[0].heatmap_dims[0];
     int heatmap_h  = pose_ret->pose[0].heatmap_dims[1];
-    int x, y;
     unsigned char imgbuf[heatmap_w * heatmap_h];
     float conf_min, conf_max;
     static int s_count = 0;
     int key_id = (s_count /1)% kPoseKeyNum;
     s_count ++;
 
-    conf_min =  FLT_MAX;
-    conf_max = -FLT_MAX;
-    for (y = 0; y < heatmap_h; y ++)
-    {
-        for (x = 0; x < heatmap_w; x ++)
-        {
-            float confidence = heatmap[(y * heatmap_w * kPoseKeyNum)+ (x * kPoseKeyNum) + key_id];
-            if (confidence < conf_min) conf_min = confidence;
-            if (confidence > conf_max) conf_max = confidence;
-        }
-    }
+    preproc_fp32_minmax (&heatmap[key_id], heatmap_w * heatmap_h, kPoseKeyNum, &conf_min, &conf_max);
 
-    for (y = 0; y < heatmap_h; y ++)
-    {
-        for (x = 0; x < heatmap_w; x ++)
-        {
-            float confidence = heatmap[(y * heatmap_w * kPoseKeyNum)+ (x * kPoseKeyNum) + key_id];
-            confidence = (confidence - conf_min) / (conf_max - conf_min);
-            if (confidence < 0.0f) confidence = 0.0f;
-            if (confidence > 1.0f) confidence = 1.0f;
-            imgbuf[y * heatmap_w + x] = confidence * 255;
-        }
-    }
-
-    GLuint texid;
+    float scale = (conf_max > conf_min) ? 1.0f / (conf_max - conf_min) : 0.0f;
+    preproc_fp32_to_gray (&heatmap[key_id], heatmap_w * heatmap_h, kPoseKeyNum, scale, -conf_min * scale, imgbuf);
 
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
-
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
-
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_LUMINANCE,
-        heatmap_w, heatmap_h, 0, GL_LUMINANCE,
-        GL_UNSIGNED_BYTE, imgbuf);
-
-    draw_2d_colormap (texid, ofstx, ofsty, draw_w, draw_h, 0.8f, 0);
+    texture_2d_t *hmaptex = update_stream_texture (&s_hmaptex, imgbuf, heatmap_w, heatmap_h, pixfmt_fourcc ('Y', '8', '0', '0'));
+    if (hmaptex == NULL)
+        return;
 
-    glDeleteTextures (1, &texid);
+    draw_2d_colormap (hmaptex->texid, ofstx, ofsty, draw_w, draw_h, 0.8f, 0);
 
     {
         char strKey[][32] = {"Nose", "Neck", 
@@ -191,7 +191,7 @@ decode_single_pose (posenet_result_t *pose_result)
 int
 invoke_pose3d (posenet_result_t *pose_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -13,6 +13,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "tflite_posenet.h"
 #include "ssbo_tensor.h"
 #include "util_camera_capture.h"
@@ -34,47 +35,28 @@ feed_posenet_image(texture_2d_t *srctex, ssbo_t *ssbo, int win_w, int win_h)
 #if defined (USE_INPUT_SSBO)
     resize_texture_to_ssbo (srctex->texid, ssbo);
 #else
-    int x, y, w, h;
+    int w, h;
 #if defined (USE_QUANT_TFLITE_MODEL)
     unsigned char *buf_u8 = (unsigned char *)get_posenet_input_buf (&w, &h);
 #else
     float *buf_fp32 = (float *)get_posenet_input_buf (&w, &h);
 #endif
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
     glPixelStorei (GL_PACK_ALIGNMENT, 4);
     glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 
+#if defined (USE_QUANT_TFLITE_MODEL)
+    preproc_rgba_to_uint8 (buf_ui8, w, h, 0, buf_u8, &preproc_norm_none, 1.0f, 0, 0);
+#else
     /* convert UI8 [0, 255] ==> FP32 [0, 1] */
     float mean =   0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-#if defined (USE_QUANT_TFLITE_MODEL)
-            *buf_u8 ++ = r;
-            *buf_u8 ++ = g;
-            *buf_u8 ++ = b;
-#else
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 #endif
-        }
-    }
 
 #endif
     return;
@@ -142,6 +124,8 @@ render_posenet_result (int x, int y, int w, int h, posenet_result_t *pose_ret)
     float col_pink[]   = {1.0f, 0.0f, 1.0f, 1.0f};
     float col_blue[]   = {0.0f, 0.5f, 1.0f, 1.0f};
     
+    begin_2d_batch ();
+
     for (int i = 0; i < pose_ret->num; i ++)
     {
         /* draw skelton */
@@ -187,15 +171,17 @@ render_posenet_result (int x, int y, int w, int h, posenet_result_t *pose_ret)
 #if defined (USE_FACE_MASK)
     render_facemask (x, y, w, h, pose_ret);
 #endif
+
+    end_2d_batch ();
 }
 
 void
 render_posenet_heatmap (int ofstx, int ofsty, int draw_w, int draw_h, posenet_result_t *pose_ret)
 {
+    static stream_texture_t s_hmaptex;
     float *heatmap = pose_ret->pose[0].heatmap;
     int heatmap_w  = pose_ret->pose[0].heatmap_dims[0];
     int heatmap_h  = pose_ret->pose[0].heatmap_dims[1];
-    int x, y;
     unsigned char imgbuf[heatmap_w * heatmap_h];
     float conf_min, conf_max;
     static int s_count = 0;
@@ -206,50 +192,17 @@ render_posenet_heatmap (int ofstx, int ofsty, int draw_w, int draw_h, posenet_re
     conf_min = -5.0f;
     conf_max =  1.0f;
 #else
-    conf_min =  FLT_MAX;
-    conf_max = -FLT_MAX;
-    for (y = 0; y < heatmap_h; y ++)
-    {
-        for (x = 0; x < heatmap_w; x ++)
-        {
-            float confidence = heatmap[(y * heatmap_w * 17)+ (x * 17) + key_id];
-            if (confidence < conf_min) conf_min = confidence;
-            if (confidence > conf_max) conf_max = confidence;
-        }
-    }
+    preproc_fp32_minmax (&heatmap[key_id], heatmap_w * heatmap_h, 17, &conf_min, &conf_max);
 #endif
 
-    for (y = 0; y < heatmap_h; y ++)
-    {
-        for (x = 0; x < heatmap_w; x ++)
-        {
-            float confidence = heatmap[(y * heatmap_w * 17)+ (x * 17) + key_id];
-            confidence = (confidence - conf_min) / (conf_max - conf_min);
-            if (confidence < 0.0f) confidence = 0.0f;
-            if (confidence > 1.0f) confidence = 1.0f;
-            imgbuf[y * heatmap_w + x] = confidence * 255;
-        }
-    }
+    float scale = (conf_max > conf_min) ? 1.0f / (conf_max - conf_min) : 0.0f;
+    preproc_fp32_to_gray (&heatmap[key_id], heatmap_w * heatmap_h, 17, scale, -conf_min * scale, imgbuf);
 
-    GLuint texid;
+    texture_2d_t *hmaptex = update_stream_texture (&s_hmaptex, imgbuf, heatmap_w, heatmap_h, pixfmt_fourcc ('Y', '8', '0', '0'));
+    if (hmaptex == NULL)
+        return;
 
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
-
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
-
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_LUMINANCE,
-        heatmap_w, heatmap_h, 0, GL_LUMINANCE,
-        GL_UNSIGNED_BYTE, imgbuf);
-
-    draw_2d_colormap (texid, ofstx, ofsty, draw_w, draw_h, 0.8f, 0);
-
-    glDeleteTextures (1, &texid);
+    draw_2d_colormap (hmaptex->texid, ofstx, ofsty, draw_w, draw_h, 0.8f, 0);
 
     {
         char strKey[][32] = {"Nose", "LEye", "REye", "LEar", "REar", "LShoulder", "RShoulder",
@@ -322,6 +275,7 @@ main(int argc, char *argv[])
     double ttime[10] = {0}, interval, invoke_ms;
     int use_quantized_tflite = 0;
     int enable_camera = 1;
+    int max_pose_num = DEFAULT_POSE_NUM;
     UNUSED (argc);
     UNUSED (*argv);
 #if defined (USE_INPUT_VIDEO_DECODE)
@@ -330,7 +284,7 @@ main(int argc, char *argv[])
 
     {
         int c;
-        const char *optstring = "qv:x";
+        const char *optstring = "n:qv:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -345,6 +299,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'n':
+                max_pose_num = atoi (optarg);
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -369,6 +326,7 @@ main(int argc, char *argv[])
 #endif
 
     init_tflite_posenet (use_quantized_tflite, ssbo);
+    set_posenet_max_pose_num (max_pose_num);
 
 #if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
     /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
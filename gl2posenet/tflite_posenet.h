@@ -11,7 +11,8 @@
 extern "C" {
 #endif
 
-#define MAX_POSE_NUM  10
+#define MAX_POSE_NUM      32
+#define DEFAULT_POSE_NUM  10
 
 enum pose_key_id {
     kNose = 0,          //  0
@@ -64,6 +65,9 @@ void  *get_posenet_input_buf (int *w, int *h);
 
 int invoke_posenet (posenet_result_t *pose_result);
 
+/* the number of poses to decode (1 .. MAX_POSE_NUM). default: DEFAULT_POSE_NUM */
+void set_posenet_max_pose_num (int num);
+
 #ifdef __cplusplus
 }
 #endif
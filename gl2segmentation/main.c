@@ -13,6 +13,8 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
+#include "util_segment.h"
 #include "tflite_deeplab.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
@@ -27,15 +29,10 @@
 void
 feed_deeplab_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_deeplab_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -45,19 +42,7 @@ feed_deeplab_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [ 0, 1] */
     float mean =   0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -67,54 +52,29 @@ static void
 render_deeplab_result (int ofstx, int ofsty, int draw_w, int draw_h,
                        deeplab_result_t *deeplab_ret)
 {
-    float *segmap = deeplab_ret->segmentmap;
-    int segmap_w  = deeplab_ret->segmentmap_dims[0];
-    int segmap_h  = deeplab_ret->segmentmap_dims[1];
-    int segmap_c  = deeplab_ret->segmentmap_dims[2];
-    int x, y, c;
-    unsigned int imgbuf[segmap_h][segmap_w];
-
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
+    segment_map_t *segmap = &deeplab_ret->segmap;
+    static stream_texture_t s_segtex;
+    static preproc_buf_t s_imgbuf;
+    static uint32_t s_palette[21];
+    static int      s_palette_valid = 0;
+    uint32_t *imgbuf = (uint32_t *)preproc_buf_reserve (&s_imgbuf, segmap->w * segmap->h * 4);
+    int c;
+
+    if (!s_palette_valid)
     {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            int max_id;
-            float conf_max = 0;
-            for (c = 0; c < 21; c ++)
-            {
-                float confidence = segmap[(y * segmap_w * segmap_c)+ (x * segmap_c) + c];
-                if (c == 0 || confidence > conf_max)
-                {
-                    conf_max = confidence;
-                    max_id = c;
-                }
-            }
-            float *col = get_deeplab_class_color (max_id);
-            unsigned char r = ((int)(col[0] * 255)) & 0xff;
-            unsigned char g = ((int)(col[1] * 255)) & 0xff;
-            unsigned char b = ((int)(col[2] * 255)) & 0xff;
-            unsigned char a = ((int)(col[3] * 255)) & 0xff;
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
+        for (c = 0; c < 21; c ++)
+            segment_palette_from_fp32 (&s_palette[c], get_deeplab_class_color (c));
+        s_palette_valid = 1;
     }
-    
-    GLuint texid;
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
-
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    /* find the most confident class for each pixel. */
+    segment_argmax (segmap, 21, NULL, NULL, s_palette, 21, imgbuf);
 
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA,
-        segmap_w, segmap_h, 0, GL_RGBA,
-        GL_UNSIGNED_BYTE, imgbuf);
+    texture_2d_t *segtex = update_stream_texture (&s_segtex, imgbuf, segmap->w, segmap->h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
+    if (segtex == NULL)
+        return;
 
-    draw_2d_texture (texid, ofstx, ofsty, draw_w, draw_h, 0);
+    draw_2d_texture (segtex->texid, ofstx, ofsty, draw_w, draw_h, 0);
 
     /* class name */
     for (c = 0; c < 21; c ++)
@@ -126,72 +86,40 @@ render_deeplab_result (int ofstx, int ofsty, int draw_w, int draw_h,
         sprintf (buf, "%2d:%s", c, name);
         draw_dbgstr_ex (buf, ofstx, ofsty + c * 22 * 0.7, 0.7f, col_str, col);
     }
-
-    glDeleteTextures (1, &texid);
 }
 
 void
 render_deeplab_heatmap (int ofstx, int ofsty, int draw_w, int draw_h, deeplab_result_t *deeplab_ret)
 {
+    static stream_texture_t s_hmaptex;
     float *segmap = deeplab_ret->segmentmap;
     int segmap_w  = deeplab_ret->segmentmap_dims[0];
     int segmap_h  = deeplab_ret->segmentmap_dims[1];
     int segmap_c  = deeplab_ret->segmentmap_dims[2];
-    int x, y;
     unsigned char imgbuf[segmap_h][segmap_w];
     static int s_count = 0;
     int key_id = (s_count /10)% 21;
     s_count ++;
     float conf_min, conf_max;
 
+    if (segmap == NULL)
+        return;
 
 #if 1
     conf_min =  0.0f;
     conf_max = 50.0f;
 #else
-    conf_min =  FLT_MAX;
-    conf_max = -FLT_MAX;
-    for (y = 0; y < segmap_h; y ++)
-    {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            float confidence = segmap[(y * segmap_w * segmap_c)+ (x * segmap_c) + key_id];
-            if (confidence < conf_min) conf_min = confidence;
-            if (confidence > conf_max) conf_max = confidence;
-        }
-    }
+    preproc_fp32_minmax (&segmap[key_id], segmap_w * segmap_h, segmap_c, &conf_min, &conf_max);
 #endif
 
-    for (y = 0; y < segmap_h; y ++)
-    {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            float confidence = segmap[(y * segmap_w * segmap_c)+ (x * segmap_c) + key_id];
-            confidence = (confidence - conf_min) / (conf_max - conf_min);
-            if (confidence < 0.0f) confidence = 0.0f;
-            if (confidence > 1.0f) confidence = 1.0f;
-            imgbuf[y][x] = confidence * 255;
-        }
-    }
-    
-    GLuint texid;
-    glGenTextures (1, &texid );
-    glBindTexture (GL_TEXTURE_2D, texid);
-
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
-
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_LUMINANCE,
-        segmap_w, segmap_h, 0, GL_LUMINANCE,
-        GL_UNSIGNED_BYTE, imgbuf);
+    float scale = (conf_max > conf_min) ? 1.0f / (conf_max - conf_min) : 0.0f;
+    preproc_fp32_to_gray (&segmap[key_id], segmap_w * segmap_h, segmap_c, scale, -conf_min * scale, &imgbuf[0][0]);
 
-    draw_2d_colormap (texid, ofstx, ofsty, draw_w, draw_h, 0.8f, 0);
+    texture_2d_t *hmaptex = update_stream_texture (&s_hmaptex, imgbuf, segmap_w, segmap_h, pixfmt_fourcc ('Y', '8', '0', '0'));
+    if (hmaptex == NULL)
+        return;
 
-    glDeleteTextures (1, &texid);
+    draw_2d_colormap (hmaptex->texid, ofstx, ofsty, draw_w, draw_h, 0.8f, 0);
 
     {
         char strbuf[128];
@@ -305,6 +233,7 @@ main(int argc, char *argv[])
     init_dbgstr (win_w, win_h);
 
     init_tflite_deeplab ();
+    segment_init (0);
 
 #if defined (USE_GL_DELEGATE) || defined (USE_GPU_DELEGATEV2)
     /* we need to recover framebuffer because GPU Delegate changes the FBO binding */
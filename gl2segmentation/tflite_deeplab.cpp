@@ -113,7 +113,7 @@ get_deeplab_class_color (int class_idx)
 int
 invoke_deeplab (deeplab_result_t *deeplab_result)
 {
-    if (s_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter) != 0)
     {
         DBG_LOGE ("ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -124,6 +124,30 @@ invoke_deeplab (deeplab_result_t *deeplab_result)
     deeplab_result->segmentmap_dims[1] = s_tensor_segment.dims[1];
     deeplab_result->segmentmap_dims[2] = s_tensor_segment.dims[3];
 
+    /* quantized logits are passed to the argmax without dequantization. */
+    segment_map_t *segmap = &deeplab_result->segmap;
+    segmap->buf         = s_tensor_segment.ptr;
+    segmap->w           = s_tensor_segment.dims[2];
+    segmap->h           = s_tensor_segment.dims[1];
+    segmap->c           = s_tensor_segment.dims[3];
+    segmap->quant_scale = s_tensor_segment.quant_scale;
+    segmap->quant_zerop = s_tensor_segment.quant_zerop;
+
+    switch (s_tensor_segment.type)
+    {
+    case kTfLiteUInt8:
+        segmap->type = SEGMENT_TYPE_UINT8;
+        deeplab_result->segmentmap = NULL;
+        break;
+    case kTfLiteInt8:
+        segmap->type = SEGMENT_TYPE_INT8;
+        deeplab_result->segmentmap = NULL;
+        break;
+    default:
+        segmap->type = SEGMENT_TYPE_FP32;
+        break;
+    }
+
     return 0;
 }
 
@@ -9,13 +9,16 @@
 extern "C" {
 #endif
 
+#include "util_segment.h"
+
 #define MAX_DETECT_CLASS 20
 
 
 typedef struct _deeplab_result_t
 {
-    float *segmentmap;
+    float *segmentmap;          /* NULL if the model output is quantized */
     int   segmentmap_dims[3];
+    segment_map_t segmap;       /* the output tensor as it is (fp32, uint8 or int8) */
 } deeplab_result_t;
 
 
@@ -13,6 +13,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "util_matrix.h"
 #include "tflite_selfie2anime.h"
 #include "util_camera_capture.h"
@@ -28,15 +29,10 @@
 void
 feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_face_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -46,19 +42,7 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -66,15 +50,10 @@ feed_face_detect_image(texture_2d_t *srctex, int win_w, int win_h)
 void
 feed_selfie2anime_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_result_t *detection, unsigned int face_id)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_selfie2anime_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     float texcoord[] = { 0.0f, 1.0f,
                          0.0f, 0.0f,
@@ -106,19 +85,7 @@ feed_selfie2anime_image(texture_2d_t *srctex, int win_w, int win_h, face_detect_
     /* convert UI8 [0, 255] ==> FP32 [0, 1] */
     float mean = 0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
@@ -188,14 +155,6 @@ render_cropped_face_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw,
     draw_2d_texture_ex_texcoord (srctex, ofstx, ofsty, texw, texh, texcoord);
 }
 
-float
-fclampf (float val)
-{
-    val = fmaxf (0.0f, val);
-    val = fminf (1.0f, val);
-    return val;
-}
-
 static void
 render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int texh,
                        face_detect_result_t *detection, unsigned int face_id, selfie2anime_result_t *selfie2anime_ret)
@@ -203,30 +162,14 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     if (detection->num <= face_id)
         return;
 
+    static stream_texture_t s_animtex[MAX_FACE_NUM];
     float *segmap = selfie2anime_ret->segmentmap;
     int segmap_w  = selfie2anime_ret->segmentmap_dims[0];
     int segmap_h  = selfie2anime_ret->segmentmap_dims[1];
-    int x, y;
     unsigned int imgbuf[segmap_h][segmap_w];
 
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < segmap_h; y ++)
-    {
-        for (x = 0; x < segmap_w; x ++)
-        {
-            float *col = &segmap[3 * (y * segmap_w + x)];
-            float fr = fclampf (col[0]) * 255;
-            float fg = fclampf (col[1]) * 255;
-            float fb = fclampf (col[2]) * 255;
-
-            unsigned char r = ((int)fr) & 0xff;
-            unsigned char g = ((int)fg) & 0xff;
-            unsigned char b = ((int)fb) & 0xff;
-            unsigned char a = 0xff;
-
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
-    }
+    /* RGB [0, 1] --> RGBA8 */
+    preproc_fp32_to_rgba (segmap, segmap_w * segmap_h, 1.0f, 0.0f, &imgbuf[0][0]);
 
     face_t *face = &(detection->faces[face_id]);
     float cx     = face->face_cx * texw; //    0--------1
@@ -237,11 +180,11 @@ render_animface_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int
     float by     = cy - face_h * 0.5f;
     float rot    = RAD_TO_DEG (face->rotation);
 
-    texture_2d_t animtex;
-    create_2d_texture_ex (&animtex, imgbuf, segmap_w, segmap_h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
-    draw_2d_texture_ex_texcoord_rot (&animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
+    texture_2d_t *animtex = update_stream_texture (&s_animtex[face_id], imgbuf, segmap_w, segmap_h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
+    if (animtex == NULL)
+        return;
 
-    glDeleteTextures (1, &animtex.texid);
+    draw_2d_texture_ex_texcoord_rot (animtex, ofstx + bx, ofsty + by, face_w, face_h, 0, 0.5, 0.5, rot);
 }
 
 /* Adjust the texture size to fit the window size
@@ -4,6 +4,7 @@
  * ------------------------------------------------ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <float.h>
@@ -13,12 +14,21 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "tflite_style_transfer.h"
+#include "style_gallery.h"
+#include "util_featcache.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
 
 #define UNUSED(x) (void)(x)
 
+#define STYLE_CACHE_PATH    "./style_transfer_model/style_cache.bin"
+
+/* frames to show a style, and to fade into the next one. */
+#define STYLE_HOLD_FRAMES   120
+#define STYLE_FADE_FRAMES   30
+
 
 
 
@@ -27,27 +37,17 @@
 void
 feed_style_transfer_image(int is_predict, texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32;
     unsigned char *buf_ui8 = NULL;
-    static int buf_w = 0, buf_h = 0;
-    static unsigned char *pui8 = NULL;
+    static preproc_buf_t s_readbuf;
 
     if (is_predict)
         buf_fp32 = (float *)get_style_predict_input_buf (&w, &h);
     else
         buf_fp32 = (float *)get_style_transfer_content_input_buf (&w, &h);
 
-    if (buf_w != w || buf_h != h)
-    {
-        if (pui8)
-            free (pui8);
-        pui8 = (unsigned char *)malloc(w * h * 4);
-        buf_w = w;
-        buf_h = h;
-    }
-
-    buf_ui8 = pui8;
+    buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -57,62 +57,62 @@ feed_style_transfer_image(int is_predict, texture_2d_t *srctex, int win_w, int w
     /* convert UI8 [0, 255] ==> FP32 [ 0, 1] */
     float mean =   0.0f;
     float std  = 255.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
 
-void
-store_style_predict (style_predict_t *style)
+/*
+ *  predict the style of the image, or take it from the cache if the file was
+ *  predicted before. (fname) == NULL for the camera/video frames which are not cached.
+ *  returns the index in the gallery.
+ */
+static int
+add_style (style_gallery_t *gallery, featcache_t *cache, char *fname,
+           texture_2d_t *tex, int win_w, int win_h)
 {
-    int size = style->size;
-    float *param = (float *)style->param;
-    float *store_param = (float *)calloc (1, size * sizeof(float));
+    const float *param = NULL;
+    uint64_t key = 0;
+    int cacheable = 0;
 
-    style->param = store_param;
+    if (fname && featcache_hash_file (fname, &key) == 0)
+    {
+        cacheable = 1;
+        param = featcache_lookup (cache, key);
+    }
 
-    while (size --> 0)
+    if (param == NULL)
     {
-        *store_param ++ = *param ++;
+        style_predict_t predict;
+
+        glClear (GL_COLOR_BUFFER_BIT);
+        feed_style_transfer_image (1, tex, win_w, win_h);
+        if (invoke_style_predict (&predict) < 0 || predict.size != gallery->size)
+        {
+            fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+            return -1;
+        }
+        param = (float *)predict.param;
+
+        if (cacheable)
+            featcache_insert (cache, key, param);
     }
+
+    return style_gallery_add (gallery, param);
 }
 
-void
-feed_blend_style (style_predict_t *style0, style_predict_t *style1, float ratio)
+/*
+ *  the style input tensor may share its memory with the other tensors,
+ *  so feed it before every invoke.
+ */
+static void
+feed_style (const float *param)
 {
     int size;
-    float *s0 = (float *)style0->param;
-    float *s1 = (float *)style1->param;
-    float *d  = (float *)get_style_transfer_style_input_buf (&size);
+    float *d = (float *)get_style_transfer_style_input_buf (&size);
 
-    if (style0->size != size || style1->size != size)
-    {
-        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
-        return;
-    }
-    
-    for (int i = 0; i < size; i ++)
-    {
-        float src0 = *s0;
-        float src1 = *s1;
-        float src  = (ratio * src1) + ((1.0f - ratio) * src0);
-
-        *d ++ = src;
-        s0 ++;
-        s1 ++;
-    }
+    if (param)
+        memcpy (d, param, size * sizeof (float));
 }
 
 
@@ -208,15 +208,18 @@ main(int argc, char *argv[])
     char input_name_default[] = "pakutaso_famicom.jpg";
     char *input_name = NULL;
     char input_style_name_default[] = "munch_scream.jpg";
-    char *input_style_name = NULL;
+    char *input_style_names[STYLE_GALLERY_MAX];
+    int num_styles = 0;
+    char *style_cache_name = STYLE_CACHE_PATH;
     int count;
     int win_w = 720 * 2;
     int win_h = 540;
     int texid;
     int texw, texh, draw_x, draw_y, draw_w, draw_h;
     texture_2d_t captex = {0};
-    texture_2d_t styletex = {0};
-    float style_ratio = -0.1f;
+    texture_2d_t styletex[STYLE_GALLERY_MAX] = {{0}};
+    float style_ratio = 1.0f;
+    int style_sel0 = 0, style_sel1 = 0;
     double ttime[10] = {0}, interval, invoke_ms;
     int enable_camera = 1;
     UNUSED (argc);
@@ -225,10 +228,10 @@ main(int argc, char *argv[])
     int enable_video = 0;
 #endif
 
-    /* gl2style_transfer [content_file_name] [style_file_name] */
+    /* gl2style_transfer [content_file_name] [style_file_name ...] */
     {
         int c;
-        const char *optstring = "v:x";
+        const char *optstring = "c:v:x";
 
         while ((c = getopt (argc, argv, optstring)) != -1)
         {
@@ -240,6 +243,9 @@ main(int argc, char *argv[])
                 input_name = optarg;
                 break;
 #endif
+            case 'c':
+                style_cache_name = optarg;
+                break;
             case 'x':
                 enable_camera = 0;
                 break;
@@ -250,16 +256,16 @@ main(int argc, char *argv[])
         {
             if (input_name == NULL)
                 input_name = argv[optind];
-            else if (input_style_name == NULL)
-                input_style_name = argv[optind];;
+            else if (num_styles < STYLE_GALLERY_MAX - 1)
+                input_style_names[num_styles ++] = argv[optind];
             optind++;
         }
     }
 
     if (input_name == NULL)
         input_name = input_name_default;
-    if (input_style_name == NULL)
-        input_style_name = input_style_name_default;
+    if (num_styles == 0)
+        input_style_names[num_styles ++] = input_style_name_default;
 
     egl_init_with_platform_window_surface (2, 0, 0, 0, win_w, win_h);
 
@@ -311,26 +317,42 @@ main(int argc, char *argv[])
     /* --------------------------------------- *
      *  Style prediction
      * --------------------------------------- */
-    style_predict_t style_predict[2] = {0};
+    style_gallery_t style_gallery;
     {
-        int w, h;
-        load_jpg_texture (input_style_name, &texid, &w, &h);
-        styletex.texid  = texid;
-        styletex.width  = texw;
-        styletex.height = texh;
-        styletex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
-
-        /* predict style of original image */
-        glClear (GL_COLOR_BUFFER_BIT);
-        feed_style_transfer_image (1, &captex, win_w, win_h);
-        invoke_style_predict (&style_predict[0]);
-        store_style_predict (&style_predict[0]);
+        featcache_t style_cache;
+        char *content_name = enable_camera ? NULL : input_name;
+        int size, i;
 
-        /* predict style of target image */
-        glClear (GL_COLOR_BUFFER_BIT);
-        feed_style_transfer_image (1, &styletex, win_w, win_h);
-        invoke_style_predict (&style_predict[1]);
-        store_style_predict (&style_predict[1]);
+        get_style_transfer_style_input_buf (&size);
+        style_gallery_init (&style_gallery, size);
+
+        /* without the cache file, every style is predicted. */
+        featcache_open (&style_cache, style_cache_name, size, get_style_predict_model_hash ());
+
+#if defined (USE_INPUT_VIDEO_DECODE)
+        if (enable_video)
+            content_name = NULL;
+#endif
+        /* [0]: style of original image. the camera/video frames are not cached. */
+        styletex[0] = captex;
+        add_style (&style_gallery, &style_cache, content_name, &captex, win_w, win_h);
+
+        /* [1..]: style of target images */
+        for (i = 0; i < num_styles; i ++)
+        {
+            texture_2d_t tex = {0};
+            int idx;
+
+            load_jpg_texture (input_style_names[i], &texid, &tex.width, &tex.height);
+            tex.texid  = texid;
+            tex.format = pixfmt_fourcc ('R', 'G', 'B', 'A');
+
+            idx = add_style (&style_gallery, &style_cache, input_style_names[i], &tex, win_w, win_h);
+            if (idx >= 0)
+                styletex[idx] = tex;
+        }
+
+        featcache_close (&style_cache);
     }
 
     /* --------------------------------------- *
@@ -367,22 +389,30 @@ main(int argc, char *argv[])
         /* --------------------------------------- *
          *  Style transfer
          * --------------------------------------- */
-#if 0
         /* 
-         *  update style parameter blend ratio.
-         *      0.0: apply 100[%] style of original image.
-         *      1.0: apply 100[%] style of target image.
+         *  select the style from the gallery.
+         *      one target image : apply 100[%] style of the target image.
+         *      more target images: show them in turn with a cross fade.
          */
-        style_ratio += 0.1f;
-        if (style_ratio > 1.01f)
-            style_ratio = -0.1f;
-#else
-        style_ratio = 1.0f;
-#endif
+        if (style_gallery.num > 2)
+        {
+            int num   = style_gallery.num - 1;
+            int slot  = count / STYLE_HOLD_FRAMES;
+            int phase = count % STYLE_HOLD_FRAMES - (STYLE_HOLD_FRAMES - STYLE_FADE_FRAMES);
 
+            style_sel0  = 1 + (slot    ) % num;
+            style_sel1  = 1 + (slot + 1) % num;
+            style_ratio = (phase > 0) ? (float)phase / STYLE_FADE_FRAMES : 0.0f;
+        }
+        else
+        {
+            style_sel0  = 0;
+            style_sel1  = style_gallery.num - 1;
+            style_ratio = 1.0f;
+        }
 
         /* feed style parameter and original image */
-        feed_blend_style (&style_predict[0], &style_predict[1], style_ratio);
+        feed_style (style_gallery_select (&style_gallery, style_sel0, style_sel1, style_ratio));
         feed_style_transfer_image (0, &captex, win_w, win_h);
 
         ttime[2] = pmeter_get_time_ms ();
@@ -407,7 +437,8 @@ main(int argc, char *argv[])
         /* render the target style image */
         {
             float col_black[] = {1.0f, 1.0f, 1.0f, 1.0f};
-            draw_2d_texture_ex (&styletex,  win_w - 200, 0, 200, 200, 0);
+            int sel = (style_ratio < 0.5f) ? style_sel0 : style_sel1;
+            draw_2d_texture_ex (&styletex[sel], win_w - 200, 0, 200, 200, 0);
             draw_2d_rect (win_w - 200, 0, 200, 200, col_black, 2.0f);
         }
 
@@ -416,8 +447,8 @@ main(int argc, char *argv[])
          * --------------------------------------- */
         draw_pmeter (0, 40);
 
-        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]\nstyle_ratio=%.1f", 
-                                interval, invoke_ms, style_ratio);
+        sprintf (strbuf, "Interval:%5.1f [ms]\nTFLite  :%5.1f [ms]\nstyle[%d->%d]=%.1f", 
+                                interval, invoke_ms, style_sel0, style_sel1, style_ratio);
         draw_dbgstr (strbuf, 10, 10);
 
         egl_swap();
@@ -0,0 +1,94 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "style_gallery.h"
+
+
+int
+style_gallery_init (style_gallery_t *gallery, int size)
+{
+    memset (gallery, 0, sizeof (*gallery));
+
+    gallery->params  = (float *)calloc (STYLE_GALLERY_MAX * size, sizeof (float));
+    gallery->blended = (float *)calloc (size, sizeof (float));
+    if (gallery->params == NULL || gallery->blended == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        style_gallery_destroy (gallery);
+        return -1;
+    }
+
+    gallery->size = size;
+    gallery->sel0 = -1;
+    gallery->sel1 = -1;
+
+    return 0;
+}
+
+void
+style_gallery_destroy (style_gallery_t *gallery)
+{
+    free (gallery->params);
+    free (gallery->blended);
+
+    gallery->params  = NULL;
+    gallery->blended = NULL;
+    gallery->num     = 0;
+}
+
+int
+style_gallery_add (style_gallery_t *gallery, const float *param)
+{
+    int idx = gallery->num;
+
+    if (idx >= STYLE_GALLERY_MAX)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    memcpy (&gallery->params[idx * gallery->size], param, gallery->size * sizeof (float));
+    gallery->num ++;
+
+    return idx;
+}
+
+const float *
+style_gallery_get (style_gallery_t *gallery, int idx)
+{
+    if (idx < 0 || idx >= gallery->num)
+        return NULL;
+
+    return &gallery->params[idx * gallery->size];
+}
+
+const float *
+style_gallery_select (style_gallery_t *gallery, int idx0, int idx1, float ratio)
+{
+    const float *s0 = style_gallery_get (gallery, idx0);
+    const float *s1 = style_gallery_get (gallery, idx1);
+    float *d = gallery->blended;
+    int i;
+
+    if (s0 == NULL || s1 == NULL)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return NULL;
+    }
+
+    if (idx0 == gallery->sel0 && idx1 == gallery->sel1 && ratio == gallery->ratio)
+        return d;
+
+    for (i = 0; i < gallery->size; i ++)
+        d[i] = (ratio * s1[i]) + ((1.0f - ratio) * s0[i]);
+
+    gallery->sel0  = idx0;
+    gallery->sel1  = idx1;
+    gallery->ratio = ratio;
+
+    return d;
+}
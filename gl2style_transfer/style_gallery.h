@@ -0,0 +1,47 @@
+/* ------------------------------------------------ *
+ * The MIT License (MIT)
+ * Copyright (c) 2020 terryky1220@gmail.com
+ * ------------------------------------------------ */
+#ifndef STYLE_GALLERY_H_
+#define STYLE_GALLERY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  the style bottlenecks preloaded at startup.
+ *  switching or blending the styles at runtime needs no style prediction.
+ */
+#define STYLE_GALLERY_MAX   64
+
+typedef struct _style_gallery_t
+{
+    int     size;                   /* dimension of a style */
+    int     num;
+    float   *params;                /* [STYLE_GALLERY_MAX][size] */
+
+    /* the current selection and its blended style */
+    int     sel0, sel1;
+    float   ratio;
+    float   *blended;
+} style_gallery_t;
+
+int   style_gallery_init    (style_gallery_t *gallery, int size);
+void  style_gallery_destroy (style_gallery_t *gallery);
+
+/* copies (param). returns the index, or -1 when the gallery is full. */
+int   style_gallery_add (style_gallery_t *gallery, const float *param);
+const float *style_gallery_get (style_gallery_t *gallery, int idx);
+
+/*
+ *  (1 - ratio) * style[idx0] + ratio * style[idx1].
+ *  the blend is computed only when the selection changes.
+ */
+const float *style_gallery_select (style_gallery_t *gallery, int idx0, int idx1, float ratio);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STYLE_GALLERY_H_ */
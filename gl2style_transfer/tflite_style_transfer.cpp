@@ -5,6 +5,7 @@
 #include "util_tflite.h"
 #include "tflite_style_transfer.h"
 #include "util_debug.h"
+#include "util_featcache.h"
 
 
 #if 0
@@ -71,6 +72,18 @@ get_style_transfer_content_input_buf (int *w, int *h)
     return (float *)s_transfer_tensor_content_in.ptr;
 }
 
+/* identifies the predict model, so that the cached styles follow the model update. */
+uint64_t
+get_style_predict_model_hash ()
+{
+    static uint64_t s_hash = 0;
+
+    if (s_hash == 0 && featcache_hash_file (STYLE_PREDICT_MODEL_PATH, &s_hash) < 0)
+        s_hash = 0;
+
+    return s_hash;
+}
+
 
 /* -------------------------------------------------- *
  * Invoke TensorFlow Lite
@@ -78,7 +91,7 @@ get_style_transfer_content_input_buf (int *w, int *h)
 int
 invoke_style_predict (style_predict_t *predict_result)
 {
-    if (s_interpreter_style_predict.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter_style_predict) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -100,7 +113,7 @@ invoke_style_predict (style_predict_t *predict_result)
 int
 invoke_style_transfer (style_transfer_t *transfered_result)
 {
-    if (s_interpreter_style_transfer.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_interpreter_style_transfer) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -5,6 +5,8 @@
 #ifndef TFLITE_STYLE_TRANSFER_H_
 #define TFLITE_STYLE_TRANSFER_H_
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -27,6 +29,7 @@ int init_tflite_style_transfer ();
 void  *get_style_predict_input_buf (int *w, int *h);
 void  *get_style_transfer_style_input_buf (int *size);
 void  *get_style_transfer_content_input_buf (int *w, int *h);
+uint64_t get_style_predict_model_hash ();
 
 int invoke_style_predict (style_predict_t  *predict_result);
 int invoke_style_transfer(style_transfer_t *transfer_result);
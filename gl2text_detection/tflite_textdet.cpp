@@ -3,8 +3,9 @@
  * Copyright (c) 2019 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_tflite.h"
+#include "util_nms.h"
 #include "tflite_textdet.h"
-#include <list>
+#include <algorithm>
 
 /* 
  * https://tfhub.dev/sayakpaul/lite-model/east-text-detector/int8/1
@@ -19,6 +20,11 @@ static tflite_tensor_t      s_detect_tensor_scores;
 static tflite_tensor_t      s_detect_tensor_geometry;
 static tflite_tensor_t      s_detect_tensor_angle;
 
+/* one slot per score map cell, allocated at init time */
+static detect_region_t      *s_detect_cands;
+static nms_box_t            *s_detect_boxes;
+static nms_t                s_nms;
+
 
 
 
@@ -52,6 +58,14 @@ init_tflite_textdet(int use_quantized_tflite, detect_config_t *config)
         tflite_get_tensor_by_name (&s_detect_interpreter, 1, "feature_fusion/concat_3",       &s_detect_tensor_geometry);
     }
 
+    int score_num = s_detect_tensor_scores.dims[1] * s_detect_tensor_scores.dims[2];
+    s_detect_cands = (detect_region_t *)calloc (score_num, sizeof (detect_region_t));
+    s_detect_boxes = (nms_box_t *)calloc (score_num, sizeof (nms_box_t));
+    if (s_detect_cands == NULL || s_detect_boxes == NULL || nms_init (&s_nms, score_num) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
 
     config->score_thresh = 0.75f;
     config->iou_thresh   = 0.3f;
@@ -111,9 +125,9 @@ get_angle_ptr (int x, int y)
  * https://colab.research.google.com/github/sayakpaul/Adventures-in-TensorFlow-Lite/blob/master/EAST_TFLite.ipynb
  */
 static int
-decode_bounds (std::list<detect_region_t> &detect_list, float score_thresh, int input_img_w, int input_img_h)
+decode_bounds (float score_thresh, int input_img_w, int input_img_h)
 {
-    detect_region_t detect_item;
+    int    num_dets = 0;
     float  *scores_ptr = (float *)s_detect_tensor_scores.ptr;
     float img_w = (float)s_detect_tensor_input.dims[2];
     float img_h = (float)s_detect_tensor_input.dims[1];
@@ -149,114 +163,43 @@ decode_bounds (std::list<detect_region_t> &detect_list, float score_thresh, int
             btmright.x = end_x   / img_w;
             btmright.y = end_y   / img_h;
 
-            detect_item.score    = score;
-            detect_item.topleft  = topleft;
-            detect_item.btmright = btmright;
-            detect_item.angle    = angle;
+            detect_region_t *detect_item = &s_detect_cands[num_dets];
+            detect_item->score    = score;
+            detect_item->topleft  = topleft;
+            detect_item->btmright = btmright;
+            detect_item->angle    = angle;
+
+            nms_box_t *box = &s_detect_boxes[num_dets];
+            box->x0    = topleft.x;
+            box->y0    = topleft.y;
+            box->x1    = btmright.x;
+            box->y1    = btmright.y;
+            box->score = score;
 
-            detect_list.push_back (detect_item);
+            num_dets ++;
         }
     }
-    return 0;
+    return num_dets;
 }
 
 /* -------------------------------------------------- *
  *  Apply NonMaxSuppression:
  *      https://github.com/tensorflow/tfjs/blob/master/tfjs-core/src/ops/image_ops.ts
  * -------------------------------------------------- */
-static float
-calc_intersection_over_union (detect_region_t &region0, detect_region_t &region1)
-{
-    float sx0 = region0.topleft.x;
-    float sy0 = region0.topleft.y;
-    float ex0 = region0.btmright.x;
-    float ey0 = region0.btmright.y;
-    float sx1 = region1.topleft.x;
-    float sy1 = region1.topleft.y;
-    float ex1 = region1.btmright.x;
-    float ey1 = region1.btmright.y;
-    
-    float xmin0 = std::min (sx0, ex0);
-    float ymin0 = std::min (sy0, ey0);
-    float xmax0 = std::max (sx0, ex0);
-    float ymax0 = std::max (sy0, ey0);
-    float xmin1 = std::min (sx1, ex1);
-    float ymin1 = std::min (sy1, ey1);
-    float xmax1 = std::max (sx1, ex1);
-    float ymax1 = std::max (sy1, ey1);
-    
-    float area0 = (ymax0 - ymin0) * (xmax0 - xmin0);
-    float area1 = (ymax1 - ymin1) * (xmax1 - xmin1);
-    if (area0 <= 0 || area1 <= 0)
-        return 0.0f;
-
-    float intersect_xmin = std::max (xmin0, xmin1);
-    float intersect_ymin = std::max (ymin0, ymin1);
-    float intersect_xmax = std::min (xmax0, xmax1);
-    float intersect_ymax = std::min (ymax0, ymax1);
-
-    float intersect_area = std::max (intersect_ymax - intersect_ymin, 0.0f) *
-                           std::max (intersect_xmax - intersect_xmin, 0.0f);
-    
-    return intersect_area / (area0 + area1 - intersect_area);
-}
-
-static bool
-compare (detect_region_t &v1, detect_region_t &v2)
-{
-    if (v1.score > v2.score)
-        return true;
-    else
-        return false;
-}
-
 static int
-non_max_suppression (std::list<detect_region_t> &detect_list, std::list<detect_region_t> &detect_sel_list, float iou_thresh)
+non_max_suppression (int num_dets, int *detect_idx, float iou_thresh)
 {
-    detect_list.sort (compare);
-
-    for (auto itr = detect_list.begin(); itr != detect_list.end(); itr ++)
-    {
-        detect_region_t detect_candidate = *itr;
-
-        int ignore_candidate = false;
-        for (auto itr_sel = detect_sel_list.rbegin(); itr_sel != detect_sel_list.rend(); itr_sel ++)
-        {
-            detect_region_t detect_sel = *itr_sel;
-
-            float iou = calc_intersection_over_union (detect_candidate, detect_sel);
-            if (iou >= iou_thresh)
-            {
-                ignore_candidate = true;
-                break;
-            }
-        }
-
-        if (!ignore_candidate)
-        {
-            detect_sel_list.push_back(detect_candidate);
-            if (detect_sel_list.size() >= MAX_TEXT_NUM)
-                break;
-        }
-    }
-
-    return 0;
+    return nms_hard (&s_nms, s_detect_boxes, num_dets, iou_thresh, MAX_TEXT_NUM, detect_idx);
 }
 
 static void
-pack_detect_result (detect_result_t *detect_result, std::list<detect_region_t> &detect_list)
+pack_detect_result (detect_result_t *detect_result, int *detect_idx, int num_detects)
 {
-    int num_detects = 0;
-    for (auto itr = detect_list.begin(); itr != detect_list.end(); itr ++)
+    for (int i = 0; i < num_detects; i ++)
     {
-        detect_region_t detect = *itr;
-        memcpy (&detect_result->texts[num_detects], &detect, sizeof (detect));
-        num_detects ++;
-        detect_result->num = num_detects;
-
-        if (num_detects >= MAX_TEXT_NUM)
-            break;
+        memcpy (&detect_result->texts[i], &s_detect_cands[detect_idx[i]], sizeof (detect_region_t));
     }
+    detect_result->num = num_detects;
 }
 
 
@@ -266,7 +209,7 @@ pack_detect_result (detect_result_t *detect_result, std::list<detect_region_t> &
 int
 invoke_textdet (detect_result_t *detect_result, detect_config_t *config)
 {
-    if (s_detect_interpreter.interpreter->Invoke() != kTfLiteOk)
+    if (tflite_invoke (&s_detect_interpreter) != 0)
     {
         fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
         return -1;
@@ -274,21 +217,23 @@ invoke_textdet (detect_result_t *detect_result, detect_config_t *config)
 
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<detect_region_t> detect_list;
+    int   detect_idx[MAX_TEXT_NUM];
+    int   num_detects;
 
     int input_img_w = s_detect_tensor_input.dims[2];
     int input_img_h = s_detect_tensor_input.dims[1];
-    decode_bounds (detect_list, score_thresh, input_img_w, input_img_h);
+    int num_dets = decode_bounds (score_thresh, input_img_w, input_img_h);
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<detect_region_t> detect_nms_list;
 
-    non_max_suppression (detect_list, detect_nms_list, iou_thresh);
-    pack_detect_result (detect_result, detect_nms_list);
+    num_detects = non_max_suppression (num_dets, detect_idx, iou_thresh);
 #else
-    pack_detect_result (detect_result, detect_list);
+    num_detects = std::min (num_dets, MAX_TEXT_NUM);
+    for (int i = 0; i < num_detects; i ++)
+        detect_idx[i] = i;
 #endif
+    pack_detect_result (detect_result, detect_idx, num_detects);
 
     return 0;
 }
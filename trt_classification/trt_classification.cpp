@@ -3,6 +3,7 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_trt.h"
+#include "util_topk.h"
 #include "trt_classification.h"
 
 
@@ -10,6 +11,8 @@
 #define PLAN_MODEL_PATH     "./models/mobilenet_v1_1.0_224.plan"
 #define LABEL_MAP_PATH      "./models/class_label.txt"
 
+#define MAX_TOPN            5
+
 static IExecutionContext   *s_trt_context;
 static trt_tensor_t         s_tensor_input;
 static trt_tensor_t         s_tensor_output;
@@ -136,50 +139,10 @@ get_classification_input_buf (int *w, int *h)
 /* -------------------------------------------------- *
  * Invoke TensorRT
  * -------------------------------------------------- */
-static float
-get_scoreval (int class_id)
-{
-    float *val = (float *)s_tensor_output.cpu_mem;
-    return val[class_id];
-}
-
-static int
-push_listitem (std::list<classify_t> &class_list, classify_t &item, size_t topn)
-{
-    size_t idx = 0;
-
-    /* search insert point */
-    for (auto itr = class_list.begin(); itr != class_list.end(); itr ++)
-    {
-        if (item.score > itr->score)
-        {
-            class_list.insert (itr, item);
-            if (class_list.size() > topn)
-            {
-                class_list.pop_back();
-            }
-            return 0;
-        }
-
-        idx ++;
-        if (idx >= topn)
-        {
-            return 0;
-        }
-    }
-
-    /* if list is not full, add item to the bottom */
-    if (class_list.size() < topn)
-    {
-        class_list.push_back (item);
-    }
-    return 0;
-}
-
 int
 invoke_classification (classification_result_t *class_ret)
 {
-    size_t topn = 5;
+    int topn = MAX_TOPN;
 
     /* copy to CUDA buffer */
     trt_copy_tensor_to_gpu (s_tensor_input);
@@ -192,28 +155,18 @@ invoke_classification (classification_result_t *class_ret)
     trt_copy_tensor_from_gpu (s_tensor_output);
 
 
-    std::list<classify_t> classify_list;
-    for (int i = 0; i < MAX_CLASS_NUM; i ++)
-    {
-        classify_t item;
-        item.id = i;
-        item.score = get_scoreval (i);
-
-        push_listitem (classify_list, item, topn);
-    }
+    topk_item_t topk[MAX_TOPN];
+    int count = topk_select_float ((float *)s_tensor_output.cpu_mem, MAX_CLASS_NUM, topn, topk);
 
-    int count = 0;
-    for (auto itr = classify_list.begin(); itr != classify_list.end(); itr ++)
+    for (int i = 0; i < count; i ++)
     {
-        classify_t *item = &class_ret->classify[count];
-
-        item->id    = itr->id;
-        item->score = itr->score;
-        memcpy (item->name, s_class_name[itr->id], 64);
+        classify_t *item = &class_ret->classify[i];
 
-        count ++;
-        class_ret->num = count;
+        item->id    = topk[i].idx;
+        item->score = topk[i].score;
+        memcpy (item->name, s_class_name[topk[i].idx], 64);
     }
+    class_ret->num = count;
 
     return 0;
 }
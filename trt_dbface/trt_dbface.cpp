@@ -3,6 +3,7 @@
  * Copyright (c) 2020 terryky1220@gmail.com
  * ------------------------------------------------ */
 #include "util_trt.h"
+#include "util_nms.h"
 #include "trt_dbface.h"
 #include <unistd.h>
 
@@ -21,6 +22,11 @@ static trt_tensor_t         s_detect_tensor_landmark;
 
 static std::vector<void *>  s_gpu_buffers;
 
+/* one slot per heatmap cell, allocated at init time */
+static nms_box_t            *s_face_boxes;
+static int                  *s_face_cells;
+static nms_t                s_nms;
+
 
 /* -------------------------------------------------- *
  *  create cuda engine
@@ -87,6 +93,16 @@ init_trt_dbface (dbface_config_t *config)
     s_gpu_buffers[s_detect_tensor_box     .bind_idx] = s_detect_tensor_box     .gpu_mem;
     s_gpu_buffers[s_detect_tensor_landmark.bind_idx] = s_detect_tensor_landmark.gpu_mem;
 
+    /* crowded scenes can light up a lot of heatmap cells. */
+    int hm_num = s_detect_tensor_hm.dims.d[1] * s_detect_tensor_hm.dims.d[2];
+    s_face_boxes = (nms_box_t *)calloc (hm_num, sizeof (nms_box_t));
+    s_face_cells = (int *)calloc (hm_num, sizeof (int));
+    if (s_face_boxes == NULL || s_face_cells == NULL || nms_init (&s_nms, hm_num) < 0)
+    {
+        fprintf (stderr, "ERR: %s(%d)\n", __FILE__, __LINE__);
+        return -1;
+    }
+
     config->score_thresh = 0.3f;
     config->iou_thresh   = 0.3f;
 
@@ -137,12 +153,12 @@ _exp (float v)
 
 
 static int
-decode_bounds (std::list<face_t> &face_list, float score_thresh)
+decode_bounds (float score_thresh)
 {
-    face_t face_item;
     float  *scores_ptr = (float *)s_detect_tensor_hm.cpu_mem;
     int score_w = s_detect_tensor_hm.dims.d[2];
     int score_h = s_detect_tensor_hm.dims.d[1];
+    int num_dets = 0;
 
     for (int y = 0; y < score_h; y ++)
     {
@@ -160,33 +176,19 @@ decode_bounds (std::list<face_t> &face_list, float score_thresh)
             float bw = p[2];
             float bh = p[3];
 
-            fvec2 topleft, btmright;
-            topleft.x  = (x - bx) / (float)score_w;
-            topleft.y  = (y - by) / (float)score_h;
-            btmright.x = (x + bw) / (float)score_w;
-            btmright.y = (y + bh) / (float)score_h;
-
-            face_item.score    = score;
-            face_item.topleft  = topleft;
-            face_item.btmright = btmright;
-
-            /* landmark positions (5 keys) */
-            float *lm = get_landmark_ptr (idx);
-            for (int j = 0; j < kFaceKeyNum; j ++)
-            {
-                float lx = lm[j    ] * 4;
-                float ly = lm[j + 5] * 4;
-                lx = (_exp (lx) + x) / (float)score_w;
-                ly = (_exp (ly) + y) / (float)score_h;
-
-                face_item.keys[j].x = lx;
-                face_item.keys[j].y = ly;
-            }
-
-            face_list.push_back (face_item);
+            nms_box_t *box = &s_face_boxes[num_dets];
+            box->x0    = (x - bx) / (float)score_w;
+            box->y0    = (y - by) / (float)score_h;
+            box->x1    = (x + bw) / (float)score_w;
+            box->y1    = (y + bh) / (float)score_h;
+            box->score = score;
+
+            /* landmarks are decoded later, only for the faces which survive NMS. */
+            s_face_cells[num_dets] = idx;
+            num_dets ++;
         }
     }
-    return 0;
+    return num_dets;
 }
 
 
@@ -194,99 +196,46 @@ decode_bounds (std::list<face_t> &face_list, float score_thresh)
  *  Apply NonMaxSuppression:
  *      https://github.com/tensorflow/tfjs/blob/master/tfjs-core/src/ops/image_ops.ts
  * -------------------------------------------------- */
-static float
-calc_intersection_over_union (face_t &face0, face_t &face1)
+static int
+non_max_suppression (int num_dets, int *face_idx, float iou_thresh)
 {
-    float sx0 = face0.topleft.x;
-    float sy0 = face0.topleft.y;
-    float ex0 = face0.btmright.x;
-    float ey0 = face0.btmright.y;
-    float sx1 = face1.topleft.x;
-    float sy1 = face1.topleft.y;
-    float ex1 = face1.btmright.x;
-    float ey1 = face1.btmright.y;
-    
-    float xmin0 = std::min (sx0, ex0);
-    float ymin0 = std::min (sy0, ey0);
-    float xmax0 = std::max (sx0, ex0);
-    float ymax0 = std::max (sy0, ey0);
-    float xmin1 = std::min (sx1, ex1);
-    float ymin1 = std::min (sy1, ey1);
-    float xmax1 = std::max (sx1, ex1);
-    float ymax1 = std::max (sy1, ey1);
-    
-    float area0 = (ymax0 - ymin0) * (xmax0 - xmin0);
-    float area1 = (ymax1 - ymin1) * (xmax1 - xmin1);
-    if (area0 <= 0 || area1 <= 0)
-        return 0.0f;
-
-    float intersect_xmin = std::max (xmin0, xmin1);
-    float intersect_ymin = std::max (ymin0, ymin1);
-    float intersect_xmax = std::min (xmax0, xmax1);
-    float intersect_ymax = std::min (ymax0, ymax1);
-
-    float intersect_area = std::max (intersect_ymax - intersect_ymin, 0.0f) *
-                           std::max (intersect_xmax - intersect_xmin, 0.0f);
-    
-    return intersect_area / (area0 + area1 - intersect_area);
+    return nms_hard (&s_nms, s_face_boxes, num_dets, iou_thresh, MAX_FACE_NUM, face_idx);
 }
 
-static bool
-compare (face_t &v1, face_t &v2)
-{
-    if (v1.score > v2.score)
-        return true;
-    else
-        return false;
-}
-
-static int
-non_max_suppression (std::list<face_t> &face_list, std::list<face_t> &face_sel_list, float iou_thresh)
+static void
+pack_face_result (dbface_result_t *face_result, int *face_idx, int num_faces)
 {
-    face_list.sort (compare);
+    int score_w = s_detect_tensor_hm.dims.d[2];
+    int score_h = s_detect_tensor_hm.dims.d[1];
 
-    for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
+    for (int i = 0; i < num_faces; i ++)
     {
-        face_t face_candidate = *itr;
-
-        int ignore_candidate = false;
-        for (auto itr_sel = face_sel_list.rbegin(); itr_sel != face_sel_list.rend(); itr_sel ++)
+        nms_box_t *box = &s_face_boxes[face_idx[i]];
+        int idx = s_face_cells[face_idx[i]];
+        int x   = idx % score_w;
+        int y   = idx / score_w;
+        face_t *face = &face_result->faces[i];
+
+        face->score      = box->score;
+        face->topleft.x  = box->x0;
+        face->topleft.y  = box->y0;
+        face->btmright.x = box->x1;
+        face->btmright.y = box->y1;
+
+        /* landmark positions (5 keys) */
+        float *lm = get_landmark_ptr (idx);
+        for (int j = 0; j < kFaceKeyNum; j ++)
         {
-            face_t face_sel = *itr_sel;
-
-            float iou = calc_intersection_over_union (face_candidate, face_sel);
-            if (iou >= iou_thresh)
-            {
-                ignore_candidate = true;
-                break;
-            }
-        }
+            float lx = lm[j    ] * 4;
+            float ly = lm[j + 5] * 4;
+            lx = (_exp (lx) + x) / (float)score_w;
+            ly = (_exp (ly) + y) / (float)score_h;
 
-        if (!ignore_candidate)
-        {
-            face_sel_list.push_back(face_candidate);
-            if (face_sel_list.size() >= MAX_FACE_NUM)
-                break;
+            face->keys[j].x = lx;
+            face->keys[j].y = ly;
         }
     }
-
-    return 0;
-}
-
-static void
-pack_face_result (dbface_result_t *face_result, std::list<face_t> &face_list)
-{
-    int num_faces = 0;
-    for (auto itr = face_list.begin(); itr != face_list.end(); itr ++)
-    {
-        face_t face = *itr;
-        memcpy (&face_result->faces[num_faces], &face, sizeof (face));
-        num_faces ++;
-        face_result->num = num_faces;
-
-        if (num_faces >= MAX_FACE_NUM)
-            break;
-    }
+    face_result->num = num_faces;
 }
 
 
@@ -311,19 +260,21 @@ invoke_dbface (dbface_result_t *face_result, dbface_config_t *config)
 
     /* decode boundary box and landmark keypoints */
     float score_thresh = config->score_thresh;
-    std::list<face_t> face_list;
+    int   face_idx[MAX_FACE_NUM];
+    int   num_faces;
 
-    decode_bounds (face_list, score_thresh);
+    int num_dets = decode_bounds (score_thresh);
 
 #if 1 /* USE NMS */
     float iou_thresh = config->iou_thresh;
-    std::list<face_t> face_nms_list;
 
-    non_max_suppression (face_list, face_nms_list, iou_thresh);
-    pack_face_result (face_result, face_nms_list);
+    num_faces = non_max_suppression (num_dets, face_idx, iou_thresh);
 #else
-    pack_face_result (face_result, face_list);
+    num_faces = std::min (num_dets, MAX_FACE_NUM);
+    for (int i = 0; i < num_faces; i ++)
+        face_idx[i] = i;
 #endif
+    pack_face_result (face_result, face_idx, num_faces);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "util_matrix.h"
 #include "trt_dense_depth.h"
 #include "util_camera_capture.h"
@@ -32,15 +33,10 @@ static imgui_data_t s_gui_prop = {0};
 void
 feed_dense_depth_image(texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_dense_depth_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
@@ -50,67 +46,32 @@ feed_dense_depth_image(texture_2d_t *srctex, int win_w, int win_h)
     /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
     float mean = 128.0f;
     float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-        }
-    }
+    preproc_rgba_to_fp32 (buf_ui8, w, h, buf_fp32, mean, std);
 
     return;
 }
 
 
 
-float
-fclampf (float val)
-{
-    val = fmaxf (0.0f, val);
-    val = fminf (1.0f, val);
-    return val;
-}
-
 static void
 render_depth_image (texture_2d_t *srctex, int ofstx, int ofsty, int texw, int texh,
                     dense_depth_result_t *dense_depth_ret)
 {
+    static stream_texture_t s_depthtex;
     float *depthmap = dense_depth_ret->depthmap;
     int depthmap_w  = dense_depth_ret->depthmap_dims[0];
     int depthmap_h  = dense_depth_ret->depthmap_dims[1];
-    int x, y;
-    unsigned int imgbuf[depthmap_h][depthmap_w];
-
-    /* find the most confident class for each pixel. */
-    for (y = 0; y < depthmap_h; y ++)
-    {
-        for (x = 0; x < depthmap_w; x ++)
-        {
-            float d = depthmap[y * depthmap_w + x];
-            d -= 0.0;
-            d /= 10.0;
-            d = fclampf (d);
+    unsigned char imgbuf[depthmap_h][depthmap_w];
 
-            unsigned char r = d * 255;
-            unsigned char g = r;
-            unsigned char b = r;
-            unsigned char a = 255;
+    /* depth [0, 10] --> gray [0, 255] */
+    preproc_fp32_to_gray (depthmap, depthmap_w * depthmap_h, 1, 1.0f / 10.0f, 0.0f, &imgbuf[0][0]);
 
-            imgbuf[y][x] = (a << 24) | (b << 16) | (g << 8) | (r);
-        }
-    }
-
-    texture_2d_t animtex;
-    create_2d_texture_ex (&animtex, imgbuf, depthmap_w, depthmap_h, pixfmt_fourcc ('R', 'G', 'B', 'A'));
-    draw_2d_texture_ex (&animtex, ofstx, ofsty, texw, texh, 0);
+    texture_2d_t *animtex = update_stream_texture (&s_depthtex, imgbuf, depthmap_w, depthmap_h,
+                                                   pixfmt_fourcc ('Y', '8', '0', '0'));
+    if (animtex == NULL)
+        return;
 
-    glDeleteTextures (1, &animtex.texid);
+    draw_2d_texture_ex (animtex, ofstx, ofsty, texw, texh, 0);
 }
 
 
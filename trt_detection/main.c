@@ -12,6 +12,7 @@
 #include "util_pmeter.h"
 #include "util_texture.h"
 #include "util_render2d.h"
+#include "util_preprocess.h"
 #include "trt_detection.h"
 #include "util_camera_capture.h"
 #include "util_video_decode.h"
@@ -24,46 +25,20 @@
 void
 feed_detect_image (texture_2d_t *srctex, int win_w, int win_h)
 {
-    int x, y, w, h;
+    int w, h;
     float *buf_fp32 = (float *)get_detect_input_buf (&w, &h);
-    unsigned char *buf_ui8 = NULL;
-    static unsigned char *pui8 = NULL;
-
-    if (pui8 == NULL)
-        pui8 = (unsigned char *)malloc(w * h * 4);
-
-    buf_ui8 = pui8;
+    static preproc_buf_t s_readbuf;
+    unsigned char *buf_ui8 = (unsigned char *)preproc_buf_reserve (&s_readbuf, w * h * 4);
 
     draw_2d_texture_ex (srctex, 0, win_h - h, w, h, 1);
 
     glPixelStorei (GL_PACK_ALIGNMENT, 4);
     glReadPixels (0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, buf_ui8);
 
-    /* convert UI8 [0, 255] ==> FP32 [-1, 1] */
-    float mean = 128.0f;
-    float std  = 128.0f;
-    for (y = 0; y < h; y ++)
-    {
-        for (x = 0; x < w; x ++)
-        {
-            int r = *buf_ui8 ++;
-            int g = *buf_ui8 ++;
-            int b = *buf_ui8 ++;
-            buf_ui8 ++;          /* skip alpha */
-#if 1
-			/* CHW */
-            int plane_size = w * h;
-            buf_fp32[(w * y + x) + plane_size * 0] = (float)(r - mean) / std;
-            buf_fp32[(w * y + x) + plane_size * 1] = (float)(g - mean) / std;
-            buf_fp32[(w * y + x) + plane_size * 2] = (float)(b - mean) / std;
-#else
-			/* HWC */
-            *buf_fp32 ++ = (float)(r - mean) / std;
-            *buf_fp32 ++ = (float)(g - mean) / std;
-            *buf_fp32 ++ = (float)(b - mean) / std;
-#endif
-        }
-    }
+    /* convert UI8 [0, 255] ==> FP32 [-1, 1] (CHW) */
+    preproc_norm_t norm;
+    preproc_norm_set (&norm, 128.0f, 128.0f);
+    preproc_rgba_to_fp32_ex (buf_ui8, w, h, 0, buf_fp32, &norm, PREPROC_FLAG_CHW);
 
     return;
 }
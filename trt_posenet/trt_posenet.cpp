@@ -4,8 +4,12 @@
  * ------------------------------------------------ */
 #include "util_trt.h"
 #include "trt_posenet.h"
+#include "util_heatmap.h"
 #include <unistd.h>
 #include <float.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
 
 #define UFF_MODEL_PATH      "./models/posenet_mobilenet_v1_100_257x257_multi_kpt_stripped.uff"
 #define PLAN_MODEL_PATH     "./models/posenet_mobilenet_v1_100_257x257_multi_kpt_stripped.plan"
@@ -23,6 +27,7 @@ static int     s_img_h = 0;
 static int     s_hmp_w = 0;
 static int     s_hmp_h = 0;
 static int     s_edge_num = 0;
+static int     s_max_pose_num = DEFAULT_POSE_NUM;
 
 typedef struct part_score_t {
     float score;
@@ -164,6 +169,12 @@ init_trt_posenet ()
     return 0;
 }
 
+void
+set_posenet_max_pose_num (int num)
+{
+    s_max_pose_num = std::min (std::max (num, 1), MAX_POSE_NUM);
+}
+
 void *
 get_posenet_input_buf (int *w, int *h)
 {
@@ -202,80 +213,24 @@ get_offset_vector (float *ofst_x, float *ofst_y, int idx_y, int idx_x, int pose_
     *ofst_y = offsets_ptr[idx1];
 }
 
-/* enqueue an item in descending order. */
-static void
-enqueue_score (std::list<part_score_t> &queue, int x, int y, int key, float score)
-{
-    std::list<part_score_t>::iterator itr;
-    for (itr = queue.begin(); itr != queue.end(); itr++)
-    {
-        if (itr->score < score)
-            break;
-    }
+#define MAX_PART_CANDIDATES 1024
 
-    part_score_t item;
-    item.score = score;
-    item.idx_x = x;
-    item.idx_y = y;
-    item.key_id= key;
-    queue.insert(itr, item);
-}
+static heatmap_t      s_heatmap;
+static heatmap_peak_t s_peaks[MAX_PART_CANDIDATES];
 
 /*
- * If the score is the highest in local window, return true.
- *
- *    xs    xe
- *   +--+--+--+
- *   |  |  |  | ys
- *   +--+--+--+
- *   |  |##|  |         ##: (idx_x, idx_y)
- *   +--+--+--+
- *   |  |  |  | ye
- *   +--+--+--+
+ *  candidate root parts: the parts which have the highest score in the local
+ *  window ((2 * max_rad + 1) square), in descending order of the score.
+ *  heatmap_find_peaks() keeps the best ones in a binary heap.
  */
-static bool
-score_is_max_in_local_window (int key, float score, int idx_y, int idx_x, int max_rad)
-{
-    int xs = std::max (idx_x - max_rad,     0);
-    int ys = std::max (idx_y - max_rad,     0);
-    int xe = std::min (idx_x + max_rad + 1, s_hmp_w);
-    int ye = std::min (idx_y + max_rad + 1, s_hmp_h);
-
-    for (int y = ys; y < ye; y ++)
-    {
-        for (int x = xs; x < xe; x ++)
-        {
-            /* if a higher score is found, return false */
-            if (get_heatmap_score (y, x, key) > score)
-                return false;
-        }
-    }
-    return true;
-}
-
-static void
-build_score_queue (std::list<part_score_t> &queue, float thresh, int max_rad)
+static int
+build_score_queue (float thresh, int max_rad)
 {
-    for (int y = 0; y < s_hmp_h; y ++)
-    {
-        for (int x = 0; x < s_hmp_w; x ++)
-        {
-            for (int key = 0; key < kPoseKeyNum; key ++)
-            {
-                float score = get_heatmap_score (y, x, key);
-
-                /* if this score is lower than thresh, skip this pixel. */
-                if (score < thresh)
-                    continue;
-
-                /* if there is a higher score near this pixel, skip this pixel. */
-                if (!score_is_max_in_local_window (key, score, y, x, max_rad))
-                    continue;
+    float *heatmap_ptr = (float *)s_tensor_heatmap.cpu_mem;
+    if (heatmap_load (&s_heatmap, heatmap_ptr, s_hmp_w, s_hmp_h, kPoseKeyNum, 0) < 0)
+        return 0;
 
-                enqueue_score (queue, x, y, key, score);
-            }
-        }
-    }
+    return heatmap_find_peaks (&s_heatmap, max_rad, thresh, s_peaks, MAX_PART_CANDIDATES);
 }
 
 /*
@@ -398,35 +353,111 @@ decode_pose (part_score_t &root, keypoint_t *keys)
     }
 }
 
-static bool
-within_nms_of_corresponding_point (posenet_result_t *pose_result,
-                        float pos_x, float pos_y, int key_id, float nms_rad)
+/*
+ *  keypoints of the registered poses, bucketed into (nms_rad) square cells
+ *  for each key. any point within (nms_rad) from (x, y) is in the 3x3 cells
+ *  around the cell of (x, y).
+ */
+typedef struct nms_grid_t
 {
-    for (int i = 0; i < pose_result->num; i ++)
+    float cell;
+    int   cols, rows;
+    std::vector<int> head;                      /* [kPoseKeyNum][rows][cols]. -1: empty */
+    int   next[kPoseKeyNum][MAX_POSE_NUM];
+    float pos [kPoseKeyNum][MAX_POSE_NUM][2];   /* in input image pixels */
+    int   num;
+} nms_grid_t;
+
+static nms_grid_t s_nms_grid;
+
+static int
+nms_grid_cell (nms_grid_t *grid, float pos, int num)
+{
+    int idx = (int)floorf (pos / grid->cell);
+    return std::min (std::max (idx, 0), num - 1);
+}
+
+static void
+nms_grid_reset (nms_grid_t *grid, float nms_rad)
+{
+    int cols = (int)ceilf (s_img_w / nms_rad);
+    int rows = (int)ceilf (s_img_h / nms_rad);
+
+    if (grid->cell != nms_rad || grid->cols != cols || grid->rows != rows)
     {
-        pose_t *pose = &pose_result->pose[i];
-        float prev_pos_x = pose->key[key_id].x * s_img_w;
-        float prev_pos_y = pose->key[key_id].y * s_img_h;
+        grid->cell = nms_rad;
+        grid->cols = cols;
+        grid->rows = rows;
+        grid->head.assign (kPoseKeyNum * rows * cols, -1);
+        grid->num  = 0;
+        return;
+    }
 
-        float dx = pos_x - prev_pos_x;
-        float dy = pos_y - prev_pos_y;
-        float len = (dx * dx) + (dy * dy);
+    /* clear only the used cells */
+    for (int key = 0; key < kPoseKeyNum; key ++)
+    {
+        for (int i = 0; i < grid->num; i ++)
+        {
+            int cx = nms_grid_cell (grid, grid->pos[key][i][0], cols);
+            int cy = nms_grid_cell (grid, grid->pos[key][i][1], rows);
+            grid->head[(key * rows + cy) * cols + cx] = -1;
+        }
+    }
+    grid->num = 0;
+}
+
+static void
+nms_grid_add (nms_grid_t *grid, keypoint_t *keys)
+{
+    int id = grid->num ++;
 
-        if (len <= (nms_rad * nms_rad))
-            return true;
+    for (int key = 0; key < kPoseKeyNum; key ++)
+    {
+        int cx = nms_grid_cell (grid, keys[key].pos_x, grid->cols);
+        int cy = nms_grid_cell (grid, keys[key].pos_y, grid->rows);
+        int *head = &grid->head[(key * grid->rows + cy) * grid->cols + cx];
+
+        grid->pos[key][id][0] = keys[key].pos_x;
+        grid->pos[key][id][1] = keys[key].pos_y;
+        grid->next[key][id]   = *head;
+        *head = id;
+    }
+}
+
+static bool
+within_nms_of_corresponding_point (nms_grid_t *grid, float pos_x, float pos_y, int key_id)
+{
+    int cx = nms_grid_cell (grid, pos_x, grid->cols);
+    int cy = nms_grid_cell (grid, pos_y, grid->rows);
+    float rad2 = grid->cell * grid->cell;
+
+    for (int y = std::max (cy - 1, 0); y <= std::min (cy + 1, grid->rows - 1); y ++)
+    {
+        for (int x = std::max (cx - 1, 0); x <= std::min (cx + 1, grid->cols - 1); x ++)
+        {
+            int id = grid->head[(key_id * grid->rows + y) * grid->cols + x];
+            for (; id >= 0; id = grid->next[key_id][id])
+            {
+                float dx = pos_x - grid->pos[key_id][id][0];
+                float dy = pos_y - grid->pos[key_id][id][1];
+
+                if ((dx * dx) + (dy * dy) <= rad2)
+                    return true;
+            }
+        }
     }
     return false;
 }
 
 static float
-get_instance_score (posenet_result_t *pose_result, keypoint_t *keys, float nms_rad)
+get_instance_score (nms_grid_t *grid, keypoint_t *keys)
 {
     float score_total = 0.0f;
     for (int i = 0; i < kPoseKeyNum; i ++)
     {
         float pos_x = keys[i].pos_x;
         float pos_y = keys[i].pos_y;
-        if (within_nms_of_corresponding_point (pose_result, pos_x, pos_y, i, nms_rad))
+        if (within_nms_of_corresponding_point (grid, pos_x, pos_y, i))
             continue;
 
         score_total += keys[i].score;
@@ -461,34 +492,34 @@ regist_detected_pose (posenet_result_t *pose_result, keypoint_t *keys, float sco
 static void
 decode_multiple_poses (posenet_result_t *pose_result)
 {
-    std::list<part_score_t> queue;
-
     float score_thresh  = 0.5f;
     int   local_max_rad = 1;
-    build_score_queue (queue, score_thresh, local_max_rad);
+    int   num_parts = build_score_queue (score_thresh, local_max_rad);
+
+    float nms_rad = 20.0f;
+    nms_grid_reset (&s_nms_grid, nms_rad);
 
     memset (pose_result, 0, sizeof (posenet_result_t));
-    while (pose_result->num < MAX_POSE_NUM && !queue.empty())
+    for (int i = 0; i < num_parts && pose_result->num < s_max_pose_num; i ++)
     {
-        part_score_t &root = queue.front();
+        part_score_t root;
+        root.score  = s_peaks[i].score;
+        root.idx_x  = s_peaks[i].x;
+        root.idx_y  = s_peaks[i].y;
+        root.key_id = s_peaks[i].key;
 
         float pos_x, pos_y;
         get_index_to_pos (root.idx_x, root.idx_y, root.key_id, &pos_x, &pos_y);
 
-        float nms_rad = 20.0f;
-        if (within_nms_of_corresponding_point (pose_result, pos_x, pos_y, root.key_id, nms_rad))
-        {
-            queue.pop_front();
+        if (within_nms_of_corresponding_point (&s_nms_grid, pos_x, pos_y, root.key_id))
             continue;
-        }
 
         keypoint_t key_points[kPoseKeyNum] = {0};
         decode_pose (root, key_points);
 
-        float score = get_instance_score (pose_result, key_points, nms_rad);
-        regist_detected_pose (pose_result, key_points, score);
-
-        queue.pop_front();
+        float score = get_instance_score (&s_nms_grid, key_points);
+        if (regist_detected_pose (pose_result, key_points, score) == 0)
+            nms_grid_add (&s_nms_grid, key_points);
     }
 }
 